@@ -0,0 +1,61 @@
+//
+// async_echo.em
+//
+
+// echo benchmark for async functions.
+//
+// it opens CONNECTIONS socket pairs on one thread. every pair
+// has a server coroutine which echoes back whatever it reads,
+// and a client coroutine which sends MESSAGES messages of
+// MESSAGE_SIZE bytes one at a time, waiting for each echo.
+// all of them are multiplexed by the event loop in async.bc,
+// without a thread per connection.
+//
+// build it, and time the executable:
+//     emc benchmarks/async_echo.em -o async_echo
+//     time ./async_echo
+//
+// (total round trips = CONNECTIONS * MESSAGES)
+
+#include <async.emh>
+
+const int CONNECTIONS = 1000;
+const int MESSAGES = 1000;
+const int MESSAGE_SIZE = 64;
+
+async void server(s32 fd) {
+    while (true) {
+        if (echo_pending(fd) > 0) {
+            await wait_writable(fd);
+        } else {
+            await wait_readable(fd);
+        }
+        int n = echo(fd);
+        if (n == 0) {
+            close_fd(fd);
+            return;
+        }
+    }
+}
+
+async void client(s32 fd) {
+    int received = 0;
+    while (received < MESSAGES) {
+        send_bytes(fd, MESSAGE_SIZE);
+        await wait_readable(fd);
+        if (recv_bytes(fd, MESSAGE_SIZE) > 0) {
+            received++;
+        }
+    }
+    close_fd(fd);
+}
+
+int main() {
+    for (int i = 0; i < CONNECTIONS; i++) {
+        s32 fd = socket_pair();
+        server(socket_peer(fd));
+        client(fd);
+    }
+    run_event_loop();
+    return 0;
+}
@@ -0,0 +1,108 @@
+//
+// frontend_bench.cpp
+//
+
+// frontend scaling benchmark: how the frontend (lexing, parsing
+// and IR generation) of emc scales with the number of threads,
+// with the C runtime's malloc, or with the allocator in alloc.cpp.
+//
+// the given files are compiled ROUNDS times over, on 1, 2, 4, ...
+// threads (up to the number of cores, or the -threads given), the
+// same way as emc does it (each thread keeps taking the next file),
+// and the files per second are printed, along with the speedup
+// over a single thread.
+//
+// build it twice, with and without the allocator, and run both
+// on the same files (a lot of small ones is the case to look at):
+//     clang++ -O2 -std=c++17 benchmarks/frontend_bench.cpp src/lexer.cpp src/parser.cpp src/ir_generator.cpp src/linker.cpp src/counters.cpp -o frontend_bench -lLLVM-21
+//     clang++ -O2 -std=c++17 -DEMC_FAST_ALLOC benchmarks/frontend_bench.cpp src/alloc.cpp src/lexer.cpp src/parser.cpp src/ir_generator.cpp src/linker.cpp src/counters.cpp -o frontend_bench_fast -lLLVM-21
+//     ./frontend_bench tests/positive/*.em
+//     ./frontend_bench_fast tests/positive/*.em
+
+#include "../src/parser.h"
+#include "../src/ir_generator.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROUNDS 20
+
+// compiles every file ROUNDS times, on the given number of threads,
+// and returns the time that it took (in seconds). returns -1 if a
+// file has errors (they are reported by the lexer/parser as usual).
+static double run_frontend(std::vector<const char *> &files, size_t num_threads) {
+    std::atomic<size_t> next_file(0);
+    std::atomic<bool> failed(false);
+    size_t total = files.size() * ROUNDS;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; t++) {
+        threads.emplace_back([&]() {
+            size_t i;
+            while ((i = next_file++) < total && !failed) {
+                Lexer *lexer = perform_lexical_analysis(files[i % files.size()]);
+                auto *ast = lexer ? parse_tokens(lexer) : nullptr;
+                if (!ast) {
+                    failed = true;
+                    delete lexer;
+                    break;
+                }
+
+                LLVM_IR *ir = emit_llvm_ir(ast, lexer->file_name.c_str(), "", true, nullptr, false, false, nullptr, nullptr);
+                free_llvm_ir(ir);
+                delete lexer;
+                delete ast;
+            }
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    return failed ? -1 : ((std::chrono::duration<double>)(end - start)).count();
+}
+
+int main(int argc, char **argv) {
+    std::vector<const char *> files;
+    size_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-threads") == 0 && i < argc - 1)
+            max_threads = (size_t)atoi(argv[++i]);
+        else
+            files.push_back(argv[i]);
+    }
+    if (files.empty() || max_threads == 0) {
+        fprintf(stderr, "usage: frontend_bench [-threads <max>] <file.em> ...\n");
+        return 1;
+    }
+
+#ifdef EMC_FAST_ALLOC
+    printf("allocator: alloc.cpp (EMC_FAST_ALLOC)\n");
+#else
+    printf("allocator: C runtime malloc\n");
+#endif
+    printf("%zu files, %d rounds\n\n", files.size(), ROUNDS);
+    printf("threads    files/s    speedup\n");
+
+    double single_thread_rate = 0;
+    for (size_t num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        double seconds = run_frontend(files, num_threads);
+        if (seconds < 0) {
+            fprintf(stderr, "\nERROR: The files must compile without errors.\n");
+            return 1;
+        }
+
+        double rate = files.size() * ROUNDS / seconds;
+        if (num_threads == 1)
+            single_thread_rate = rate;
+        printf("%7zu %10.0f %9.2fx\n", num_threads, rate, rate / single_thread_rate);
+    }
+    return 0;
+}
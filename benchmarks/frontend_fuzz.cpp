@@ -0,0 +1,524 @@
+//
+// frontend_fuzz.cpp
+//
+
+// compile time fuzzer: looks for Em programs that make the frontend
+// (lexing and parsing) of emc take more than linear time in the size
+// of the program, like
+//     - the separator pre-scan of a call (in parse_ast_function_call),
+//       with calls nested in the arguments of calls
+//     - the recursion in parse_ast_subexpression, with deeply nested
+//       expressions
+//     - the linear probing of smap, with a lot of names
+//     - the walk over the scopes in Symbol_Table::exists, with deeply
+//       nested blocks
+//
+// the bytes from libFuzzer aren't compiled as they are (almost none
+// of them would get past the lexer), but are read as the choices for
+// a generator of Em programs, so that every input is a valid program.
+// each program is generated at two sizes (for the larger one, the
+// statements and the globals are repeated SCALE times over, and the
+// nesting is SCALE times deeper), both are compiled, and the time per
+// byte of both is compared. if the time grows faster than the size to
+// the MAX_EXPONENT, the larger program is saved in the output directory
+// (with what was measured, in a comment at the top), to be looked at
+// later.
+//
+// build it with libFuzzer, and run it for a while (the programs are
+// leaked on errors, so the leak detection has to be off):
+//     clang++ -g -O2 -std=c++17 -fsanitize=fuzzer benchmarks/frontend_fuzz.cpp src/lexer.cpp src/parser.cpp src/ir_generator.cpp src/linker.cpp src/counters.cpp -o frontend_fuzz -lLLVM-21
+//     mkdir corpus superlinear
+//     ./frontend_fuzz -detect_leaks=0 -max_len=256 corpus
+//
+// the directory for the programs can be changed with EMC_FUZZ_OUTPUT,
+// and the exponent with EMC_FUZZ_MAX_EXPONENT. without libFuzzer, build
+// it with -DFUZZ_STANDALONE, and it runs the given inputs (or random
+// ones, with -runs <n>) through the same check.
+//
+// (only the lexer and the parser are run, since the errors from the IR
+// generation still exit, instead of going through error_recovery_hook.
+// the generator doesn't make programs with errors, but the fuzzer
+// shouldn't exit on one if it does.)
+
+#include "../src/parser.h"
+#include <algorithm>
+#include <chrono>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define SCALE 4
+#define MAX_EXPONENT 1.75
+#define MIN_SECONDS 0.001 // (the larger program, below which it is all noise)
+#define TIMED_RUNS 3      // (the fastest of these is taken)
+
+
+//                   Generating the programs
+/* *********************************************************** */
+
+// the input, read as a sequence of choices (from the start again,
+// once it runs out)
+struct Choices {
+    const uint8_t *data;
+    size_t size;
+    size_t pos = 0;
+
+    int next(int n) { return size ? data[pos++ % size] % n : 0; }
+};
+
+struct Generator {
+    Choices choices;
+    int scale;
+    std::string out;
+
+    std::vector<int> function_params; // (the number of parameters, of each function so far)
+    std::vector<std::vector<std::string>> scopes;
+    int num_variables = 0;
+    int depth = 0; // (of the blocks)
+
+    Generator(const uint8_t *data, size_t size, int scale)
+        : choices{data, size}, scale(scale) {}
+
+    void indent() { out.append(4 * depth, ' '); }
+
+    // a depth from the input, that grows with the scale
+    int scaled(int n) { return (1 + choices.next(n)) * scale; }
+
+    // runs body a number of times (from the input), and for the larger
+    // program, does all of that scale times over, with the same choices
+    // each time. (so that the larger program is the smaller one, with
+    // this part repeated, and not a different program altogether.)
+    template <typename Body> void repeat(int n, Body body) {
+        int count = 1 + choices.next(n);
+        size_t start = choices.pos, end = start;
+        for (int copy = 0; copy < scale; copy++) {
+            choices.pos = start;
+            for (int i = 0; i < count; i++)
+                body();
+            if (copy == 0) end = choices.pos;
+        }
+        choices.pos = end;
+    }
+
+    std::string any_variable() {
+        // (the scopes are picked from the outermost one that has any
+        // variables, so that the lookups go through all of the scopes)
+        int first = 0;
+        while (first < (int)scopes.size() - 1 && scopes[first].empty())
+            first++;
+        std::vector<std::string> &scope =
+            scopes[first + choices.next((int)scopes.size() - first)];
+        if (scope.empty())
+            return scopes[first].empty() ? "1" : scopes[first][0];
+        return scope[choices.next((int)scope.size())];
+    }
+
+    std::string term() {
+        if (choices.next(2) == 0) return std::to_string(1 + choices.next(99));
+        return any_variable();
+    }
+
+    // (without any parentheses. only these can come before the last
+    // argument of a call, since the separators are counted up to the
+    // first ')' in parse_ast_function_call.)
+    void flat_expression() {
+        static const char *operators[] = {" + ", " - ", " * ", " / ", " % "};
+        int length = choices.next(4) == 0 ? 1 + choices.next(32) : 1 + choices.next(3);
+        for (int i = 0; i < length; i++) {
+            if (i > 0) out += operators[choices.next(5)];
+            out += term();
+        }
+    }
+
+    // (both sides in parentheses, since the comparisons don't have a
+    // lower precedence than all of the arithmetic)
+    void condition() {
+        static const char *comparisons[] = {") < (", ") > (", ") == (", ") != ("};
+        out += "(";
+        flat_expression();
+        out += comparisons[choices.next(4)];
+        flat_expression();
+        out += ")";
+    }
+
+    // (inside the argument of a call, there can't be a call with more
+    // than one parameter either, since its separators would be counted
+    // as well)
+    void expression(int max_depth, bool inside_call = false) {
+        if (max_depth <= 0) {
+            flat_expression();
+            return;
+        }
+
+        switch (choices.next(5)) {
+        case 0: // (deeply nested parentheses)
+        {
+            int nesting = scaled(16);
+            for (int i = 0; i < nesting; i++) out += "(";
+            expression(max_depth - 1, inside_call);
+            for (int i = 0; i < nesting; i++) out += " + 1)";
+            break;
+        }
+        case 1:
+            out += "(";
+            expression(max_depth - 1, inside_call);
+            out += " * ";
+            expression(max_depth - 1, inside_call);
+            out += ")";
+            break;
+        case 2: // (deeply nested calls, each of which scans to the innermost ')')
+        {
+            int function = any_function(1, 1);
+            if (function < 0) {
+                call(max_depth - 1, inside_call);
+                break;
+            }
+            int nesting = scaled(16);
+            for (int i = 0; i < nesting; i++) out += "f" + std::to_string(function) + "(";
+            expression(max_depth - 1, true);
+            for (int i = 0; i < nesting; i++) out += ")";
+            break;
+        }
+        case 3:
+            call(max_depth - 1, inside_call);
+            break;
+        default:
+            flat_expression();
+            break;
+        }
+    }
+
+    // one of the functions before, with between min_params and
+    // max_params parameters (or -1 if there isn't one)
+    int any_function(int min_params, int max_params) {
+        std::vector<int> candidates;
+        for (int i = 0; i < (int)function_params.size(); i++) {
+            if (function_params[i] >= min_params && function_params[i] <= max_params)
+                candidates.push_back(i);
+        }
+        return candidates.empty() ? -1 : candidates[choices.next((int)candidates.size())];
+    }
+
+    void call(int max_depth, bool inside_call) {
+        int function = any_function(0, inside_call ? 1 : INT_MAX);
+        if (function < 0) {
+            flat_expression();
+            return;
+        }
+
+        out += "f" + std::to_string(function) + "(";
+        int num_params = function_params[function];
+        for (int i = 0; i < num_params; i++) {
+            if (i > 0) out += ", ";
+            if (i < num_params - 1) flat_expression();
+            else expression(max_depth, true);
+        }
+        out += ")";
+    }
+
+    void declare(std::string name) { scopes.back().push_back(name); }
+
+    void statement(int max_depth) {
+        indent();
+        switch (max_depth > 0 ? choices.next(6) : choices.next(2)) {
+        case 0:
+        {
+            std::string name = "v" + std::to_string(num_variables++);
+            out += "int " + name + " = ";
+            expression(3);
+            out += ";\n";
+            declare(name);
+            break;
+        }
+        case 1:
+            out += any_variable() + " = ";
+            expression(3);
+            out += ";\n";
+            break;
+        case 2:
+            out += "if (";
+            condition();
+            out += ") ";
+            block(max_depth - 1);
+            out += " else ";
+            block(max_depth - 1);
+            out += "\n";
+            break;
+        case 3:
+            out += "while (";
+            condition();
+            out += ") ";
+            block(max_depth - 1);
+            out += "\n";
+            break;
+        case 4: // (deeply nested blocks, using the variables from the outside)
+        {
+            // (on one line, since the indentation would grow with the
+            // square of the depth)
+            int nesting = scaled(16);
+            for (int i = 0; i < nesting; i++) {
+                out += "{ ";
+                scopes.emplace_back();
+            }
+            out += any_variable() + " = ";
+            expression(1);
+            out += ";";
+            for (int i = 0; i < nesting; i++) {
+                scopes.pop_back();
+                out += " }";
+            }
+            out += "\n";
+            break;
+        }
+        default:
+            out += "int v" + std::to_string(num_variables) + " = ";
+            call(3, false);
+            out += ";\n";
+            declare("v" + std::to_string(num_variables++));
+            break;
+        }
+    }
+
+    void block(int max_depth) {
+        out += "{\n";
+        depth++;
+        scopes.emplace_back();
+
+        int length = 1 + choices.next(4);
+        for (int i = 0; i < length; i++)
+            statement(max_depth);
+
+        scopes.pop_back();
+        depth--;
+        indent();
+        out += "}";
+    }
+
+    void function(const std::string &name, int num_params) {
+        out += "int " + name + "(";
+        scopes.emplace_back();
+        for (int i = 0; i < num_params; i++) {
+            std::string param = "p" + std::to_string(i);
+            out += (i > 0 ? ", int " : "int ") + param;
+            declare(param);
+        }
+        out += ") {\n";
+        depth++;
+
+        repeat(8, [&]() { statement(2); });
+
+        indent();
+        out += "return ";
+        expression(2);
+        out += ";\n}\n\n";
+        depth--;
+        scopes.pop_back();
+    }
+
+    std::string generate() {
+        // (the globals are in the outermost scope, so that every
+        // lookup from a nested block walks all the way out to them)
+        scopes.emplace_back();
+        repeat(32, [&]() {
+            std::string name = "g" + std::to_string(scopes[0].size());
+            out += "int " + name + " = " + std::to_string(choices.next(100)) + ";\n";
+            declare(name);
+        });
+        out += "\n";
+
+        int num_functions = 1 + choices.next(6);
+        for (int i = 0; i < num_functions; i++) {
+            int num_params = choices.next(4) == 0 ? 1 + choices.next(32) : choices.next(3);
+            function("f" + std::to_string(i), num_params);
+            function_params.push_back(num_params);
+        }
+        function("main", 0);
+        return out;
+    }
+};
+
+
+//                         Compiling
+/* *********************************************************** */
+
+// (what recover_from_error throws)
+struct Frontend_Error {};
+
+// (set as the error_recovery_hook, so that an error doesn't exit)
+static void recover_from_error(const char *message, const std::string &file_name,
+                               int line_num, int pos) {
+    throw Frontend_Error();
+}
+
+// lexes and parses the program (into the lexer and the AST, which are
+// held by the caller, so that they are kept on an error as far as they
+// got). returns false on errors.
+static bool compile(const std::string *program, Lexer **lexer,
+                    std::vector<AST_Expression *> **ast) {
+    *lexer = new Lexer;
+    (*lexer)->file_name = "fuzz.em";
+    bool inside_multiline_comment = false;
+
+    try {
+        size_t start = 0;
+        while (start < program->size()) {
+            size_t end = program->find('\n', start);
+            if (end == std::string::npos) end = program->size();
+
+            (*lexer)->line = program->substr(start, end - start);
+            (*lexer)->line_num++;
+            generate_tokens(*lexer, &inside_multiline_comment);
+            start = end + 1;
+        }
+
+        *ast = parse_tokens(*lexer);
+    } catch (const Frontend_Error &) {
+        return false;
+    }
+    return true;
+}
+
+// the fastest of num_runs compilations (in seconds), or -1 on errors
+static double time_compile(const std::string &program, int num_runs) {
+    double fastest = -1;
+    for (int run = 0; run < num_runs; run++) {
+        Lexer *lexer = NULL;
+        std::vector<AST_Expression *> *ast = NULL;
+
+        auto start = std::chrono::steady_clock::now();
+        error_recovery_hook = recover_from_error;
+        bool succeeded = compile(&program, &lexer, &ast);
+        error_recovery_hook = NULL;
+        auto end = std::chrono::steady_clock::now();
+
+        if (!succeeded)
+            return -1; // (and the lexer and the AST are leaked)
+
+        delete lexer;
+        delete ast;
+
+        double seconds = ((std::chrono::duration<double>)(end - start)).count();
+        if (fastest < 0 || seconds < fastest)
+            fastest = seconds;
+    }
+    return fastest;
+}
+
+static void save_program(const std::string &program, const char *measured) {
+    const char *directory = getenv("EMC_FUZZ_OUTPUT");
+    if (directory == NULL) directory = "superlinear";
+
+    // (named after the program, so that the same one is saved once)
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : program)
+        hash = (hash ^ (uint8_t)c) * 1099511628211ull;
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/case_%016llx.em", directory, (unsigned long long)hash);
+
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "frontend_fuzz: couldn't save %s\n", path);
+        return;
+    }
+    fprintf(file, "// %s\n\n%s", measured, program.c_str());
+    fclose(file);
+    fprintf(stderr, "frontend_fuzz: saved %s (%s)\n", path, measured);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static double max_exponent = getenv("EMC_FUZZ_MAX_EXPONENT")
+                                 ? atof(getenv("EMC_FUZZ_MAX_EXPONENT")) : MAX_EXPONENT;
+    static double worst_exponent = 0;
+
+    std::string small = Generator(data, size, 1).generate();
+    std::string large = Generator(data, size, SCALE).generate();
+    // (the exponent means nothing if the sizes are too close)
+    if (large.size() < 2 * small.size())
+        return 0;
+
+    double small_seconds, large_seconds, exponent;
+    auto measure = [&](int num_runs) {
+        small_seconds = time_compile(small, num_runs);
+        large_seconds = time_compile(large, num_runs);
+        if (small_seconds <= 0 || large_seconds < MIN_SECONDS)
+            return false;
+
+        // (how the time grows with the size: 1 is linear, 2 is quadratic)
+        exponent = log(large_seconds / small_seconds) /
+                   log((double)large.size() / small.size());
+        return true;
+    };
+    if (!measure(TIMED_RUNS))
+        return 0;
+
+    // (a single slow run can look superlinear, so it is measured again,
+    // for longer, before it counts)
+    if (exponent > max_exponent && !measure(TIMED_RUNS * 4))
+        return 0;
+
+    char measured[256];
+    snprintf(measured, sizeof(measured),
+             "time ~ size^%.2f: %zu bytes in %.2f ms (%.1f ns/byte), "
+             "%zu bytes in %.2f ms (%.1f ns/byte)",
+             exponent, large.size(), large_seconds * 1e3, large_seconds * 1e9 / large.size(),
+             small.size(), small_seconds * 1e3, small_seconds * 1e9 / small.size());
+
+    if (exponent > worst_exponent) {
+        worst_exponent = exponent;
+        fprintf(stderr, "frontend_fuzz: worst so far, %s\n", measured);
+    }
+    if (exponent > max_exponent)
+        save_program(large, measured);
+    return 0;
+}
+
+
+#ifdef FUZZ_STANDALONE
+
+// runs the given inputs (the files libFuzzer saves, say), or random ones
+int main(int argc, char **argv) {
+    int runs = 0;
+    std::vector<const char *> files;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-runs") == 0 && i < argc - 1)
+            runs = atoi(argv[++i]);
+        else
+            files.push_back(argv[i]);
+    }
+    if (files.empty() && runs <= 0) {
+        fprintf(stderr, "usage: frontend_fuzz [-runs <n>] [<input> ...]\n");
+        return 1;
+    }
+
+    for (const char *file_name : files) {
+        FILE *file = fopen(file_name, "rb");
+        if (file == NULL) {
+            fprintf(stderr, "frontend_fuzz: couldn't open %s\n", file_name);
+            return 1;
+        }
+        std::vector<uint8_t> data;
+        int c;
+        while ((c = fgetc(file)) != EOF)
+            data.push_back((uint8_t)c);
+        fclose(file);
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+
+    srand(1);
+    for (int run = 0; run < runs; run++) {
+        std::vector<uint8_t> data(1 + rand() % 256);
+        for (uint8_t &byte : data)
+            byte = (uint8_t)rand();
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+    return 0;
+}
+
+#endif
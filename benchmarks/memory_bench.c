@@ -0,0 +1,244 @@
+//
+// memory_bench.c
+//
+
+// allocation benchmark: the memory.c runtime (mem_alloc / arenas)
+// against the C runtime's malloc (glibc on Linux).
+//
+// every workload is run with both allocators, and the time per
+// operation is printed side by side:
+//
+//     (1) churn: allocate and free a 64 byte object, over and over.
+//
+//     (2) random: a live set of LIVE_SLOTS objects of random sizes
+//     (16 B - 1 KB), where each step frees a random one and
+//     replaces it. this is the one that stresses the free lists.
+//
+//     (3) random, on THREADS threads at once (each with its own set).
+//
+//     (4) tree: allocate NODES small nodes (like building a tree),
+//     and then free them all. the arena version bump allocates
+//     them, and frees them with a single arena_reset().
+//
+// and then the bulk operations (mem_copy, mem_set, ...) against
+// the C runtime's memcpy, memset, memcmp, memchr and strlen, on
+// BULK_SIZE bytes (in GB/s).
+//
+// build and run it (memory.c is compiled in, instead of memory.bc):
+//     clang -O2 benchmarks/memory_bench.c include/src/memory.c -o memory_bench -lpthread
+//     ./memory_bench
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define CHURN_ITERATIONS 20000000
+#define RANDOM_ITERATIONS 10000000
+#define LIVE_SLOTS 10000
+#define THREADS 4
+#define NODES 1000000
+#define NODE_SIZE 32
+#define TREE_ROUNDS 10
+#define BULK_SIZE 4096
+#define BULK_ITERATIONS 2000000
+
+uint64_t mem_alloc(int32_t size);
+void mem_free(uint64_t address);
+uint64_t arena_create(int32_t capacity);
+uint64_t arena_alloc(uint64_t arena, int32_t size);
+void arena_reset(uint64_t arena);
+void arena_destroy(uint64_t arena);
+void mem_copy(uint64_t destination, uint64_t source, int32_t size);
+void mem_set(uint64_t destination, uint8_t value, int32_t size);
+int32_t mem_compare(uint64_t a, uint64_t b, int32_t size);
+int32_t mem_find(uint64_t address, uint8_t value, int32_t size);
+int32_t str_length(const char *text);
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// (so that the allocations can't be optimized away)
+static volatile uintptr_t sink;
+
+static void *em_malloc(size_t size) { return (void *)(uintptr_t)mem_alloc((int32_t)size); }
+static void em_free(void *p) { mem_free((uint64_t)(uintptr_t)p); }
+
+typedef struct {
+    const char *name;
+    void *(*alloc)(size_t size);
+    void (*free)(void *p);
+} Allocator;
+
+static const Allocator allocators[] = {
+    {"malloc", malloc, free},
+    {"mem_alloc", em_malloc, em_free},
+};
+
+
+//                         Workloads
+// ***********************************************************
+
+static double churn(const Allocator *a) {
+    double start = now();
+    for (int i = 0; i < CHURN_ITERATIONS; i++) {
+        void *p = a->alloc(64);
+        *(volatile char *)p = (char)i;
+        a->free(p);
+    }
+    return (now() - start) / CHURN_ITERATIONS;
+}
+
+static double random_live_set(const Allocator *a, uint32_t seed) {
+    void **slots = (void **)calloc(LIVE_SLOTS, sizeof(void *));
+    uint32_t x = seed;
+
+    double start = now();
+    for (int i = 0; i < RANDOM_ITERATIONS; i++) {
+        x = x * 1664525u + 1013904223u;
+        uint32_t slot = (x >> 8) % LIVE_SLOTS;
+        size_t size = 16 + (x >> 20) % 1009;
+
+        if (slots[slot])
+            a->free(slots[slot]);
+        slots[slot] = a->alloc(size);
+        *(volatile char *)slots[slot] = (char)i;
+    }
+    for (int i = 0; i < LIVE_SLOTS; i++)
+        a->free(slots[i]);
+    double elapsed = now() - start;
+
+    free(slots);
+    return elapsed / RANDOM_ITERATIONS;
+}
+
+typedef struct {
+    const Allocator *a;
+    uint32_t seed;
+    double result;
+} Thread_Args;
+
+static void *random_thread(void *arg) {
+    Thread_Args *t = (Thread_Args *)arg;
+    t->result = random_live_set(t->a, t->seed);
+    return 0;
+}
+
+static double random_threaded(const Allocator *a) {
+    pthread_t threads[THREADS];
+    Thread_Args args[THREADS];
+
+    double start = now();
+    for (int i = 0; i < THREADS; i++) {
+        args[i].a = a;
+        args[i].seed = 12345 + i;
+        pthread_create(&threads[i], 0, random_thread, &args[i]);
+    }
+    for (int i = 0; i < THREADS; i++)
+        pthread_join(threads[i], 0);
+
+    // (as the total throughput: time per operation, over all threads)
+    return (now() - start) / ((double)RANDOM_ITERATIONS * THREADS);
+}
+
+static double tree(const Allocator *a) {
+    void **nodes = (void **)malloc(NODES * sizeof(void *));
+
+    double start = now();
+    for (int round = 0; round < TREE_ROUNDS; round++) {
+        for (int i = 0; i < NODES; i++) {
+            nodes[i] = a->alloc(NODE_SIZE);
+            *(volatile char *)nodes[i] = (char)i;
+        }
+        for (int i = 0; i < NODES; i++)
+            a->free(nodes[i]);
+    }
+    double elapsed = now() - start;
+
+    free(nodes);
+    return elapsed / ((double)NODES * TREE_ROUNDS);
+}
+
+static double tree_arena(void) {
+    uint64_t arena = arena_create(NODES * NODE_SIZE);
+
+    double start = now();
+    for (int round = 0; round < TREE_ROUNDS; round++) {
+        for (int i = 0; i < NODES; i++) {
+            void *node = (void *)(uintptr_t)arena_alloc(arena, NODE_SIZE);
+            *(volatile char *)node = (char)i;
+            sink = (uintptr_t)node;
+        }
+        arena_reset(arena);
+    }
+    double elapsed = now() - start;
+
+    arena_destroy(arena);
+    return elapsed / ((double)NODES * TREE_ROUNDS);
+}
+
+
+//                      Bulk operations
+// ***********************************************************
+
+static char bulk_a[BULK_SIZE + 64], bulk_b[BULK_SIZE + 64];
+#define ADDRESS(p) ((uint64_t)(uintptr_t)(p))
+
+// (every iteration touches the buffers through sink, so that
+// the calls can't be hoisted out of the loop)
+#define BULK_LOOP(statement)                                         \
+    do {                                                             \
+        double start = now();                                        \
+        for (int i = 0; i < BULK_ITERATIONS; i++) {                  \
+            statement;                                               \
+            sink += (uintptr_t)bulk_b[i & 63];                       \
+        }                                                            \
+        return (double)BULK_SIZE * BULK_ITERATIONS / (now() - start) * 1e-9; \
+    } while (0)
+
+static double libc_copy(void) { BULK_LOOP(memcpy(bulk_b + 1, bulk_a, BULK_SIZE)); }
+static double em_copy(void) { BULK_LOOP(mem_copy(ADDRESS(bulk_b + 1), ADDRESS(bulk_a), BULK_SIZE)); }
+static double libc_set(void) { BULK_LOOP(memset(bulk_b + 1, i, BULK_SIZE)); }
+static double em_set(void) { BULK_LOOP(mem_set(ADDRESS(bulk_b + 1), (uint8_t)i, BULK_SIZE)); }
+static double libc_compare(void) { BULK_LOOP(sink += memcmp(bulk_a, bulk_b, BULK_SIZE)); }
+static double em_compare(void) { BULK_LOOP(sink += mem_compare(ADDRESS(bulk_a), ADDRESS(bulk_b), BULK_SIZE)); }
+static double libc_find(void) { BULK_LOOP(sink += (uintptr_t)memchr(bulk_a, 1, BULK_SIZE)); }
+static double em_find(void) { BULK_LOOP(sink += mem_find(ADDRESS(bulk_a), 1, BULK_SIZE)); }
+static double libc_length(void) { BULK_LOOP(sink += strlen(bulk_a)); }
+static double em_length(void) { BULK_LOOP(sink += str_length(bulk_a)); }
+
+
+int main(void) {
+    printf("%-28s %14s %14s\n", "workload (ns per op)", allocators[0].name, allocators[1].name);
+    printf("----------------------------------------------------------\n");
+
+    printf("%-28s %14.2f %14.2f\n", "churn (64 B)",
+           churn(&allocators[0]) * 1e9, churn(&allocators[1]) * 1e9);
+    printf("%-28s %14.2f %14.2f\n", "random (16 B - 1 KB)",
+           random_live_set(&allocators[0], 1) * 1e9, random_live_set(&allocators[1], 1) * 1e9);
+    printf("%-28s %14.2f %14.2f\n", "random, 4 threads",
+           random_threaded(&allocators[0]) * 1e9, random_threaded(&allocators[1]) * 1e9);
+    printf("%-28s %14.2f %14.2f\n", "tree (32 B nodes)",
+           tree(&allocators[0]) * 1e9, tree(&allocators[1]) * 1e9);
+    printf("%-28s %14s %14.2f\n", "tree, with an arena", "-", tree_arena() * 1e9);
+
+    // (a and b are equal, and have no 1 bytes, so all of
+    // them run over the whole BULK_SIZE bytes)
+    memset(bulk_a, 'x', BULK_SIZE);
+    memset(bulk_b, 'x', BULK_SIZE);
+
+    printf("\n%-28s %14s %14s\n", "bulk, 4 KB (GB/s)", "libc", "memory.c");
+    printf("----------------------------------------------------------\n");
+    printf("%-28s %14.2f %14.2f\n", "copy", libc_copy(), em_copy());
+    printf("%-28s %14.2f %14.2f\n", "set", libc_set(), em_set());
+    memset(bulk_b, 'x', BULK_SIZE + 64);
+    printf("%-28s %14.2f %14.2f\n", "compare", libc_compare(), em_compare());
+    printf("%-28s %14.2f %14.2f\n", "find", libc_find(), em_find());
+    printf("%-28s %14.2f %14.2f\n", "length", libc_length(), em_length());
+    return 0;
+}
@@ -0,0 +1,15 @@
+@echo off
+
+rem Builds the runtime libraries of the standard headers (include/src/*.c)
+rem into the bitcode files in lib/, which the compiler links into every
+rem program that includes their header. (this is run by build.bat and
+rem build-msvc.bat, and can be run on its own after editing a runtime)
+
+set LIB_FLAGS=-c -emit-llvm -O2 -w
+
+clang %LIB_FLAGS% include/src/parallel.c -o lib/parallel.bc || exit /B 1
+clang %LIB_FLAGS% include/src/async.c -o lib/async.bc || exit /B 1
+clang %LIB_FLAGS% include/src/memory.c -o lib/memory.bc || exit /B 1
+clang %LIB_FLAGS% include/src/print.c -o lib/print.bc || exit /B 1
+clang %LIB_FLAGS% include/src/profile.c -o lib/profile.bc || exit /B 1
+clang %LIB_FLAGS% include/src/time.c -o lib/time.bc || exit /B 1
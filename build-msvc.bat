@@ -4,6 +4,7 @@ set OPT_FLAG=/O2
 set DEBUG_FLAG=
 set TRACY_PROFILE_FLAGS=
 set TRACY_CLIENT_CPP=
+set ALLOC_FLAG=
 
 if "%1"=="Clean" (
 	del /Q bin\emc.exe bin\emc.ilk bin\emc.pdb
@@ -18,11 +19,17 @@ if "%1"=="Debug" (
    set TRACY_CLIENT_CPP="D:\softwares\tracy\public\TracyClient.cpp"
 )
 
+rem (FastAlloc, after the build type, builds in the allocator in src/alloc.cpp)
+if "%2"=="FastAlloc" (
+   set ALLOC_FLAG=/DEMC_FAST_ALLOC
+)
+
 echo Build type: %1
 
 clang-cl ^
 %OPT_FLAG% ^
 /std:c++17 ^
+/EHsc ^
 /DEXPERIMENTAL_KEY_INSTRUCTIONS ^
 /D_FILE_OFFSET_BITS=64 ^
 /D__STDC_CONSTANT_MACROS ^
@@ -30,9 +37,10 @@ clang-cl ^
 /D__STDC_LIMIT_MACROS ^
 %DEBUG_FLAG% ^
 %TRACY_PROFILE_FLAGS% ^
+%ALLOC_FLAG% ^
 /I "D:\softwares\clang+llvm-21.1.8-x86_64-pc-windows-msvc\include" ^
 /I "D:\softwares\tracy\public" ^
-src/lexer.cpp src/parser.cpp src/ir_generator.cpp src/dsa.cpp src/linker.cpp src/main.cpp %TRACY_CLIENT_CPP% ^
+src/lexer.cpp src/parser.cpp src/ir_generator.cpp src/linker.cpp src/lsp.cpp src/alloc.cpp src/counters.cpp src/incremental.cpp src/main.cpp %TRACY_CLIENT_CPP% ^
 /link ^
 ntdll.lib ^
 /LIBPATH:"D:\softwares\clang+llvm-21.1.8-x86_64-pc-windows-msvc\lib" ^
@@ -166,3 +174,5 @@ LLVMTableGen.lib ^
 LLVMSupport.lib ^
 LLVMDemangle.lib ^
 /OUT:bin/emc.exe
+
+call build-lib.bat
@@ -6,14 +6,19 @@ if "%1"=="-debug" (
    set DEBUG_FLAG=-w
 )
 
+rem (-fast-alloc builds in the allocator in src/alloc.cpp)
+set ALLOC_FLAG=
+if "%1"=="-fast-alloc" set ALLOC_FLAG=-DEMC_FAST_ALLOC
+if "%2"=="-fast-alloc" set ALLOC_FLAG=-DEMC_FAST_ALLOC
+
 clang++ ^
 %DEBUG_FLAG% ^
-src/lexer.cpp src/parser.cpp src/ir_generator.cpp src/dsa.cpp src/linker.cpp src/main.cpp ^
+%ALLOC_FLAG% ^
+src/lexer.cpp src/parser.cpp src/ir_generator.cpp src/linker.cpp src/lsp.cpp src/alloc.cpp src/counters.cpp src/incremental.cpp src/main.cpp ^
 -o ^
 bin/emc ^
 -I ^
 -std=c++17 ^
--fno-exceptions ^
 -funwind-tables ^
 -DEXPERIMENTAL_KEY_INSTRUCTIONS ^
 -D_FILE_OFFSET_BITS=64 ^
@@ -23,3 +28,5 @@ bin/emc ^
 -L ^
 D:/softwares/msys64/mingw64/lib ^
 -lLLVM-21
+
+call build-lib.bat
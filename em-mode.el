@@ -26,7 +26,7 @@
   '("void" "bool" "char" "int" "u8" "u16" "u32" "u64" "s8" "s16" "s32" "s64" "float" "double" "string"))
 
 (defun em-keywords ()
-  '("if" "else" "switch" "case" "for" "while" "return" "break" "continue" "varg" "typedef" "enum" "true" "false"))
+  '("if" "else" "switch" "case" "for" "in" "parallel" "async" "await" "while" "return" "break" "continue" "varg" "asm" "const" "atomic" "typedef" "enum" "true" "false"))
 
 (defun em-font-lock-keywords ()
   (list
@@ -101,4 +101,9 @@
   (setq-local indent-line-function 'em-indent-line)
   (setq-local comment-start "// "))
 
+;; the compiler is also a language server (emc -lsp), for
+;; diagnostics, go-to-definition and hover with eglot
+(with-eval-after-load 'eglot
+  (add-to-list 'eglot-server-programs '(em-mode . ("emc" "-lsp"))))
+
 (provide 'em-mode)
@@ -0,0 +1,613 @@
+//
+// async.c
+//
+
+/*
+
+This is the runtime for async functions (coroutines),
+along with a small event loop for them.
+
+The compiler lowers an async function into an LLVM
+coroutine (switch-resumed). What it needs from here:
+
+    (1) __em_coro_alloc() / __em_coro_free() for the
+    coroutine frames.
+
+    (2) __em_coro_set_current(), which is called right
+    before the function call of an await. so the function
+    that is being awaited (like wait_readable) knows which
+    coroutine to resume later on.
+
+The event loop keeps a queue of coroutines that are
+ready to run, and the coroutines waiting on an fd. it
+resumes the ready ones, and then waits for the fds,
+until there is nobody left waiting.
+
+The fds are waited on with epoll on Linux, and with
+poll() everywhere else (WSAPoll on Windows, where the
+fds are sockets, and a socket_pair() is a connection
+over the loopback interface).
+
+Since Em does not have pointers yet, the I/O functions
+here work with their own buffers, and only take fds and
+sizes (just enough for an echo style server).
+
+NOTE: define EM_ASYNC_USE_POLL to use poll() on Linux too.
+
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EM_MAX_EVENTS 256
+#define EM_IO_BUFFER_SIZE 65536
+
+
+//                      OS sockets
+// ***********************************************************
+
+#ifdef _WIN32
+
+typedef uintptr_t Em_Socket;
+
+typedef struct {
+    Em_Socket fd;
+    short events;
+    short revents;
+} Em_Poll_Fd;
+
+typedef struct {
+    short sin_family;
+    unsigned short sin_port;
+    uint32_t sin_addr;
+    char sin_zero[8];
+} Em_Sockaddr_In;
+
+#define EM_INVALID_SOCKET (~(Em_Socket)0)
+#define AF_INET 2
+#define SOCK_STREAM 1
+#define IPPROTO_TCP 6
+#define TCP_NODELAY 1
+#define FIONBIO ((long)0x8004667E)
+#define WSAEWOULDBLOCK 10035
+#define EM_LOOPBACK_ADDRESS 0x0100007F // (127.0.0.1, in network byte order)
+
+#define POLLERR 0x0001
+#define POLLHUP 0x0002
+#define POLLNVAL 0x0004
+#define POLLOUT 0x0010
+#define POLLIN 0x0300
+
+#define MSG_NOSIGNAL 0
+
+int __stdcall WSAStartup(unsigned short version, void *data);
+int __stdcall WSAGetLastError(void);
+int __stdcall WSAPoll(Em_Poll_Fd *fds, unsigned long num_fds, int timeout);
+Em_Socket __stdcall socket(int family, int type, int protocol);
+int __stdcall bind(Em_Socket s, const void *address, int length);
+int __stdcall listen(Em_Socket s, int backlog);
+int __stdcall getsockname(Em_Socket s, void *address, int *length);
+int __stdcall connect(Em_Socket s, const void *address, int length);
+Em_Socket __stdcall accept(Em_Socket s, void *address, int *length);
+int __stdcall setsockopt(Em_Socket s, int level, int name, const char *value, int length);
+int __stdcall ioctlsocket(Em_Socket s, long command, unsigned long *argument);
+int __stdcall send(Em_Socket s, const char *buffer, int length, int flags);
+int __stdcall recv(Em_Socket s, char *buffer, int length, int flags);
+int __stdcall closesocket(Em_Socket s);
+
+#define em_poll(fds, num_fds, timeout) WSAPoll(fds, (unsigned long)(num_fds), timeout)
+#define close_socket(fd) closesocket((Em_Socket)(fd))
+
+static int would_block(void) {
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+
+static int make_socket_pair(int32_t fds[2]) {
+    static int is_winsock_started = 0;
+    if (!is_winsock_started) {
+        char wsa_data[512]; // (WSADATA)
+        if (WSAStartup(0x0202, wsa_data) != 0)
+            return 0;
+        is_winsock_started = 1;
+    }
+
+    // there is no socketpair(), so connect to a listener on
+    // the loopback interface, and take both ends
+    Em_Socket listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == EM_INVALID_SOCKET)
+        return 0;
+
+    Em_Sockaddr_In address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr = EM_LOOPBACK_ADDRESS;
+    int length = sizeof(address);
+
+    Em_Socket a = EM_INVALID_SOCKET;
+    Em_Socket b = EM_INVALID_SOCKET;
+    if (bind(listener, &address, length) == 0 && listen(listener, 1) == 0 &&
+        getsockname(listener, &address, &length) == 0) {
+        a = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (a != EM_INVALID_SOCKET && connect(a, &address, length) == 0)
+            b = accept(listener, 0, 0);
+    }
+    closesocket(listener);
+
+    if (b == EM_INVALID_SOCKET) {
+        if (a != EM_INVALID_SOCKET) closesocket(a);
+        return 0;
+    }
+
+    unsigned long non_blocking = 1;
+    int no_delay = 1;
+    ioctlsocket(a, FIONBIO, &non_blocking);
+    ioctlsocket(b, FIONBIO, &non_blocking);
+    setsockopt(a, IPPROTO_TCP, TCP_NODELAY, (const char *)&no_delay, sizeof(no_delay));
+    setsockopt(b, IPPROTO_TCP, TCP_NODELAY, (const char *)&no_delay, sizeof(no_delay));
+
+    fds[0] = (int32_t)a;
+    fds[1] = (int32_t)b;
+    return 1;
+}
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#if defined(__linux__) && !defined(EM_ASYNC_USE_POLL)
+#define EM_ASYNC_USE_EPOLL 1
+#include <sys/epoll.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+typedef int Em_Socket;
+typedef struct pollfd Em_Poll_Fd;
+
+#define em_poll(fds, num_fds, timeout) poll(fds, (nfds_t)(num_fds), timeout)
+#define close_socket(fd) close(fd)
+
+static int would_block(void) {
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+static int make_socket_pair(int32_t fds[2]) {
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0)
+        return 0;
+
+    for (int i = 0; i < 2; i++) {
+        fcntl(pair[i], F_SETFL, fcntl(pair[i], F_GETFL) | O_NONBLOCK);
+        fcntl(pair[i], F_SETFD, FD_CLOEXEC);
+        fds[i] = pair[i];
+    }
+    return 1;
+}
+
+#endif
+
+// (these return -1 if the call would block, and 0 on an error)
+static int32_t socket_send(int32_t fd, const char *buffer, int32_t count) {
+    int64_t n = send((Em_Socket)fd, buffer, count, MSG_NOSIGNAL);
+    if (n < 0)
+        return would_block() ? -1 : 0;
+    return (int32_t)n;
+}
+
+static int32_t socket_recv(int32_t fd, char *buffer, int32_t count) {
+    int64_t n = recv((Em_Socket)fd, buffer, count, 0);
+    if (n < 0)
+        return would_block() ? -1 : 0;
+    return (int32_t)n;
+}
+
+
+//                     Coroutine support
+// ***********************************************************
+
+static _Thread_local void *current_coroutine = 0;
+
+void *__em_coro_alloc(uint64_t size) {
+    return malloc(size);
+}
+
+void __em_coro_free(void *frame) {
+    free(frame);
+}
+
+void __em_coro_set_current(void *handle) {
+    current_coroutine = handle;
+}
+
+static void resume(void *handle) {
+#if defined(__clang__)
+    __builtin_coro_resume(handle);
+#else
+    // in the switch-resumed ABI, the frame begins with
+    // a pointer to the resume function of the coroutine.
+    (*(void (**)(void *))handle)(handle);
+#endif
+}
+
+
+//                       Ready queue
+// ***********************************************************
+
+// a growable ring buffer of coroutines that can be resumed
+static void **ready = 0;
+static size_t ready_capacity = 0;
+static size_t ready_head = 0;
+static size_t ready_count = 0;
+
+static void push_ready(void *handle) {
+    if (ready_count == ready_capacity) {
+        size_t new_capacity = ready_capacity ? ready_capacity * 2 : 64;
+        void **new_ready = (void **)malloc(new_capacity * sizeof(void *));
+
+        for (size_t i = 0; i < ready_count; i++)
+            new_ready[i] = ready[(ready_head + i) % ready_capacity];
+
+        free(ready);
+        ready = new_ready;
+        ready_capacity = new_capacity;
+        ready_head = 0;
+    }
+    ready[(ready_head + ready_count) % ready_capacity] = handle;
+    ready_count++;
+}
+
+static void *pop_ready(void) {
+    void *handle = ready[ready_head];
+    ready_head = (ready_head + 1) % ready_capacity;
+    ready_count--;
+    return handle;
+}
+
+
+//                     Waiting on fds
+// ***********************************************************
+
+/*
+every fd has (at most) one reader and one writer waiting
+on it. the fd stays registered with epoll (level-triggered),
+or in the array that is passed to poll(), and the events it
+is waited on for are updated whenever the waiters change.
+*/
+
+typedef struct {
+    void *reader;
+    void *writer;
+#ifdef EM_ASYNC_USE_EPOLL
+    uint32_t registered_events;
+    int is_registered;
+#else
+    int poll_index; // (+1, or 0 if it is not in poll_fds)
+#endif
+} Em_Fd_Waiters;
+
+static Em_Fd_Waiters *fd_waiters = 0;
+static int fd_waiters_capacity = 0;
+static size_t num_waiting = 0;
+
+static Em_Fd_Waiters *get_fd_waiters(int fd) {
+    if (fd >= fd_waiters_capacity) {
+        int new_capacity = fd_waiters_capacity ? fd_waiters_capacity : 64;
+        while (new_capacity <= fd) new_capacity *= 2;
+
+        fd_waiters = (Em_Fd_Waiters *)realloc(fd_waiters, new_capacity * sizeof(Em_Fd_Waiters));
+        memset(fd_waiters + fd_waiters_capacity, 0,
+               (new_capacity - fd_waiters_capacity) * sizeof(Em_Fd_Waiters));
+        fd_waiters_capacity = new_capacity;
+    }
+    return &fd_waiters[fd];
+}
+
+static void wake_fd_waiters(int fd, int is_readable, int is_writable);
+
+#ifdef EM_ASYNC_USE_EPOLL
+
+static int epoll_fd = -1;
+
+static void update_fd_events(int fd, Em_Fd_Waiters *w) {
+    uint32_t events = (w->reader ? EPOLLIN : 0) | (w->writer ? EPOLLOUT : 0);
+    if (events == w->registered_events && w->is_registered)
+        return;
+
+    if (epoll_fd < 0)
+        epoll_fd = epoll_create1(0);
+
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.fd = fd;
+
+    if (!w->is_registered) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        w->is_registered = 1;
+    } else {
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+    }
+    w->registered_events = events;
+}
+
+static void forget_fd(int fd, Em_Fd_Waiters *w) {
+    if (w->is_registered)
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, 0);
+    w->is_registered = 0;
+    w->registered_events = 0;
+}
+
+static void wait_for_fds(int timeout) {
+    struct epoll_event events[EM_MAX_EVENTS];
+
+    int n = epoll_wait(epoll_fd, events, EM_MAX_EVENTS, timeout);
+    for (int i = 0; i < n; i++) {
+        uint32_t ev = events[i].events;
+        wake_fd_waiters(events[i].data.fd,
+                        ev & (EPOLLIN | EPOLLERR | EPOLLHUP),
+                        ev & (EPOLLOUT | EPOLLERR | EPOLLHUP));
+    }
+}
+
+#else
+
+static Em_Poll_Fd *poll_fds = 0;
+static int num_poll_fds = 0;
+static int poll_fds_capacity = 0;
+
+static void forget_fd(int fd, Em_Fd_Waiters *w) {
+    if (w->poll_index == 0)
+        return;
+
+    // the last one takes its place
+    int index = w->poll_index - 1;
+    poll_fds[index] = poll_fds[--num_poll_fds];
+    if (index < num_poll_fds)
+        get_fd_waiters((int)poll_fds[index].fd)->poll_index = index + 1;
+    w->poll_index = 0;
+}
+
+static void update_fd_events(int fd, Em_Fd_Waiters *w) {
+    short events = (w->reader ? POLLIN : 0) | (w->writer ? POLLOUT : 0);
+    if (events == 0) {
+        forget_fd(fd, w);
+        return;
+    }
+
+    if (w->poll_index == 0) {
+        if (num_poll_fds == poll_fds_capacity) {
+            poll_fds_capacity = poll_fds_capacity ? poll_fds_capacity * 2 : 64;
+            poll_fds = (Em_Poll_Fd *)realloc(poll_fds, poll_fds_capacity * sizeof(Em_Poll_Fd));
+        }
+        poll_fds[num_poll_fds].fd = (Em_Socket)fd;
+        poll_fds[num_poll_fds].revents = 0;
+        w->poll_index = ++num_poll_fds;
+    }
+    poll_fds[w->poll_index - 1].events = events;
+}
+
+static void wait_for_fds(int timeout) {
+    if (em_poll(poll_fds, num_poll_fds, timeout) <= 0)
+        return;
+
+    // (backwards, since waking up the waiters of an fd can move
+    // the last one, which has already been seen, into its place)
+    for (int i = num_poll_fds - 1; i >= 0; i--) {
+        short ev = poll_fds[i].revents;
+        if (ev == 0)
+            continue;
+
+        poll_fds[i].revents = 0;
+        wake_fd_waiters((int)poll_fds[i].fd,
+                        ev & (POLLIN | POLLERR | POLLHUP | POLLNVAL),
+                        ev & (POLLOUT | POLLERR | POLLHUP | POLLNVAL));
+    }
+}
+
+#endif
+
+// errors and hang ups wake up both sides, so that
+// they can find out from their next read/write
+static void wake_fd_waiters(int fd, int is_readable, int is_writable) {
+    Em_Fd_Waiters *w = get_fd_waiters(fd);
+
+    if (is_readable && w->reader) {
+        push_ready(w->reader);
+        w->reader = 0;
+        num_waiting--;
+    }
+    if (is_writable && w->writer) {
+        push_ready(w->writer);
+        w->writer = 0;
+        num_waiting--;
+    }
+    update_fd_events(fd, w);
+}
+
+static void wait_on_fd(int fd, int for_writing) {
+    Em_Fd_Waiters *w = get_fd_waiters(fd);
+    if (for_writing) w->writer = current_coroutine;
+    else w->reader = current_coroutine;
+
+    num_waiting++;
+    update_fd_events(fd, w);
+}
+
+void wait_readable(int32_t fd) {
+    wait_on_fd(fd, 0);
+}
+
+void wait_writable(int32_t fd) {
+    wait_on_fd(fd, 1);
+}
+
+void yield_now(void) {
+    push_ready(current_coroutine);
+}
+
+
+//                       Event loop
+// ***********************************************************
+
+void run_event_loop(void) {
+    while (ready_count > 0 || num_waiting > 0) {
+        // run everything that is ready. (the coroutines that
+        // get ready in the meantime, are left for the next round,
+        // so that the fds are also polled in between)
+        size_t num_ready = ready_count;
+        while (num_ready-- > 0)
+            resume(pop_ready());
+
+        if (num_waiting == 0)
+            continue;
+
+        // only block if there is nothing else to do
+        wait_for_fds(ready_count > 0 ? 0 : -1);
+    }
+}
+
+
+//                     Non-blocking I/O
+// ***********************************************************
+
+typedef struct {
+    int32_t peer;
+
+    // what echo() could not write back yet
+    char *pending;
+    int32_t pending_offset;
+    int32_t pending_count;
+} Em_Socket_State;
+
+static Em_Socket_State *sockets = 0;
+static int sockets_capacity = 0;
+static char io_buffer[EM_IO_BUFFER_SIZE];
+
+static Em_Socket_State *get_socket_state(int fd) {
+    if (fd >= sockets_capacity) {
+        int new_capacity = sockets_capacity ? sockets_capacity : 64;
+        while (new_capacity <= fd) new_capacity *= 2;
+
+        sockets = (Em_Socket_State *)realloc(sockets, new_capacity * sizeof(Em_Socket_State));
+        memset(sockets + sockets_capacity, 0,
+               (new_capacity - sockets_capacity) * sizeof(Em_Socket_State));
+        for (int i = sockets_capacity; i < new_capacity; i++)
+            sockets[i].peer = -1;
+        sockets_capacity = new_capacity;
+    }
+    return &sockets[fd];
+}
+
+int32_t socket_pair(void) {
+    int32_t fds[2];
+    if (!make_socket_pair(fds))
+        return -1;
+
+    get_socket_state(fds[0])->peer = fds[1];
+    get_socket_state(fds[1])->peer = fds[0];
+    return fds[0];
+}
+
+int32_t socket_peer(int32_t fd) {
+    return (fd >= 0 && fd < sockets_capacity) ? sockets[fd].peer : -1;
+}
+
+void close_fd(int32_t fd) {
+    if (fd < 0)
+        return;
+
+    // whoever is still waiting on the fd is resumed (its next
+    // read or write fails, like at the end of the stream), so
+    // that the event loop does not wait for it forever. the fd
+    // must not stay registered either, since it can be reused.
+    if (fd < fd_waiters_capacity) {
+        Em_Fd_Waiters *w = &fd_waiters[fd];
+        if (w->reader) {
+            push_ready(w->reader);
+            num_waiting--;
+        }
+        if (w->writer) {
+            push_ready(w->writer);
+            num_waiting--;
+        }
+        w->reader = w->writer = 0;
+        forget_fd(fd, w);
+    }
+
+    if (fd < sockets_capacity) {
+        free(sockets[fd].pending);
+        memset(&sockets[fd], 0, sizeof(Em_Socket_State));
+        sockets[fd].peer = -1;
+    }
+    close_socket(fd);
+}
+
+int32_t send_bytes(int32_t fd, int32_t count) {
+    if (count > EM_IO_BUFFER_SIZE) count = EM_IO_BUFFER_SIZE;
+    return socket_send(fd, io_buffer, count);
+}
+
+int32_t recv_bytes(int32_t fd, int32_t count) {
+    if (count > EM_IO_BUFFER_SIZE) count = EM_IO_BUFFER_SIZE;
+    return socket_recv(fd, io_buffer, count);
+}
+
+// writes out what is left from the last echo(). returns 1 once
+// all of it has been written, -1 if the rest would block, and
+// 0 on an error.
+static int32_t write_pending(int32_t fd, Em_Socket_State *s) {
+    while (s->pending_count > 0) {
+        int32_t n = socket_send(fd, s->pending + s->pending_offset, s->pending_count);
+        if (n <= 0)
+            return n;
+
+        s->pending_offset += n;
+        s->pending_count -= n;
+    }
+    return 1;
+}
+
+int32_t echo(int32_t fd) {
+    Em_Socket_State *s = get_socket_state(fd);
+
+    // what could not be written back the last time goes first
+    int32_t result = write_pending(fd, s);
+    if (result <= 0)
+        return result;
+
+    int32_t n = socket_recv(fd, io_buffer, EM_IO_BUFFER_SIZE);
+    if (n <= 0)
+        return n;
+
+    // write back as much as the peer takes right now. if its
+    // buffer is full, the rest is kept for the next call (the
+    // caller can wait_writable() while echo_pending() is not 0)
+    int32_t written = 0;
+    while (written < n) {
+        int32_t w = socket_send(fd, io_buffer + written, n - written);
+        if (w == 0)
+            return 0;
+
+        if (w < 0) {
+            if (s->pending == 0)
+                s->pending = (char *)malloc(EM_IO_BUFFER_SIZE);
+
+            memcpy(s->pending, io_buffer + written, n - written);
+            s->pending_offset = 0;
+            s->pending_count = n - written;
+            break;
+        }
+        written += w;
+    }
+    return n;
+}
+
+int32_t echo_pending(int32_t fd) {
+    return (fd >= 0 && fd < sockets_capacity) ? sockets[fd].pending_count : 0;
+}
@@ -0,0 +1,849 @@
+//
+// memory.c
+//
+
+/*
+
+This is the heap allocation runtime for Em programs.
+
+It has two kinds of allocation:
+
+    (1) mem_alloc() / mem_free(), a general purpose allocator
+    built out of size classes:
+
+        - every request (up to 32 KB) is rounded up to one
+        of 40 size classes (16, 32, ... 128, and then 4 steps
+        for every power of 2 up to 32 KB).
+
+        - the objects of a size class are carved out of slabs
+        (256 KB, aligned to their size), so the slab header,
+        which holds the size class, can be found from any
+        object by masking its address. the slabs themselves
+        come out of 4 MB segments, mapped from the OS.
+
+        - every thread keeps a cache (a free list) per size
+        class, so most allocations and frees are just a push
+        or pop, without any locking. the caches go to the
+        central free list of their size class (which is
+        locked) only in batches: to refill when empty, and
+        to give back half when they grow too long.
+
+        - anything larger than 32 KB is mapped directly from
+        the OS, and unmapped when freed.
+
+    (2) arenas, for allocations that all die together (like
+    everything allocated while handling a request, or building
+    a tree). allocating is a bump of a pointer, there is no
+    freeing of single allocations, and arena_reset() releases
+    everything at once (keeping the memory for reuse).
+
+The memory is mapped directly from the OS (mmap / VirtualAlloc),
+and nothing here depends on the C runtime's malloc.
+
+Since Em does not have pointers yet, the addresses are passed
+around as u64, and mem_load_* / mem_store_* are there to read
+and write the memory. the bulk operations (mem_copy, mem_set,
+mem_compare, mem_find, str_length) are vectorized, with the
+instruction set picked at runtime.
+
+NOTE: slabs are never given back to the OS (the objects in them
+are reused through the free lists), and the cache of a thread is
+not given back when the thread exits.
+
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define EM_NUM_SIZE_CLASSES 40
+#define EM_MAX_SMALL_SIZE 32768
+#define EM_SLAB_SIZE (256 * 1024)          // (also the alignment of the slabs)
+#define EM_SEGMENT_SIZE (4 * 1024 * 1024)
+#define EM_SLAB_HEADER_SIZE 64
+#define EM_LARGE_CLASS 0xFFFF
+#define EM_MAX_BATCH 64
+#define EM_ARENA_MIN_CHUNK (64 * 1024)
+#define EM_ALIGNMENT 16
+
+
+//                     OS memory mapping
+// ***********************************************************
+
+#ifdef _WIN32
+
+#define MEM_COMMIT 0x1000
+#define MEM_RESERVE 0x2000
+#define MEM_RELEASE 0x8000
+#define PAGE_NOACCESS 0x01
+#define PAGE_READWRITE 0x04
+
+void *__stdcall VirtualAlloc(void *address, size_t size, unsigned long type, unsigned long protect);
+int __stdcall VirtualFree(void *address, size_t size, unsigned long type);
+
+static void *os_map(size_t size) {
+    return VirtualAlloc(0, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+}
+
+static void os_unmap(void *address, size_t size) {
+    (void)size;
+    VirtualFree(address, 0, MEM_RELEASE);
+}
+
+// a region can only be released as a whole on Windows, so instead of
+// trimming a larger mapping, we look for an aligned address (by
+// reserving a larger region, and releasing it) and then map there.
+// (another thread could take that address in between, so retry)
+static void *os_map_aligned(size_t size, size_t alignment) {
+    for (int attempt = 0; attempt < 16; attempt++) {
+        char *p = (char *)VirtualAlloc(0, size + alignment, MEM_RESERVE, PAGE_NOACCESS);
+        if (!p)
+            return 0;
+        VirtualFree(p, 0, MEM_RELEASE);
+
+        char *aligned = (char *)(((uintptr_t)p + alignment - 1) & ~(uintptr_t)(alignment - 1));
+        void *q = VirtualAlloc(aligned, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if (q)
+            return q;
+    }
+    return 0;
+}
+
+#else
+
+#include <sys/mman.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+static void *os_map(size_t size) {
+    void *p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return (p == MAP_FAILED) ? 0 : p;
+}
+
+static void os_unmap(void *address, size_t size) {
+    munmap(address, size);
+}
+
+// maps a larger region, and trims the parts before and after the
+// aligned range (those pages were never touched, so it's cheap)
+static void *os_map_aligned(size_t size, size_t alignment) {
+    char *p = (char *)os_map(size + alignment);
+    if (!p)
+        return 0;
+
+    char *aligned = (char *)(((uintptr_t)p + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    size_t head = aligned - p;
+    size_t tail = alignment - head;
+
+    if (head)
+        os_unmap(p, head);
+    if (tail)
+        os_unmap(aligned + size, tail);
+    return aligned;
+}
+
+#endif
+
+
+//                         Spinlocks
+// ***********************************************************
+
+// the critical sections are short (moving a batch of objects),
+// so a spinlock is cheaper than going to the OS.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define cpu_relax() __asm__ __volatile__("yield")
+#else
+#define cpu_relax()
+#endif
+
+static void lock(int *l) {
+    while (__atomic_exchange_n(l, 1, __ATOMIC_ACQUIRE)) {
+        while (__atomic_load_n(l, __ATOMIC_RELAXED))
+            cpu_relax();
+    }
+}
+
+static void unlock(int *l) {
+    __atomic_store_n(l, 0, __ATOMIC_RELEASE);
+}
+
+
+//                        Size classes
+// ***********************************************************
+
+static uint32_t size_to_class(size_t size) {
+    if (size <= 128)
+        return size ? (uint32_t)((size + 15) / 16 - 1) : 0;
+
+    // for sizes in (2^k, 2^(k+1)], there are 4 classes, 2^(k-2) apart
+    uint32_t k = 63 - __builtin_clzll((unsigned long long)(size - 1));
+    return 8 + (k - 7) * 4 + (uint32_t)((size - 1 - ((size_t)1 << k)) >> (k - 2));
+}
+
+static size_t class_to_size(uint32_t size_class) {
+    if (size_class < 8)
+        return (size_t)(size_class + 1) * 16;
+
+    uint32_t k = 7 + (size_class - 8) / 4;
+    uint32_t step = (size_class - 8) % 4 + 1;
+    return ((size_t)1 << k) + step * ((size_t)1 << (k - 2));
+}
+
+// how many objects move between a thread cache and the
+// central free list at a time (about 64 KB worth of them)
+static uint32_t class_batch_size(uint32_t size_class) {
+    size_t batch = (64 * 1024) / class_to_size(size_class);
+    if (batch < 2) return 2;
+    if (batch > EM_MAX_BATCH) return EM_MAX_BATCH;
+    return (uint32_t)batch;
+}
+
+
+//                      Slabs and segments
+// ***********************************************************
+
+// at the beginning of every slab (and of every large allocation)
+typedef struct {
+    uint32_t size_class;  // EM_LARGE_CLASS for large allocations
+    uint32_t object_size;
+    size_t mapped_size;   // (only for large allocations)
+} Em_Slab_Header;
+
+static int segment_lock = 0;
+static char *segment_next = 0;
+static char *segment_end = 0;
+
+static char *new_slab(uint32_t size_class) {
+    lock(&segment_lock);
+
+    if (segment_next == segment_end) {
+        char *segment = (char *)os_map_aligned(EM_SEGMENT_SIZE, EM_SLAB_SIZE);
+        if (!segment) {
+            unlock(&segment_lock);
+            return 0;
+        }
+        segment_next = segment;
+        segment_end = segment + EM_SEGMENT_SIZE;
+    }
+    char *slab = segment_next;
+    segment_next += EM_SLAB_SIZE;
+
+    unlock(&segment_lock);
+
+    Em_Slab_Header *header = (Em_Slab_Header *)slab;
+    header->size_class = size_class;
+    header->object_size = (uint32_t)class_to_size(size_class);
+    return slab;
+}
+
+static Em_Slab_Header *get_header(void *p) {
+    return (Em_Slab_Header *)((uintptr_t)p & ~(uintptr_t)(EM_SLAB_SIZE - 1));
+}
+
+
+//                    Central free lists
+// ***********************************************************
+
+// the free objects are linked through their first word
+typedef struct Em_Free_Object {
+    struct Em_Free_Object *next;
+} Em_Free_Object;
+
+typedef struct {
+    int lock;
+    Em_Free_Object *head;
+    uint32_t count;
+
+    // the part of the latest slab that hasn't been handed out yet
+    char *bump;
+    char *bump_end;
+} Em_Central_List;
+
+static Em_Central_List central[EM_NUM_SIZE_CLASSES];
+
+// takes (up to) count objects, and links them into a list.
+// returns how many were taken.
+static uint32_t central_take(uint32_t size_class, uint32_t count,
+                             Em_Free_Object **head_out) {
+    Em_Central_List *c = &central[size_class];
+    size_t size = class_to_size(size_class);
+    Em_Free_Object *head = 0;
+    uint32_t taken = 0;
+
+    lock(&c->lock);
+
+    // first from the objects that have been freed
+    while (taken < count && c->head) {
+        Em_Free_Object *obj = c->head;
+        c->head = obj->next;
+        obj->next = head;
+        head = obj;
+        taken++;
+    }
+    c->count -= taken;
+
+    // and then the fresh ones, from the slab
+    while (taken < count) {
+        if (c->bump + size > c->bump_end) {
+            char *slab = new_slab(size_class);
+            if (!slab)
+                break;
+            c->bump = slab + EM_SLAB_HEADER_SIZE;
+            c->bump_end = slab + EM_SLAB_SIZE;
+        }
+        Em_Free_Object *obj = (Em_Free_Object *)c->bump;
+        c->bump += size;
+        obj->next = head;
+        head = obj;
+        taken++;
+    }
+
+    unlock(&c->lock);
+
+    *head_out = head;
+    return taken;
+}
+
+static void central_give(uint32_t size_class, Em_Free_Object *head,
+                         Em_Free_Object *tail, uint32_t count) {
+    Em_Central_List *c = &central[size_class];
+
+    lock(&c->lock);
+    tail->next = c->head;
+    c->head = head;
+    c->count += count;
+    unlock(&c->lock);
+}
+
+
+//                       Thread caches
+// ***********************************************************
+
+typedef struct {
+    Em_Free_Object *head;
+    uint32_t count;
+} Em_Thread_List;
+
+static _Thread_local Em_Thread_List thread_cache[EM_NUM_SIZE_CLASSES];
+
+static void *thread_cache_refill(uint32_t size_class) {
+    Em_Thread_List *list = &thread_cache[size_class];
+    Em_Free_Object *head;
+    uint32_t taken = central_take(size_class, class_batch_size(size_class), &head);
+    if (taken == 0)
+        return 0;
+
+    // hand out the first one, and keep the rest
+    list->head = head->next;
+    list->count = taken - 1;
+    return head;
+}
+
+// gives back a batch from the front of the list
+static void thread_cache_release(uint32_t size_class) {
+    Em_Thread_List *list = &thread_cache[size_class];
+    uint32_t batch = class_batch_size(size_class);
+
+    Em_Free_Object *head = list->head;
+    Em_Free_Object *tail = head;
+    for (uint32_t i = 1; i < batch; i++)
+        tail = tail->next;
+
+    list->head = tail->next;
+    list->count -= batch;
+    central_give(size_class, head, tail, batch);
+}
+
+
+//                    General allocation
+// ***********************************************************
+
+static void *allocate(size_t size) {
+    if (size > EM_MAX_SMALL_SIZE) {
+        // (rounded up, so that it stays a multiple of the page size)
+        size_t mapped_size = (size + EM_SLAB_HEADER_SIZE + 0xFFFF) & ~(size_t)0xFFFF;
+        char *base = (char *)os_map_aligned(mapped_size, EM_SLAB_SIZE);
+        if (!base)
+            return 0;
+
+        Em_Slab_Header *header = (Em_Slab_Header *)base;
+        header->size_class = EM_LARGE_CLASS;
+        header->object_size = 0;
+        header->mapped_size = mapped_size;
+        return base + EM_SLAB_HEADER_SIZE;
+    }
+
+    uint32_t size_class = size_to_class(size);
+    Em_Thread_List *list = &thread_cache[size_class];
+
+    Em_Free_Object *obj = list->head;
+    if (obj) {
+        list->head = obj->next;
+        list->count--;
+        return obj;
+    }
+    return thread_cache_refill(size_class);
+}
+
+static void deallocate(void *p) {
+    if (!p)
+        return;
+
+    Em_Slab_Header *header = get_header(p);
+    if (header->size_class == EM_LARGE_CLASS) {
+        os_unmap(header, header->mapped_size);
+        return;
+    }
+
+    uint32_t size_class = header->size_class;
+    Em_Thread_List *list = &thread_cache[size_class];
+
+    Em_Free_Object *obj = (Em_Free_Object *)p;
+    obj->next = list->head;
+    list->head = obj;
+    list->count++;
+
+    if (list->count >= 2 * class_batch_size(size_class))
+        thread_cache_release(size_class);
+}
+
+static size_t usable_size(void *p) {
+    Em_Slab_Header *header = get_header(p);
+    if (header->size_class == EM_LARGE_CLASS)
+        return header->mapped_size - EM_SLAB_HEADER_SIZE;
+    return header->object_size;
+}
+
+uint64_t mem_alloc(int32_t size) {
+    if (size < 0)
+        return 0;
+    return (uint64_t)(uintptr_t)allocate((size_t)size);
+}
+
+uint64_t mem_alloc_zeroed(int32_t size) {
+    if (size < 0)
+        return 0;
+    char *p = (char *)allocate((size_t)size);
+
+    // (large allocations come fresh from the OS, already zeroed)
+    if (p && size <= EM_MAX_SMALL_SIZE)
+        __builtin_memset(p, 0, (size_t)size);
+    return (uint64_t)(uintptr_t)p;
+}
+
+uint64_t mem_realloc(uint64_t address, int32_t size) {
+    void *p = (void *)(uintptr_t)address;
+    if (!p)
+        return mem_alloc(size);
+    if (size < 0)
+        return 0;
+
+    // it may still fit where it is (as long as it would
+    // not be wasting most of a large allocation)
+    size_t old_size = usable_size(p);
+    if ((size_t)size <= old_size) {
+        if (old_size > EM_MAX_SMALL_SIZE ? size > EM_MAX_SMALL_SIZE
+                                         : size_to_class((size_t)size) == size_to_class(old_size))
+            return address;
+    }
+
+    void *q = allocate((size_t)size);
+    if (!q)
+        return 0;
+    __builtin_memcpy(q, p, old_size < (size_t)size ? old_size : (size_t)size);
+    deallocate(p);
+    return (uint64_t)(uintptr_t)q;
+}
+
+void mem_free(uint64_t address) {
+    deallocate((void *)(uintptr_t)address);
+}
+
+
+//                           Arenas
+// ***********************************************************
+
+typedef struct Em_Arena_Chunk {
+    struct Em_Arena_Chunk *next;
+    size_t size;
+} Em_Arena_Chunk;
+
+typedef struct {
+    Em_Arena_Chunk *first;
+    Em_Arena_Chunk *current;
+    char *ptr;
+    char *end;
+} Em_Arena;
+
+#define EM_CHUNK_HEADER_SIZE ((sizeof(Em_Arena_Chunk) + EM_ALIGNMENT - 1) & ~(size_t)(EM_ALIGNMENT - 1))
+#define EM_ARENA_HEADER_SIZE ((sizeof(Em_Arena) + EM_ALIGNMENT - 1) & ~(size_t)(EM_ALIGNMENT - 1))
+
+static Em_Arena_Chunk *new_arena_chunk(size_t size) {
+    Em_Arena_Chunk *chunk = (Em_Arena_Chunk *)os_map(size);
+    if (!chunk)
+        return 0;
+    chunk->next = 0;
+    chunk->size = size;
+    return chunk;
+}
+
+// the arena itself lives at the beginning of its first chunk
+uint64_t arena_create(int32_t capacity) {
+    size_t size = (capacity > 0 ? (size_t)capacity : 0) + EM_CHUNK_HEADER_SIZE + EM_ARENA_HEADER_SIZE;
+    if (size < EM_ARENA_MIN_CHUNK)
+        size = EM_ARENA_MIN_CHUNK;
+
+    Em_Arena_Chunk *chunk = new_arena_chunk(size);
+    if (!chunk)
+        return 0;
+
+    Em_Arena *arena = (Em_Arena *)((char *)chunk + EM_CHUNK_HEADER_SIZE);
+    arena->first = chunk;
+    arena->current = chunk;
+    arena->ptr = (char *)arena + EM_ARENA_HEADER_SIZE;
+    arena->end = (char *)chunk + size;
+    return (uint64_t)(uintptr_t)arena;
+}
+
+uint64_t arena_alloc(uint64_t handle, int32_t size) {
+    Em_Arena *arena = (Em_Arena *)(uintptr_t)handle;
+    if (!arena || size < 0)
+        return 0;
+
+    size_t aligned_size = ((size_t)size + EM_ALIGNMENT - 1) & ~(size_t)(EM_ALIGNMENT - 1);
+    if (aligned_size <= (size_t)(arena->end - arena->ptr)) {
+        char *p = arena->ptr;
+        arena->ptr += aligned_size;
+        return (uint64_t)(uintptr_t)p;
+    }
+
+    // move on to the next chunk that is big enough (after a reset,
+    // the chunks from before are still there), or else add one,
+    // twice as big as the last
+    Em_Arena_Chunk *chunk = arena->current->next;
+    while (chunk && chunk->size - EM_CHUNK_HEADER_SIZE < aligned_size)
+        chunk = chunk->next;
+
+    if (!chunk) {
+        Em_Arena_Chunk *last = arena->current;
+        while (last->next)
+            last = last->next;
+
+        size_t chunk_size = last->size * 2;
+        if (chunk_size < aligned_size + EM_CHUNK_HEADER_SIZE)
+            chunk_size = aligned_size + EM_CHUNK_HEADER_SIZE;
+
+        chunk = new_arena_chunk(chunk_size);
+        if (!chunk)
+            return 0;
+        last->next = chunk;
+    }
+
+    arena->current = chunk;
+    char *p = (char *)chunk + EM_CHUNK_HEADER_SIZE;
+    arena->ptr = p + aligned_size;
+    arena->end = (char *)chunk + chunk->size;
+    return (uint64_t)(uintptr_t)p;
+}
+
+// frees everything in the arena at once. the chunks are
+// kept, so the memory gets reused by the next allocations.
+void arena_reset(uint64_t handle) {
+    Em_Arena *arena = (Em_Arena *)(uintptr_t)handle;
+    if (!arena)
+        return;
+
+    arena->current = arena->first;
+    arena->ptr = (char *)arena + EM_ARENA_HEADER_SIZE;
+    arena->end = (char *)arena->first + arena->first->size;
+}
+
+void arena_destroy(uint64_t handle) {
+    Em_Arena *arena = (Em_Arena *)(uintptr_t)handle;
+    if (!arena)
+        return;
+
+    // (the first chunk holds the arena, so it goes last)
+    Em_Arena_Chunk *chunk = arena->first->next;
+    while (chunk) {
+        Em_Arena_Chunk *next = chunk->next;
+        os_unmap(chunk, chunk->size);
+        chunk = next;
+    }
+    os_unmap(arena->first, arena->first->size);
+}
+
+
+//                      Reading / writing
+// ***********************************************************
+
+int64_t mem_load_s64(uint64_t address, int32_t index) {
+    return ((int64_t *)(uintptr_t)address)[index];
+}
+
+void mem_store_s64(uint64_t address, int32_t index, int64_t value) {
+    ((int64_t *)(uintptr_t)address)[index] = value;
+}
+
+uint8_t mem_load_u8(uint64_t address, int32_t index) {
+    return ((uint8_t *)(uintptr_t)address)[index];
+}
+
+void mem_store_u8(uint64_t address, int32_t index, uint8_t value) {
+    ((uint8_t *)(uintptr_t)address)[index] = value;
+}
+
+
+//                      Bulk operations
+// ***********************************************************
+
+/*
+mem_copy, mem_set, mem_compare, mem_find and str_length come in
+a few versions (see memory_simd.h):
+
+    - SSE2, 16 bytes at a time (always there on x86-64)
+    - AVX2, 32 bytes at a time
+    - NEON, 16 bytes at a time (always there on AArch64)
+    - plain C, for everything else
+
+on x86-64 the version is picked on the first call (from cpuid),
+and kept in a table of function pointers.
+
+the compiler turns mem_copy / mem_set with a small constant size
+into llvm.memcpy / llvm.memset (which are inlined as a few moves),
+so these end up being called for the large or unknown sizes.
+*/
+
+static inline uint64_t load_u64(const uint8_t *p) {
+    uint64_t v;
+    __builtin_memcpy(&v, p, 8);
+    return v;
+}
+
+static inline void store_u64(uint8_t *p, uint64_t v) {
+    __builtin_memcpy(p, &v, 8);
+}
+
+// (for the sizes smaller than a vector. the first and
+// last 8 bytes overlap, so there is no loop for the rest)
+static void copy_small(uint8_t *dst, const uint8_t *src, size_t n) {
+    if (n >= 16) {
+        uint64_t a = load_u64(src), b = load_u64(src + 8);
+        uint64_t c = load_u64(src + n - 16), d = load_u64(src + n - 8);
+        store_u64(dst, a);
+        store_u64(dst + 8, b);
+        store_u64(dst + n - 16, c);
+        store_u64(dst + n - 8, d);
+    } else if (n >= 8) {
+        uint64_t a = load_u64(src), b = load_u64(src + n - 8);
+        store_u64(dst, a);
+        store_u64(dst + n - 8, b);
+    } else {
+        for (size_t i = 0; i < n; i++)
+            dst[i] = src[i];
+    }
+}
+
+static void set_small(uint8_t *dst, uint8_t value, size_t n) {
+    uint64_t v = value * 0x0101010101010101ull;
+    if (n >= 16) {
+        store_u64(dst, v);
+        store_u64(dst + 8, v);
+        store_u64(dst + n - 16, v);
+        store_u64(dst + n - 8, v);
+    } else if (n >= 8) {
+        store_u64(dst, v);
+        store_u64(dst + n - 8, v);
+    } else {
+        for (size_t i = 0; i < n; i++)
+            dst[i] = value;
+    }
+}
+
+static int32_t compare_small(const uint8_t *a, const uint8_t *b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] != b[i])
+            return (int32_t)a[i] - (int32_t)b[i];
+    }
+    return 0;
+}
+
+static int32_t find_small(const uint8_t *p, uint8_t value, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (p[i] == value)
+            return (int32_t)i;
+    }
+    return -1;
+}
+
+typedef struct {
+    void (*copy)(uint8_t *dst, const uint8_t *src, size_t n);
+    void (*set)(uint8_t *dst, uint8_t value, size_t n);
+    int32_t (*compare)(const uint8_t *a, const uint8_t *b, size_t n);
+    int32_t (*find)(const uint8_t *p, uint8_t value, size_t n);
+    int32_t (*length)(const char *text);
+} Em_Bulk_Ops;
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#include <immintrin.h>
+#include <cpuid.h>
+
+#define EM_SIMD(name) sse2_##name
+#define EM_TARGET __attribute__((target("sse2")))
+#define EM_VEC __m128i
+#define EM_WIDTH 16
+#define EM_LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+#define EM_STORE(p, v) _mm_storeu_si128((__m128i *)(p), (v))
+#define EM_SPLAT(b) _mm_set1_epi8((char)(b))
+#define EM_EQ(a, b) _mm_cmpeq_epi8((a), (b))
+#define EM_AND(a, b) _mm_and_si128((a), (b))
+#define EM_OR(a, b) _mm_or_si128((a), (b))
+#define EM_MASK(v) ((uint64_t)(uint32_t)_mm_movemask_epi8(v))
+#define EM_MASK_BITS 1
+#define EM_FULL_MASK 0xFFFFull
+#include "memory_simd.h"
+
+#define EM_SIMD(name) avx2_##name
+#define EM_TARGET __attribute__((target("avx2")))
+#define EM_VEC __m256i
+#define EM_WIDTH 32
+#define EM_LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+#define EM_STORE(p, v) _mm256_storeu_si256((__m256i *)(p), (v))
+#define EM_SPLAT(b) _mm256_set1_epi8((char)(b))
+#define EM_EQ(a, b) _mm256_cmpeq_epi8((a), (b))
+#define EM_AND(a, b) _mm256_and_si256((a), (b))
+#define EM_OR(a, b) _mm256_or_si256((a), (b))
+#define EM_MASK(v) ((uint64_t)(uint32_t)_mm256_movemask_epi8(v))
+#define EM_MASK_BITS 1
+#define EM_FULL_MASK 0xFFFFFFFFull
+#include "memory_simd.h"
+
+static const Em_Bulk_Ops sse2_ops = {sse2_copy, sse2_set, sse2_compare, sse2_find, sse2_length};
+static const Em_Bulk_Ops avx2_ops = {avx2_copy, avx2_set, avx2_compare, avx2_find, avx2_length};
+
+static int cpu_has_avx2(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return 0;
+
+    // the OS has to save the ymm registers too (OSXSAVE, and
+    // then the xmm and ymm state enabled in XCR0)
+    if (!(ecx & (1u << 27)) || !(ecx & (1u << 28)))
+        return 0;
+    unsigned int xcr0_lo, xcr0_hi;
+    __asm__ __volatile__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    if ((xcr0_lo & 6) != 6)
+        return 0;
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        return 0;
+    return (ebx & (1u << 5)) != 0;
+}
+
+static const Em_Bulk_Ops *select_bulk_ops(void) {
+    return cpu_has_avx2() ? &avx2_ops : &sse2_ops;
+}
+
+#elif defined(__aarch64__) || defined(_M_ARM64)
+
+#include <arm_neon.h>
+
+// (NEON has no movemask, so the vector is narrowed down
+// to 4 bits per byte instead, which fit in 64 bits)
+static inline uint64_t neon_mask(uint8x16_t v) {
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(v), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+}
+
+#define EM_SIMD(name) neon_##name
+#define EM_TARGET
+#define EM_VEC uint8x16_t
+#define EM_WIDTH 16
+#define EM_LOAD(p) vld1q_u8((const uint8_t *)(p))
+#define EM_STORE(p, v) vst1q_u8((uint8_t *)(p), (v))
+#define EM_SPLAT(b) vdupq_n_u8((uint8_t)(b))
+#define EM_EQ(a, b) vceqq_u8((a), (b))
+#define EM_AND(a, b) vandq_u8((a), (b))
+#define EM_OR(a, b) vorrq_u8((a), (b))
+#define EM_MASK(v) neon_mask(v)
+#define EM_MASK_BITS 4
+#define EM_FULL_MASK 0xFFFFFFFFFFFFFFFFull
+#include "memory_simd.h"
+
+static const Em_Bulk_Ops neon_ops = {neon_copy, neon_set, neon_compare, neon_find, neon_length};
+
+static const Em_Bulk_Ops *select_bulk_ops(void) {
+    return &neon_ops;
+}
+
+#else
+
+static void scalar_copy(uint8_t *dst, const uint8_t *src, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] = src[i];
+}
+
+static void scalar_set(uint8_t *dst, uint8_t value, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] = value;
+}
+
+static int32_t scalar_length(const char *text) {
+    const char *p = text;
+    while (*p) p++;
+    return (int32_t)(p - text);
+}
+
+static const Em_Bulk_Ops scalar_ops = {scalar_copy, scalar_set, compare_small, find_small, scalar_length};
+
+static const Em_Bulk_Ops *select_bulk_ops(void) {
+    return &scalar_ops;
+}
+
+#endif
+
+static const Em_Bulk_Ops *bulk_ops = 0;
+
+static const Em_Bulk_Ops *get_bulk_ops(void) {
+    // (any thread may select them, they all come up with the same)
+    const Em_Bulk_Ops *ops = __atomic_load_n(&bulk_ops, __ATOMIC_RELAXED);
+    if (!ops) {
+        ops = select_bulk_ops();
+        __atomic_store_n(&bulk_ops, ops, __ATOMIC_RELAXED);
+    }
+    return ops;
+}
+
+// the regions must not overlap
+void mem_copy(uint64_t destination, uint64_t source, int32_t size) {
+    if (size > 0)
+        get_bulk_ops()->copy((uint8_t *)(uintptr_t)destination,
+                             (const uint8_t *)(uintptr_t)source, (size_t)size);
+}
+
+void mem_set(uint64_t destination, uint8_t value, int32_t size) {
+    if (size > 0)
+        get_bulk_ops()->set((uint8_t *)(uintptr_t)destination, value, (size_t)size);
+}
+
+int32_t mem_compare(uint64_t a, uint64_t b, int32_t size) {
+    if (size <= 0)
+        return 0;
+    return get_bulk_ops()->compare((const uint8_t *)(uintptr_t)a,
+                                   (const uint8_t *)(uintptr_t)b, (size_t)size);
+}
+
+int32_t mem_find(uint64_t address, uint8_t value, int32_t size) {
+    if (size <= 0)
+        return -1;
+    return get_bulk_ops()->find((const uint8_t *)(uintptr_t)address, value, (size_t)size);
+}
+
+int32_t str_length(const char *text) {
+    return get_bulk_ops()->length(text);
+}
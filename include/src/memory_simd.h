@@ -0,0 +1,201 @@
+//
+// memory_simd.h
+//
+
+/*
+
+The vectorized bulk operations of memory.c, written once
+for all the instruction sets.
+
+memory.c includes this file once per instruction set, with
+these defined:
+
+    EM_SIMD(name)       the name of the functions of that version
+    EM_TARGET           the target attribute for the functions
+    EM_VEC              the vector type
+    EM_WIDTH            the size of the vector, in bytes
+    EM_LOAD(p)          an unaligned load of a vector
+    EM_STORE(p, v)      an unaligned store of a vector
+    EM_SPLAT(b)         a vector with every byte set to b
+    EM_EQ(a, b)         a vector with 0xFF in the bytes that are equal
+    EM_AND(a, b) / EM_OR(a, b)
+    EM_MASK(v)          a mask of the 0xFF bytes of v (as a uint64_t,
+                        with the lowest byte first)
+    EM_MASK_BITS        the number of bits per byte in those masks
+    EM_FULL_MASK        the mask of a vector where all bytes are 0xFF
+
+(and it undefines them at the end)
+
+*/
+
+#define EM_FIRST_INDEX(mask) ((size_t)__builtin_ctzll(mask) / EM_MASK_BITS)
+#define EM_EQ_MASK(a, b) EM_MASK(EM_EQ((a), (b)))
+
+EM_TARGET static void EM_SIMD(copy)(uint8_t *dst, const uint8_t *src, size_t n) {
+    if (n < EM_WIDTH) {
+        copy_small(dst, src, n);
+        return;
+    }
+
+    // the first and the last vector are copied separately (overlapping
+    // with the ones in between), so that the stores in between can be
+    // aligned, and there is no tail left over.
+    EM_VEC first = EM_LOAD(src);
+    EM_VEC last = EM_LOAD(src + n - EM_WIDTH);
+    size_t i = EM_WIDTH - ((uintptr_t)dst & (EM_WIDTH - 1));
+
+    for (; i + 4 * EM_WIDTH <= n; i += 4 * EM_WIDTH) {
+        EM_VEC a = EM_LOAD(src + i);
+        EM_VEC b = EM_LOAD(src + i + EM_WIDTH);
+        EM_VEC c = EM_LOAD(src + i + 2 * EM_WIDTH);
+        EM_VEC d = EM_LOAD(src + i + 3 * EM_WIDTH);
+        EM_STORE(dst + i, a);
+        EM_STORE(dst + i + EM_WIDTH, b);
+        EM_STORE(dst + i + 2 * EM_WIDTH, c);
+        EM_STORE(dst + i + 3 * EM_WIDTH, d);
+    }
+    for (; i + EM_WIDTH <= n; i += EM_WIDTH)
+        EM_STORE(dst + i, EM_LOAD(src + i));
+
+    EM_STORE(dst, first);
+    EM_STORE(dst + n - EM_WIDTH, last);
+}
+
+EM_TARGET static void EM_SIMD(set)(uint8_t *dst, uint8_t value, size_t n) {
+    if (n < EM_WIDTH) {
+        set_small(dst, value, n);
+        return;
+    }
+
+    // (the same way as the copy: aligned stores in between)
+    EM_VEC v = EM_SPLAT(value);
+    EM_STORE(dst, v);
+    EM_STORE(dst + n - EM_WIDTH, v);
+    size_t i = EM_WIDTH - ((uintptr_t)dst & (EM_WIDTH - 1));
+
+    for (; i + 4 * EM_WIDTH <= n; i += 4 * EM_WIDTH) {
+        EM_STORE(dst + i, v);
+        EM_STORE(dst + i + EM_WIDTH, v);
+        EM_STORE(dst + i + 2 * EM_WIDTH, v);
+        EM_STORE(dst + i + 3 * EM_WIDTH, v);
+    }
+    for (; i + EM_WIDTH <= n; i += EM_WIDTH)
+        EM_STORE(dst + i, v);
+}
+
+EM_TARGET static int32_t EM_SIMD(compare)(const uint8_t *a, const uint8_t *b, size_t n) {
+    if (n < EM_WIDTH)
+        return compare_small(a, b, n);
+
+    // 4 vectors at a time, and when they are not all equal,
+    // the first difference is found one vector at a time below
+    size_t i = 0;
+    for (; i + 4 * EM_WIDTH <= n; i += 4 * EM_WIDTH) {
+        EM_VEC eq = EM_AND(EM_AND(EM_EQ(EM_LOAD(a + i), EM_LOAD(b + i)),
+                                  EM_EQ(EM_LOAD(a + i + EM_WIDTH), EM_LOAD(b + i + EM_WIDTH))),
+                           EM_AND(EM_EQ(EM_LOAD(a + i + 2 * EM_WIDTH), EM_LOAD(b + i + 2 * EM_WIDTH)),
+                                  EM_EQ(EM_LOAD(a + i + 3 * EM_WIDTH), EM_LOAD(b + i + 3 * EM_WIDTH))));
+        if (EM_MASK(eq) != EM_FULL_MASK)
+            break;
+    }
+    if (i == n)
+        return 0;
+
+    // (the last vector overlaps with the ones before it, but
+    // those were all equal, so the first difference is the same)
+    for (;; i += EM_WIDTH) {
+        if (i + EM_WIDTH > n)
+            i = n - EM_WIDTH;
+
+        uint64_t mask = EM_EQ_MASK(EM_LOAD(a + i), EM_LOAD(b + i));
+        if (mask != EM_FULL_MASK) {
+            size_t j = i + EM_FIRST_INDEX(~mask & EM_FULL_MASK);
+            return (int32_t)a[j] - (int32_t)b[j];
+        }
+        if (i + EM_WIDTH == n)
+            return 0;
+    }
+}
+
+EM_TARGET static int32_t EM_SIMD(find)(const uint8_t *p, uint8_t value, size_t n) {
+    if (n < EM_WIDTH)
+        return find_small(p, value, n);
+
+    EM_VEC needle = EM_SPLAT(value);
+    size_t i = 0;
+    for (; i + 4 * EM_WIDTH <= n; i += 4 * EM_WIDTH) {
+        EM_VEC found = EM_OR(EM_OR(EM_EQ(EM_LOAD(p + i), needle),
+                                   EM_EQ(EM_LOAD(p + i + EM_WIDTH), needle)),
+                             EM_OR(EM_EQ(EM_LOAD(p + i + 2 * EM_WIDTH), needle),
+                                   EM_EQ(EM_LOAD(p + i + 3 * EM_WIDTH), needle)));
+        if (EM_MASK(found))
+            break;
+    }
+    if (i == n)
+        return -1;
+
+    for (;; i += EM_WIDTH) {
+        if (i + EM_WIDTH > n)
+            i = n - EM_WIDTH;
+
+        uint64_t mask = EM_EQ_MASK(EM_LOAD(p + i), needle);
+        if (mask)
+            return (int32_t)(i + EM_FIRST_INDEX(mask));
+        if (i + EM_WIDTH == n)
+            return -1;
+    }
+}
+
+EM_TARGET static int32_t EM_SIMD(length)(const char *text) {
+    // the vectors are read from aligned addresses, so that they
+    // never cross into the next page (which may not be mapped),
+    // even though they read past the end of the string. the first
+    // one starts before the string, so those bytes are shifted out.
+    size_t misalignment = (uintptr_t)text & (EM_WIDTH - 1);
+    const uint8_t *block = (const uint8_t *)text - misalignment;
+    EM_VEC zero = EM_SPLAT(0);
+
+    uint64_t mask = EM_EQ_MASK(EM_LOAD(block), zero) >> (misalignment * EM_MASK_BITS);
+    if (mask)
+        return (int32_t)EM_FIRST_INDEX(mask);
+
+    // then 4 aligned vectors at a time (which are all on the same
+    // page, as long as the first one is aligned to 4 vectors)
+    block += EM_WIDTH;
+    while ((uintptr_t)block & (4 * EM_WIDTH - 1)) {
+        mask = EM_EQ_MASK(EM_LOAD(block), zero);
+        if (mask)
+            return (int32_t)(block - (const uint8_t *)text + EM_FIRST_INDEX(mask));
+        block += EM_WIDTH;
+    }
+    for (;; block += 4 * EM_WIDTH) {
+        EM_VEC a = EM_EQ(EM_LOAD(block), zero);
+        EM_VEC b = EM_EQ(EM_LOAD(block + EM_WIDTH), zero);
+        EM_VEC c = EM_EQ(EM_LOAD(block + 2 * EM_WIDTH), zero);
+        EM_VEC d = EM_EQ(EM_LOAD(block + 3 * EM_WIDTH), zero);
+        if (!EM_MASK(EM_OR(EM_OR(a, b), EM_OR(c, d))))
+            continue;
+
+        size_t offset = block - (const uint8_t *)text;
+        if ((mask = EM_MASK(a))) return (int32_t)(offset + EM_FIRST_INDEX(mask));
+        if ((mask = EM_MASK(b))) return (int32_t)(offset + EM_WIDTH + EM_FIRST_INDEX(mask));
+        if ((mask = EM_MASK(c))) return (int32_t)(offset + 2 * EM_WIDTH + EM_FIRST_INDEX(mask));
+        return (int32_t)(offset + 3 * EM_WIDTH + EM_FIRST_INDEX(EM_MASK(d)));
+    }
+}
+
+#undef EM_FIRST_INDEX
+#undef EM_EQ_MASK
+#undef EM_SIMD
+#undef EM_TARGET
+#undef EM_VEC
+#undef EM_WIDTH
+#undef EM_LOAD
+#undef EM_STORE
+#undef EM_SPLAT
+#undef EM_EQ
+#undef EM_AND
+#undef EM_OR
+#undef EM_MASK
+#undef EM_MASK_BITS
+#undef EM_FULL_MASK
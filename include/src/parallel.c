@@ -0,0 +1,400 @@
+//
+// parallel.c
+//
+
+/*
+
+This is the runtime for the "parallel for" construct.
+
+The compiler outlines the body of a parallel for
+loop into a function of the form:
+
+    void body(s64 begin, s64 end, void *ctx);
+
+which runs the iterations [begin, end) sequentially.
+It then emits a single call to __em_parallel_for(),
+which is implemented here.
+
+The runtime is a work-stealing thread pool:
+
+    (1) there is one worker thread per core (minus one,
+    since the calling thread also does work). these are
+    started lazily, on the first parallel for.
+
+    (2) each thread owns a Chase-Lev deque of tasks. a
+    task is just a range of iterations of some loop. the
+    owner pushes/pops at the bottom of its deque (LIFO,
+    which is cache friendly), while idle threads steal
+    from the top of other deques (FIFO, which gives them
+    the biggest remaining chunks).
+
+    (3) a range is split in half lazily: before running a
+    range larger than the grain size, the thread pushes
+    the upper half to its deque (so that it can be stolen)
+    and continues with the lower half.
+
+    (4) the calling thread keeps on working (and stealing)
+    until every iteration of its loop has been completed.
+    so a nested parallel for, inside a body, works too.
+
+The grain size is the smallest range that is not split
+any further. If the compiler passes 0, we choose one that
+gives each thread about 8 chunks of the range.
+
+NOTE: this file only depends on the OS threading APIs
+(kernel32 on Windows, pthreads elsewhere), and not on any
+C runtime library, just like print.c.
+
+*/
+
+#include <stdint.h>
+
+#define EM_MAX_WORKERS 64
+#define EM_DEQUE_CAPACITY 1024 // must be a power of 2
+#define EM_CHUNKS_PER_WORKER 8
+#define EM_SPINS_BEFORE_SLEEP 2048
+
+typedef void (*em_body_fn)(int64_t begin, int64_t end, void *ctx);
+
+
+//                   OS threading primitives
+// ***********************************************************
+
+#ifdef _WIN32
+
+typedef void* HANDLE;
+typedef unsigned long DWORD;
+typedef int BOOL;
+
+typedef struct { void *ptr; } SRWLOCK;
+typedef struct { void *ptr; } CONDITION_VARIABLE;
+
+#define INFINITE 0xFFFFFFFF
+#define ALL_PROCESSOR_GROUPS 0xFFFF
+
+HANDLE __stdcall CreateThread(void *attributes, uint64_t stack_size,
+                              DWORD (__stdcall *start)(void *), void *param,
+                              DWORD flags, DWORD *thread_id);
+DWORD __stdcall GetActiveProcessorCount(unsigned short group);
+BOOL __stdcall SwitchToThread(void);
+void __stdcall AcquireSRWLockExclusive(SRWLOCK *lock);
+void __stdcall ReleaseSRWLockExclusive(SRWLOCK *lock);
+BOOL __stdcall SleepConditionVariableSRW(CONDITION_VARIABLE *cv, SRWLOCK *lock,
+                                         DWORD ms, unsigned long flags);
+void __stdcall WakeAllConditionVariable(CONDITION_VARIABLE *cv);
+
+static SRWLOCK sleep_lock;
+static CONDITION_VARIABLE sleep_cv;
+
+#define lock_sleepers() AcquireSRWLockExclusive(&sleep_lock)
+#define unlock_sleepers() ReleaseSRWLockExclusive(&sleep_lock)
+#define wait_sleepers() SleepConditionVariableSRW(&sleep_cv, &sleep_lock, INFINITE, 0)
+#define wake_sleepers() WakeAllConditionVariable(&sleep_cv)
+#define yield_thread() SwitchToThread()
+
+#else
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+static pthread_mutex_t sleep_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sleep_cv = PTHREAD_COND_INITIALIZER;
+
+#define lock_sleepers() pthread_mutex_lock(&sleep_lock)
+#define unlock_sleepers() pthread_mutex_unlock(&sleep_lock)
+#define wait_sleepers() pthread_cond_wait(&sleep_cv, &sleep_lock)
+#define wake_sleepers() pthread_cond_broadcast(&sleep_cv)
+#define yield_thread() sched_yield()
+
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define cpu_relax() __asm__ __volatile__("yield")
+#else
+#define cpu_relax()
+#endif
+
+#define load_relaxed(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define load_acquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define store_relaxed(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+
+//                          Tasks
+// ***********************************************************
+
+// one parallel for loop (shared by all of its tasks)
+typedef struct {
+    em_body_fn body;
+    void *ctx;
+    int64_t grain;
+    int64_t remaining; // iterations not yet completed
+} Em_Job;
+
+// a range of iterations of a job
+typedef struct {
+    Em_Job *job;
+    int64_t begin;
+    int64_t end;
+} Em_Task;
+
+
+//                    Chase-Lev deque
+// ***********************************************************
+
+/*
+the owner of the deque is the only one that
+touches the bottom, while thieves compete on
+the top using a CAS. the only tricky case is
+when there is a single task left, and both the
+owner and some thief try to take it. then the
+owner also has to win a CAS on top.
+
+since tasks are split lazily, the deque of a
+thread can only hold about log2(n / grain) tasks,
+so we use a fixed capacity and simply run a task
+inline if the deque ever happens to be full.
+*/
+
+typedef struct {
+    int64_t top;
+    char _pad0[56]; // keep top and bottom on different cache lines
+    int64_t bottom;
+    char _pad1[56];
+    Em_Task tasks[EM_DEQUE_CAPACITY];
+} Em_Deque;
+
+static int deque_push(Em_Deque *d, Em_Task task) {
+    int64_t b = load_relaxed(&d->bottom);
+    int64_t t = load_acquire(&d->top);
+
+    if (b - t >= EM_DEQUE_CAPACITY)
+        return 0; // full
+
+    d->tasks[b & (EM_DEQUE_CAPACITY - 1)] = task;
+    store_release(&d->bottom, b + 1);
+    return 1;
+}
+
+static int deque_pop(Em_Deque *d, Em_Task *task) {
+    int64_t b = load_relaxed(&d->bottom) - 1;
+    store_relaxed(&d->bottom, b);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t t = load_relaxed(&d->top);
+
+    if (t > b) {
+        // deque was empty
+        store_relaxed(&d->bottom, b + 1);
+        return 0;
+    }
+
+    *task = d->tasks[b & (EM_DEQUE_CAPACITY - 1)];
+    if (t == b) {
+        // last task: race against the thieves for it
+        int won = __atomic_compare_exchange_n(&d->top, &t, t + 1, 0,
+                                              __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+        store_relaxed(&d->bottom, b + 1);
+        return won;
+    }
+    return 1;
+}
+
+static int deque_steal(Em_Deque *d, Em_Task *task) {
+    int64_t t = load_acquire(&d->top);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t b = load_acquire(&d->bottom);
+
+    if (t >= b)
+        return 0; // empty
+
+    *task = d->tasks[t & (EM_DEQUE_CAPACITY - 1)];
+    return __atomic_compare_exchange_n(&d->top, &t, t + 1, 0,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+
+//                       Thread pool
+// ***********************************************************
+
+// deque 0 belongs to the main thread of the program,
+// and 1..num_workers to the workers
+static Em_Deque deques[EM_MAX_WORKERS + 1];
+static int num_workers = 0;
+static int pool_state = 0; // 0: not started, 1: starting, 2: running
+
+static int64_t active_jobs = 0;
+static int sleeping_workers = 0;
+
+static _Thread_local int thread_index = 0;
+static _Thread_local uint32_t steal_seed = 0;
+
+// xorshift, for choosing a victim to steal from
+static uint32_t next_random(void) {
+    uint32_t x = steal_seed ? steal_seed : (uint32_t)(thread_index * 2654435761u + 1);
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    steal_seed = x;
+    return x;
+}
+
+// runs a task, splitting it in halves (and pushing the
+// upper halves onto our own deque) until it is small enough
+static void run_task(Em_Task task) {
+    Em_Deque *own = &deques[thread_index];
+    Em_Job *job = task.job;
+
+    while (task.end - task.begin > job->grain) {
+        int64_t mid = task.begin + (task.end - task.begin) / 2;
+        Em_Task upper = { job, mid, task.end };
+
+        if (!deque_push(own, upper))
+            break; // deque full, just run the whole range
+        task.end = mid;
+    }
+
+    job->body(task.begin, task.end, job->ctx);
+    __atomic_fetch_sub(&job->remaining, task.end - task.begin, __ATOMIC_ACQ_REL);
+}
+
+// finds some task to run: first from our own deque,
+// and then by stealing from a random victim.
+static int find_task(Em_Task *task) {
+    if (deque_pop(&deques[thread_index], task))
+        return 1;
+
+    int total = load_acquire(&num_workers) + 1;
+    int start = (int)(next_random() % (uint32_t)total);
+
+    for (int i = 0; i < total; i++) {
+        int victim = (start + i) % total;
+        if (victim != thread_index && deque_steal(&deques[victim], task))
+            return 1;
+    }
+    return 0;
+}
+
+#ifdef _WIN32
+static DWORD __stdcall worker_main(void *arg)
+#else
+static void *worker_main(void *arg)
+#endif
+{
+    thread_index = (int)(intptr_t)arg;
+    int idle_spins = 0;
+
+    while (1) {
+        Em_Task task;
+        if (find_task(&task)) {
+            run_task(task);
+            idle_spins = 0;
+            continue;
+        }
+
+        if (++idle_spins < EM_SPINS_BEFORE_SLEEP) {
+            cpu_relax();
+            continue;
+        }
+
+        // nothing to do for a while. go to sleep
+        // until some parallel for is started.
+        lock_sleepers();
+        sleeping_workers++;
+        while (load_acquire(&active_jobs) == 0)
+            wait_sleepers();
+        sleeping_workers--;
+        unlock_sleepers();
+        idle_spins = 0;
+    }
+    return 0;
+}
+
+static int get_num_cores(void) {
+#ifdef _WIN32
+    return (int)GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+#else
+    return (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+static void start_pool(void) {
+    int expected = 0;
+    if (!__atomic_compare_exchange_n(&pool_state, &expected, 1, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        // someone else is starting the pool. wait for it.
+        while (load_acquire(&pool_state) != 2) yield_thread();
+        return;
+    }
+
+    int workers = get_num_cores() - 1;
+    if (workers < 0) workers = 0;
+    if (workers > EM_MAX_WORKERS) workers = EM_MAX_WORKERS;
+
+    // (published before the workers start, since they read it
+    // to pick their victims)
+    store_release(&num_workers, workers);
+
+    for (int i = 1; i <= workers; i++) {
+#ifdef _WIN32
+        CreateThread(0, 0, worker_main, (void *)(intptr_t)i, 0, 0);
+#else
+        pthread_t thread;
+        pthread_create(&thread, 0, worker_main, (void *)(intptr_t)i);
+        pthread_detach(thread);
+#endif
+    }
+    store_release(&pool_state, 2);
+}
+
+
+//                       Entry point
+// ***********************************************************
+
+// runs body over [begin, end) on all cores, and returns
+// once every iteration has been completed.
+void __em_parallel_for(int64_t begin, int64_t end, int64_t grain,
+                       em_body_fn body, void *ctx) {
+    if (end <= begin)
+        return;
+
+    if (load_acquire(&pool_state) != 2)
+        start_pool();
+
+    int64_t n = end - begin;
+    if (grain <= 0) {
+        grain = n / ((int64_t)(num_workers + 1) * EM_CHUNKS_PER_WORKER);
+        if (grain < 1) grain = 1;
+    }
+
+    // no point in going through the pool for a single chunk
+    if (num_workers == 0 || n <= grain) {
+        body(begin, end, ctx);
+        return;
+    }
+
+    Em_Job job = { body, ctx, grain, n };
+
+    // wake up the sleeping workers (under the lock, so
+    // that none of them can miss this wake up)
+    lock_sleepers();
+    __atomic_fetch_add(&active_jobs, 1, __ATOMIC_ACQ_REL);
+    if (sleeping_workers > 0)
+        wake_sleepers();
+    unlock_sleepers();
+
+    Em_Task root = { &job, begin, end };
+    run_task(root);
+
+    // help out (with any task, not only ours) until
+    // all the iterations of this loop are done.
+    while (load_acquire(&job.remaining) > 0) {
+        Em_Task task;
+        if (find_task(&task)) run_task(task);
+        else cpu_relax();
+    }
+
+    __atomic_fetch_sub(&active_jobs, 1, __ATOMIC_ACQ_REL);
+}
@@ -90,8 +90,18 @@ void print_int(int value) {
     while (i--) putchar(buffer[i]);
 }
 
+// to write count chars to stdout, with a single call
+static void write_chars(const char *str, DWORD count)
+{
+    DWORD written;
+    if (count > 0)
+        WriteFile(get_stdout(), str, count, &written, 0);
+}
+
 void print_str(const char *str) {
-    while (*str) putchar(*str++);
+    // (strlen of the C runtime is vectorized, and then the
+    // whole string goes out at once, not a char at a time)
+    write_chars(str, (DWORD)__builtin_strlen(str));
 }
 
 // implementation of a simple printf function
@@ -132,10 +142,13 @@ void print(const char *format, ...) {
                     break;
                 }
             }
+            format++;
         } else {
-            putchar(*format);
+            // write everything up to the next specifier at once
+            const char *run = format;
+            while (*format && *format != '%') format++;
+            write_chars(run, (DWORD)(format - run));
         }
-        format++;
     }
 
     va_end(args);
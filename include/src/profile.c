@@ -0,0 +1,311 @@
+//
+// profile.c
+//
+
+/*
+
+This is the profiling runtime for -finstrument-functions, to
+profile Em programs where perf (or any other sampling profiler)
+is not allowed.
+
+With that flag, the compiler emits a call at the start of every
+function, and before each of its returns:
+
+    __em_profile_enter("name of the function");
+    ...
+    __em_profile_exit("name of the function");
+
+(async functions are left out, since they can be suspended in
+the middle, and resumed later from somewhere else)
+
+These have to be cheap, since they are in every function. So all
+they do is read the timestamp counter, and write an event (the
+timestamp and the name) into a ring buffer of the thread. nothing
+is shared between the threads, and there is no locking.
+
+When the ring of a thread fills up, its events are folded into a
+call tree of the thread (a node for every distinct stack, with
+the time spent in it, not counting the calls it makes), and the
+ring starts over. so the memory used depends on the number of
+distinct stacks, and not on how long the program runs.
+
+At exit, the trees of all the threads are merged, and written out
+as folded stacks (one line per stack, with its self time in
+nanoseconds), which is what flamegraph.pl takes:
+
+    main;parse;next_token 1834000
+    main;parse 52000
+    ...
+
+    ./flamegraph.pl --countname=ns em-profile.folded > profile.svg
+
+The file is em-profile.folded, in the current directory (or the
+path in the EM_PROFILE_OUTPUT environment variable).
+
+NOTE: the threads that are still running at exit (like the idle
+workers of parallel for) are folded as they are, at that point.
+
+*/
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L // (for clock_gettime)
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EM_PROFILE_RING_SIZE 4096       // (events per thread, before they are folded)
+#define EM_PROFILE_EXIT (1ull << 63)    // (the bit of the timestamp that marks an exit)
+#define EM_PROFILE_MAX_DEPTH 1024       // (of the stacks that are written out)
+#define EM_PROFILE_DEFAULT_OUTPUT "em-profile.folded"
+
+
+//                         Timestamps
+// ***********************************************************
+
+// the OS clock, in nanoseconds
+
+#ifdef _WIN32
+
+int __stdcall QueryPerformanceCounter(int64_t *count);
+int __stdcall QueryPerformanceFrequency(int64_t *frequency);
+
+static uint64_t os_nanoseconds(void) {
+    int64_t count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)((double)count * 1e9 / (double)frequency);
+}
+
+#else
+
+#include <time.h>
+
+static uint64_t os_nanoseconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+#endif
+
+// the events are timestamped with the cycle counter where there is
+// one that can be read cheaply from user space (and converted to
+// nanoseconds at the end, against the OS clock). elsewhere, the OS
+// clock is used directly.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define em_ticks() __builtin_ia32_rdtsc()
+#else
+#define em_ticks() os_nanoseconds()
+#endif
+
+
+//                    Threads and call trees
+// ***********************************************************
+
+typedef struct Em_Profile_Event {
+    uint64_t time; // (with EM_PROFILE_EXIT set for an exit)
+    const char *name;
+} Em_Profile_Event;
+
+// a node of the call tree, for a distinct stack
+typedef struct Em_Profile_Node {
+    const char *name;
+    struct Em_Profile_Node *parent;
+    struct Em_Profile_Node *first_child;
+    struct Em_Profile_Node *next_sibling;
+    uint64_t self_ticks;
+} Em_Profile_Node;
+
+typedef struct Em_Profile_Thread {
+    Em_Profile_Event ring[EM_PROFILE_RING_SIZE];
+    uint32_t num_events;
+
+    Em_Profile_Node root; // (the time outside of the instrumented functions)
+    Em_Profile_Node *current;
+    uint64_t last_time;
+
+    struct Em_Profile_Thread *next; // (in the list of all the threads)
+} Em_Profile_Thread;
+
+static _Thread_local Em_Profile_Thread *this_thread = 0;
+static Em_Profile_Thread *all_threads = 0;
+
+static int started = 0;
+static uint64_t start_ticks, start_nanoseconds;
+
+static void write_profile(void);
+
+static Em_Profile_Thread *start_thread(void) {
+    Em_Profile_Thread *thread = (Em_Profile_Thread *)calloc(1, sizeof(Em_Profile_Thread));
+    if (!thread)
+        return 0;
+
+    thread->current = &thread->root;
+    thread->last_time = em_ticks();
+
+    // (pushed onto the list of the threads, without a lock)
+    thread->next = __atomic_load_n(&all_threads, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&all_threads, &thread->next, thread, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+
+    // the first thread sets up the timing, and the writing at exit
+    if (!__atomic_exchange_n(&started, 1, __ATOMIC_ACQ_REL)) {
+        start_nanoseconds = os_nanoseconds();
+        start_ticks = em_ticks();
+        atexit(write_profile);
+    }
+
+    this_thread = thread;
+    return thread;
+}
+
+static int same_name(const char *a, const char *b) {
+    return a == b || strcmp(a, b) == 0;
+}
+
+// the node for a call of name, from parent. (the names are usually
+// the same pointer for the same function, so that is looked for
+// first, and only then the strings are compared)
+static Em_Profile_Node *child_node(Em_Profile_Node *parent, const char *name) {
+    Em_Profile_Node *child;
+    for (child = parent->first_child; child; child = child->next_sibling) {
+        if (child->name == name)
+            return child;
+    }
+    for (child = parent->first_child; child; child = child->next_sibling) {
+        if (strcmp(child->name, name) == 0)
+            return child;
+    }
+
+    child = (Em_Profile_Node *)calloc(1, sizeof(Em_Profile_Node));
+    if (!child)
+        return parent; // (out of memory, so the time goes to the caller)
+
+    child->name = name;
+    child->parent = parent;
+    child->next_sibling = parent->first_child;
+    parent->first_child = child;
+    return child;
+}
+
+// replays the events in the ring, onto the call tree of the thread
+static void fold_events(Em_Profile_Thread *thread) {
+    for (uint32_t i = 0; i < thread->num_events; i++) {
+        Em_Profile_Event *event = &thread->ring[i];
+        uint64_t time = event->time & ~EM_PROFILE_EXIT;
+
+        // (the time till now was spent in the current function)
+        if (time > thread->last_time)
+            thread->current->self_ticks += time - thread->last_time;
+        thread->last_time = time;
+
+        if (!(event->time & EM_PROFILE_EXIT)) {
+            thread->current = child_node(thread->current, event->name);
+            continue;
+        }
+
+        // an exit is of the current function, unless the exits of
+        // the functions in between were missed (like when exit() is
+        // called from one of them). so we go up to the one that exits.
+        Em_Profile_Node *node = thread->current;
+        while (node != &thread->root && !same_name(node->name, event->name))
+            node = node->parent;
+        if (node != &thread->root)
+            thread->current = node->parent;
+    }
+    thread->num_events = 0;
+}
+
+static inline void record_event(const char *name, uint64_t exit_bit) {
+    Em_Profile_Thread *thread = this_thread;
+    if (!thread && !(thread = start_thread()))
+        return;
+
+    Em_Profile_Event *event = &thread->ring[thread->num_events];
+    event->time = em_ticks() | exit_bit;
+    event->name = name;
+
+    if (++thread->num_events == EM_PROFILE_RING_SIZE)
+        fold_events(thread);
+}
+
+void __em_profile_enter(const char *name) {
+    record_event(name, 0);
+}
+
+void __em_profile_exit(const char *name) {
+    record_event(name, EM_PROFILE_EXIT);
+}
+
+
+//                    Writing out the profile
+// ***********************************************************
+
+// adds the times of the tree at from, into the tree at into
+static void merge_tree(Em_Profile_Node *into, Em_Profile_Node *from) {
+    into->self_ticks += from->self_ticks;
+    for (Em_Profile_Node *child = from->first_child; child; child = child->next_sibling)
+        merge_tree(child_node(into, child->name), child);
+}
+
+static void write_stacks(FILE *file, Em_Profile_Node *node, const char **stack,
+                         int depth, double nanoseconds_per_tick) {
+    uint64_t nanoseconds = (uint64_t)((double)node->self_ticks * nanoseconds_per_tick);
+    if (depth > 0 && nanoseconds > 0) {
+        for (int i = 0; i < depth; i++)
+            fprintf(file, i ? ";%s" : "%s", stack[i]);
+        fprintf(file, " %llu\n", (unsigned long long)nanoseconds);
+    }
+
+    // (the stacks deeper than this are cut off, and their time is lost)
+    if (depth == EM_PROFILE_MAX_DEPTH)
+        return;
+
+    for (Em_Profile_Node *child = node->first_child; child; child = child->next_sibling) {
+        stack[depth] = child->name;
+        write_stacks(file, child, stack, depth + 1, nanoseconds_per_tick);
+    }
+}
+
+static void write_profile(void) {
+    uint64_t end_ticks = em_ticks();
+    uint64_t end_nanoseconds = os_nanoseconds();
+    double nanoseconds_per_tick = 1;
+    if (end_ticks > start_ticks && end_nanoseconds > start_nanoseconds)
+        nanoseconds_per_tick = (double)(end_nanoseconds - start_nanoseconds) /
+                               (double)(end_ticks - start_ticks);
+
+    Em_Profile_Node merged;
+    memset(&merged, 0, sizeof(merged));
+
+    Em_Profile_Thread *thread = __atomic_load_n(&all_threads, __ATOMIC_ACQUIRE);
+    for (; thread; thread = thread->next) {
+        fold_events(thread);
+
+        // (the functions that haven't returned yet get the time till now)
+        if (end_ticks > thread->last_time)
+            thread->current->self_ticks += end_ticks - thread->last_time;
+        thread->last_time = end_ticks;
+
+        merge_tree(&merged, &thread->root);
+    }
+
+    const char *path = getenv("EM_PROFILE_OUTPUT");
+    if (!path)
+        path = EM_PROFILE_DEFAULT_OUTPUT;
+
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "em profile: couldn't write %s\n", path);
+        return;
+    }
+
+    static const char *stack[EM_PROFILE_MAX_DEPTH];
+    write_stacks(file, &merged, stack, 0, nanoseconds_per_tick);
+    fclose(file);
+}
@@ -0,0 +1,262 @@
+//
+// time.c
+//
+
+/*
+
+This is the runtime for time.emh: clocks and cycle counters for
+Em programs, and a small helper to microbenchmark them.
+
+    (1) time_now_ns() is the monotonic clock of the OS
+    (clock_gettime on Linux and macOS, QueryPerformanceCounter
+    on Windows).
+
+    (2) cycles_start() / cycles_stop() read the cycle counter
+    (rdtsc on x86, cntvct_el0 on ARM64), with a barrier on the
+    side facing the code being timed, so that it can't move in or
+    out of the timed region:
+
+        cycles_start:  lfence; rdtsc; lfence
+        cycles_stop:   rdtscp; lfence
+
+    (lfence rather than cpuid, which is slower, and exits to the
+    hypervisor in a VM.) cycles_per_ns() is measured once, over
+    10 ms of the clock, to convert them.
+
+    (3) black_box() is lowered by the compiler (into an empty
+    inline assembly that takes the value), so the definitions
+    here are only there for anything else that calls them.
+
+    (4) the benchmark helper runs the body of a loop in batches.
+    the batches grow (doubling) until one takes EM_BENCH_BATCH_NS,
+    and then EM_BENCH_SAMPLES batches of that size are timed. the
+    median time per iteration is printed (along with the fastest
+    one), and can be read with bench_ns_per_iteration():
+
+        int bench = bench_begin("sum");
+        while (bench_running(bench)) {
+            ...
+        }
+
+    the loop itself (a call and a decrement per iteration, about
+    a nanosecond) is included in the time.
+
+*/
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L // (for clock_gettime)
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define EM_BENCH_BATCH_NS 10000000 // (10 ms)
+#define EM_BENCH_SAMPLES 11
+#define EM_MAX_BENCHES 256
+#define EM_CALIBRATION_NS 10000000
+
+
+//                           Clock
+// ***********************************************************
+
+#ifdef _WIN32
+
+int __stdcall QueryPerformanceCounter(int64_t *count);
+int __stdcall QueryPerformanceFrequency(int64_t *frequency);
+
+int64_t time_now_ns(void) {
+    static int64_t frequency = 0;
+    int64_t count;
+    if (!frequency)
+        QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&count);
+
+    // (in two parts, so that it doesn't overflow)
+    return (count / frequency) * 1000000000 + (count % frequency) * 1000000000 / frequency;
+}
+
+#else
+
+#include <time.h>
+
+int64_t time_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+#endif
+
+
+//                       Cycle counters
+// ***********************************************************
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+
+uint64_t cycles_start(void) {
+    __builtin_ia32_lfence();
+    uint64_t cycles = __builtin_ia32_rdtsc();
+    __builtin_ia32_lfence();
+    return cycles;
+}
+
+uint64_t cycles_stop(void) {
+    unsigned int processor;
+    uint64_t cycles = __builtin_ia32_rdtscp(&processor);
+    __builtin_ia32_lfence();
+    return cycles;
+}
+
+#elif defined(__aarch64__)
+
+static uint64_t read_virtual_timer(void) {
+    uint64_t ticks;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+}
+
+uint64_t cycles_start(void) {
+    __asm__ __volatile__("isb" ::: "memory");
+    uint64_t ticks = read_virtual_timer();
+    __asm__ __volatile__("isb" ::: "memory");
+    return ticks;
+}
+
+uint64_t cycles_stop(void) {
+    __asm__ __volatile__("isb" ::: "memory");
+    uint64_t ticks = read_virtual_timer();
+    __asm__ __volatile__("isb" ::: "memory");
+    return ticks;
+}
+
+#else
+
+// (no counter that we know of, so these are just the clock)
+uint64_t cycles_start(void) { return (uint64_t)time_now_ns(); }
+uint64_t cycles_stop(void) { return (uint64_t)time_now_ns(); }
+
+#endif
+
+double cycles_per_ns(void) {
+    static double measured = 0;
+    if (measured > 0)
+        return measured;
+
+    int64_t start_ns = time_now_ns(), end_ns;
+    uint64_t start = cycles_start();
+    do {
+        end_ns = time_now_ns();
+    } while (end_ns - start_ns < EM_CALIBRATION_NS);
+    uint64_t end = cycles_stop();
+
+    measured = (double)(end - start) / (double)(end_ns - start_ns);
+    return measured;
+}
+
+
+//                          black_box
+// ***********************************************************
+
+int64_t black_box(int64_t value) {
+    __asm__ __volatile__("" : : "r"(&value) : "memory");
+    return value;
+}
+
+double black_box_f64(double value) {
+    __asm__ __volatile__("" : : "r"(&value) : "memory");
+    return value;
+}
+
+
+//                         Benchmarks
+// ***********************************************************
+
+typedef struct Em_Bench {
+    const char *name;
+    int64_t batch_size;
+    int64_t remaining; // (iterations left in the current batch)
+    int64_t batch_start;
+    int calibrating; // (still growing the batches)
+    int num_samples;
+    double samples[EM_BENCH_SAMPLES]; // (ns per iteration, of each batch)
+    double result;
+} Em_Bench;
+
+static Em_Bench benches[EM_MAX_BENCHES];
+static int num_benches = 0;
+
+int bench_begin(const char *name) {
+    int bench = __atomic_fetch_add(&num_benches, 1, __ATOMIC_RELAXED);
+    if (bench >= EM_MAX_BENCHES) {
+        fprintf(stderr, "bench_begin: too many benchmarks (at most %d)\n", EM_MAX_BENCHES);
+        return -1;
+    }
+
+    benches[bench].name = name;
+    benches[bench].batch_size = 1;
+    benches[bench].calibrating = 1;
+    return bench;
+}
+
+static void report(Em_Bench *bench) {
+    // (sorted, for the median. there are only a few of them)
+    double *samples = bench->samples;
+    for (int i = 1; i < EM_BENCH_SAMPLES; i++) {
+        for (int j = i; j > 0 && samples[j - 1] > samples[j]; j--) {
+            double sample = samples[j];
+            samples[j] = samples[j - 1];
+            samples[j - 1] = sample;
+        }
+    }
+    bench->result = samples[EM_BENCH_SAMPLES / 2];
+
+    printf("%s: %.2f ns per iteration (fastest %.2f, %d batches of %lld)\n",
+           bench->name, bench->result, samples[0], EM_BENCH_SAMPLES,
+           (long long)bench->batch_size);
+    fflush(stdout);
+}
+
+// the end of a batch (or the start of the first one).
+// returns whether there is another batch to run.
+static int next_batch(Em_Bench *bench) {
+    int64_t now = time_now_ns();
+
+    if (bench->batch_start != 0) {
+        int64_t elapsed = now - bench->batch_start;
+
+        if (bench->calibrating) {
+            if (elapsed < EM_BENCH_BATCH_NS)
+                bench->batch_size *= 2;
+            else
+                bench->calibrating = 0;
+        } else {
+            bench->samples[bench->num_samples++] = (double)elapsed / bench->batch_size;
+            if (bench->num_samples == EM_BENCH_SAMPLES) {
+                report(bench);
+                return 0;
+            }
+        }
+    }
+
+    bench->remaining = bench->batch_size;
+    bench->batch_start = time_now_ns();
+    return 1;
+}
+
+int bench_running(int index) {
+    if (index < 0 || index >= EM_MAX_BENCHES)
+        return 0;
+
+    Em_Bench *bench = &benches[index];
+    if (--bench->remaining > 0)
+        return 1;
+    if (bench->num_samples == EM_BENCH_SAMPLES)
+        return 0; // (it's done already)
+    return next_batch(bench);
+}
+
+double bench_ns_per_iteration(int index) {
+    if (index < 0 || index >= EM_MAX_BENCHES)
+        return 0;
+    return benches[index].result;
+}
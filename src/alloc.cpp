@@ -0,0 +1,494 @@
+//
+// alloc.cpp
+//
+
+/*
+
+An allocator for the compiler itself, which replaces the global
+operator new and delete when emc is built with EMC_FAST_ALLOC
+(build.bat -fast-alloc, or build-msvc.bat Release FastAlloc).
+Without it, this file is empty.
+
+The frontend threads allocate lots of small objects (the tokens
+and their strings, the AST nodes, the scopes, the arrays of the
+smaps), and with many of them running at once, the lock of the
+C runtime's malloc is where they end up waiting on each other.
+
+This is built like the mem_alloc() runtime (include/src/memory.c):
+
+    - every request up to 32 KB is rounded up to one of 40 size
+    classes, and carved out of 256 KB slabs (aligned to their
+    size), whose header holds the size class.
+
+    - every thread keeps a free list per size class, so most
+    allocations and frees don't lock anything. a thread only
+    goes to the central (locked) list of a size class to take
+    or give back a batch of objects.
+
+The difference is where the slabs come from: they are all taken
+out of a single region of address space, which is reserved once
+(and committed 4 MB at a time), so that delete can tell whether
+an object is one of ours from its address alone. Everything else
+goes to malloc: requests over 32 KB, over-aligned ones, and all
+of them once the region is used up (or if it couldn't be reserved).
+
+When a thread exits, its free lists are given back to the central
+ones, so that the memory that the worker threads freed can be used
+by the link stage and the backend.
+
+*/
+
+#ifdef EMC_FAST_ALLOC
+
+#include <atomic>
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+#define ALLOC_NUM_SIZE_CLASSES 40
+#define ALLOC_MAX_SMALL_SIZE 32768
+#define ALLOC_SLAB_SIZE (256 * 1024)          // (also the alignment of the slabs)
+#define ALLOC_SEGMENT_SIZE (4 * 1024 * 1024)  // (how much is committed at a time)
+#define ALLOC_REGION_SIZE (64ull << 30)       // (the address space reserved for the slabs)
+#define ALLOC_SLAB_HEADER_SIZE 64
+#define ALLOC_MAX_BATCH 64
+#define ALLOC_ALIGNMENT 16
+
+
+//                        The region
+// ***********************************************************
+
+static char *region_begin = nullptr;
+static char *region_end = nullptr;
+static char *region_committed = nullptr; // (the slabs are handed out up to here)
+static char *region_next = nullptr;
+
+static std::atomic<int> region_state(0); // 0: not reserved yet, 1: being reserved, 2: done
+
+static char *os_reserve(size_t size) {
+#if defined(_WIN32)
+    return (char *)VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    void *p = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return (p == MAP_FAILED) ? nullptr : (char *)p;
+#endif
+}
+
+static bool os_commit(char *address, size_t size) {
+#if defined(_WIN32)
+    return VirtualAlloc(address, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+    return mprotect(address, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+// reserves the region on the first allocation (which can be before
+// main, so nothing here can allocate). a thread that gets here while
+// another one is reserving it waits for it.
+static void reserve_region() {
+    int state = 0;
+    if (region_state.compare_exchange_strong(state, 1, std::memory_order_acquire)) {
+        // (a slab more than needed, so that the slabs can be aligned)
+        char *p = os_reserve(ALLOC_REGION_SIZE + ALLOC_SLAB_SIZE);
+        if (p) {
+            region_begin = (char *)(((uintptr_t)p + ALLOC_SLAB_SIZE - 1) & ~(uintptr_t)(ALLOC_SLAB_SIZE - 1));
+            region_end = region_begin + ALLOC_REGION_SIZE;
+            region_committed = region_next = region_begin;
+        }
+        region_state.store(2, std::memory_order_release);
+        return;
+    }
+    while (region_state.load(std::memory_order_acquire) != 2) {}
+}
+
+static bool in_region(void *p) {
+    return (char *)p >= region_begin && (char *)p < region_end;
+}
+
+
+//                         Spinlocks
+// ***********************************************************
+
+// the critical sections are short (moving a batch of objects),
+// so a spinlock is cheaper than going to the OS. (but the thread
+// holding it may have been preempted, when there are more threads
+// than cores, so after a while of spinning we give up the core)
+struct Spinlock {
+    std::atomic<bool> locked{false};
+
+    void lock() {
+        while (locked.exchange(true, std::memory_order_acquire)) {
+            for (int spins = 0; locked.load(std::memory_order_relaxed); spins++) {
+                if (spins >= 64)
+                    std::this_thread::yield();
+            }
+        }
+    }
+    void unlock() { locked.store(false, std::memory_order_release); }
+};
+
+static Spinlock region_lock;
+
+
+//                        Size classes
+// ***********************************************************
+
+// (the same ones as in memory.c: 16, 32, ... 128, and then
+// 4 steps for every power of 2 up to 32 KB)
+static uint32_t size_to_class(size_t size) {
+    if (size <= 128)
+        return size ? (uint32_t)((size + 15) / 16 - 1) : 0;
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanReverse64(&index, (unsigned long long)(size - 1));
+    uint32_t k = (uint32_t)index;
+#else
+    uint32_t k = 63 - __builtin_clzll((unsigned long long)(size - 1));
+#endif
+    return 8 + (k - 7) * 4 + (uint32_t)((size - 1 - ((size_t)1 << k)) >> (k - 2));
+}
+
+static size_t class_to_size(uint32_t size_class) {
+    if (size_class < 8)
+        return (size_t)(size_class + 1) * 16;
+
+    uint32_t k = 7 + (size_class - 8) / 4;
+    uint32_t step = (size_class - 8) % 4 + 1;
+    return ((size_t)1 << k) + step * ((size_t)1 << (k - 2));
+}
+
+// how many objects move between a thread cache and the
+// central free list at a time (about 64 KB worth of them)
+static uint32_t class_batch_size(uint32_t size_class) {
+    size_t batch = (64 * 1024) / class_to_size(size_class);
+    if (batch < 2) return 2;
+    if (batch > ALLOC_MAX_BATCH) return ALLOC_MAX_BATCH;
+    return (uint32_t)batch;
+}
+
+
+//                          Slabs
+// ***********************************************************
+
+// at the beginning of every slab
+struct Slab_Header {
+    uint32_t size_class;
+};
+
+static char *new_slab(uint32_t size_class) {
+    if (!region_begin)
+        return nullptr;
+
+    region_lock.lock();
+
+    if (region_next == region_committed) {
+        if (region_committed == region_end ||
+            !os_commit(region_committed, ALLOC_SEGMENT_SIZE)) {
+            region_lock.unlock();
+            return nullptr;
+        }
+        region_committed += ALLOC_SEGMENT_SIZE;
+    }
+    char *slab = region_next;
+    region_next += ALLOC_SLAB_SIZE;
+
+    region_lock.unlock();
+
+    ((Slab_Header *)slab)->size_class = size_class;
+    return slab;
+}
+
+static Slab_Header *get_header(void *p) {
+    return (Slab_Header *)((uintptr_t)p & ~(uintptr_t)(ALLOC_SLAB_SIZE - 1));
+}
+
+
+//                    Central free lists
+// ***********************************************************
+
+// the free objects are linked through their first word
+struct Free_Object {
+    Free_Object *next;
+};
+
+struct Central_List {
+    Spinlock lock;
+    Free_Object *head = nullptr;
+
+    // the part of the latest slab that hasn't been handed out yet
+    char *bump = nullptr;
+    char *bump_end = nullptr;
+};
+
+static Central_List central[ALLOC_NUM_SIZE_CLASSES];
+
+// takes (up to) count objects, and links them into a list.
+// returns how many were taken.
+static uint32_t central_take(uint32_t size_class, uint32_t count, Free_Object **head_out) {
+    Central_List *c = &central[size_class];
+    size_t size = class_to_size(size_class);
+    Free_Object *head = nullptr;
+    uint32_t taken = 0;
+
+    c->lock.lock();
+
+    // first from the objects that have been freed
+    while (taken < count && c->head) {
+        Free_Object *obj = c->head;
+        c->head = obj->next;
+        obj->next = head;
+        head = obj;
+        taken++;
+    }
+
+    // and then the fresh ones, from the slab
+    while (taken < count) {
+        if (!c->bump || c->bump + size > c->bump_end) {
+            char *slab = new_slab(size_class);
+            if (!slab)
+                break;
+            c->bump = slab + ALLOC_SLAB_HEADER_SIZE;
+            c->bump_end = slab + ALLOC_SLAB_SIZE;
+        }
+        Free_Object *obj = (Free_Object *)c->bump;
+        c->bump += size;
+        obj->next = head;
+        head = obj;
+        taken++;
+    }
+
+    c->lock.unlock();
+
+    *head_out = head;
+    return taken;
+}
+
+static void central_give(uint32_t size_class, Free_Object *head, Free_Object *tail) {
+    Central_List *c = &central[size_class];
+
+    c->lock.lock();
+    tail->next = c->head;
+    c->head = head;
+    c->lock.unlock();
+}
+
+
+//                       Thread caches
+// ***********************************************************
+
+struct Thread_List {
+    Free_Object *head;
+    uint32_t count;
+};
+
+// (plain data, so that it can still be used while the thread is
+// exiting, by destructors that run after Thread_Cache_Owner's)
+static thread_local Thread_List thread_cache[ALLOC_NUM_SIZE_CLASSES];
+static thread_local bool thread_cache_gone = false;
+
+// gives back the free lists of the thread when it exits
+struct Thread_Cache_Owner {
+    bool active = false;
+
+    ~Thread_Cache_Owner() {
+        for (uint32_t size_class = 0; size_class < ALLOC_NUM_SIZE_CLASSES; size_class++) {
+            Thread_List *list = &thread_cache[size_class];
+            if (!list->head)
+                continue;
+
+            Free_Object *tail = list->head;
+            while (tail->next)
+                tail = tail->next;
+            central_give(size_class, list->head, tail);
+            list->head = nullptr;
+            list->count = 0;
+        }
+        thread_cache_gone = true;
+    }
+};
+
+static thread_local Thread_Cache_Owner thread_cache_owner;
+
+static void *thread_cache_refill(uint32_t size_class) {
+    // (registers the destructor of the thread's cache, the first time)
+    if (!thread_cache_owner.active)
+        thread_cache_owner.active = true;
+
+    Thread_List *list = &thread_cache[size_class];
+    Free_Object *head;
+    uint32_t taken = central_take(size_class, class_batch_size(size_class), &head);
+    if (taken == 0)
+        return nullptr;
+
+    // hand out the first one, and keep the rest
+    list->head = head->next;
+    list->count = taken - 1;
+    return head;
+}
+
+// gives back a batch from the front of the list
+static void thread_cache_release(uint32_t size_class) {
+    Thread_List *list = &thread_cache[size_class];
+    uint32_t batch = class_batch_size(size_class);
+
+    Free_Object *head = list->head;
+    Free_Object *tail = head;
+    for (uint32_t i = 1; i < batch; i++)
+        tail = tail->next;
+
+    list->head = tail->next;
+    list->count -= batch;
+    central_give(size_class, head, tail);
+}
+
+
+//                        Allocation
+// ***********************************************************
+
+static void *allocate(size_t size) {
+    if (size > ALLOC_MAX_SMALL_SIZE)
+        return malloc(size);
+
+    if (region_state.load(std::memory_order_acquire) != 2)
+        reserve_region();
+
+    uint32_t size_class = size_to_class(size);
+    Thread_List *list = &thread_cache[size_class];
+
+    void *p = nullptr;
+    if (list->head) {
+        p = list->head;
+        list->head = list->head->next;
+        list->count--;
+    } else if (!thread_cache_gone) {
+        p = thread_cache_refill(size_class);
+    } else {
+        // (the thread is exiting, so nothing is kept in its cache)
+        Free_Object *head;
+        if (central_take(size_class, 1, &head))
+            p = head;
+    }
+    return p ? p : malloc(size);
+}
+
+static void deallocate(void *p) {
+    if (!p)
+        return;
+    if (!in_region(p)) {
+        free(p);
+        return;
+    }
+
+    uint32_t size_class = get_header(p)->size_class;
+    Free_Object *obj = (Free_Object *)p;
+
+    if (thread_cache_gone) {
+        central_give(size_class, obj, obj);
+        return;
+    }
+
+    Thread_List *list = &thread_cache[size_class];
+    obj->next = list->head;
+    list->head = obj;
+    list->count++;
+
+    if (list->count >= 2 * class_batch_size(size_class))
+        thread_cache_release(size_class);
+}
+
+// (the ones aligned to more than 16 bytes go to the C runtime)
+static void *allocate_aligned(size_t size, size_t alignment) {
+    if (alignment <= ALLOC_ALIGNMENT)
+        return allocate(size);
+#if defined(_WIN32)
+    return _aligned_malloc(size ? size : 1, alignment);
+#else
+    void *p = nullptr;
+    return posix_memalign(&p, alignment, size ? size : 1) == 0 ? p : nullptr;
+#endif
+}
+
+static void deallocate_aligned(void *p, size_t alignment) {
+    if (alignment <= ALLOC_ALIGNMENT) {
+        deallocate(p);
+        return;
+    }
+#if defined(_WIN32)
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+static void *allocate_or_exit(size_t size, size_t alignment) {
+    void *p = allocate_aligned(size, alignment);
+    if (!p) {
+        fprintf(stderr, "ERROR: Out of memory.");
+        exit(1);
+    }
+    return p;
+}
+
+
+//                 Global operator new / delete
+// ***********************************************************
+
+void *operator new(size_t size) { return allocate_or_exit(size, ALLOC_ALIGNMENT); }
+void *operator new[](size_t size) { return allocate_or_exit(size, ALLOC_ALIGNMENT); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+
+void *operator new(size_t size, std::align_val_t alignment) {
+    return allocate_or_exit(size, (size_t)alignment);
+}
+void *operator new[](size_t size, std::align_val_t alignment) {
+    return allocate_or_exit(size, (size_t)alignment);
+}
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return allocate_aligned(size, (size_t)alignment);
+}
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return allocate_aligned(size, (size_t)alignment);
+}
+
+void operator delete(void *p) noexcept { deallocate(p); }
+void operator delete[](void *p) noexcept { deallocate(p); }
+void operator delete(void *p, size_t) noexcept { deallocate(p); }
+void operator delete[](void *p, size_t) noexcept { deallocate(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { deallocate(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { deallocate(p); }
+
+void operator delete(void *p, std::align_val_t alignment) noexcept {
+    deallocate_aligned(p, (size_t)alignment);
+}
+void operator delete[](void *p, std::align_val_t alignment) noexcept {
+    deallocate_aligned(p, (size_t)alignment);
+}
+void operator delete(void *p, size_t, std::align_val_t alignment) noexcept {
+    deallocate_aligned(p, (size_t)alignment);
+}
+void operator delete[](void *p, size_t, std::align_val_t alignment) noexcept {
+    deallocate_aligned(p, (size_t)alignment);
+}
+void operator delete(void *p, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    deallocate_aligned(p, (size_t)alignment);
+}
+void operator delete[](void *p, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    deallocate_aligned(p, (size_t)alignment);
+}
+
+#endif
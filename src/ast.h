@@ -27,11 +27,26 @@ enum Expression_Type {
     EXPR_RETURN,
     EXPR_JUMP,
     EXPR_BLOCK,
-    EXPR_VARG
+    EXPR_VARG,
+    EXPR_PARALLEL_FOR,
+    EXPR_AWAIT,
+    EXPR_RANGE_FOR,
+    EXPR_ASM,
+    EXPR_PACK_FOR
 };
 
 enum Jump_Type { J_BREAK, J_CONTINUE };
 
+// memory orderings for the atomic builtins
+enum Atomic_Ordering {
+    AO_NONE, // (not an atomic builtin)
+    AO_RELAXED,
+    AO_ACQUIRE,
+    AO_RELEASE,
+    AO_ACQ_REL,
+    AO_SEQ_CST
+};
+
 struct Function_Parameter {
     std::string name;
     Data_Type *type = NULL;
@@ -43,6 +58,44 @@ struct Function_Parameter {
 struct LLVM_Symbol_Info {
     llvm::Value *val;
     llvm::Type *type;
+
+    // the Em type of the variable (for what the llvm type doesn't
+    // tell, like whether an integer is signed). NULL if unknown.
+    Data_Type *data_type = nullptr;
+
+    // for const variables. if the initializer was a scalar
+    // constant, reads of the variable are folded into it.
+    bool is_const = false;
+    llvm::Constant *const_value = nullptr;
+
+    // for atomic variables, every access is an atomic instruction
+    bool is_atomic = false;
+
+    // for the induction variable of a range for loop,
+    // which cannot be assigned to inside the loop
+    bool is_induction_variable = false;
+};
+
+// the state of the coroutine (async function) being emitted.
+// a return jumps to the cleanup, which frees the coroutine frame,
+// and the suspend block is where control goes back to the caller
+// (or whoever resumed the coroutine).
+struct Coroutine_Info {
+    llvm::Value *id;
+    llvm::Value *handle;
+    llvm::BasicBlock *cleanup;
+    llvm::BasicBlock *suspend;
+};
+
+struct AST_Function_Definition;
+
+// an instance of a generic function, for one list of type
+// arguments. its body is emitted after the rest of the file.
+struct Generic_Instance {
+    AST_Function_Definition *function;
+    std::vector<Data_Type *> type_args;
+    llvm::Function *llvm_function;
+    std::vector<Data_Type *> pack_types; // (the types of the parameter pack)
 };
 
 struct Loop_Terminals {
@@ -61,6 +114,11 @@ struct LLVM_IR {
     // memory, and does not seem to maintain type info).
     smap<LLVM_Symbol_Info *> llvm_symbol_table;
 
+    // every symbol info made for this file. (an inner scope's ones are
+    // replaced in the table once it ends, so they are kept track of
+    // here instead, to all be freed along with the rest of the IR)
+    std::vector<LLVM_Symbol_Info *> symbol_infos;
+
     // defining a stack to store the pairs <LOOP_CONDITION, LOOP_END>
     // whenever we encounter a while/for loop. this is needed
     // to be able to jump to those locations when a break/continue
@@ -77,6 +135,45 @@ struct LLVM_IR {
     // so that it can be used inside a case block
     llvm::BasicBlock *current_switch_end = nullptr;
 
+    // set while emitting the body of an async function
+    Coroutine_Info *current_coroutine = nullptr;
+
+    // the definitions (or prototypes) of the functions seen so far,
+    // for the Em types of the values they return
+    smap<AST_Function_Definition *> functions;
+
+    // generic functions are not emitted where they are defined.
+    // instead, every distinct list of type arguments they get called
+    // with gets its own instance. the instances are cached by their
+    // name (like "max<s64>") for the whole file, so each of them is
+    // only emitted once.
+    smap<AST_Function_Definition *> generic_functions;
+    smap<llvm::Function *> generic_instances;
+    std::vector<Generic_Instance> pending_generic_instances;
+
+    // the arguments in the parameter pack of the instance that is
+    // being emitted (and their types), for: for x in args { ... }
+    std::vector<LLVM_Symbol_Info *> current_pack;
+    std::vector<Data_Type *> current_pack_types;
+
+    // the target that the code is being compiled for
+    // (for checking the constraints of inline assembly)
+    std::string target_triple;
+
+    // (false when the context is the one that all the files
+    // of a thread share, with -fbatch-modules)
+    bool owns_context = true;
+
+    // with -finstrument-functions, every function calls the profiling
+    // runtime (lib/profile.bc) on entry and before it returns, with its
+    // name (which is kept here while its body is emitted)
+    bool instrument_functions = false;
+    llvm::Value *current_function_name = nullptr;
+
+    // the functions that weren't emitted, since they can't be called
+    // from main (see find_reachable_functions)
+    size_t skipped_functions = 0;
+
     LLVM_IR(llvm::LLVMContext &c, llvm::IRBuilder<> *b, llvm::Module *m)
         : _context(c), _builder(b), _module(m) {}
 };
@@ -135,13 +232,25 @@ struct AST_Function_Definition : AST_Expression {
 
     bool is_prototype = false;
     bool has_variadic_args = false;
+    bool is_async = false;
+    bool is_from_std_library = false; // (declared in a header from include/)
 
     Data_Type *return_type = NULL;
     std::string function_name;
 
+    // for generic functions: <return_type> <name><T, U, ...>(...)
+    std::vector<Data_Type *> type_params;
+
+    // for a typed parameter pack: <return_type> <name>(..., ...<pack_name>)
+    // (like a generic function, it gets an instance for every list
+    // of argument types that it is called with)
+    std::string pack_name;
+
     std::vector<Function_Parameter *> params;
     std::vector<AST_Expression *> block;
 
+    llvm::Function *generate_ir_declaration(LLVM_IR *ir); // (only declares it)
+    llvm::Value *generate_ir_body(LLVM_IR *ir, llvm::Function *_f); // emits the body into _f
     llvm::Value *generate_ir(LLVM_IR *ir) override;
 };
 
@@ -185,6 +294,43 @@ struct AST_For_Expression : AST_Expression {
     llvm::Value *generate_ir(LLVM_IR *ir) override;
 };
 
+// for <induction_variable> in <begin>..<end> step <step> { ... }
+//
+// the induction variable cannot be assigned to in the body, so the
+// number of iterations is known before the loop begins. this gets
+// emitted as a canonical counted loop (a preheader that works out
+// the trip count, and a single latch) which the loop passes of
+// LLVM (vectorizer, unroller...) can always make sense of.
+struct AST_Range_For_Expression : AST_Expression {
+    AST_Range_For_Expression() : AST_Expression(EXPR_RANGE_FOR) {}
+
+    std::string induction_variable;
+    Data_Type *induction_type = NULL; // NULL if not given (then it is the type of the bounds)
+    Data_Type *deduced_type = NULL;   // (if not given) a type parameter, bound to the type of the bounds
+
+    AST_Expression *begin = NULL;
+    AST_Expression *end = NULL;   // (exclusive)
+    AST_Expression *step = NULL;  // NULL for a step of 1
+    std::vector<AST_Expression *> block;
+
+    llvm::Value *generate_ir(LLVM_IR *ir) override;
+};
+
+// for <element> in <pack> { ... }
+//
+// the loop over a parameter pack is unrolled: the block is emitted
+// once for every argument in the pack (of the instance that is being
+// emitted), with the element bound to that argument.
+struct AST_Pack_For_Expression : AST_Expression {
+    AST_Pack_For_Expression() : AST_Expression(EXPR_PACK_FOR) {}
+
+    std::string element;
+    Data_Type *element_type = NULL; // a type parameter, bound to the type of each argument in turn
+    std::vector<AST_Expression *> block;
+
+    llvm::Value *generate_ir(LLVM_IR *ir) override;
+};
+
 struct AST_While_Expression : AST_Expression {
     AST_While_Expression() : AST_Expression(EXPR_WHILE) {}
 
@@ -197,6 +343,8 @@ struct AST_While_Expression : AST_Expression {
 struct AST_Declaration : AST_Expression {
     AST_Declaration() : AST_Expression(EXPR_DECL) {}
 
+    bool is_const = false;
+    bool is_atomic = false;
     Data_Type *data_type = NULL;
     std::string variable_name;
 
@@ -223,12 +371,30 @@ struct AST_Binary_Expression : AST_Expression {
     llvm::Value *generate_ir(LLVM_IR *ir) override;
 };
 
+// the subexpression parser leaves a single operand wrapped inside a
+// binary expression with no operator. this gets rid of that wrapping.
+inline AST_Expression *unwrap_ast_expression(AST_Expression *expr) {
+    while (expr != NULL && expr->expr_type == EXPR_BINARY &&
+           ((AST_Binary_Expression *)expr)->op == TOKEN_NONE &&
+           ((AST_Binary_Expression *)expr)->right == NULL)
+        expr = ((AST_Binary_Expression *)expr)->left;
+    return expr;
+}
+
 struct AST_Function_Call : AST_Expression {
     AST_Function_Call() : AST_Expression(EXPR_FUNC_CALL) {}
 
     std::string function_name;
     std::vector<AST_Expression *> params;
 
+    // for generic functions, if the type arguments are given
+    // explicitly: <name><type_1, type_2, ...>(...)
+    std::vector<Data_Type *> type_args;
+
+    // set only for the atomic builtins
+    // (atomic_load, atomic_store, atomic_fetch_add, atomic_cas, fence)
+    Atomic_Ordering ordering = AO_NONE;
+
     llvm::Value *generate_ir(LLVM_IR *ir) override;
 };
 
@@ -256,6 +422,64 @@ struct AST_Varg : AST_Expression {
     llvm::Value *generate_ir(LLVM_IR *ir) override;
 };
 
+// await <function_call>
+//
+// the call is made with the current coroutine published to the
+// runtime (so that the callee can arrange for it to be resumed),
+// and then the coroutine is suspended.
+struct AST_Await_Expression : AST_Expression {
+    AST_Await_Expression() : AST_Expression(EXPR_AWAIT) {}
+
+    AST_Function_Call *call = NULL;
+
+    llvm::Value *generate_ir(LLVM_IR *ir) override;
+};
+
+// parallel for (<induction_variable> = <begin>; <induction_variable> < <end>; <induction_variable>++)
+//
+// the body is outlined into a separate function (that runs
+// a range of iterations), and the locals that it refers to
+// (captures) are passed to it by reference.
+struct AST_Parallel_For_Expression : AST_Expression {
+    AST_Parallel_For_Expression() : AST_Expression(EXPR_PARALLEL_FOR) {}
+
+    std::string induction_variable;
+    Data_Type *induction_type = NULL; // NULL if it was declared outside the loop
+
+    AST_Expression *begin = NULL;
+    AST_Expression *end = NULL;
+    bool is_inclusive = false; // for (<=) conditions
+
+    std::vector<std::string> captures;
+    std::vector<AST_Expression *> block;
+
+    llvm::Value *generate_ir(LLVM_IR *ir) override;
+};
+
+// an operand of an inline assembly block:  "<constraint>"(<expression>)
+struct Asm_Operand {
+    std::string constraint;
+    AST_Expression *expr = NULL; // (always an identifier for outputs)
+};
+
+// asm [volatile] ("<template>" : <outputs> : <inputs> : <clobbers>)
+//
+// (in the same form as GCC's extended asm). the outputs are
+// stored back into their variables once the assembly has run.
+// the constraints are checked against the target, so that a
+// typo doesn't only turn up as a failure deep inside LLVM.
+struct AST_Asm_Expression : AST_Expression {
+    AST_Asm_Expression() : AST_Expression(EXPR_ASM) {}
+
+    std::string asm_template;
+    bool is_volatile = false;
+    std::vector<Asm_Operand> outputs;
+    std::vector<Asm_Operand> inputs;
+    std::vector<std::string> clobbers;
+
+    llvm::Value *generate_ir(LLVM_IR *ir) override;
+};
+
 // for scoped expression blocks
 // (other than the ones attached to if/for/while/functions...)
 struct AST_Block_Expression : AST_Expression {
@@ -0,0 +1,327 @@
+//
+// counters.cpp
+//
+
+#include "counters.h"
+#include <mutex>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// (the times that the group was enabled and running for, which come
+// after the counts, and scale them when the counters are multiplexed)
+#define COUNTER_TIME_ENABLED NUM_COUNTER_EVENTS
+#define COUNTER_TIME_RUNNING (NUM_COUNTER_EVENTS + 1)
+
+static const char *phase_names[NUM_COUNTER_PHASES] = {
+    "lex", "parse", "IR gen", "move", "link", "optimize", "codegen",
+};
+
+static bool counters_enabled = false;
+
+// (why the counters couldn't be opened, if they couldn't)
+static std::string counters_unavailable_reason;
+static std::mutex counters_mutex;
+
+struct Thread_Totals {
+    std::string name;
+    bool has_event[NUM_COUNTER_EVENTS] = {}; // (that this CPU could count)
+    uint64_t totals[NUM_COUNTER_PHASES][NUM_COUNTER_EVENTS] = {};
+    size_t num_counted[NUM_COUNTER_PHASES] = {};
+};
+
+// the totals of the threads that have exited
+static std::vector<Thread_Totals> finished_threads;
+static size_t num_worker_threads = 0;
+
+
+//                     Per-thread counters
+// ***********************************************************
+
+// the counters of a thread are a single group (so that they are all
+// read at once, with a single read), with cycles as its leader. the
+// events that this CPU doesn't have are left out of the group.
+struct Thread_Counters {
+    bool opened = false;
+    bool available = false;
+    int leader_fd = -1;
+    int fds[NUM_COUNTER_EVENTS];
+    int value_index[NUM_COUNTER_EVENTS]; // (of the event, in what the group reads, or -1)
+    int num_values = 0;
+    Thread_Totals totals;
+
+    void open();
+    bool read_values(uint64_t *values);
+    ~Thread_Counters();
+};
+
+static thread_local Thread_Counters thread_counters;
+
+#if defined(__linux__)
+
+static int open_event(uint32_t type, uint64_t config, int group_fd) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group_fd == -1; // (the leader enables the whole group)
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // (this thread, on any cpu)
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+static uint64_t cache_miss_config(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+void Thread_Counters::open() {
+    opened = true;
+    for (int i = 0; i < NUM_COUNTER_EVENTS; i++) {
+        fds[i] = -1;
+        value_index[i] = -1;
+    }
+
+    const uint32_t types[NUM_COUNTER_EVENTS] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+        PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE,
+    };
+    const uint64_t configs[NUM_COUNTER_EVENTS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+        cache_miss_config(PERF_COUNT_HW_CACHE_L1D), cache_miss_config(PERF_COUNT_HW_CACHE_LL),
+    };
+
+    leader_fd = open_event(types[COUNTER_CYCLES], configs[COUNTER_CYCLES], -1);
+    if (leader_fd == -1) {
+        std::lock_guard<std::mutex> lock(counters_mutex);
+        if (counters_unavailable_reason.empty()) {
+            counters_unavailable_reason = strerror(errno);
+            if (errno == EACCES || errno == EPERM)
+                counters_unavailable_reason += ", see /proc/sys/kernel/perf_event_paranoid";
+        }
+        return;
+    }
+    fds[COUNTER_CYCLES] = leader_fd;
+    value_index[COUNTER_CYCLES] = num_values++;
+
+    for (int i = COUNTER_CYCLES + 1; i < NUM_COUNTER_EVENTS; i++) {
+        fds[i] = open_event(types[i], configs[i], leader_fd);
+        if (fds[i] != -1)
+            value_index[i] = num_values++;
+    }
+    for (int i = 0; i < NUM_COUNTER_EVENTS; i++)
+        totals.has_event[i] = fds[i] != -1;
+
+    ioctl(leader_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    available = true;
+}
+
+// reads the counts of the group (values[COUNTER_...]), and the times
+bool Thread_Counters::read_values(uint64_t *values) {
+    // nr, time enabled, time running, and then the values
+    uint64_t buffer[3 + NUM_COUNTER_EVENTS];
+    ssize_t size = read(leader_fd, buffer, sizeof(buffer));
+    if (size < (ssize_t)((3 + num_values) * sizeof(uint64_t)))
+        return false;
+
+    for (int i = 0; i < NUM_COUNTER_EVENTS; i++)
+        values[i] = value_index[i] == -1 ? 0 : buffer[3 + value_index[i]];
+    values[COUNTER_TIME_ENABLED] = buffer[1];
+    values[COUNTER_TIME_RUNNING] = buffer[2];
+    return true;
+}
+
+Thread_Counters::~Thread_Counters() {
+    for (int i = 0; opened && i < NUM_COUNTER_EVENTS; i++) {
+        if (fds[i] != -1)
+            close(fds[i]);
+    }
+    if (!available)
+        return;
+
+    std::lock_guard<std::mutex> lock(counters_mutex);
+    finished_threads.push_back(totals);
+}
+
+#else
+
+void Thread_Counters::open() {
+    opened = true;
+    std::lock_guard<std::mutex> lock(counters_mutex);
+    counters_unavailable_reason = "they are only read on Linux";
+}
+
+bool Thread_Counters::read_values(uint64_t *) { return false; }
+Thread_Counters::~Thread_Counters() {}
+
+#endif
+
+
+//                         Phases
+// ***********************************************************
+
+Phase_Counter::Phase_Counter(Counter_Phase phase) : phase(phase) {
+    if (!counters_enabled)
+        return;
+
+    Thread_Counters *counters = &thread_counters;
+    if (!counters->opened) {
+        counters->open();
+        if (counters->available && counters->totals.name.empty()) {
+            std::lock_guard<std::mutex> lock(counters_mutex);
+            counters->totals.name = "worker " + std::to_string(++num_worker_threads);
+        }
+    }
+    active = counters->available && counters->read_values(start);
+}
+
+Phase_Counter::~Phase_Counter() {
+    if (!active)
+        return;
+
+    Thread_Counters *counters = &thread_counters;
+    uint64_t end[NUM_COUNTER_EVENTS + 2];
+    if (!counters->read_values(end))
+        return;
+
+    // (when there are more events than the PMU can count at once,
+    // they take turns, and the counts are scaled up to the whole time)
+    uint64_t enabled = end[COUNTER_TIME_ENABLED] - start[COUNTER_TIME_ENABLED];
+    uint64_t running = end[COUNTER_TIME_RUNNING] - start[COUNTER_TIME_RUNNING];
+    double scale = (running && running < enabled) ? (double)enabled / running : 1.0;
+
+    for (int i = 0; i < NUM_COUNTER_EVENTS; i++)
+        counters->totals.totals[phase][i] += (uint64_t)((end[i] - start[i]) * scale);
+    counters->totals.num_counted[phase]++;
+}
+
+void enable_counters() {
+    counters_enabled = true;
+}
+
+// names the current thread, in the report
+// (the others are numbered, as workers)
+void set_counter_thread_name(const char *name) {
+    if (counters_enabled)
+        thread_counters.totals.name = name;
+}
+
+
+//                         Report
+// ***********************************************************
+
+static void print_count(uint64_t count, bool available) {
+    if (!available)
+        printf(" %14s", "-");
+    else
+        printf(" %14llu", (unsigned long long)count);
+}
+
+static void print_per_token(uint64_t count, size_t total_tokens, bool available, const char *what) {
+    if (!available)
+        printf(", %8s %s", "-", what);
+    else
+        printf(", %8.3f %s", (double)count / total_tokens, what);
+}
+
+static double ratio(uint64_t a, uint64_t b) {
+    return b ? (double)a / b : 0;
+}
+
+// prints the counts of each phase (summed over the threads), the misses
+// per token of the lexer and the parser, and the counts of each thread
+void print_counter_report(size_t total_tokens) {
+    if (!counters_enabled)
+        return;
+
+    std::vector<Thread_Totals> threads;
+    {
+        std::lock_guard<std::mutex> lock(counters_mutex);
+        threads = finished_threads;
+    }
+    if (thread_counters.available)
+        threads.push_back(thread_counters.totals); // (this thread is still running)
+
+    printf("\n                                 Hardware counters\n");
+    printf("-------------------------------------------------------------------------------------------\n");
+
+    if (threads.empty()) {
+        printf("Hardware counters are not available (%s),\nso only the times are shown.\n",
+               counters_unavailable_reason.c_str());
+        printf("-------------------------------------------------------------------------------------------\n");
+        return;
+    }
+
+    bool available[NUM_COUNTER_EVENTS] = {};
+    uint64_t totals[NUM_COUNTER_PHASES][NUM_COUNTER_EVENTS] = {};
+    size_t num_counted[NUM_COUNTER_PHASES] = {};
+
+    for (Thread_Totals &thread : threads) {
+        for (int p = 0; p < NUM_COUNTER_PHASES; p++) {
+            for (int e = 0; e < NUM_COUNTER_EVENTS; e++)
+                totals[p][e] += thread.totals[p][e];
+            num_counted[p] += thread.num_counted[p];
+        }
+    }
+    for (Thread_Totals &thread : threads) {
+        for (int e = 0; e < NUM_COUNTER_EVENTS; e++)
+            available[e] = available[e] || thread.has_event[e];
+    }
+
+    printf("%-10s %14s %14s %6s %14s %14s %14s\n", "Phase", "Cycles", "Instructions", "IPC",
+           "Branch misses", "L1d misses", "LLC misses");
+    for (int p = 0; p < NUM_COUNTER_PHASES; p++) {
+        if (!num_counted[p])
+            continue;
+
+        printf("%-10s", phase_names[p]);
+        print_count(totals[p][COUNTER_CYCLES], true);
+        print_count(totals[p][COUNTER_INSTRUCTIONS], available[COUNTER_INSTRUCTIONS]);
+        printf(" %6.2f", ratio(totals[p][COUNTER_INSTRUCTIONS], totals[p][COUNTER_CYCLES]));
+        print_count(totals[p][COUNTER_BRANCH_MISSES], available[COUNTER_BRANCH_MISSES]);
+        print_count(totals[p][COUNTER_L1D_MISSES], available[COUNTER_L1D_MISSES]);
+        print_count(totals[p][COUNTER_LLC_MISSES], available[COUNTER_LLC_MISSES]);
+        printf("\n");
+    }
+
+    if (total_tokens) {
+        printf("\nPer token (%zu tokens):\n", total_tokens);
+        for (int p = PHASE_LEX; p <= PHASE_PARSE; p++) {
+            printf("%-10s %8.1f cycles", phase_names[p], ratio(totals[p][COUNTER_CYCLES], total_tokens));
+            print_per_token(totals[p][COUNTER_BRANCH_MISSES], total_tokens,
+                            available[COUNTER_BRANCH_MISSES], "branch misses");
+            print_per_token(totals[p][COUNTER_L1D_MISSES], total_tokens,
+                            available[COUNTER_L1D_MISSES], "L1d misses");
+            print_per_token(totals[p][COUNTER_LLC_MISSES], total_tokens,
+                            available[COUNTER_LLC_MISSES], "LLC misses");
+            printf("\n");
+        }
+    }
+
+    printf("\n%-10s %14s %14s %6s\n", "Thread", "Cycles", "Instructions", "IPC");
+    for (Thread_Totals &thread : threads) {
+        uint64_t cycles = 0, instructions = 0;
+        for (int p = 0; p < NUM_COUNTER_PHASES; p++) {
+            cycles += thread.totals[p][COUNTER_CYCLES];
+            instructions += thread.totals[p][COUNTER_INSTRUCTIONS];
+        }
+        printf("%-10s", thread.name.c_str());
+        print_count(cycles, true);
+        print_count(instructions, available[COUNTER_INSTRUCTIONS]);
+        printf(" %6.2f\n", ratio(instructions, cycles));
+    }
+    printf("-------------------------------------------------------------------------------------------\n");
+}
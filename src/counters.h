@@ -0,0 +1,76 @@
+//
+// counters.h
+//
+
+/*
+
+Hardware performance counters for -benchmark=counters.
+
+The times in -benchmark don't say why a phase takes as long as it
+does (whether the lexer is held up by branch misses, or the IR
+generation by cache misses). With -benchmark=counters, every thread
+also counts these, around each phase of the compilation:
+
+    cycles, instructions, branch misses, L1d (read) misses
+    and last level cache (read) misses
+
+which are then reported for each phase (summed over the threads),
+with the IPC and the misses per token, and for each thread.
+
+The counters are read with perf_event_open, so this only works on
+Linux (and only counts user space, which is allowed by the default
+perf_event_paranoid). Where they can't be opened (another OS, a
+container or a VM without access to them), there is a note about it
+in the report, and just the times are shown.
+
+A phase is counted with a Phase_Counter on the stack:
+
+    {
+        Phase_Counter counter(PHASE_LEX);
+        ... // (the lexing)
+    }
+
+which does nothing at all unless the counters are enabled.
+
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+enum Counter_Phase {
+    PHASE_LEX,
+    PHASE_PARSE,
+    PHASE_IR_GEN,
+    PHASE_MOVE,     // (bringing the modules into the shared context)
+    PHASE_LINK,
+    PHASE_OPTIMIZE,
+    PHASE_CODEGEN,
+    NUM_COUNTER_PHASES,
+};
+
+enum Counter_Event {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+    NUM_COUNTER_EVENTS,
+};
+
+// counts the phase from here till the end of the scope
+// (on the current thread)
+struct Phase_Counter {
+    Counter_Phase phase;
+    bool active = false;
+    uint64_t start[NUM_COUNTER_EVENTS + 2]; // (and the times enabled/running)
+
+    Phase_Counter(Counter_Phase phase);
+    ~Phase_Counter();
+};
+
+void enable_counters();
+void set_counter_thread_name(const char *name);
+void print_counter_report(size_t total_tokens);
@@ -135,20 +135,3 @@ template <typename T> inline void smap<T>::resize(size_t new_capacity) {
 
     delete[] old_data;
 }
-
-
-// string to int conversion handling
-
-#define MAX_POS "2147483647"
-#define MAX_NEG "2147483648"
-
-
-// returns true if the integer string can fit in a 32 bit int
-//
-// NOTE: this function is only meant to be called for TOKEN_NUMERICAL_LITERAL
-// of an integer type, and hence it assumes:
-//
-//    (1) the string has a non-zero length
-//    (2) it is a valid integer string (may have a sign at the beginning)
-
-bool fits_s32(std::string& str);
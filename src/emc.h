@@ -13,18 +13,33 @@
 
 enum Output_File_Type { OBJ, ASM, LL };
 
+// how far to go with the files (the check modes only report
+// the errors, and stop before the backend and linking)
+enum Compilation_Mode { FULL_COMPILATION, SYNTAX_ONLY, SEMANTICS_ONLY };
+
 struct Flag_Settings {
     bool print_ast = false;
     bool print_ir = false;
     Output_File_Type output_file_type = OBJ;
     std::string cpu_type;
+    std::string target_triple; // (worked out from the cpu type)
     std::string output_file_name = "out";
     int optimization_level = 0;
+    Compilation_Mode mode = FULL_COMPILATION;
+    bool discard_value_names = false; // (when the IR isn't printed)
+    bool batch_modules = false; // (a context and a module per thread, not per file)
+    bool instrument_functions = false; // (calls to the profiling runtime, in every function)
+    bool skip_unreachable = false; // (only the functions that can be called from main are emitted)
+    bool incremental = false; // (the functions that haven't changed are taken from emc-cache/)
 };
 
 struct Compilation_Metrics {
     size_t total_lines = 0;
+    size_t total_tokens = 0; // (for the misses per token, with -benchmark=counters)
+    size_t num_files = 1;
     size_t num_threads = 1;
+    size_t skipped_functions = 0; // (not reachable from main, so not emitted)
+    size_t reused_functions = 0; // (taken from the cache, with -fincremental)
     double aggregate_frontend_time = 0;  // sum of frontend times of each thread
     double frontend_time = 0;      // total fronend time taken
     double backend_time = 0;       // total backend time taken (mainly by LLVM)
@@ -32,6 +32,8 @@
 #define E086 "error E086: Included file name must be in the format: <FILE_NAME>.<EXTENSION>"
 #define E087 "error E087: Could not find the file: %s"
 #define E107 "error E107: Invalid escape sequence encountered."
+#define E148 "error E148: Invalid numeric literal. Expected: <digits>[.<digits>], 0x<hex digits> or 0b<binary digits> (with any '_' only between two digits)"
+#define E149 "error E149: Numeric literal is too large (integers must fit in 64 bits)."
 
 /* errors originating in parser */
 #define E015 "\nerror E015: Could not find current token."
@@ -82,7 +84,7 @@
 #define E060 "error E060: No tokens found."
 #define E061 "error E061: Incomplete top-level expression encountered."
 #define E062 "error E062: Duplicate entry points found."
-#define E088 "error E088: Invalid function definition: Variadic arg marker \'...\' must be followed by \')\'."
+#define E088 "error E088: Invalid function definition: Variadic arg marker \'...\' (or parameter pack \'...<name>\') must be followed by \')\'."
 #define E089 "error E089: Invalid varg syntax: Expected \'(\'."
 #define E090 "error E090: Invalid varg syntax: Expected data type."
 #define E091 "error E091: Invalid varg syntax: Expected \')\'."
@@ -106,6 +108,26 @@
 #define E111 "error E111: Incomplete enum statement encountered."
 #define E112 "error E112: Expected integer literal for enum value."
 #define E113 "error E113: Expected \';\' at the end of enum statement."
+#define E114 "error E114: const keyword must be followed by a data type."
+#define E115 "error E115: const declaration must be initialized."
+#define E117 "error E117: \'parallel\' must be followed by a \'for\' loop."
+#define E118 "error E118: parallel for must be of the form: for (i = <begin>; i < <end>; i++)"
+#define E119 "error E119: \'break\', \'return\', \'varg\', \'await\' and parameter pack loops cannot be used directly inside a parallel for body."
+#define E121 "error E121: atomic keyword must be followed by an integer data type."
+#define E122 "error E122: Invalid memory ordering for atomic operation."
+#define E123 "error E123: The first argument of an atomic operation must be a variable."
+#define E126 "error E126: \'async\' can only be applied to a function definition with a void return type."
+#define E127 "error E127: \'await\' can only be used inside an async function."
+#define E128 "error E128: \'await\' must be followed by a function call."
+#define E130 "error E130: Invalid type parameters for generic function. Expected: <return_type> <name><T, U, ...>(...)"
+#define E131 "error E131: Type parameter name is already used by a data type."
+#define E132 "error E132: Generic functions must be defined with a body (they cannot be prototypes)."
+#define E133 "error E133: Invalid type arguments for generic function call. Expected: <name><type_1, type_2, ...>(...)"
+#define E136 "error E136: Invalid range for loop. Expected: for [<data_type>] <identifier> in <expression>..<expression> [step <expression>] { ... }"
+#define E140 "error E140: Invalid inline assembly. Expected: asm [volatile] (\"<template>\" : <outputs> : <inputs> : <clobbers>)"
+#define E141 "error E141: Inline assembly operands must be written as \"<constraint>\"(<expression>), and the outputs must be variables."
+#define E146 "error E146: Functions with a parameter pack must be defined with a body (they cannot be prototypes)."
+#define E150 "error E150: This name is reserved for an atomic builtin (atomic_load, atomic_store, atomic_fetch_add, atomic_cas, fence)."
 
 /* errors originating in ir_generator */
 #define E063 "error E063: Non-integer type in logical expression."
@@ -129,3 +151,19 @@
 #define E081 "error E081: Global initializers must be constant expressions."
 #define E082 "error E082: Invalid top-level expression encountered."
 #define E101 "error E101: (FATAL) Cannot find parent IR block for \'switch\' statement."
+#define E116 "error E116: Cannot assign to a const variable."
+#define E120 "error E120: parallel for induction variable must be of an integer type."
+#define E124 "error E124: Atomic operation on a non-atomic variable."
+#define E125 "error E125: Only =, +=, -=, &=, |=, ^=, ++ and -- can be applied to an atomic variable."
+#define E129 "error E129: (FATAL) Cannot find the coroutine for \'await\'."
+#define E134 "error E134: Conflicting types for a type parameter in a generic function call."
+#define E135 "error E135: Cannot deduce the type arguments of a generic function call. They must be given explicitly: <name><type_1, type_2, ...>(...)"
+#define E137 "error E137: Cannot assign to the induction variable of a range for loop."
+#define E138 "error E138: The bounds and step of a range for loop must be of an integer type."
+#define E139 "error E139: The step of a range for loop must be greater than zero."
+#define E142 "error E142: Inline assembly constraint is not valid for the target."
+#define E143 "error E143: Inline assembly clobber is not a register of the target (or \"memory\" / \"cc\")."
+#define E144 "error E144: Inline assembly template refers to an operand that does not exist."
+#define E145 "error E145: Inline assembly operand with an immediate constraint (i, n) must be a constant."
+#define E147 "error E147: Cannot pass an argument of this type to a parameter pack."
+#define E151 "error E151: An integer cannot be passed to a smaller integer parameter, or stored in a smaller atomic variable (unless it is a constant that fits)."
@@ -0,0 +1,651 @@
+//
+// incremental.cpp
+//
+
+// (see incremental.h for how the cache works)
+
+#include "incremental.h"
+#include "emc.h"
+#include "linker.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Analysis/InlineCost.h"
+#include "llvm/Transforms/IPO/GlobalDCE.h"
+#include "llvm/Transforms/IPO/Inliner.h"
+#include "llvm/Transforms/InstCombine/InstCombine.h"
+#include "llvm/Transforms/Scalar/EarlyCSE.h"
+#include "llvm/Transforms/Scalar/SimplifyCFG.h"
+#include "llvm/Transforms/Vectorize/LoopVectorize.h"
+#include "llvm/Transforms/Vectorize/SLPVectorizer.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+
+//                          Hashing
+// ***********************************************************
+
+// FNV-1a (like fnv1a_hash), over the fields of the nodes
+struct Hasher {
+    uint64_t hash = 1469598103934665603ull;
+
+    void add_bytes(const void *data, size_t size) {
+        const unsigned char *bytes = (const unsigned char *)data;
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    void add(uint64_t value) { add_bytes(&value, sizeof(value)); }
+    void add(const std::string &s) {
+        add(s.size()); // (so that "ab" "c" isn't the same as "a" "bc")
+        add_bytes(s.data(), s.size());
+    }
+};
+
+#define HASH_NULL 0x6e756c6cull // (for a missing node or type)
+
+static void hash_type(Hasher &h, Data_Type *data_type) {
+    if (!data_type) {
+        h.add(HASH_NULL);
+        return;
+    }
+    h.add(data_type->type_kind);
+    if (data_type->type_kind == TK_PRIMITIVE) {
+        h.add(data_type->name.p);
+    } else {
+        h.add(data_type->name.np ? *data_type->name.np : std::string());
+    }
+
+    // (a type parameter is only bound while its function is emitted)
+    if (data_type->type_kind != TK_TYPE_PARAM)
+        hash_type(h, data_type->base_type);
+}
+
+static void hash_literal(Hasher &h, AST_Literal *literal) {
+    hash_type(h, literal->type);
+    if (!literal->type || literal->type->type_kind != TK_PRIMITIVE)
+        return;
+
+    // (only the member for the type is set, the rest of the union isn't)
+    switch (literal->type->name.p) {
+    case T_BOOL: h.add(literal->value.b); break;
+    case T_U8:   h.add(literal->value.i_u8); break;
+    case T_U16:  h.add(literal->value.i_u16); break;
+    case T_U32:  h.add(literal->value.i_u32); break;
+    case T_U64:  h.add(literal->value.i_u64); break;
+    case T_S8:   h.add((uint64_t)literal->value.i_s8); break;
+    case T_S16:  h.add((uint64_t)literal->value.i_s16); break;
+    case T_S32:  h.add((uint64_t)literal->value.i_s32); break;
+    case T_S64:  h.add((uint64_t)literal->value.i_s64); break;
+    case T_F32:  h.add_bytes(&literal->value.f_32, sizeof(float)); break;
+    case T_F64:  h.add_bytes(&literal->value.f_64, sizeof(double)); break;
+    case T_STRING:
+        h.add(literal->value.s ? *literal->value.s : std::string());
+        break;
+    default:
+        break;
+    }
+}
+
+static void hash_expression(Hasher &h, AST_Expression *expr, std::vector<std::string> &references);
+
+static void hash_block(Hasher &h, std::vector<AST_Expression *> &block,
+                       std::vector<std::string> &references) {
+    h.add(block.size());
+    for (AST_Expression *e : block)
+        hash_expression(h, e, references);
+}
+
+// the signature of a function (what the calls to it are emitted with)
+static void hash_signature(Hasher &h, AST_Function_Definition *function) {
+    h.add(function->function_name);
+    hash_type(h, function->return_type);
+    h.add(function->params.size());
+    for (Function_Parameter *param : function->params)
+        hash_type(h, param->type);
+    h.add(function->has_variadic_args);
+    h.add(function->is_async);
+    h.add(function->type_params.size());
+    h.add(function->pack_name);
+}
+
+// hashes the whole tree of an expression, and adds the names that
+// it refers to (the identifiers, and the functions it calls) to references
+static void hash_expression(Hasher &h, AST_Expression *expr, std::vector<std::string> &references) {
+    if (expr == NULL) {
+        h.add(HASH_NULL);
+        return;
+    }
+    h.add(expr->expr_type);
+
+    switch (expr->expr_type) {
+    case EXPR_IDENT: {
+        auto *e = (AST_Identifier *)expr;
+        h.add(e->name);
+        references.push_back(e->name);
+        break;
+    }
+    case EXPR_LITERAL:
+        hash_literal(h, (AST_Literal *)expr);
+        break;
+    case EXPR_FUNC_DEF: {
+        auto *e = (AST_Function_Definition *)expr;
+        hash_signature(h, e);
+        h.add(e->is_prototype);
+        for (Data_Type *type_param : e->type_params)
+            hash_type(h, type_param);
+        for (Function_Parameter *param : e->params)
+            h.add(param->name);
+        hash_block(h, e->block, references);
+        break;
+    }
+    case EXPR_IF: {
+        auto *e = (AST_If_Expression *)expr;
+        hash_expression(h, e->condition, references);
+        hash_block(h, e->block, references);
+        hash_block(h, e->else_block, references);
+        break;
+    }
+    case EXPR_CASE: {
+        auto *e = (AST_Case_Expression *)expr;
+        hash_expression(h, e->literal, references);
+        hash_block(h, e->block, references);
+        break;
+    }
+    case EXPR_SWITCH: {
+        auto *e = (AST_Switch_Expression *)expr;
+        h.add(e->has_default_case);
+        hash_expression(h, e->identifier_or_call, references);
+        h.add(e->case_list.size());
+        for (AST_Case_Expression *c : e->case_list)
+            hash_expression(h, c, references);
+        break;
+    }
+    case EXPR_FOR: {
+        auto *e = (AST_For_Expression *)expr;
+        hash_expression(h, e->init, references);
+        hash_expression(h, e->condition, references);
+        hash_expression(h, e->increment, references);
+        hash_block(h, e->block, references);
+        break;
+    }
+    case EXPR_RANGE_FOR: {
+        auto *e = (AST_Range_For_Expression *)expr;
+        h.add(e->induction_variable);
+        hash_type(h, e->induction_type);
+        hash_expression(h, e->begin, references);
+        hash_expression(h, e->end, references);
+        hash_expression(h, e->step, references);
+        hash_block(h, e->block, references);
+        break;
+    }
+    case EXPR_PACK_FOR: {
+        auto *e = (AST_Pack_For_Expression *)expr;
+        h.add(e->element);
+        hash_block(h, e->block, references);
+        break;
+    }
+    case EXPR_WHILE: {
+        auto *e = (AST_While_Expression *)expr;
+        hash_expression(h, e->condition, references);
+        hash_block(h, e->block, references);
+        break;
+    }
+    case EXPR_DECL: {
+        auto *e = (AST_Declaration *)expr;
+        h.add(e->is_const);
+        h.add(e->is_atomic);
+        hash_type(h, e->data_type);
+        h.add(e->variable_name);
+        break;
+    }
+    case EXPR_UNARY: {
+        auto *e = (AST_Unary_Expression *)expr;
+        h.add(e->is_postfix);
+        h.add(e->op);
+        hash_expression(h, e->expr, references);
+        break;
+    }
+    case EXPR_BINARY: {
+        auto *e = (AST_Binary_Expression *)expr;
+        h.add(e->op);
+        hash_expression(h, e->left, references);
+        hash_expression(h, e->right, references);
+        break;
+    }
+    case EXPR_FUNC_CALL: {
+        auto *e = (AST_Function_Call *)expr;
+        h.add(e->function_name);
+        h.add(e->ordering);
+        h.add(e->type_args.size());
+        for (Data_Type *type_arg : e->type_args)
+            hash_type(h, type_arg);
+        hash_block(h, e->params, references);
+        references.push_back(e->function_name);
+        break;
+    }
+    case EXPR_RETURN:
+        hash_expression(h, ((AST_Return_Expression *)expr)->value, references);
+        break;
+    case EXPR_JUMP:
+        h.add(((AST_Jump_Expression *)expr)->jump_type);
+        break;
+    case EXPR_VARG:
+        hash_type(h, ((AST_Varg *)expr)->data_type);
+        break;
+    case EXPR_AWAIT:
+        hash_expression(h, ((AST_Await_Expression *)expr)->call, references);
+        break;
+    case EXPR_PARALLEL_FOR: {
+        auto *e = (AST_Parallel_For_Expression *)expr;
+        h.add(e->induction_variable);
+        hash_type(h, e->induction_type);
+        hash_expression(h, e->begin, references);
+        hash_expression(h, e->end, references);
+        h.add(e->is_inclusive);
+        h.add(e->captures.size());
+        for (std::string &capture : e->captures)
+            h.add(capture);
+        hash_block(h, e->block, references);
+        break;
+    }
+    case EXPR_ASM: {
+        auto *e = (AST_Asm_Expression *)expr;
+        h.add(e->asm_template);
+        h.add(e->is_volatile);
+        h.add(e->outputs.size());
+        for (Asm_Operand &operand : e->outputs) {
+            h.add(operand.constraint);
+            hash_expression(h, operand.expr, references);
+        }
+        h.add(e->inputs.size());
+        for (Asm_Operand &operand : e->inputs) {
+            h.add(operand.constraint);
+            hash_expression(h, operand.expr, references);
+        }
+        h.add(e->clobbers.size());
+        for (std::string &clobber : e->clobbers)
+            h.add(clobber);
+        break;
+    }
+    case EXPR_BLOCK:
+        hash_block(h, ((AST_Block_Expression *)expr)->block, references);
+        break;
+    default:
+        break;
+    }
+}
+
+// what the functions of a file can refer to, by name
+struct File_Symbols {
+    smap<AST_Function_Definition *> functions; // (the definition, or else the prototype)
+    smap<AST_Expression *> globals;            // (the top-level declaration)
+    smap<AST_Function_Definition *> defined_twice;
+};
+
+// the hash of a function: the function itself, and what it refers to.
+// (for a generic function, or a global, that is all of it, along with
+// what it refers to in turn. for the other functions, it is only their
+// signature, since that is all that the calls to them depend on)
+static uint64_t hash_function(AST_Function_Definition *function, File_Symbols &symbols,
+                              uint64_t salt) {
+    Hasher h;
+    h.add(salt);
+
+    std::vector<std::string> references;
+    hash_expression(h, function, references);
+
+    smap<AST_Function_Definition *> visited;
+    visited.insert(function->function_name, function);
+
+    // (references can get added while we go through them)
+    for (size_t i = 0; i < references.size(); i++) {
+        std::string name = references[i];
+        if (visited[name])
+            continue;
+        visited.insert(name, function);
+        h.add(name);
+
+        AST_Function_Definition *callee = symbols.functions[name];
+        if (!callee) {
+            h.add(HASH_NULL); // (a builtin, or a local)
+        } else if (!callee->type_params.empty() || !callee->pack_name.empty()) {
+            hash_expression(h, callee, references);
+        } else {
+            hash_signature(h, callee);
+        }
+
+        AST_Expression *global = symbols.globals[name];
+        if (global)
+            hash_expression(h, global, references);
+    }
+    return h.hash;
+}
+
+// the name of a global, from its top-level declaration
+static const std::string *global_name(AST_Expression *expr) {
+    if (expr->expr_type == EXPR_DECL)
+        return &((AST_Declaration *)expr)->variable_name;
+    if (expr->expr_type == EXPR_BINARY) {
+        auto *bin = (AST_Binary_Expression *)expr;
+        if (bin->left && bin->left->expr_type == EXPR_DECL)
+            return &((AST_Declaration *)bin->left)->variable_name;
+    }
+    return nullptr;
+}
+
+// everything (other than the code) that the IR of a function depends on
+static uint64_t cache_salt(Flag_Settings *flag_settings) {
+    Hasher h;
+
+    // (the build of the compiler, since the IR it emits can change. any
+    // rebuild of it changes the size or the time of its executable)
+    static const std::pair<uint64_t, int64_t> compiler_build = []() {
+        std::error_code ec;
+        std::filesystem::path exe_path = get_compiler_executable_path();
+        uint64_t size = std::filesystem::file_size(exe_path, ec);
+        int64_t time = std::filesystem::last_write_time(exe_path, ec).time_since_epoch().count();
+        return std::make_pair(size, time);
+    }();
+    h.add(compiler_build.first);
+    h.add(compiler_build.second);
+    h.add(std::string(LLVM_VERSION_STRING));
+
+    h.add(flag_settings->optimization_level);
+    h.add(flag_settings->target_triple);
+    h.add(flag_settings->cpu_type);
+    h.add(flag_settings->instrument_functions);
+    return h.hash;
+}
+
+
+//                        Opening the cache
+// ***********************************************************
+
+static std::string to_hex(uint64_t value) {
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)value);
+    return buffer;
+}
+
+// works out the hash of every function of the file, and which of them
+// are the same as in the last build (according to the index)
+Function_Cache *open_function_cache(std::vector<AST_Expression *> *ast,
+                                    const std::string &file_name,
+                                    Flag_Settings *flag_settings) {
+    auto *cache = new Function_Cache;
+
+    std::error_code ec;
+    std::filesystem::create_directories(EMC_CACHE_DIRECTORY, ec);
+
+    std::filesystem::path path = std::filesystem::absolute(file_name, ec).lexically_normal();
+    std::string key = to_hex(fnv1a_hash(path.string()));
+    cache->pack_path = std::string(EMC_CACHE_DIRECTORY "/") + key + ".bc";
+    cache->index_path = std::string(EMC_CACHE_DIRECTORY "/") + key + ".idx";
+
+    File_Symbols symbols;
+    for (AST_Expression *ast_expr : *ast) {
+        if (ast_expr->expr_type != EXPR_FUNC_DEF) {
+            if (const std::string *name = global_name(ast_expr))
+                symbols.globals.insert(*name, ast_expr);
+            continue;
+        }
+
+        auto *function = (AST_Function_Definition *)ast_expr;
+        AST_Function_Definition *previous = symbols.functions[function->function_name];
+        if (function->is_prototype) {
+            if (!previous)
+                symbols.functions.insert(function->function_name, function);
+            continue;
+        }
+        if (previous && !previous->is_prototype)
+            symbols.defined_twice.insert(function->function_name, function);
+        symbols.functions.insert(function->function_name, function);
+    }
+
+    uint64_t salt = cache_salt(flag_settings);
+    for (AST_Expression *ast_expr : *ast) {
+        if (ast_expr->expr_type != EXPR_FUNC_DEF)
+            continue;
+
+        // (the generic functions are emitted along with their callers)
+        auto *function = (AST_Function_Definition *)ast_expr;
+        if (function->is_prototype || !function->type_params.empty() ||
+            !function->pack_name.empty() || symbols.defined_twice[function->function_name])
+            continue;
+
+        cache->functions.push_back({function->function_name,
+                                    hash_function(function, symbols, salt)});
+    }
+
+    // the hashes from the last build (there is nothing
+    // to take from it, if the pack isn't there anymore)
+    std::ifstream index(cache->index_path);
+    if (!index || !std::filesystem::exists(cache->pack_path, ec))
+        return cache;
+
+    smap<Cached_Function *> by_name;
+    for (Cached_Function &cached : cache->functions)
+        by_name.insert(cached.name, &cached);
+
+    std::string line;
+    while (std::getline(index, line)) {
+        std::istringstream fields(line);
+        std::string name, hash;
+        if (!(fields >> name >> hash))
+            continue;
+        cache->num_indexed++;
+
+        Cached_Function *cached = by_name[name];
+        if (cached && to_hex(cached->hash) == hash) {
+            cache->reused.insert(name, symbols.functions[name]);
+            cache->num_reused++;
+        }
+    }
+    return cache;
+}
+
+
+//                        Closing the cache
+// ***********************************************************
+
+// optimizes each of the functions that were emitted, on its own (see
+// the NOTE in incremental.h), with the function passes of the level
+static void optimize_functions(llvm::Module *module, Flag_Settings *flag_settings) {
+    llvm::OptimizationLevel opt_level;
+    switch (flag_settings->optimization_level) {
+        case 1: opt_level = llvm::OptimizationLevel::O1; break;
+        case 2: opt_level = llvm::OptimizationLevel::O2; break;
+        case 3: opt_level = llvm::OptimizationLevel::O3; break;
+        default: return;
+    }
+
+    std::string error;
+    const llvm::Target *target =
+        llvm::TargetRegistry::lookupTarget(flag_settings->target_triple, error);
+    if (!target)
+        return; // (the backend reports this)
+
+    llvm::Triple triple(flag_settings->target_triple);
+    llvm::TargetOptions opt;
+    auto RM = std::optional<llvm::Reloc::Model>();
+    std::unique_ptr<llvm::TargetMachine> target_machine(target->createTargetMachine(
+        triple, flag_settings->cpu_type, "", opt, RM));
+
+    // (the layout is only needed while optimizing, the backend sets
+    // it on the whole program. until then, the modules are left as
+    // they would be without -fincremental)
+    std::string previous_layout = module->getDataLayoutStr();
+    module->setDataLayout(target_machine->createDataLayout());
+
+    llvm::PassBuilder pb(target_machine.get());
+
+    llvm::LoopAnalysisManager lam;
+    llvm::FunctionAnalysisManager fam;
+    llvm::CGSCCAnalysisManager cgam;
+    llvm::ModuleAnalysisManager mam;
+
+    pb.registerModuleAnalyses(mam);
+    pb.registerFunctionAnalyses(fam);
+    pb.registerLoopAnalyses(lam);
+    pb.registerCGSCCAnalyses(cgam);
+    pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+    // the simplification of the functions, and then the vectorizers
+    // (from the optimization part of the pipeline of the module)
+    llvm::FunctionPassManager fpm =
+        pb.buildFunctionSimplificationPipeline(opt_level, llvm::ThinOrFullLTOPhase::None);
+    if (flag_settings->optimization_level >= 2) {
+        fpm.addPass(llvm::LoopVectorizePass());
+        fpm.addPass(llvm::InstCombinePass());
+        fpm.addPass(llvm::SLPVectorizerPass());
+        fpm.addPass(llvm::InstCombinePass());
+        fpm.addPass(llvm::SimplifyCFGPass());
+    }
+
+    // (an async function is left as it is, since its coroutine is
+    // split up by the passes of the module, in the backend)
+    for (llvm::Function &f : *module) {
+        if (!f.isDeclaration() && !f.isPresplitCoroutine())
+            fpm.run(f, fam);
+    }
+
+    module->setDataLayout(previous_layout);
+}
+
+// writes out the module as the pack, and then its index (so that
+// an index is never there with a pack that it isn't for)
+static void write_pack(Function_Cache *cache, llvm::Module *module) {
+    std::error_code ec;
+    std::filesystem::remove(cache->index_path, ec);
+
+    std::string temp_path = cache->pack_path + ".tmp";
+    {
+        llvm::raw_fd_ostream pack(temp_path, ec, llvm::sys::fs::OF_None);
+        if (ec)
+            return; // (the cache is only skipped)
+        llvm::WriteBitcodeToFile(*module, pack);
+    }
+    std::filesystem::rename(temp_path, cache->pack_path, ec);
+    if (ec)
+        return;
+
+    std::ofstream index(cache->index_path);
+    for (Cached_Function &cached : cache->functions) {
+        llvm::Function *f = module->getFunction(cached.name);
+        if (f && !f->isDeclaration())
+            index << cached.name << " " << to_hex(cached.hash) << "\n";
+    }
+}
+
+// once the IR of the file has been emitted: optimizes the functions that
+// were emitted, links in the ones that were reused from the pack, and
+// writes out the module as the pack for the next build.
+//
+// returns false if the pack didn't have the functions that were to be
+// taken from it (then the index is removed, so that, when the file is
+// emitted again, nothing is taken from the cache).
+bool close_function_cache(Function_Cache *cache, LLVM_IR *ir,
+                          Flag_Settings *flag_settings) {
+    llvm::Module *module = ir->_module;
+
+    size_t num_emitted = 0;
+    for (Cached_Function &cached : cache->functions) {
+        llvm::Function *f = module->getFunction(cached.name);
+        if (f && !f->isDeclaration())
+            num_emitted++;
+    }
+
+    optimize_functions(module, flag_settings);
+
+    // (the functions that are defined by now are the ones that were
+    // emitted, the rest come from the pack)
+    std::vector<llvm::Function *> emitted;
+    for (llvm::Function &f : *module) {
+        if (!f.isDeclaration())
+            emitted.push_back(&f);
+    }
+
+    if (cache->num_reused > 0) {
+        // (lazily, so that only the functions that are linked in are read)
+        llvm::SMDiagnostic error;
+        std::unique_ptr<llvm::Module> pack =
+            llvm::getLazyIRFileModule(cache->pack_path, error, ir->_context);
+
+        // (only the declarations in the module get their definitions
+        // from the pack, along with whatever those refer to)
+        bool is_broken = !pack || llvm::Linker::linkModules(
+                                      *module, std::move(pack),
+                                      llvm::Linker::Flags::LinkOnlyNeeded);
+
+        // (a reused function that wasn't declared, like with
+        // -fskip-unreachable, isn't counted)
+        cache->num_reused = 0;
+        for (Cached_Function &cached : cache->functions) {
+            llvm::Function *f = module->getFunction(cached.name);
+            if (!cache->reused[cached.name] || !f)
+                continue;
+            if (f->isDeclaration())
+                is_broken = true;
+            cache->num_reused++;
+        }
+
+        if (is_broken) {
+            std::error_code ec;
+            std::filesystem::remove(cache->index_path, ec);
+            return false;
+        }
+    }
+
+    // (nothing has changed, if every function came from the pack)
+    if (num_emitted > 0 || cache->num_reused != cache->num_indexed)
+        write_pack(cache, module);
+
+    // (only now, so that the pack doesn't have them marked)
+    for (llvm::Function *f : emitted)
+        f->addFnAttr(EMC_EMITTED_ATTRIBUTE);
+    return true;
+}
+
+
+//                          The backend
+// ***********************************************************
+
+// runs the passes on the functions that were emitted in this build only
+struct Emitted_Functions_Pass : llvm::PassInfoMixin<Emitted_Functions_Pass> {
+    llvm::FunctionPassManager fpm;
+
+    explicit Emitted_Functions_Pass(llvm::FunctionPassManager fpm) : fpm(std::move(fpm)) {}
+
+    llvm::PreservedAnalyses run(llvm::Function &f, llvm::FunctionAnalysisManager &fam) {
+        if (!f.hasFnAttribute(EMC_EMITTED_ATTRIBUTE))
+            return llvm::PreservedAnalyses::all();
+        return fpm.run(f, fam);
+    }
+};
+
+// the passes of the backend for -fincremental, at O1 and above. the
+// coroutines are lowered (like at O0, since the async functions aren't
+// optimized on their own), and then the functions are inlined into each
+// other, like in the pipeline of the module. but after the inlining,
+// only the functions that were emitted in this build are simplified
+// again, the ones from the cache are left as they are.
+llvm::ModulePassManager build_incremental_pipeline(llvm::PassBuilder &pb,
+                                                   llvm::OptimizationLevel opt_level) {
+    llvm::ModulePassManager mpm = pb.buildO0DefaultPipeline(llvm::OptimizationLevel::O0);
+
+    llvm::FunctionPassManager cleanup;
+    cleanup.addPass(llvm::EarlyCSEPass());
+    cleanup.addPass(llvm::InstCombinePass());
+    cleanup.addPass(llvm::SimplifyCFGPass());
+
+    llvm::ModuleInlinerWrapperPass inliner(
+        llvm::getInlineParams(opt_level.getSpeedupLevel(), opt_level.getSizeLevel()));
+    inliner.getPM().addPass(
+        llvm::createCGSCCToFunctionPassAdaptor(Emitted_Functions_Pass(std::move(cleanup))));
+    mpm.addPass(std::move(inliner));
+
+    // (the functions that are left without callers, once inlined)
+    mpm.addPass(llvm::GlobalDCEPass());
+    return mpm;
+}
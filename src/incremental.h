@@ -0,0 +1,95 @@
+//
+// incremental.h
+//
+
+/*
+
+Function level incremental compilation, for -fincremental.
+
+Rebuilding a file after an edit usually changes only a few of its
+functions, but all of them would be emitted and optimized again. So
+with -fincremental, the optimized IR of every function of a file is
+kept in a cache (in emc-cache/, in the current directory), and only
+the functions that changed are emitted and optimized again. the rest
+are taken from the cache, when the module of the file is put together.
+
+A function is known to be unchanged by its hash, which covers:
+
+    (1) the function itself (its signature, and the whole tree of
+    its body, down to the names and literals)
+
+    (2) whatever it refers to by name: the signatures of the
+    functions that it calls (the whole of a generic function, since
+    its instances are emitted from the callers), and the declarations
+    of the globals it uses (with their initializers, since a const
+    global is folded into the functions that use it)
+
+    (3) the flags that change the IR (the optimization level, the
+    target and -finstrument-functions), and the build of the compiler
+    (by the size and the time of its executable)
+
+The cache of a file is a pack (the bitcode of the module of the file,
+from the last build) and its index (the hash of each function in it):
+
+    emc-cache/<hash of the path>.bc
+    emc-cache/<hash of the path>.idx
+
+In a build, a function that has the same hash as in the index is only
+declared by the IR generator. once the rest has been emitted (and
+optimized), the bodies of those declarations are linked in from the
+pack, which is loaded lazily, so that only the functions that are
+needed are read. the module is then written out as the new pack.
+
+NOTE: the IR that is kept in the cache has every function optimized
+on its own (with the function passes of the optimization level), since
+the IR of a function that had others inlined into it (or was optimized
+with what is known about them) would be stale, once those change. the
+inlining between the functions is left to the backend, which runs only
+the inliner over the whole program (see build_incremental_pipeline).
+after inlining, only the functions that were emitted in this build are
+simplified again, so the ones from the cache aren't optimized again in
+every build.
+
+*/
+
+#pragma once
+
+#include "ast.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define EMC_CACHE_DIRECTORY "emc-cache"
+
+// the attribute of the functions that were emitted (and optimized) in
+// this build, rather than taken from the cache. (it isn't kept in the pack)
+#define EMC_EMITTED_ATTRIBUTE "emc-emitted"
+
+struct Flag_Settings;
+
+struct Cached_Function {
+    std::string name;
+    uint64_t hash;
+};
+
+// the cache of a file, for a build
+struct Function_Cache {
+    std::string pack_path;
+    std::string index_path;
+
+    std::vector<Cached_Function> functions; // (the hashes in this build)
+
+    // the functions that are the same as in the pack, so only their
+    // declarations are emitted (by their name, with their definition)
+    smap<AST_Function_Definition *> reused;
+    size_t num_reused = 0;  // (that were linked in from the pack, once it is closed)
+    size_t num_indexed = 0; // (the functions in the pack)
+};
+
+Function_Cache *open_function_cache(std::vector<AST_Expression *> *ast,
+                                    const std::string &file_name,
+                                    Flag_Settings *flag_settings);
+bool close_function_cache(Function_Cache *cache, LLVM_IR *ir,
+                          Flag_Settings *flag_settings);
+llvm::ModulePassManager build_incremental_pipeline(llvm::PassBuilder &pb,
+                                                   llvm::OptimizationLevel opt_level);
@@ -57,6 +57,11 @@ get_llvm_data_type:
     } else if (curr_type->type_kind == TK_ALIAS || curr_type->type_kind == TK_ENUM) {
 	curr_type = curr_type->base_type;
 	goto get_llvm_data_type;
+    } else if (curr_type->type_kind == TK_TYPE_PARAM) {
+	// (a type parameter only has a type while its function is being instantiated)
+	if (!curr_type->base_type) return nullptr;
+	curr_type = curr_type->base_type;
+	goto get_llvm_data_type;
     }
 
     // TODO: handle non-primitive types later
@@ -87,6 +92,18 @@ llvm::Value *AST_Identifier::generate_ir(LLVM_IR *ir) {
         throw_ir_error(E064);
     }
 
+    // a const variable with a constant initializer never
+    // changes, so we can use the initializer directly
+    // instead of loading it from memory.
+    if (sym_info->const_value)
+        return sym_info->const_value;
+
+    // plain reads of an atomic variable are sequentially consistent
+    if (sym_info->is_atomic)
+        return emit_atomic_load(ir, sym_info,
+                                llvm::AtomicOrdering::SequentiallyConsistent,
+                                name.c_str());
+
     return ir->_builder->CreateLoad(sym_info->type, sym_info->val,
                                     name.c_str());
 }
@@ -160,6 +177,26 @@ llvm::Value *AST_Literal::generate_ir(LLVM_IR *ir) {
 }
 
 llvm::Value *AST_Function_Definition::generate_ir(LLVM_IR *ir) {
+    // a generic function is only a template. nothing is emitted
+    // for it here, its instances are created by the calls to it.
+    // (the same goes for a function with a parameter pack)
+    if (!type_params.empty() || !pack_name.empty()) {
+        ir->generic_functions.insert(function_name, this);
+        return nullptr;
+    }
+
+    llvm::Function *_f = generate_ir_declaration(ir);
+
+    // if this is just a prototype, then we don't need to
+    // create a basic block. just declaring the function is
+    // all that's needed.
+    if (is_prototype)
+        return _f;
+
+    return generate_ir_body(ir, _f);
+}
+
+llvm::Function *AST_Function_Definition::generate_ir_declaration(LLVM_IR *ir) {
     // get the llvm return type
     llvm::Type *llvm_return_type = llvm_type_map(return_type, ir->_context);
 
@@ -178,24 +215,42 @@ llvm::Value *AST_Function_Definition::generate_ir(LLVM_IR *ir) {
     // handles those separately)
     llvm::FunctionType *f_type =
         llvm::FunctionType::get(llvm_return_type, llvm_param_types, has_variadic_args);
-    llvm::Function *_f = llvm::Function::Create(
+    return llvm::Function::Create(
         f_type, llvm::Function::ExternalLinkage, function_name, ir->_module);
+}
 
-    // if this is just a prototype, then we don't need to
-    // create a basic block. just declaring the function is
-    // all that's needed.
-    if (is_prototype)
-        return _f;
+llvm::Value *AST_Function_Definition::generate_ir_body(LLVM_IR *ir, llvm::Function *_f) {
+    llvm::Type *llvm_return_type = _f->getReturnType();
 
     // create the entry block
     llvm::BasicBlock *function_entry =
         llvm::BasicBlock::Create(ir->_context, "entry", _f);
     ir->_builder->SetInsertPoint(function_entry);
 
+    // an async function gets its coroutine frame before anything
+    // else, so that the parameters are copied into it.
+    if (is_async)
+        ir->current_coroutine = emit_coroutine_begin(ir, _f);
+
+    // (an async function is left out of the profile, since it can be
+    // suspended in the middle, and resumed later from somewhere else)
+    if (ir->instrument_functions && !is_async) {
+        ir->current_function_name =
+            ir->_builder->CreateGlobalStringPtr(_f->getName(), "profile.name");
+        emit_profile_call(ir, "__em_profile_enter");
+    }
+
     // set parameter names and allocate storage
-    int index = 0;
+    // (the arguments after the params are the ones in the parameter
+    // pack, which are only reachable through: for x in <pack> { ... })
+    size_t index = 0;
+    ir->current_pack.clear();
     for (auto &arg : _f->args()) {
-        std::string param_name = params[index++]->name;
+        bool is_in_pack = index >= params.size();
+        std::string param_name = is_in_pack
+            ? pack_name + "." + std::to_string(index - params.size())
+            : params[index]->name;
+        index++;
         arg.setName(param_name);
 
         // we need to create an alloca in the entry block, for this parameter.
@@ -212,8 +267,16 @@ llvm::Value *AST_Function_Definition::generate_ir(LLVM_IR *ir) {
         ir->_builder->CreateStore(&arg, _alloca);
 
         // store in the symbol table
-        auto *sym_info = new LLVM_Symbol_Info{_alloca, arg.getType()};
-        ir->llvm_symbol_table.insert(param_name, sym_info);
+        // (the types of the arguments in the pack come with the instance)
+        Data_Type *data_type = !is_in_pack
+            ? params[index - 1]->type
+            : (index - 1 - params.size() < ir->current_pack_types.size()
+               ? ir->current_pack_types[index - 1 - params.size()] : nullptr);
+        auto *sym_info = new_symbol_info(ir, _alloca, arg.getType(), data_type);
+        if (is_in_pack)
+            ir->current_pack.push_back(sym_info);
+        else
+            ir->llvm_symbol_table.insert(param_name, sym_info);
     }
 
 
@@ -247,12 +310,23 @@ llvm::Value *AST_Function_Definition::generate_ir(LLVM_IR *ir) {
     // if return type is void, add a return void instruction
     // (for other types, the return expression should be present
     // in the block itself).
-    if (!has_terminator_in_block) {
+    if (is_async) {
+        if (!has_terminator_in_block)
+            ir->_builder->CreateBr(ir->current_coroutine->cleanup);
+
+        emit_coroutine_end(ir, _f);
+        delete ir->current_coroutine;
+        ir->current_coroutine = nullptr;
+    } else if (!has_terminator_in_block) {
 	if (has_variadic_args) emit_va_end(ir);
 
-	if (llvm_return_type->isVoidTy()) ir->_builder->CreateRetVoid();
+	if (llvm_return_type->isVoidTy()) {
+	    emit_profile_call(ir, "__em_profile_exit");
+	    ir->_builder->CreateRetVoid();
+	}
 	else throw_ir_error(E066);
     }
+    ir->current_function_name = nullptr;
 
     // verify function
     if (llvm::verifyFunction(*_f, &llvm::errs())) {
@@ -281,10 +355,13 @@ llvm::Value *AST_If_Expression::generate_ir(LLVM_IR *ir) {
 
     llvm::BasicBlock *_then =
         llvm::BasicBlock::Create(ir->_context, "then", _f);
+    // (the blocks that are inserted into the function later
+    // on must not have a parent yet, or they end up in its
+    // list of blocks twice)
     llvm::BasicBlock *_else =
-        llvm::BasicBlock::Create(ir->_context, "else", _f);
+        llvm::BasicBlock::Create(ir->_context, "else");
     llvm::BasicBlock *_ifend =
-        llvm::BasicBlock::Create(ir->_context, "ifend", _f);
+        llvm::BasicBlock::Create(ir->_context, "ifend");
 
     // create conditional branch
     ir->_builder->CreateCondBr(_condition, _then, _else);
@@ -299,7 +376,7 @@ llvm::Value *AST_If_Expression::generate_ir(LLVM_IR *ir) {
     // emit instructions for _else block
     _else->insertInto(_f);
     ir->_builder->SetInsertPoint(_else);
-    has_terminator_in_block = generate_block_ir(ir, block);
+    has_terminator_in_block = generate_block_ir(ir, else_block);
     if (!has_terminator_in_block)
         ir->_builder->CreateBr(_ifend);
     _else = ir->_builder->GetInsertBlock();
@@ -328,6 +405,10 @@ llvm::Value *AST_Switch_Expression::generate_ir(LLVM_IR *ir) {
     if (ir->_builder->GetInsertBlock() == nullptr) {
         throw_ir_error(E101);
     }
+    // (the type of a type parameter is only checked here, once it is bound)
+    if (!_value->getType()->isIntegerTy()) {
+        throw_ir_error(E102);
+    }
 
     llvm::Function *_f = ir->_builder->GetInsertBlock()->getParent();
 
@@ -396,11 +477,11 @@ llvm::Value *AST_For_Expression::generate_ir(LLVM_IR *ir) {
     llvm::BasicBlock *_forcond =
         llvm::BasicBlock::Create(ir->_context, "forcond", f);
     llvm::BasicBlock *_forbody =
-        llvm::BasicBlock::Create(ir->_context, "forbody", f);
+        llvm::BasicBlock::Create(ir->_context, "forbody");
     llvm::BasicBlock *_forinc =
-        llvm::BasicBlock::Create(ir->_context, "forinc", f);
+        llvm::BasicBlock::Create(ir->_context, "forinc");
     llvm::BasicBlock *_forend =
-        llvm::BasicBlock::Create(ir->_context, "forend", f);
+        llvm::BasicBlock::Create(ir->_context, "forend");
 
     // jump to condition check
     ir->_builder->CreateBr(_forcond);
@@ -448,9 +529,424 @@ llvm::Value *AST_For_Expression::generate_ir(LLVM_IR *ir) {
     ir->_builder->SetInsertPoint(_forend);
 
     ir->loop_terminals.pop();
+    delete terminals;
+    return nullptr; // for statement doesn't return any value
+}
+
+llvm::Value *AST_Range_For_Expression::generate_ir(LLVM_IR *ir) {
+    /*
+    for i in begin..end step s { ... } is emitted as:
+
+            (bounds are evaluated once)
+            br (begin < end && s > 0), preheader, end
+        preheader:
+            trip_count = (end - begin - 1) / s + 1
+        body:
+            index = phi [0, preheader], [next, latch]
+            i = begin + index * s
+            ...
+        latch:
+            next = index + 1
+            br (next < trip_count), body, end
+
+    the loop is always entered from the preheader, it has a
+    single latch (continue jumps there too), and the trip count
+    is known before the first iteration. this is the form that the
+    loop passes want, and it never overflows, even when the end
+    is right at the maximum of the type.
+    */
+
+    if (ir->_builder->GetInsertBlock() == nullptr) {
+        throw_ir_error(E069);
+    }
+
+    llvm::Function *f = ir->_builder->GetInsertBlock()->getParent();
+
+    llvm::Value *_begin = begin->generate_ir(ir);
+    llvm::Value *_end = end->generate_ir(ir);
+    llvm::Value *_step = step ? step->generate_ir(ir) : nullptr;
+
+    if (!_begin->getType()->isIntegerTy() || !_end->getType()->isIntegerTy() ||
+        (_step && !_step->getType()->isIntegerTy())) {
+        throw_ir_error(E138);
+    }
+
+    // the induction variable takes the given type, or else the type of
+    // the bounds (as for the operands of an operator), which its type
+    // parameter is bound to while the loop is emitted
+    Data_Type *induction_data_type = induction_type;
+    Data_Type *previous_deduced_type = nullptr;
+    if (induction_type == NULL) {
+        induction_data_type = get_common_data_type(begin, end, ir);
+        if (induction_data_type == nullptr || !is_int_type(induction_data_type))
+            induction_data_type = get_data_type_from_llvm_type(
+                (_begin->getType()->getIntegerBitWidth() >= _end->getType()->getIntegerBitWidth())
+                ? _begin->getType() : _end->getType());
+        previous_deduced_type = deduced_type->base_type;
+        deduced_type->base_type = induction_data_type;
+    }
+    if (!is_int_type(induction_data_type)) {
+        throw_ir_error(E138);
+    }
+    llvm::Type *induction_llvm_type = llvm_type_map(induction_data_type, ir->_context);
+    bool is_signed = !is_unsigned_int_type(induction_data_type);
+
+    _begin = ir->_builder->CreateIntCast(_begin, induction_llvm_type, is_signed, "rforbegin");
+    _end = ir->_builder->CreateIntCast(_end, induction_llvm_type, is_signed, "rforend");
+    if (_step) {
+        _step = ir->_builder->CreateIntCast(_step, induction_llvm_type, is_signed, "rforstep");
+        auto *const_step = llvm::dyn_cast<llvm::ConstantInt>(_step);
+        if (const_step && (const_step->isZero() || (is_signed && const_step->isNegative()))) {
+            throw_ir_error(E139);
+        }
+    }
+
+    // the induction variable gets its own slot (which mem2reg
+    // turns back into a plain value)
+    llvm::IRBuilder<> tmp_builder(ir->_context);
+    llvm::BasicBlock &_entry = f->getEntryBlock();
+    tmp_builder.SetInsertPoint(&_entry, _entry.begin());
+    llvm::AllocaInst *_induction =
+        tmp_builder.CreateAlloca(induction_llvm_type, nullptr, induction_variable);
+
+    LLVM_Symbol_Info *outer_sym_info = ir->llvm_symbol_table[induction_variable];
+    auto *sym_info = new_symbol_info(ir, _induction, induction_llvm_type,
+                                     induction_type != NULL ? induction_type : deduced_type);
+    sym_info->is_induction_variable = true;
+    ir->llvm_symbol_table.insert(induction_variable, sym_info);
+
+    llvm::BasicBlock *_preheader =
+        llvm::BasicBlock::Create(ir->_context, "rforpreheader");
+    llvm::BasicBlock *_body =
+        llvm::BasicBlock::Create(ir->_context, "rforbody");
+    llvm::BasicBlock *_latch =
+        llvm::BasicBlock::Create(ir->_context, "rforlatch");
+    llvm::BasicBlock *_rforend =
+        llvm::BasicBlock::Create(ir->_context, "rforend");
+
+    llvm::Value *_has_iterations = is_signed
+        ? ir->_builder->CreateICmpSLT(_begin, _end, "rforguard")
+        : ir->_builder->CreateICmpULT(_begin, _end, "rforguard");
+
+    // a step that is only known at run time has to be positive as
+    // well, or else the loop has no iterations (instead of never ending)
+    if (_step && !llvm::isa<llvm::ConstantInt>(_step)) {
+        llvm::Value *zero = llvm::ConstantInt::get(induction_llvm_type, 0);
+        _has_iterations = ir->_builder->CreateAnd(
+            _has_iterations,
+            is_signed ? ir->_builder->CreateICmpSGT(_step, zero, "rforstepguard")
+                      : ir->_builder->CreateICmpNE(_step, zero, "rforstepguard"),
+            "rforguard");
+    }
+    ir->_builder->CreateCondBr(_has_iterations, _preheader, _rforend);
+
+    // preheader
+    _preheader->insertInto(f);
+    ir->_builder->SetInsertPoint(_preheader);
+
+    llvm::Value *_span = ir->_builder->CreateSub(_end, _begin, "rforspan");
+    llvm::Value *_trip_count = _span;
+    if (_step) {
+        llvm::Value *one = llvm::ConstantInt::get(induction_llvm_type, 1);
+        _trip_count = ir->_builder->CreateAdd(
+            ir->_builder->CreateUDiv(ir->_builder->CreateSub(_span, one), _step),
+            one, "rfortripcount");
+    }
+    ir->_builder->CreateBr(_body);
+
+    // body
+    _body->insertInto(f);
+    ir->_builder->SetInsertPoint(_body);
+
+    llvm::PHINode *_index = ir->_builder->CreatePHI(induction_llvm_type, 2, "rforindex");
+    _index->addIncoming(llvm::ConstantInt::get(induction_llvm_type, 0), _preheader);
+
+    llvm::Value *_offset = _step ? ir->_builder->CreateMul(_index, _step) : _index;
+    ir->_builder->CreateStore(ir->_builder->CreateAdd(_begin, _offset), _induction);
+
+    auto *terminals = new Loop_Terminals;
+    terminals->loop_condition = _latch; // continue moves to the next iteration
+    terminals->loop_end = _rforend;
+    ir->loop_terminals.push(terminals);
+
+    bool has_terminator_in_block = generate_block_ir(ir, block);
+    if (!has_terminator_in_block)
+        ir->_builder->CreateBr(_latch);
+
+    // latch
+    _latch->insertInto(f);
+    ir->_builder->SetInsertPoint(_latch);
+
+    llvm::Value *_next = ir->_builder->CreateAdd(
+        _index, llvm::ConstantInt::get(induction_llvm_type, 1), "rfornext",
+        /*HasNUW=*/true);
+    _index->addIncoming(_next, _latch);
+    ir->_builder->CreateCondBr(
+        ir->_builder->CreateICmpULT(_next, _trip_count, "rforcond"), _body, _rforend);
+
+    // for end
+    _rforend->insertInto(f);
+    ir->_builder->SetInsertPoint(_rforend);
+
+    ir->loop_terminals.pop();
+    delete terminals;
+
+    ir->llvm_symbol_table.insert(induction_variable, outer_sym_info);
+    if (induction_type == NULL)
+        deduced_type->base_type = previous_deduced_type;
     return nullptr; // for statement doesn't return any value
 }
 
+llvm::Value *AST_Pack_For_Expression::generate_ir(LLVM_IR *ir) {
+    /*
+    for x in args { ... } is unrolled over the arguments in the pack:
+
+            (x = args.0)
+            ...
+            br packnext
+        packnext:
+            (x = args.1)
+            ...
+            br packnext1
+        packnext1:
+            ...
+            br packend
+        packend:
+
+    every copy of the block sees x with the type of its own argument
+    (the type parameter of the element is bound to it while the copy
+    is emitted), and continue / break jump to the next copy / the end.
+    */
+
+    if (ir->_builder->GetInsertBlock() == nullptr) {
+        throw_ir_error(E069);
+    }
+
+    llvm::Function *f = ir->_builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock *_packend =
+        llvm::BasicBlock::Create(ir->_context, "packend");
+
+    LLVM_Symbol_Info *outer_sym_info = ir->llvm_symbol_table[element];
+    Data_Type *previous_element_type = element_type->base_type;
+
+    for (size_t i = 0; i < ir->current_pack.size(); i++) {
+        ir->llvm_symbol_table.insert(element, ir->current_pack[i]);
+        element_type->base_type = ir->current_pack_types[i];
+
+        llvm::BasicBlock *_next =
+            llvm::BasicBlock::Create(ir->_context, "packnext");
+
+        auto *terminals = new Loop_Terminals;
+        terminals->loop_condition = _next;
+        terminals->loop_end = _packend;
+        ir->loop_terminals.push(terminals);
+
+        bool has_terminator_in_block = generate_block_ir(ir, block);
+        if (!has_terminator_in_block)
+            ir->_builder->CreateBr(_next);
+
+        ir->loop_terminals.pop();
+        delete terminals;
+
+        _next->insertInto(f);
+        ir->_builder->SetInsertPoint(_next);
+    }
+
+    ir->_builder->CreateBr(_packend);
+    _packend->insertInto(f);
+    ir->_builder->SetInsertPoint(_packend);
+
+    ir->llvm_symbol_table.insert(element, outer_sym_info);
+    element_type->base_type = previous_element_type;
+    return nullptr;
+}
+
+llvm::Value *AST_Asm_Expression::generate_ir(LLVM_IR *ir) {
+    /*
+    this becomes a call to an llvm::InlineAsm. the operands are
+    laid out in the order that LLVM expects (and in which GCC
+    numbers them in the template):
+
+        (1) outputs. the ones in registers are returned by the call
+        (as a struct, if there are more than one), and the ones in
+        memory get the address of their variable as an argument.
+
+        (2) inputs
+
+        (3) the inputs that are implied by the in/out (+) outputs,
+        which are tied to their outputs.
+    */
+
+    llvm::Triple triple(ir->target_triple.empty() ? llvm::sys::getDefaultTargetTriple()
+                                                   : ir->target_triple);
+
+    std::vector<std::string> constraints;
+    std::vector<llvm::Value *> args;
+    std::vector<llvm::Type *> indirect_types; // (per argument. nullptr if passed by value)
+    std::vector<LLVM_Symbol_Info *> results;
+    std::vector<std::string> tied_constraints;
+    std::vector<llvm::Value *> tied_args;
+
+    // outputs
+    for (size_t i = 0; i < outputs.size(); i++) {
+        const std::string &constraint = outputs[i].constraint;
+        if (constraint.empty() || (constraint[0] != '=' && constraint[0] != '+')) {
+            throw_ir_error(E142);
+        }
+        bool is_early_clobber = constraint.size() > 1 && constraint[1] == '&';
+        std::string code = constraint.substr(is_early_clobber ? 2 : 1);
+        if (!is_valid_asm_constraint(triple, code, true, outputs.size())) {
+            throw_ir_error(E142);
+        }
+
+        AST_Expression *output = outputs[i].expr;
+        if (is_const_identifier(ir, output)) {
+            throw_ir_error(E116);
+        }
+        if (is_induction_variable_identifier(ir, output)) {
+            throw_ir_error(E137);
+        }
+        LLVM_Symbol_Info *sym_info = ir->llvm_symbol_table[((AST_Identifier *)output)->name];
+        if (sym_info == NULL) {
+            throw_ir_error(E064);
+        }
+
+        if (is_memory_only_asm_constraint(triple, code)) {
+            // (memory is read and written in place, so there is nothing to tie for a +)
+            constraints.push_back("=*" + code);
+            args.push_back(sym_info->val);
+            indirect_types.push_back(sym_info->type);
+            continue;
+        }
+
+        constraints.push_back((is_early_clobber ? "=&" : "=") + convert_asm_constraint(triple, code));
+        results.push_back(sym_info);
+
+        if (constraint[0] == '+') {
+            tied_constraints.push_back(std::to_string(i));
+            tied_args.push_back(ir->_builder->CreateLoad(sym_info->type, sym_info->val));
+        }
+    }
+
+    // inputs
+    for (Asm_Operand &input : inputs) {
+        const std::string &code = input.constraint;
+        if (!is_valid_asm_constraint(triple, code, false, outputs.size())) {
+            throw_ir_error(E142);
+        }
+
+        if (is_memory_only_asm_constraint(triple, code)) {
+            AST_Expression *expr = input.expr;
+            while (expr->expr_type == EXPR_BINARY && ((AST_Binary_Expression *)expr)->op == TOKEN_NONE &&
+                   ((AST_Binary_Expression *)expr)->right == NULL)
+                expr = ((AST_Binary_Expression *)expr)->left;
+            if (expr->expr_type != EXPR_IDENT) {
+                throw_ir_error(E142);
+            }
+            llvm::Value *addr = ((AST_Identifier *)expr)->generate_ir_pointer(ir);
+            constraints.push_back("*" + code);
+            args.push_back(addr);
+            indirect_types.push_back(ir->llvm_symbol_table[((AST_Identifier *)expr)->name]->type);
+            continue;
+        }
+
+        llvm::Value *val = input.expr->generate_ir(ir);
+        if (is_immediate_only_asm_constraint(code) && !llvm::isa<llvm::Constant>(val)) {
+            throw_ir_error(E145);
+        }
+
+        // an input that shares the register of an output takes its type
+        // (and is extended as its own type says)
+        if (isdigit((unsigned char)code[0]) && val->getType()->isIntegerTy()) {
+            llvm::Type *output_type = ir->llvm_symbol_table[
+                ((AST_Identifier *)outputs[std::stoi(code)].expr)->name]->type;
+            if (output_type->isIntegerTy())
+                val = ir->_builder->CreateIntCast(val, output_type,
+                                                  is_signed_int_value(val, input.expr, ir));
+        }
+
+        constraints.push_back(convert_asm_constraint(triple, code));
+        args.push_back(val);
+        indirect_types.push_back(nullptr);
+    }
+
+    for (size_t i = 0; i < tied_args.size(); i++) {
+        constraints.push_back(tied_constraints[i]);
+        args.push_back(tied_args[i]);
+        indirect_types.push_back(nullptr);
+    }
+
+    // clobbers
+    for (const std::string &clobber : clobbers) {
+        if (clobber == "memory") {
+            constraints.push_back("~{memory}");
+        } else if (clobber == "cc") {
+            // (the flags are always clobbered on x86, see below)
+            if (!triple.isX86())
+                constraints.push_back("~{cc}");
+        } else if (is_asm_register(triple, clobber)) {
+            constraints.push_back("~{" + clobber + "}");
+        } else {
+            throw_ir_error(E143);
+        }
+    }
+    if (triple.isX86()) {
+        constraints.push_back("~{dirflag}");
+        constraints.push_back("~{fpsr}");
+        constraints.push_back("~{flags}");
+    }
+
+    std::string constraint_string;
+    for (size_t i = 0; i < constraints.size(); i++) {
+        if (i > 0)
+            constraint_string += ",";
+        constraint_string += constraints[i];
+    }
+
+    // the outputs in registers are what the call returns
+    llvm::Type *return_type = llvm::Type::getVoidTy(ir->_context);
+    if (results.size() == 1) {
+        return_type = results[0]->type;
+    } else if (results.size() > 1) {
+        std::vector<llvm::Type *> result_types;
+        for (LLVM_Symbol_Info *result : results)
+            result_types.push_back(result->type);
+        return_type = llvm::StructType::get(ir->_context, result_types);
+    }
+
+    std::vector<llvm::Type *> arg_types;
+    for (llvm::Value *arg : args)
+        arg_types.push_back(arg->getType());
+
+    // like in GCC, without any outputs the assembly is only there for
+    // its side effects, so it must never be removed.
+    bool has_side_effects = is_volatile || results.empty();
+
+    size_t num_operands = outputs.size() + inputs.size();
+    bool has_operands = num_operands > 0 || !clobbers.empty();
+
+    llvm::FunctionType *asm_type = llvm::FunctionType::get(return_type, arg_types, false);
+    llvm::InlineAsm *inline_asm = llvm::InlineAsm::get(
+        asm_type, convert_asm_template(asm_template, num_operands, has_operands),
+        constraint_string, has_side_effects);
+
+    llvm::CallInst *call = ir->_builder->CreateCall(asm_type, inline_asm, args);
+    for (size_t i = 0; i < indirect_types.size(); i++) {
+        if (indirect_types[i])
+            call->addParamAttr(i, llvm::Attribute::get(ir->_context, llvm::Attribute::ElementType,
+                                                       indirect_types[i]));
+    }
+
+    // store the outputs back into their variables
+    if (results.size() == 1) {
+        ir->_builder->CreateStore(call, results[0]->val);
+    } else {
+        for (size_t i = 0; i < results.size(); i++)
+            ir->_builder->CreateStore(ir->_builder->CreateExtractValue(call, i), results[i]->val);
+    }
+    return nullptr; // asm doesn't return any value (the outputs are stored)
+}
+
 llvm::Value *AST_While_Expression::generate_ir(LLVM_IR *ir) {
     // here we will need labels for the
     // while condition, while body,
@@ -466,9 +962,9 @@ llvm::Value *AST_While_Expression::generate_ir(LLVM_IR *ir) {
     llvm::BasicBlock *_whilecond =
         llvm::BasicBlock::Create(ir->_context, "whilecond", f);
     llvm::BasicBlock *_body =
-        llvm::BasicBlock::Create(ir->_context, "whilebody", f);
+        llvm::BasicBlock::Create(ir->_context, "whilebody");
     llvm::BasicBlock *_whileend =
-        llvm::BasicBlock::Create(ir->_context, "whileend", f);
+        llvm::BasicBlock::Create(ir->_context, "whileend");
 
     // jump to condition block first
     ir->_builder->CreateBr(_whilecond);
@@ -507,9 +1003,247 @@ llvm::Value *AST_While_Expression::generate_ir(LLVM_IR *ir) {
     ir->_builder->SetInsertPoint(_whileend);
 
     ir->loop_terminals.pop();
+    delete terminals;
     return nullptr; // while statement returns no value
 }
 
+llvm::Value *AST_Parallel_For_Expression::generate_ir(LLVM_IR *ir) {
+    // a parallel for is lowered in two parts:
+    //
+    //   1. the body is outlined into an internal function
+    //        void <parent>.parallel_body(i64 begin, i64 end, i8* ctx)
+    //      which runs the iterations numbered [begin, end), the n-th
+    //      one with the induction variable at first + n. the ctx holds
+    //      pointers to the captured variables of the parent (and, after
+    //      those, to the first value).
+    //
+    //   2. at the loop itself, we fill in the ctx and hand the
+    //      whole range over to the runtime (lib/parallel.bc):
+    //        __em_parallel_for(0, count, grain, body, ctx)
+    //      which splits it across the worker threads, and only
+    //      returns once all the iterations are done.
+    //
+    // (the number of iterations is worked out in the parent, by the
+    // signedness of the induction variable. so an unsigned bound above
+    // the largest s64, or an inclusive end at the largest value of the
+    // type, don't wrap around the i64 range of the runtime)
+
+    if (ir->_builder->GetInsertBlock() == nullptr) {
+        throw_ir_error(E069);
+    }
+
+    llvm::Function *f = ir->_builder->GetInsertBlock()->getParent();
+    llvm::Type *i64_ty = llvm::Type::getInt64Ty(ir->_context);
+    llvm::Type *i8_ptr_ty = llvm::Type::getInt8Ty(ir->_context)->getPointerTo();
+
+    // the type of the induction variable
+    llvm::Type *induction_llvm_type = nullptr;
+    Data_Type *induction_data_type = induction_type;
+    if (induction_type != NULL) {
+        induction_llvm_type = llvm_type_map(induction_type, ir->_context);
+    } else {
+        LLVM_Symbol_Info *sym_info = ir->llvm_symbol_table[induction_variable];
+        if (sym_info == NULL) {
+            throw_ir_error(E064);
+        }
+        induction_llvm_type = sym_info->type;
+        induction_data_type = sym_info->data_type;
+    }
+    if (!induction_llvm_type->isIntegerTy()) {
+        throw_ir_error(E120);
+    }
+
+    // evaluate the range (in the parent)
+    llvm::Value *_begin = begin->generate_ir(ir);
+    llvm::Value *_end = end->generate_ir(ir);
+    if (!_begin || !_end || !_begin->getType()->isIntegerTy() ||
+        !_end->getType()->isIntegerTy()) {
+        throw_ir_error(E120);
+    }
+    bool is_signed = !is_unsigned_int_type(induction_data_type);
+    _begin = ir->_builder->CreateIntCast(_begin, i64_ty, is_signed, "pforbegin");
+    _end = ir->_builder->CreateIntCast(_end, i64_ty, is_signed, "pforend");
+
+    // the number of iterations, as an unsigned i64: end - begin (+ 1).
+    // (it only doesn't fit in the s64 that the runtime takes when there
+    // are more than 2^63 iterations, which then is saturated)
+    llvm::Value *in_range = is_inclusive
+        ? (is_signed ? ir->_builder->CreateICmpSLE(_begin, _end)
+                     : ir->_builder->CreateICmpULE(_begin, _end))
+        : (is_signed ? ir->_builder->CreateICmpSLT(_begin, _end)
+                     : ir->_builder->CreateICmpULT(_begin, _end));
+    llvm::Value *max_count = llvm::ConstantInt::get(i64_ty, INT64_MAX);
+    llvm::Value *span = ir->_builder->CreateSub(_end, _begin, "pforspan");
+    llvm::Value *_count = is_inclusive
+        ? ir->_builder->CreateSelect(ir->_builder->CreateICmpUGE(span, max_count), max_count,
+                                     ir->_builder->CreateAdd(span, llvm::ConstantInt::get(i64_ty, 1)))
+        : ir->_builder->CreateSelect(ir->_builder->CreateICmpUGT(span, max_count), max_count, span);
+    _count = ir->_builder->CreateSelect(in_range, _count, llvm::ConstantInt::get(i64_ty, 0),
+                                        "pforcount");
+
+    // build the ctx: an array of pointers to the captured variables
+    std::vector<LLVM_Symbol_Info *> captured_info;
+    for (const std::string &name : captures) {
+        LLVM_Symbol_Info *sym_info = ir->llvm_symbol_table[name];
+        if (sym_info == NULL) {
+            throw_ir_error(E064);
+        }
+        captured_info.push_back(sym_info);
+    }
+
+    llvm::ArrayType *ctx_type = llvm::ArrayType::get(i8_ptr_ty, captures.size() + 1);
+    llvm::IRBuilder<> tmp_builder(ir->_context);
+    llvm::BasicBlock &_entry = f->getEntryBlock();
+    tmp_builder.SetInsertPoint(&_entry, _entry.begin());
+    llvm::AllocaInst *_ctx = tmp_builder.CreateAlloca(ctx_type, nullptr, "pforctx");
+    llvm::AllocaInst *_first = tmp_builder.CreateAlloca(i64_ty, nullptr, "pforfirst");
+
+    for (size_t i = 0; i < captured_info.size(); i++) {
+        llvm::Value *slot = ir->_builder->CreateConstInBoundsGEP2_32(ctx_type, _ctx, 0, i);
+        ir->_builder->CreateStore(
+            ir->_builder->CreateBitCast(captured_info[i]->val, i8_ptr_ty), slot);
+    }
+    ir->_builder->CreateStore(_begin, _first);
+    ir->_builder->CreateStore(
+        ir->_builder->CreateBitCast(_first, i8_ptr_ty),
+        ir->_builder->CreateConstInBoundsGEP2_32(ctx_type, _ctx, 0, captures.size()));
+
+    // create the outlined body
+    llvm::FunctionType *body_type =
+        llvm::FunctionType::get(llvm::Type::getVoidTy(ir->_context),
+                                {i64_ty, i64_ty, i8_ptr_ty}, false);
+    llvm::Function *body_f = llvm::Function::Create(
+        body_type, llvm::Function::InternalLinkage,
+        f->getName() + ".parallel_body", ir->_module);
+
+    llvm::Argument *arg_begin = body_f->getArg(0);
+    llvm::Argument *arg_end = body_f->getArg(1);
+    llvm::Argument *arg_ctx = body_f->getArg(2);
+    arg_begin->setName("begin");
+    arg_end->setName("end");
+    arg_ctx->setName("ctx");
+
+    // the body is emitted with the same IR state, so save the parts of
+    // it that belong to the parent (the symbol table is flat, so the
+    // entries that get rebound inside the body are restored after).
+    llvm::IRBuilderBase::InsertPoint parent_insert_point = ir->_builder->saveIP();
+    llvm::Value *parent_va_list = ir->current_va_list;
+    llvm::BasicBlock *parent_switch_end = ir->current_switch_end;
+    Coroutine_Info *parent_coroutine = ir->current_coroutine;
+    ir->current_va_list = nullptr;
+    ir->current_switch_end = nullptr;
+    ir->current_coroutine = nullptr;
+
+    std::vector<std::pair<std::string, LLVM_Symbol_Info *>> rebound;
+    rebound.push_back({induction_variable, ir->llvm_symbol_table[induction_variable]});
+    for (size_t i = 0; i < captures.size(); i++)
+        rebound.push_back({captures[i], captured_info[i]});
+
+    llvm::BasicBlock *body_entry =
+        llvm::BasicBlock::Create(ir->_context, "entry", body_f);
+    llvm::BasicBlock *_pforcond =
+        llvm::BasicBlock::Create(ir->_context, "pforcond", body_f);
+    llvm::BasicBlock *_pforbody =
+        llvm::BasicBlock::Create(ir->_context, "pforbody", body_f);
+    llvm::BasicBlock *_pforinc =
+        llvm::BasicBlock::Create(ir->_context, "pforinc", body_f);
+    llvm::BasicBlock *_pforend =
+        llvm::BasicBlock::Create(ir->_context, "pforend", body_f);
+
+    ir->_builder->SetInsertPoint(body_entry);
+
+    // every chunk gets its own copy of the induction variable
+    llvm::AllocaInst *_index = ir->_builder->CreateAlloca(i64_ty, nullptr, "pforindex");
+    llvm::AllocaInst *_induction =
+        ir->_builder->CreateAlloca(induction_llvm_type, nullptr, induction_variable);
+    ir->llvm_symbol_table.insert(
+        induction_variable,
+        new_symbol_info(ir, _induction, induction_llvm_type, induction_data_type));
+
+    // and the captures are reached through the ctx
+    llvm::Value *ctx_array = ir->_builder->CreateBitCast(arg_ctx, ctx_type->getPointerTo());
+    for (size_t i = 0; i < captures.size(); i++) {
+        llvm::Value *slot = ir->_builder->CreateConstInBoundsGEP2_32(ctx_type, ctx_array, 0, i);
+        llvm::Value *ptr = ir->_builder->CreateLoad(i8_ptr_ty, slot);
+        ptr = ir->_builder->CreateBitCast(
+            ptr, captured_info[i]->type->getPointerTo(), captures[i]);
+
+        auto *sym_info =
+            new_symbol_info(ir, ptr, captured_info[i]->type, captured_info[i]->data_type);
+        sym_info->is_const = captured_info[i]->is_const;
+        sym_info->const_value = captured_info[i]->const_value;
+        sym_info->is_atomic = captured_info[i]->is_atomic;
+        ir->llvm_symbol_table.insert(captures[i], sym_info);
+    }
+    llvm::Value *first_slot =
+        ir->_builder->CreateConstInBoundsGEP2_32(ctx_type, ctx_array, 0, captures.size());
+    llvm::Value *first = ir->_builder->CreateLoad(
+        i64_ty, ir->_builder->CreateBitCast(ir->_builder->CreateLoad(i8_ptr_ty, first_slot),
+                                            i64_ty->getPointerTo()),
+        "pforfirst");
+
+    ir->_builder->CreateStore(arg_begin, _index);
+    ir->_builder->CreateBr(_pforcond);
+
+    ir->_builder->SetInsertPoint(_pforcond);
+    llvm::Value *index = ir->_builder->CreateLoad(i64_ty, _index);
+    ir->_builder->CreateCondBr(ir->_builder->CreateICmpSLT(index, arg_end, "pforcond"),
+                               _pforbody, _pforend);
+
+    auto *terminals = new Loop_Terminals;
+    terminals->loop_condition = _pforinc; // continue moves to the next iteration
+    terminals->loop_end = _pforend;
+    ir->loop_terminals.push(terminals);
+
+    ir->_builder->SetInsertPoint(_pforbody);
+    ir->_builder->CreateStore(
+        ir->_builder->CreateIntCast(ir->_builder->CreateAdd(first, index), induction_llvm_type,
+                                    is_signed),
+        _induction);
+
+    bool has_terminator_in_block = generate_block_ir(ir, block);
+    if (!has_terminator_in_block)
+        ir->_builder->CreateBr(_pforinc);
+
+    ir->_builder->SetInsertPoint(_pforinc);
+    index = ir->_builder->CreateLoad(i64_ty, _index);
+    ir->_builder->CreateStore(
+        ir->_builder->CreateAdd(index, llvm::ConstantInt::get(i64_ty, 1), "pforinc"),
+        _index);
+    ir->_builder->CreateBr(_pforcond);
+
+    ir->_builder->SetInsertPoint(_pforend);
+    ir->_builder->CreateRetVoid();
+
+    ir->loop_terminals.pop();
+    delete terminals;
+
+    // back to the parent
+    for (auto &entry : rebound) {
+        ir->llvm_symbol_table.insert(entry.first, entry.second);
+    }
+    ir->current_va_list = parent_va_list;
+    ir->current_switch_end = parent_switch_end;
+    ir->current_coroutine = parent_coroutine;
+    ir->_builder->restoreIP(parent_insert_point);
+
+    // hand the iterations over to the runtime
+    // (a grain of 0 lets the runtime pick one)
+    llvm::FunctionCallee parallel_for = ir->_module->getOrInsertFunction(
+        "__em_parallel_for",
+        llvm::FunctionType::get(llvm::Type::getVoidTy(ir->_context),
+                                {i64_ty, i64_ty, i64_ty,
+                                 body_type->getPointerTo(), i8_ptr_ty},
+                                false));
+
+    ir->_builder->CreateCall(
+        parallel_for,
+        {llvm::ConstantInt::get(i64_ty, 0), _count, llvm::ConstantInt::get(i64_ty, 0), body_f,
+         ir->_builder->CreateBitCast(_ctx, i8_ptr_ty)});
+
+    return nullptr; // parallel for statement doesn't return any value
+}
+
 llvm::Value *AST_Declaration::generate_ir(LLVM_IR *ir) {
     if (ir->_builder->GetInsertBlock() == nullptr) {
         throw_ir_error(E071);
@@ -527,7 +1261,9 @@ llvm::Value *AST_Declaration::generate_ir(LLVM_IR *ir) {
         tmp_builder.CreateAlloca(var_type, nullptr, variable_name);
 
     // store it in the symbol table
-    auto *sym_info = new LLVM_Symbol_Info{_alloca, var_type};
+    auto *sym_info = new_symbol_info(ir, _alloca, var_type, data_type);
+    sym_info->is_const = is_const;
+    sym_info->is_atomic = is_atomic;
     ir->llvm_symbol_table.insert(variable_name, sym_info);
     return _alloca;
 }
@@ -557,6 +1293,28 @@ llvm::Value *AST_Unary_Expression::generate_ir(LLVM_IR *ir) {
             throw_ir_error(
                 E072);
         }
+        if (is_const_identifier(ir, expr)) {
+            throw_ir_error(E116);
+        }
+        if (is_induction_variable_identifier(ir, expr)) {
+            throw_ir_error(E137);
+        }
+
+        // on an atomic variable, this is a single atomicrmw
+        if (is_atomic_identifier(ir, expr)) {
+            LLVM_Symbol_Info *sym_info =
+                ir->llvm_symbol_table[((AST_Identifier *)expr)->name];
+            llvm::Value *one = llvm::ConstantInt::get(sym_info->type, 1);
+            llvm::Value *old_val = ir->_builder->CreateAtomicRMW(
+                op == TOKEN_INCREMENT ? llvm::AtomicRMWInst::Add : llvm::AtomicRMWInst::Sub,
+                sym_info->val, one, get_atomic_alignment(sym_info->type),
+                llvm::AtomicOrdering::SequentiallyConsistent);
+            if (is_postfix)
+                return old_val;
+            return (op == TOKEN_INCREMENT)
+                ? ir->_builder->CreateAdd(old_val, one, "incdec")
+                : ir->_builder->CreateSub(old_val, one, "incdec");
+        }
 
         llvm::Value *val_addr =
             ((AST_Identifier *)expr)->generate_ir_pointer(ir);
@@ -598,6 +1356,13 @@ llvm::Value *AST_Binary_Expression::generate_ir(LLVM_IR *ir) {
     if (op == TOKEN_OR)
         return generate_ir__logical_or(left, right, ir);
 
+    if (is_assignment_op(op) && is_const_identifier(ir, left)) {
+        throw_ir_error(E116);
+    }
+    if (is_assignment_op(op) && is_induction_variable_identifier(ir, left)) {
+        throw_ir_error(E137);
+    }
+
     llvm::Value *L = nullptr, *Rval = nullptr;
     if (left) {
         // turns out this is not as simple as it looks.
@@ -631,18 +1396,30 @@ llvm::Value *AST_Binary_Expression::generate_ir(LLVM_IR *ir) {
     etc.)
     */
 
+    if (is_assignment_op(op) && is_atomic_identifier(ir, left))
+        return generate_ir__atomic_assignment(ir, op, (AST_Identifier *)left, right, Rval);
+
     if (op == TOKEN_ASSIGN) {
         if (Rval && Rval->getType()->isPointerTy())
             Rval = ir->_builder->CreateLoad(
                 llvm::dyn_cast<llvm::PointerType>(Rval->getType()), Rval);
 
         ir->_builder->CreateStore(Rval, L); // here L must be an address
+
+        // for a const declaration initialized with a scalar
+        // constant, remember the constant so that the reads
+        // of this variable can be folded.
+        if (left->expr_type == EXPR_DECL && ((AST_Declaration *)left)->is_const)
+            set_const_value(ir, ((AST_Declaration *)left)->variable_name, Rval);
         return Rval;
     }
 
     // for compound assignments
 
-    llvm::Value *Lval = left->generate_ir(ir);
+    // (only an identifier needs to be loaded here. anything else
+    // was already generated above, and generating it again would
+    // repeat its side effects, like calls or awaits)
+    llvm::Value *Lval = (left->expr_type == EXPR_IDENT) ? left->generate_ir(ir) : L;
 
     if (Lval && Lval->getType()->isPointerTy())
         Lval = ir->_builder->CreateLoad(
@@ -703,6 +1480,41 @@ llvm::Value *AST_Binary_Expression::generate_ir(LLVM_IR *ir) {
     // For other logical / bitwise operations
     // In this case, both sides should be values
 
+    // (floating point values have their own instructions)
+    if (Lval && Lval->getType()->isFloatingPointTy()) {
+        switch (op) {
+        case TOKEN_PLUS:
+            return ir->_builder->CreateFAdd(Lval, Rval, "addtmp");
+        case TOKEN_MINUS:
+            return ir->_builder->CreateFSub(Lval, Rval, "subtmp");
+        case TOKEN_STAR:
+            return ir->_builder->CreateFMul(Lval, Rval, "multmp");
+        case TOKEN_DIVIDE:
+            return ir->_builder->CreateFDiv(Lval, Rval, "divtmp");
+        case TOKEN_MOD:
+            return ir->_builder->CreateFRem(Lval, Rval, "modtmp");
+        case TOKEN_LESS:
+            return ir->_builder->CreateFCmpOLT(Lval, Rval, "cmptmp");
+        case TOKEN_GREATER:
+            return ir->_builder->CreateFCmpOGT(Lval, Rval, "cmptmp");
+        case TOKEN_LESSEQ:
+            return ir->_builder->CreateFCmpOLE(Lval, Rval, "cmptmp");
+        case TOKEN_GREATEREQ:
+            return ir->_builder->CreateFCmpOGE(Lval, Rval, "cmptmp");
+        case TOKEN_EQUAL:
+            return ir->_builder->CreateFCmpOEQ(Lval, Rval, "cmptmp");
+        case TOKEN_NOTEQ:
+            return ir->_builder->CreateFCmpUNE(Lval, Rval, "cmptmp");
+        default:
+            break;
+        }
+        return nullptr;
+    }
+
+    // (division, remainder, right shifts and orderings
+    // depend on whether the operands are unsigned)
+    bool is_unsigned = is_unsigned_int_type(get_operand_data_type(this, ir));
+
     switch (op) {
     case TOKEN_PLUS:
         return ir->_builder->CreateAdd(Lval, Rval, "addtmp");
@@ -711,17 +1523,23 @@ llvm::Value *AST_Binary_Expression::generate_ir(LLVM_IR *ir) {
     case TOKEN_STAR:
         return ir->_builder->CreateMul(Lval, Rval, "multmp");
     case TOKEN_DIVIDE:
-        return ir->_builder->CreateSDiv(Lval, Rval, "divtmp");
+        return is_unsigned ? ir->_builder->CreateUDiv(Lval, Rval, "divtmp")
+                           : ir->_builder->CreateSDiv(Lval, Rval, "divtmp");
     case TOKEN_MOD:
-        return ir->_builder->CreateSRem(Lval, Rval, "modtmp");
+        return is_unsigned ? ir->_builder->CreateURem(Lval, Rval, "modtmp")
+                           : ir->_builder->CreateSRem(Lval, Rval, "modtmp");
     case TOKEN_LESS:
-        return ir->_builder->CreateICmpSLT(Lval, Rval, "cmptmp");
+        return is_unsigned ? ir->_builder->CreateICmpULT(Lval, Rval, "cmptmp")
+                           : ir->_builder->CreateICmpSLT(Lval, Rval, "cmptmp");
     case TOKEN_GREATER:
-        return ir->_builder->CreateICmpSGT(Lval, Rval, "cmptmp");
+        return is_unsigned ? ir->_builder->CreateICmpUGT(Lval, Rval, "cmptmp")
+                           : ir->_builder->CreateICmpSGT(Lval, Rval, "cmptmp");
     case TOKEN_LESSEQ:
-        return ir->_builder->CreateICmpSLE(Lval, Rval, "cmptmp");
+        return is_unsigned ? ir->_builder->CreateICmpULE(Lval, Rval, "cmptmp")
+                           : ir->_builder->CreateICmpSLE(Lval, Rval, "cmptmp");
     case TOKEN_GREATEREQ:
-        return ir->_builder->CreateICmpSGE(Lval, Rval, "cmptmp");
+        return is_unsigned ? ir->_builder->CreateICmpUGE(Lval, Rval, "cmptmp")
+                           : ir->_builder->CreateICmpSGE(Lval, Rval, "cmptmp");
     case TOKEN_EQUAL:
         return ir->_builder->CreateICmpEQ(Lval, Rval, "cmptmp");
     case TOKEN_NOTEQ:
@@ -729,7 +1547,8 @@ llvm::Value *AST_Binary_Expression::generate_ir(LLVM_IR *ir) {
     case TOKEN_LSHIFT:
         return ir->_builder->CreateShl(Lval, Rval, "lshtmp");
     case TOKEN_RSHIFT:
-        return ir->_builder->CreateAShr(Lval, Rval, "rshtmp");
+        return is_unsigned ? ir->_builder->CreateLShr(Lval, Rval, "rshtmp")
+                           : ir->_builder->CreateAShr(Lval, Rval, "rshtmp");
     case TOKEN_BIT_OR:
         return ir->_builder->CreateOr(Lval, Rval, "ortmp");
     case TOKEN_XOR:
@@ -743,17 +1562,309 @@ llvm::Value *AST_Binary_Expression::generate_ir(LLVM_IR *ir) {
     return nullptr;
 }
 
+// the Em type for an llvm type, for a value whose Em type is not
+// known (see get_expression_data_type). integers are taken as signed.
+Data_Type *get_data_type_from_llvm_type(llvm::Type *type) {
+    static Data_Type types[] = {
+        {TK_PRIMITIVE, nullptr, T_BOOL}, {TK_PRIMITIVE, nullptr, T_S8},
+        {TK_PRIMITIVE, nullptr, T_S16},  {TK_PRIMITIVE, nullptr, T_S32},
+        {TK_PRIMITIVE, nullptr, T_S64},  {TK_PRIMITIVE, nullptr, T_F32},
+        {TK_PRIMITIVE, nullptr, T_F64},  {TK_PRIMITIVE, nullptr, T_STRING}
+    };
+
+    if (type->isIntegerTy(1)) return &types[0];
+    if (type->isIntegerTy(8)) return &types[1];
+    if (type->isIntegerTy(16)) return &types[2];
+    if (type->isIntegerTy(32)) return &types[3];
+    if (type->isIntegerTy(64)) return &types[4];
+    if (type->isFloatTy()) return &types[5];
+    if (type->isDoubleTy()) return &types[6];
+    if (type->isPointerTy()) return &types[7];
+    return nullptr;
+}
+
+// the Em type of an expression (as a primitive type), as far as it is
+// known here: the type of a variable, a literal, or what a function
+// returns, and for an operator, the type of its operands. NULL if it
+// is not known (like for a comparison, which is just an i1).
+Data_Type *get_expression_data_type(AST_Expression *expr, LLVM_IR *ir) {
+    expr = unwrap_ast_expression(expr);
+    switch (expr->expr_type) {
+    case EXPR_IDENT: {
+        LLVM_Symbol_Info *sym_info = ir->llvm_symbol_table[((AST_Identifier *)expr)->name];
+        return sym_info ? get_primitive_type(sym_info->data_type) : nullptr;
+    }
+    case EXPR_LITERAL:
+        return get_primitive_type(((AST_Literal *)expr)->type);
+    case EXPR_FUNC_CALL: {
+        AST_Function_Definition *function = ir->functions[((AST_Function_Call *)expr)->function_name];
+        return function ? get_primitive_type(function->return_type) : nullptr;
+    }
+    case EXPR_AWAIT:
+        return get_expression_data_type(((AST_Await_Expression *)expr)->call, ir);
+    case EXPR_VARG:
+        return get_primitive_type(((AST_Varg *)expr)->data_type);
+    case EXPR_UNARY: {
+        auto *unary = (AST_Unary_Expression *)expr;
+        return (unary->op == TOKEN_NOT) ? nullptr : get_expression_data_type(unary->expr, ir);
+    }
+    case EXPR_BINARY: {
+        auto *binary = (AST_Binary_Expression *)expr;
+        if (!binary->left || !binary->right)
+            return nullptr;
+        if (is_assignment_op(binary->op))
+            return get_expression_data_type(binary->left, ir);
+        switch (binary->op) {
+        case TOKEN_LESS: case TOKEN_GREATER: case TOKEN_LESSEQ: case TOKEN_GREATEREQ:
+        case TOKEN_EQUAL: case TOKEN_NOTEQ: case TOKEN_AND: case TOKEN_OR:
+            return nullptr;
+        case TOKEN_LSHIFT: case TOKEN_RSHIFT:
+            return get_expression_data_type(binary->left, ir);
+        default:
+            break;
+        }
+
+        return get_operand_data_type(binary, ir);
+    }
+    default:
+        return nullptr;
+    }
+}
+
+// the Em type that the operands of a binary operator are taken as.
+Data_Type *get_operand_data_type(AST_Binary_Expression *binary, LLVM_IR *ir) {
+    return get_common_data_type(binary->left, binary->right, ir);
+}
+
+// the Em type that two expressions are taken as together (like the
+// operands of an operator, or the bounds of a range). a literal takes
+// the type of the other one, otherwise the larger type wins, or the
+// unsigned one of the same size.
+Data_Type *get_common_data_type(AST_Expression *left_expr, AST_Expression *right_expr,
+                                LLVM_IR *ir) {
+    Data_Type *left = get_expression_data_type(left_expr, ir);
+    Data_Type *right = get_expression_data_type(right_expr, ir);
+    if (!left || !right)
+        return nullptr;
+    if (unwrap_ast_expression(right_expr)->expr_type == EXPR_LITERAL)
+        return left;
+    if (unwrap_ast_expression(left_expr)->expr_type == EXPR_LITERAL)
+        return right;
+
+    llvm::Type *left_type = llvm_type_map(left, ir->_context);
+    llvm::Type *right_type = llvm_type_map(right, ir->_context);
+    if (left_type->getPrimitiveSizeInBits() != right_type->getPrimitiveSizeInBits())
+        return left_type->getPrimitiveSizeInBits() > right_type->getPrimitiveSizeInBits()
+            ? left : right;
+    return is_unsigned_int_type(right) ? right : left;
+}
+
+// binds the type parameters of a generic function to the type arguments,
+// and returns what they were bound to before (since an instance can be
+// created while another instance of the same function is being emitted)
+std::vector<Data_Type *> bind_type_params(AST_Function_Definition *function,
+                                          const std::vector<Data_Type *> &type_args) {
+    std::vector<Data_Type *> previous;
+    for (size_t i = 0; i < function->type_params.size(); i++) {
+        previous.push_back(function->type_params[i]->base_type);
+        function->type_params[i]->base_type = type_args[i];
+    }
+    return previous;
+}
+
+// the Em type of the i-th argument of a call (from the llvm type
+// of the argument, if the Em type is not known, or doesn't match)
+Data_Type *get_argument_data_type(AST_Function_Call *call, size_t i,
+                                  std::vector<llvm::Value *> &args, LLVM_IR *ir) {
+    Data_Type *arg_data_type = get_expression_data_type(call->params[i], ir);
+    if (arg_data_type == nullptr ||
+        llvm_type_map(arg_data_type, ir->_context) != args[i]->getType())
+        arg_data_type = get_data_type_from_llvm_type(args[i]->getType());
+    return arg_data_type;
+}
+
+// tells whether an integer (the value of expr) is extended with its sign,
+// by its Em type. (a bool, or an unsigned integer, is filled with zeros)
+bool is_signed_int_value(llvm::Value *val, AST_Expression *expr, LLVM_IR *ir) {
+    Data_Type *data_type = get_expression_data_type(expr, ir);
+    if (data_type == nullptr || llvm_type_map(data_type, ir->_context) != val->getType())
+        data_type = get_data_type_from_llvm_type(val->getType());
+    return !val->getType()->isIntegerTy(1) && !is_unsigned_int_type(data_type);
+}
+
+// converts an integer (the value of expr) to another integer type, like
+// it is done for an argument. it is extended as its own type says (a bool
+// or an unsigned integer with zeros), and is never narrowed, unless it is
+// a constant whose value fits in the type.
+llvm::Value *convert_int_value(llvm::Value *val, AST_Expression *expr,
+                               llvm::Type *type, LLVM_IR *ir) {
+    if (val->getType() == type)
+        return val;
+
+    unsigned bits = type->getIntegerBitWidth();
+    if (val->getType()->getIntegerBitWidth() > bits) {
+        auto *constant = llvm::dyn_cast<llvm::ConstantInt>(val);
+        if (!constant || !(constant->getValue().isSignedIntN(bits) ||
+                           constant->getValue().isIntN(bits))) {
+            throw_ir_error(E151);
+        }
+    }
+
+    return ir->_builder->CreateIntCast(val, type, is_signed_int_value(val, expr, ir), "intcast");
+}
+
+// finds the type arguments for a call to a generic function. either they
+// are given explicitly, or they are deduced from the Em types of the
+// arguments. for an integer or float type parameter that gets different
+// sizes, the largest one is used (and for integers of the same size, the
+// unsigned one, unless it comes from a literal, which takes the type of
+// the other arguments instead).
+std::vector<Data_Type *> get_generic_type_args(AST_Function_Definition *function,
+                                               AST_Function_Call *call,
+                                               std::vector<llvm::Value *> &args,
+                                               LLVM_IR *ir) {
+    std::vector<Data_Type *> type_args;
+
+    // (explicit type arguments may refer to the type
+    // parameters of the instance that is being emitted)
+    if (!call->type_args.empty()) {
+        for (Data_Type *type_arg : call->type_args)
+            type_args.push_back(resolve_type_parameter(type_arg));
+        return type_args;
+    }
+
+    type_args.resize(function->type_params.size(), nullptr);
+    std::vector<llvm::Type *> llvm_type_args(type_args.size(), nullptr);
+    std::vector<bool> is_from_literal(type_args.size(), false);
+
+    for (size_t i = 0; i < function->params.size() && i < args.size(); i++) {
+        Data_Type *param_type = function->params[i]->type;
+
+        size_t k = 0;
+        while (k < function->type_params.size() && function->type_params[k] != param_type)
+            k++;
+        if (k == function->type_params.size())
+            continue; // not a type parameter
+
+        llvm::Type *arg_type = args[i]->getType();
+        llvm::Type *bound_type = llvm_type_args[k];
+        bool is_literal = unwrap_ast_expression(call->params[i])->expr_type == EXPR_LITERAL;
+
+        Data_Type *arg_data_type = get_argument_data_type(call, i, args, ir);
+
+        bool is_wider = bound_type == nullptr ||
+            (arg_type->isIntegerTy() && bound_type->isIntegerTy() &&
+             arg_type->getIntegerBitWidth() > bound_type->getIntegerBitWidth()) ||
+            (arg_type->isDoubleTy() && bound_type->isFloatTy());
+        bool takes_over = bound_type == arg_type && !is_literal &&
+            (is_from_literal[k] || is_unsigned_int_type(arg_data_type));
+
+        if (is_wider || takes_over) {
+            type_args[k] = arg_data_type;
+            llvm_type_args[k] = arg_type;
+            is_from_literal[k] = is_literal;
+        } else if (!(bound_type == arg_type ||
+                     (arg_type->isIntegerTy() && bound_type->isIntegerTy()) ||
+                     (arg_type->isFloatTy() && bound_type->isDoubleTy()))) {
+            throw_ir_error(E134);
+        }
+    }
+
+    for (size_t k = 0; k < type_args.size(); k++) {
+        if (type_args[k] == nullptr)
+            throw_ir_error(E135);
+    }
+    return type_args;
+}
+
+// returns the instance of a generic function for the given call.
+// the instance is declared the first time it is needed (and its body
+// is emitted later), after that, it is found in the cache.
+llvm::Function *get_generic_instance(AST_Function_Definition *function,
+                                     AST_Function_Call *call,
+                                     std::vector<llvm::Value *> &args,
+                                     LLVM_IR *ir) {
+    std::vector<Data_Type *> type_args = get_generic_type_args(function, call, args, ir);
+
+    // the arguments after the params go to the parameter pack
+    // (with the exact types they are passed with)
+    std::vector<Data_Type *> pack_types;
+    for (size_t i = function->params.size(); i < args.size(); i++) {
+        Data_Type *pack_type = get_argument_data_type(call, i, args, ir);
+        if (pack_type == nullptr)
+            throw_ir_error(E147);
+        pack_types.push_back(pack_type);
+    }
+
+    // the instance is named after the type arguments, like: max<s64>
+    // (and the types in the pack, like: print_all<...s32,f64>)
+    std::string instance_name = function->function_name + "<";
+    for (size_t i = 0; i < type_args.size(); i++) {
+        if (i > 0) instance_name += ",";
+        instance_name += get_type_name(type_args[i]);
+    }
+    if (!function->pack_name.empty()) {
+        if (!type_args.empty()) instance_name += ",";
+        instance_name += "...";
+        for (size_t i = 0; i < pack_types.size(); i++) {
+            if (i > 0) instance_name += ",";
+            instance_name += get_type_name(pack_types[i]);
+        }
+    }
+    instance_name += ">";
+
+    llvm::Function *_f = ir->generic_instances[instance_name];
+    if (_f)
+        return _f;
+
+    std::vector<Data_Type *> previous = bind_type_params(function, type_args);
+
+    llvm::Type *llvm_return_type = llvm_type_map(function->return_type, ir->_context);
+    std::vector<llvm::Type *> llvm_param_types;
+    for (auto *param : function->params) {
+        llvm_param_types.push_back(llvm_type_map(param->type, ir->_context));
+    }
+    for (Data_Type *pack_type : pack_types) {
+        llvm_param_types.push_back(llvm_type_map(pack_type, ir->_context));
+    }
+
+    bind_type_params(function, previous);
+
+    // (other files may create the same instance, and
+    // the linker is allowed to keep any one of them)
+    llvm::FunctionType *f_type = llvm::FunctionType::get(
+        llvm_return_type, llvm_param_types, function->has_variadic_args);
+    _f = llvm::Function::Create(f_type, llvm::Function::LinkOnceODRLinkage,
+                                instance_name, ir->_module);
+
+    ir->generic_instances.insert(instance_name, _f);
+    ir->pending_generic_instances.push_back({function, type_args, _f, pack_types});
+    return _f;
+}
+
+// emits the body of an instance of a generic function
+void emit_generic_instance(LLVM_IR *ir, Generic_Instance instance) {
+    std::vector<Data_Type *> previous =
+        bind_type_params(instance.function, instance.type_args);
+    ir->current_pack_types = instance.pack_types;
+
+    instance.function->generate_ir_body(ir, instance.llvm_function);
+
+    bind_type_params(instance.function, previous);
+    ir->current_pack.clear();
+    ir->current_pack_types.clear();
+}
+
 llvm::Value *AST_Function_Call::generate_ir(LLVM_IR *ir) {
     if (ir->_builder->GetInsertBlock() == nullptr) {
         throw_ir_error(
             E074);
     }
 
-    // find the function in the module
-    llvm::Function *callee = ir->_module->getFunction(function_name);
-    if (!callee) {
-        throw_ir_error(E075);
-    }
+    // the atomic builtins are not actual functions,
+    // but are lowered directly into atomic instructions
+    if (ordering != AO_NONE)
+        return generate_ir__atomic_builtin(this, ir);
 
     // generate instructions for each argument
     std::vector<llvm::Value *> args;
@@ -764,6 +1875,42 @@ llvm::Value *AST_Function_Call::generate_ir(LLVM_IR *ir) {
         args.push_back(arg_val);
     }
 
+    // find the function in the module (for a generic function,
+    // this is the instance for the types of the arguments)
+    llvm::Function *callee;
+    AST_Function_Definition *generic_function = ir->generic_functions[function_name];
+    if (generic_function)
+        callee = get_generic_instance(generic_function, this, args, ir);
+    else
+        callee = ir->_module->getFunction(function_name);
+
+    if (!callee) {
+        throw_ir_error(E075);
+    }
+
+    // the arguments may be of a different size than the parameters
+    // (like a literal passed for an s64, or the arguments for a type
+    // parameter that are smaller than the type that was deduced for it)
+    for (size_t i = 0; i < args.size() && i < callee->arg_size(); i++) {
+        llvm::Type *param_type = callee->getFunctionType()->getParamType(i);
+        if (args[i]->getType() == param_type)
+            continue;
+        if (args[i]->getType()->isIntegerTy() && param_type->isIntegerTy())
+            args[i] = convert_int_value(args[i], params[i], param_type, ir);
+        else if (args[i]->getType()->isFloatTy() && param_type->isDoubleTy())
+            args[i] = ir->_builder->CreateFPExt(args[i], param_type, "argcast");
+        else if (args[i]->getType()->isPointerTy() && param_type->isPointerTy())
+            args[i] = ir->_builder->CreatePointerCast(args[i], param_type, "argcast");
+    }
+
+    // mem_copy / mem_set with a small constant size
+    if (generate_ir__bulk_memory_op(this, callee, args, ir))
+        return nullptr;
+
+    // black_box / black_box_f64, which the optimizer mustn't see through
+    if (llvm::Value *opaque = generate_ir__black_box(this, callee, args, ir))
+        return opaque;
+
     // in case the return type is void, we should not return anything
     if (callee->getReturnType()->isVoidTy()) {
         ir->_builder->CreateCall(callee, args);
@@ -774,6 +1921,54 @@ llvm::Value *AST_Function_Call::generate_ir(LLVM_IR *ir) {
     return ir->_builder->CreateCall(callee, args, "calltmp");
 }
 
+llvm::Value *AST_Await_Expression::generate_ir(LLVM_IR *ir) {
+    // await f(...) is emitted as:
+    //
+    //     call void @__em_coro_set_current(i8* %hdl)
+    //     %result = call f(...)
+    //     %s = call i8 @llvm.coro.suspend(token none, i1 false)
+    //     switch i8 %s, label %corosuspend [i8 0, label %awaitresume
+    //                                       i8 1, label %corocleanup]
+    //   awaitresume:
+    //     ...
+    //
+    // f is expected to hand the current coroutine over to someone
+    // that will resume it later (like the event loop in async.bc).
+    // the value of the await is whatever f returned.
+
+    Coroutine_Info *coro = ir->current_coroutine;
+    if (coro == nullptr) {
+        throw_ir_error(E129);
+    }
+
+    llvm::Type *i8_ptr_ty = llvm::Type::getInt8Ty(ir->_context)->getPointerTo();
+    llvm::FunctionCallee set_current = ir->_module->getOrInsertFunction(
+        "__em_coro_set_current",
+        llvm::FunctionType::get(llvm::Type::getVoidTy(ir->_context), {i8_ptr_ty}, false));
+    ir->_builder->CreateCall(set_current, {coro->handle});
+
+    llvm::Value *result = call->generate_ir(ir);
+
+    llvm::Function *coro_suspend =
+        llvm::Intrinsic::getDeclaration(ir->_module, llvm::Intrinsic::coro_suspend);
+    llvm::Value *suspend_result = ir->_builder->CreateCall(
+        coro_suspend,
+        {llvm::ConstantTokenNone::get(ir->_context), llvm::ConstantInt::getFalse(ir->_context)},
+        "suspend");
+
+    llvm::Function *f = ir->_builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock *_resume =
+        llvm::BasicBlock::Create(ir->_context, "awaitresume", f);
+
+    llvm::SwitchInst *_switch =
+        ir->_builder->CreateSwitch(suspend_result, coro->suspend, 2);
+    _switch->addCase(llvm::ConstantInt::get(llvm::Type::getInt8Ty(ir->_context), 0), _resume);
+    _switch->addCase(llvm::ConstantInt::get(llvm::Type::getInt8Ty(ir->_context), 1), coro->cleanup);
+
+    ir->_builder->SetInsertPoint(_resume);
+    return result;
+}
+
 llvm::Value *AST_Return_Expression::generate_ir(LLVM_IR *ir) {
     // in case the function within which this return
     // is being called, was a variadic args function,
@@ -781,8 +1976,14 @@ llvm::Value *AST_Return_Expression::generate_ir(LLVM_IR *ir) {
     // return instruction.
     if (ir->current_va_list) emit_va_end(ir);
 
-    if (!value)
+    // in an async function, the frame has to be freed first
+    if (ir->current_coroutine)
+        return ir->_builder->CreateBr(ir->current_coroutine->cleanup);
+
+    if (!value) {
+        emit_profile_call(ir, "__em_profile_exit");
         return ir->_builder->CreateRetVoid(); // ret void
+    }
 
     llvm::Value *val = value->generate_ir(ir);
     if (!val)
@@ -795,12 +1996,19 @@ llvm::Value *AST_Return_Expression::generate_ir(LLVM_IR *ir) {
         // add cast if needed
         if (val->getType()->isIntegerTy() && retTy->isIntegerTy()) {
             val = ir->_builder->CreateIntCast(val, retTy, true, "retcast");
+        } else if (val->getType()->isIntegerTy() && retTy->isFloatingPointTy()) {
+            // (like a "return 0;" in a generic function instantiated for a float type)
+            val = ir->_builder->CreateSIToFP(val, retTy, "retcast");
+        } else if (val->getType()->isFloatingPointTy() && retTy->isFloatingPointTy()) {
+            val = ir->_builder->CreateFPCast(val, retTy, "retcast");
         } else {
             throw_ir_error(
                 E076);
         }
     }
 
+    // (after the value, so that the calls in it count for this function)
+    emit_profile_call(ir, "__em_profile_exit");
     return ir->_builder->CreateRet(val); // ret <value>
 }
 
@@ -864,7 +2072,8 @@ llvm::Value *generate_ir__global_declaration(LLVM_IR *ir,
             *(ir->_module), var_type, false, llvm::GlobalValue::ExternalLinkage,
             init, decl->variable_name);
 
-        auto *sym_info = new LLVM_Symbol_Info{global, var_type};
+        auto *sym_info = new_symbol_info(ir, global, var_type, decl->data_type);
+        sym_info->is_atomic = decl->is_atomic;
         ir->llvm_symbol_table.insert(decl->variable_name, sym_info);
         return global;
     }
@@ -886,12 +2095,32 @@ llvm::Value *generate_ir__global_declaration(LLVM_IR *ir,
             throw_ir_error(E081);
         }
 
+        // integer literals may have a different width
+        // than the declared type of the global
+        if (auto *c_int = llvm::dyn_cast<llvm::ConstantInt>(init)) {
+            if (var_type->isIntegerTy() && var_type != c_int->getType())
+                init = llvm::ConstantInt::get(
+                    var_type,
+                    c_int->getValue().sextOrTrunc(var_type->getIntegerBitWidth()));
+        }
+
+        // const globals are emitted as constant globals, so that
+        // they are placed in read-only memory (.rodata), and loads
+        // from them can be folded by the optimizer.
         auto *global = new llvm::GlobalVariable(
-            *(ir->_module), var_type, false, llvm::GlobalValue::ExternalLinkage,
-            init, decl->variable_name);
+            *(ir->_module), var_type, decl->is_const,
+            llvm::GlobalValue::ExternalLinkage, init, decl->variable_name);
+
+        if (decl->is_const)
+            global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
 
-        auto *sym_info = new LLVM_Symbol_Info{global, var_type};
+        auto *sym_info = new_symbol_info(ir, global, var_type, decl->data_type);
+        sym_info->is_const = decl->is_const;
+        sym_info->is_atomic = decl->is_atomic;
         ir->llvm_symbol_table.insert(decl->variable_name, sym_info);
+
+        if (decl->is_const)
+            set_const_value(ir, decl->variable_name, init);
         return global;
     }
     default: {
@@ -901,20 +2130,217 @@ llvm::Value *generate_ir__global_declaration(LLVM_IR *ir,
     return nullptr;
 }
 
+// adds the names of the functions called from an expression (and
+// from everything inside of it) to called. the templates of inline
+// assembly are collected separately, since they can call functions
+// by their name too.
+void collect_called_functions(AST_Expression *expr, std::vector<std::string> &called,
+                              std::vector<std::string *> &asm_templates) {
+    if (expr == NULL)
+        return;
+
+    auto collect_block = [&](std::vector<AST_Expression *> &block) {
+        for (AST_Expression *e : block)
+            collect_called_functions(e, called, asm_templates);
+    };
+
+    switch (expr->expr_type) {
+    case EXPR_FUNC_CALL: {
+        auto *e = (AST_Function_Call *)expr;
+        called.push_back(e->function_name);
+        collect_block(e->params);
+        break;
+    }
+    case EXPR_AWAIT:
+        collect_called_functions(((AST_Await_Expression *)expr)->call, called, asm_templates);
+        break;
+    case EXPR_UNARY:
+        collect_called_functions(((AST_Unary_Expression *)expr)->expr, called, asm_templates);
+        break;
+    case EXPR_BINARY: {
+        auto *e = (AST_Binary_Expression *)expr;
+        collect_called_functions(e->left, called, asm_templates);
+        collect_called_functions(e->right, called, asm_templates);
+        break;
+    }
+    case EXPR_RETURN:
+        collect_called_functions(((AST_Return_Expression *)expr)->value, called, asm_templates);
+        break;
+    case EXPR_IF: {
+        auto *e = (AST_If_Expression *)expr;
+        collect_called_functions(e->condition, called, asm_templates);
+        collect_block(e->block);
+        collect_block(e->else_block);
+        break;
+    }
+    case EXPR_SWITCH: {
+        auto *e = (AST_Switch_Expression *)expr;
+        collect_called_functions(e->identifier_or_call, called, asm_templates);
+        for (AST_Case_Expression *c : e->case_list)
+            collect_block(c->block);
+        break;
+    }
+    case EXPR_FOR: {
+        auto *e = (AST_For_Expression *)expr;
+        collect_called_functions(e->init, called, asm_templates);
+        collect_called_functions(e->condition, called, asm_templates);
+        collect_called_functions(e->increment, called, asm_templates);
+        collect_block(e->block);
+        break;
+    }
+    case EXPR_RANGE_FOR: {
+        auto *e = (AST_Range_For_Expression *)expr;
+        collect_called_functions(e->begin, called, asm_templates);
+        collect_called_functions(e->end, called, asm_templates);
+        collect_called_functions(e->step, called, asm_templates);
+        collect_block(e->block);
+        break;
+    }
+    case EXPR_PARALLEL_FOR: {
+        auto *e = (AST_Parallel_For_Expression *)expr;
+        collect_called_functions(e->begin, called, asm_templates);
+        collect_called_functions(e->end, called, asm_templates);
+        collect_block(e->block);
+        break;
+    }
+    case EXPR_WHILE: {
+        auto *e = (AST_While_Expression *)expr;
+        collect_called_functions(e->condition, called, asm_templates);
+        collect_block(e->block);
+        break;
+    }
+    case EXPR_ASM: {
+        auto *e = (AST_Asm_Expression *)expr;
+        asm_templates.push_back(&e->asm_template);
+        for (Asm_Operand &operand : e->outputs)
+            collect_called_functions(operand.expr, called, asm_templates);
+        for (Asm_Operand &operand : e->inputs)
+            collect_called_functions(operand.expr, called, asm_templates);
+        break;
+    }
+    case EXPR_PACK_FOR:
+        collect_block(((AST_Pack_For_Expression *)expr)->block);
+        break;
+    case EXPR_BLOCK:
+        collect_block(((AST_Block_Expression *)expr)->block);
+        break;
+    case EXPR_FUNC_DEF:
+        collect_block(((AST_Function_Definition *)expr)->block);
+        break;
+    default:
+        break;
+    }
+}
+
+// works out which of the functions defined in the file can be called,
+// starting from main, by going over the calls in their bodies. the
+// names of those functions are put in reachable.
+//
+// (the calls are only looked at by their name, so this can keep more
+// than is needed, like every instance of a generic function, but never
+// less. a name that turns up in inline assembly counts as a call.)
+//
+// when the file is compiled with others, called_from_other_files has
+// the functions that those declare (to call them), which are where
+// the calls start from as well, in every file.
+//
+// returns false if the file has no main, and is compiled on its own
+// (then it is a library, and any of its functions can be called).
+bool find_reachable_functions(std::vector<AST_Expression *> *ast,
+                              smap<AST_Function_Definition *> &reachable,
+                              const std::vector<std::string> *called_from_other_files) {
+    smap<AST_Function_Definition *> definitions;
+    std::vector<AST_Function_Definition *> all_definitions;
+    std::vector<std::string> called;
+    std::vector<std::string *> asm_templates;
+
+    for (AST_Expression *ast_expr : *ast) {
+        if (ast_expr->expr_type != EXPR_FUNC_DEF) {
+            // (the initializers of globals are roots too)
+            collect_called_functions(ast_expr, called, asm_templates);
+            continue;
+        }
+        auto *function = (AST_Function_Definition *)ast_expr;
+        if (function->is_prototype)
+            continue;
+        definitions.insert(function->function_name, function);
+        all_definitions.push_back(function);
+    }
+
+    if (definitions["main"])
+        called.push_back("main");
+    else if (!called_from_other_files)
+        return false;
+    if (called_from_other_files)
+        called.insert(called.end(), called_from_other_files->begin(),
+                      called_from_other_files->end());
+
+    // (a worklist of the names, with the asm templates
+    // looked at once the calls have all been followed)
+    size_t next_template = 0;
+    while (!called.empty() || next_template < asm_templates.size()) {
+        if (called.empty()) {
+            std::string *asm_template = asm_templates[next_template++];
+            for (AST_Function_Definition *function : all_definitions) {
+                if (asm_template->find(function->function_name) != std::string::npos)
+                    called.push_back(function->function_name);
+            }
+            continue;
+        }
+
+        std::string name = called.back();
+        called.pop_back();
+        if (reachable[name])
+            continue;
+
+        AST_Function_Definition *function = definitions[name];
+        if (!function)
+            continue; // (a prototype, or a builtin)
+        reachable.insert(name, function);
+        collect_called_functions(function, called, asm_templates);
+    }
+    return true;
+}
+
 // goes through each top-level expression in the AST
 // and runs the IR generation for each of them.
 // this emits the llvm IR into the module.
+//
+// with only_reachable (-fskip-unreachable), the functions that can't
+// be called from main aren't emitted at all (like the rest of a library
+// that is brought in with #include "..."), so the errors in them aren't
+// found either. the number of those is kept in ir->skipped_functions.
+// (called_from_other_files is for the builds of several files, see
+// find_reachable_functions)
+//
+// with a cache (-fincremental), the functions that are the same as in
+// the last build are only declared. their bodies are linked in from the
+// cache once the file is done (see close_function_cache).
 LLVM_IR *emit_llvm_ir(std::vector<AST_Expression *> *ast,
-                      const char *file_name) {
+                      const char *file_name, const std::string &target_triple,
+                      bool discard_value_names, llvm::LLVMContext *shared_context,
+                      bool instrument_functions, bool only_reachable,
+                      const std::vector<std::string> *called_from_other_files,
+                      Function_Cache *cache) {
     ZoneScopedS(10); // for tracy profiler
 
-    auto *_context = new llvm::LLVMContext; // creating a context for this file
+    // creating a context for this file (unless it is given one, which
+    // is then kept, with the types and constants in it, for the next file)
+    auto *_context = shared_context ? shared_context : new llvm::LLVMContext;
+
+    // (the names of the local values are only seen when
+    // the IR is printed, so they aren't kept otherwise)
+    _context->setDiscardValueNames(discard_value_names);
+
     auto *_module =
         new llvm::Module(file_name, *_context); // container for functions/vars
     auto *_builder =
         new llvm::IRBuilder<>(*_context); // helper to generate instructions
 
     auto *ir = new LLVM_IR(*_context, _builder, _module);
+    ir->target_triple = target_triple;
+    ir->owns_context = !shared_context;
+    ir->instrument_functions = instrument_functions;
 
     // if a top-level expression is a non-function
     // then it must be either a declaration, or a binary
@@ -922,11 +2348,36 @@ LLVM_IR *emit_llvm_ir(std::vector<AST_Expression *> *ast,
     // these must be treated separately, to emit a global
     // declaration LLVM instruction.
 
+    smap<AST_Function_Definition *> reachable;
+    if (only_reachable && !find_reachable_functions(ast, reachable, called_from_other_files))
+        only_reachable = false;
+
     for (AST_Expression *ast_expr : *ast) {
         if (ast_expr->expr_type != EXPR_FUNC_DEF) {
             generate_ir__global_declaration(ir, ast_expr);
-        } else
-            ast_expr->generate_ir(ir);
+            continue;
+        }
+
+        // (the prototypes are kept, since they are only declarations)
+        auto *function = (AST_Function_Definition *)ast_expr;
+        ir->functions.insert(function->function_name, function);
+        if (only_reachable && !function->is_prototype &&
+            !reachable[function->function_name]) {
+            ir->skipped_functions++;
+            continue;
+        }
+        if (cache && !function->is_prototype && cache->reused[function->function_name]) {
+            function->generate_ir_declaration(ir);
+            continue;
+        }
+        ast_expr->generate_ir(ir);
+    }
+
+    // now emit the bodies of the generic function instances that
+    // were called. (these bodies may call other generic functions,
+    // and so more instances can get added while we go through them)
+    for (size_t i = 0; i < ir->pending_generic_instances.size(); i++) {
+        emit_generic_instance(ir, ir->pending_generic_instances[i]);
     }
 
     // verify the LLVM IR generated
@@ -935,6 +2386,19 @@ LLVM_IR *emit_llvm_ir(std::vector<AST_Expression *> *ast,
     return ir;
 }
 
+// frees the IR of a file (along with its module, builder and context),
+// once the module has been verified and moved out of its context
+void free_llvm_ir(LLVM_IR *ir) {
+    for (LLVM_Symbol_Info *sym_info : ir->symbol_infos)
+        delete sym_info;
+
+    llvm::LLVMContext *_context = ir->owns_context ? &ir->_context : nullptr;
+    delete ir->_module;
+    delete ir->_builder;
+    delete ir;
+    delete _context;
+}
+
 // writes the LLVM IR code to a .ll file
 void write_llvm_ir_to_file(const char *llvm_file_name, llvm::Module *_module) {
     std::error_code EC;
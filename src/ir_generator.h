@@ -17,6 +17,7 @@ to help describe what IR instructions are meant to be generated.
 
 #include "ast.h"
 #include "errors.h"
+#include "incremental.h"
 #include <tracy/Tracy.hpp>
 
 
@@ -35,6 +36,15 @@ inline void print_ir(llvm::Module *_module) {
     printf("\n");
 }
 
+// makes a symbol info that is owned by the IR (see LLVM_IR::symbol_infos)
+inline LLVM_Symbol_Info *new_symbol_info(LLVM_IR *ir, llvm::Value *val, llvm::Type *type,
+                                         Data_Type *data_type = nullptr) {
+    auto *sym_info = new LLVM_Symbol_Info{val, type};
+    sym_info->data_type = data_type;
+    ir->symbol_infos.push_back(sym_info);
+    return sym_info;
+}
+
 // cast some llvm value to bool (if possible, else throw an error)
 inline llvm::Value *cast_llvm_value_to_bool(llvm::Value *val,
                                             llvm::LLVMContext &_context,
@@ -172,9 +182,666 @@ inline void emit_va_end(LLVM_IR *ir) {
     ir->current_va_list = nullptr;
 }
 
+// emits a call to the profiling runtime, for the function whose body is
+// being emitted (with -finstrument-functions), like:
+//     call void @__em_profile_enter(i8* @.str)
+// where the runtime is either __em_profile_enter or __em_profile_exit.
+inline void emit_profile_call(LLVM_IR *ir, const char *runtime_function) {
+    if (!ir->current_function_name)
+        return;
+
+    llvm::Type *i8_ptr_ty = llvm::Type::getInt8Ty(ir->_context)->getPointerTo();
+    llvm::FunctionCallee profile_fn = ir->_module->getOrInsertFunction(
+        runtime_function,
+        llvm::FunctionType::get(llvm::Type::getVoidTy(ir->_context), {i8_ptr_ty}, false));
+    ir->_builder->CreateCall(profile_fn, {ir->current_function_name});
+}
+
+// emits the start of an async function (a coroutine, using the
+// switch-resumed lowering of LLVM). this allocates the coroutine
+// frame (through the runtime), and creates the blocks that the
+// end of the function (and every return) will go to.
+//
+//     %id   = call token @llvm.coro.id(i32 0, i8* null, i8* null, i8* null)
+//     %size = call i64 @llvm.coro.size.i64()
+//     %mem  = call i8* @__em_coro_alloc(i64 %size)
+//     %hdl  = call i8* @llvm.coro.begin(token %id, i8* %mem)
+inline Coroutine_Info *emit_coroutine_begin(LLVM_IR *ir, llvm::Function *f) {
+    llvm::Type *i8_ptr_ty = llvm::Type::getInt8Ty(ir->_context)->getPointerTo();
+    llvm::Type *i64_ty = llvm::Type::getInt64Ty(ir->_context);
+    llvm::Value *null_ptr =
+        llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(i8_ptr_ty));
+
+    // the coroutine passes of LLVM only split the functions marked this way
+    f->setPresplitCoroutine();
+
+    auto *coro = new Coroutine_Info;
+
+    llvm::Function *coro_id =
+        llvm::Intrinsic::getDeclaration(ir->_module, llvm::Intrinsic::coro_id);
+    coro->id = ir->_builder->CreateCall(
+        coro_id,
+        {llvm::ConstantInt::get(llvm::Type::getInt32Ty(ir->_context), 0),
+         null_ptr, null_ptr, null_ptr},
+        "coroid");
+
+    llvm::Function *coro_size = llvm::Intrinsic::getDeclaration(
+        ir->_module, llvm::Intrinsic::coro_size, {i64_ty});
+    llvm::Value *size = ir->_builder->CreateCall(coro_size, {}, "corosize");
+
+    llvm::FunctionCallee coro_alloc = ir->_module->getOrInsertFunction(
+        "__em_coro_alloc", llvm::FunctionType::get(i8_ptr_ty, {i64_ty}, false));
+    llvm::Value *mem = ir->_builder->CreateCall(coro_alloc, {size}, "coromem");
+
+    llvm::Function *coro_begin =
+        llvm::Intrinsic::getDeclaration(ir->_module, llvm::Intrinsic::coro_begin);
+    coro->handle = ir->_builder->CreateCall(coro_begin, {coro->id, mem}, "corohdl");
+
+    coro->cleanup = llvm::BasicBlock::Create(ir->_context, "corocleanup");
+    coro->suspend = llvm::BasicBlock::Create(ir->_context, "corosuspend");
+    return coro;
+}
+
+// emits the end of an async function. when the body completes,
+// the frame is freed, and control goes back to whoever resumed
+// the coroutine last (or to the caller, if it never suspended).
+//
+//   corocleanup:
+//     %mem = call i8* @llvm.coro.free(token %id, i8* %hdl)
+//     call void @__em_coro_free(i8* %mem)
+//     br label %corosuspend
+//   corosuspend:
+//     call i1 @llvm.coro.end(i8* %hdl, i1 false)
+//     ret void
+inline void emit_coroutine_end(LLVM_IR *ir, llvm::Function *f) {
+    Coroutine_Info *coro = ir->current_coroutine;
+    llvm::Type *i8_ptr_ty = llvm::Type::getInt8Ty(ir->_context)->getPointerTo();
+
+    coro->cleanup->insertInto(f);
+    ir->_builder->SetInsertPoint(coro->cleanup);
+
+    llvm::Function *coro_free =
+        llvm::Intrinsic::getDeclaration(ir->_module, llvm::Intrinsic::coro_free);
+    llvm::Value *mem = ir->_builder->CreateCall(coro_free, {coro->id, coro->handle}, "coromem");
+
+    llvm::FunctionCallee free_fn = ir->_module->getOrInsertFunction(
+        "__em_coro_free",
+        llvm::FunctionType::get(llvm::Type::getVoidTy(ir->_context), {i8_ptr_ty}, false));
+    ir->_builder->CreateCall(free_fn, {mem});
+    ir->_builder->CreateBr(coro->suspend);
+
+    coro->suspend->insertInto(f);
+    ir->_builder->SetInsertPoint(coro->suspend);
+
+    // (newer versions of llvm.coro.end take an extra token)
+    llvm::Function *coro_end =
+        llvm::Intrinsic::getDeclaration(ir->_module, llvm::Intrinsic::coro_end);
+    std::vector<llvm::Value *> end_args = {
+        coro->handle, llvm::ConstantInt::getFalse(ir->_context)};
+    if (coro_end->getFunctionType()->getNumParams() == 3)
+        end_args.push_back(llvm::ConstantTokenNone::get(ir->_context));
+    ir->_builder->CreateCall(coro_end, end_args);
+    ir->_builder->CreateRetVoid();
+}
+
+// tells whether an expression is an identifier
+// that refers to a const variable
+inline bool is_const_identifier(LLVM_IR *ir, AST_Expression *expr) {
+    if (expr == NULL || expr->expr_type != EXPR_IDENT)
+        return false;
+
+    LLVM_Symbol_Info *sym_info =
+        ir->llvm_symbol_table[((AST_Identifier *)expr)->name];
+    return sym_info != NULL && sym_info->is_const;
+}
+
+// tells whether an expression is an identifier that refers
+// to the induction variable of a range for loop
+inline bool is_induction_variable_identifier(LLVM_IR *ir, AST_Expression *expr) {
+    if (expr == NULL || expr->expr_type != EXPR_IDENT)
+        return false;
+
+    LLVM_Symbol_Info *sym_info =
+        ir->llvm_symbol_table[((AST_Identifier *)expr)->name];
+    return sym_info != NULL && sym_info->is_induction_variable;
+}
+
+// record the value of a const variable, if it is a scalar
+// constant (int / float), so that its reads can be folded
+// during the IR emission itself.
+inline void set_const_value(LLVM_IR *ir, const std::string &name,
+                            llvm::Value *val) {
+    LLVM_Symbol_Info *sym_info = ir->llvm_symbol_table[name];
+    if (sym_info == NULL)
+        return;
+
+    // integer constants are resized to the declared type of the
+    // variable (the literal itself may be of a different width)
+    if (auto *c_int = llvm::dyn_cast<llvm::ConstantInt>(val)) {
+        if (sym_info->type->isIntegerTy() && sym_info->type != c_int->getType()) {
+            sym_info->const_value = llvm::ConstantInt::get(
+                sym_info->type,
+                c_int->getValue().sextOrTrunc(sym_info->type->getIntegerBitWidth()));
+            return;
+        }
+        sym_info->const_value = c_int;
+    } else if (llvm::isa<llvm::ConstantFP>(val) && sym_info->type == val->getType()) {
+        sym_info->const_value = llvm::cast<llvm::Constant>(val);
+    }
+}
+
+// tells whether an expression is an identifier
+// that refers to an atomic variable
+inline bool is_atomic_identifier(LLVM_IR *ir, AST_Expression *expr) {
+    if (expr == NULL || expr->expr_type != EXPR_IDENT)
+        return false;
+
+    LLVM_Symbol_Info *sym_info =
+        ir->llvm_symbol_table[((AST_Identifier *)expr)->name];
+    return sym_info != NULL && sym_info->is_atomic;
+}
+
+inline llvm::AtomicOrdering get_llvm_atomic_ordering(Atomic_Ordering ordering) {
+    switch (ordering) {
+    case AO_RELAXED: return llvm::AtomicOrdering::Monotonic;
+    case AO_ACQUIRE: return llvm::AtomicOrdering::Acquire;
+    case AO_RELEASE: return llvm::AtomicOrdering::Release;
+    case AO_ACQ_REL: return llvm::AtomicOrdering::AcquireRelease;
+    default:         return llvm::AtomicOrdering::SequentiallyConsistent;
+    }
+}
+
+// atomic instructions need an explicit alignment. since only
+// integer types can be atomic, this is just the size of the type.
+inline llvm::MaybeAlign get_atomic_alignment(llvm::Type *type) {
+    return llvm::MaybeAlign(std::max(1u, type->getIntegerBitWidth() / 8));
+}
+
+inline llvm::Value *emit_atomic_load(LLVM_IR *ir, LLVM_Symbol_Info *sym_info,
+                                     llvm::AtomicOrdering ordering,
+                                     const std::string &name = "") {
+    llvm::LoadInst *load = ir->_builder->CreateAlignedLoad(
+        sym_info->type, sym_info->val, get_atomic_alignment(sym_info->type), name);
+    load->setAtomic(ordering);
+    return load;
+}
+
+inline void emit_atomic_store(LLVM_IR *ir, LLVM_Symbol_Info *sym_info,
+                              llvm::Value *val, llvm::AtomicOrdering ordering) {
+    llvm::StoreInst *store = ir->_builder->CreateAlignedStore(
+        val, sym_info->val, get_atomic_alignment(sym_info->type));
+    store->setAtomic(ordering);
+}
+
+llvm::Value *convert_int_value(llvm::Value *val, AST_Expression *expr,
+                               llvm::Type *type, LLVM_IR *ir);
+
+// assignments to an atomic variable. (=) is a sequentially
+// consistent store, and the compound assignments that have
+// an atomicrmw equivalent are emitted as a single atomicrmw.
+// (the value is converted to the type of the variable like
+// an argument, see convert_int_value)
+inline llvm::Value *generate_ir__atomic_assignment(LLVM_IR *ir, Token_Type op,
+                                                   AST_Identifier *left,
+                                                   AST_Expression *right,
+                                                   llvm::Value *Rval) {
+    LLVM_Symbol_Info *sym_info = ir->llvm_symbol_table[left->name];
+    if (!Rval->getType()->isIntegerTy()) {
+        throw_ir_error(E124);
+    }
+    Rval = convert_int_value(Rval, right, sym_info->type, ir);
+
+    llvm::AtomicOrdering seq_cst = llvm::AtomicOrdering::SequentiallyConsistent;
+    if (op == TOKEN_ASSIGN) {
+        emit_atomic_store(ir, sym_info, Rval, seq_cst);
+        return Rval;
+    }
+
+    llvm::AtomicRMWInst::BinOp rmw_op;
+    llvm::Instruction::BinaryOps bin_op;
+    switch (op) {
+    case TOKEN_PLUSEQ:
+        rmw_op = llvm::AtomicRMWInst::Add;
+        bin_op = llvm::Instruction::Add;
+        break;
+    case TOKEN_MINUSEQ:
+        rmw_op = llvm::AtomicRMWInst::Sub;
+        bin_op = llvm::Instruction::Sub;
+        break;
+    case TOKEN_ANDEQ:
+    case TOKEN_BIT_ANDEQ:
+        rmw_op = llvm::AtomicRMWInst::And;
+        bin_op = llvm::Instruction::And;
+        break;
+    case TOKEN_OREQ:
+    case TOKEN_BIT_OREQ:
+        rmw_op = llvm::AtomicRMWInst::Or;
+        bin_op = llvm::Instruction::Or;
+        break;
+    case TOKEN_XOREQ:
+        rmw_op = llvm::AtomicRMWInst::Xor;
+        bin_op = llvm::Instruction::Xor;
+        break;
+    default:
+        throw_ir_error(E125);
+        return nullptr;
+    }
+
+    // atomicrmw gives back the old value, but the
+    // assignment evaluates to the new one.
+    llvm::Value *old_val = ir->_builder->CreateAtomicRMW(
+        rmw_op, sym_info->val, Rval, get_atomic_alignment(sym_info->type), seq_cst);
+    return ir->_builder->CreateBinOp(bin_op, old_val, Rval, "atomictmp");
+}
+
+// emits the atomic builtins, which look like function calls:
+//
+//     atomic_load(x, ord)              -> load atomic
+//     atomic_store(x, val, ord)        -> store atomic
+//     atomic_fetch_add(x, val, ord)    -> atomicrmw add (returns the old value)
+//     atomic_cas(x, expected, desired, ord)
+//                                      -> cmpxchg (returns whether it succeeded)
+//     fence(ord)                       -> fence
+inline llvm::Value *generate_ir__atomic_builtin(AST_Function_Call *call,
+                                                LLVM_IR *ir) {
+    llvm::AtomicOrdering ordering = get_llvm_atomic_ordering(call->ordering);
+
+    if (call->function_name == "fence") {
+        ir->_builder->CreateFence(ordering);
+        return nullptr;
+    }
+
+    // the first argument is always the atomic variable
+    LLVM_Symbol_Info *sym_info = nullptr;
+    if (!call->params.empty() && call->params[0]->expr_type == EXPR_IDENT)
+        sym_info = ir->llvm_symbol_table[((AST_Identifier *)call->params[0])->name];
+    if (sym_info == NULL || !sym_info->is_atomic) {
+        throw_ir_error(E124);
+    }
+
+    // the other arguments are converted to the type of the variable
+    std::vector<llvm::Value *> args;
+    for (size_t i = 1; i < call->params.size(); i++) {
+        llvm::Value *arg_val = call->params[i]->generate_ir(ir);
+        if (!arg_val || !arg_val->getType()->isIntegerTy()) {
+            throw_ir_error(E124);
+        }
+        args.push_back(convert_int_value(arg_val, call->params[i], sym_info->type, ir));
+    }
+
+    if (call->function_name == "atomic_load")
+        return emit_atomic_load(ir, sym_info, ordering, "atomicload");
+
+    if (call->function_name == "atomic_store") {
+        emit_atomic_store(ir, sym_info, args[0], ordering);
+        return nullptr;
+    }
+
+    if (call->function_name == "atomic_fetch_add")
+        return ir->_builder->CreateAtomicRMW(
+            llvm::AtomicRMWInst::Add, sym_info->val, args[0],
+            get_atomic_alignment(sym_info->type), ordering);
+
+    // atomic_cas. (the ordering on failure is the strongest
+    // one that is allowed for the ordering given.)
+    llvm::Value *cmpxchg = ir->_builder->CreateAtomicCmpXchg(
+        sym_info->val, args[0], args[1], get_atomic_alignment(sym_info->type),
+        ordering, llvm::AtomicCmpXchgInst::getStrongestFailureOrdering(ordering));
+    return ir->_builder->CreateExtractValue(cmpxchg, 1, "casok");
+}
+
+//                   Bulk memory operations
+// ******************************************************************
+
+// tells whether a call goes to a function that is only declared, and
+// by one of the standard headers (whose runtime it is then linked with)
+inline bool is_std_library_declaration(AST_Function_Call *call,
+                                       llvm::Function *callee, LLVM_IR *ir) {
+    AST_Function_Definition *function = ir->functions[call->function_name];
+    return callee->isDeclaration() && function && function->is_prototype &&
+           function->is_from_std_library;
+}
+
+// the largest size of a mem_copy / mem_set that is emitted inline
+#define EM_INLINE_BULK_MEMORY_LIMIT 128
+
+// mem_copy / mem_set (from memory.emh) with a small constant size
+// are emitted as llvm.memcpy / llvm.memset, instead of a call. LLVM
+// turns those into a few moves (and can see through them), while the
+// large and unknown sizes still go to the vectorized runtime.
+//
+// returns whether the call was emitted here.
+inline bool generate_ir__bulk_memory_op(AST_Function_Call *call,
+                                        llvm::Function *callee,
+                                        std::vector<llvm::Value *> &args,
+                                        LLVM_IR *ir) {
+    bool is_copy = call->function_name == "mem_copy";
+    bool is_set = call->function_name == "mem_set";
+
+    // (only the declarations from memory.emh, not some other
+    // function that happens to have the same name)
+    if ((!is_copy && !is_set) || !is_std_library_declaration(call, callee, ir) ||
+        args.size() != 3)
+        return false;
+
+    llvm::Type *i64_ty = llvm::Type::getInt64Ty(ir->_context);
+    llvm::Type *value_ty = is_copy ? i64_ty : llvm::Type::getInt8Ty(ir->_context);
+    if (args[0]->getType() != i64_ty || args[1]->getType() != value_ty)
+        return false;
+
+    auto *size = llvm::dyn_cast<llvm::ConstantInt>(args[2]);
+    if (!size || size->isNegative() || size->getZExtValue() > EM_INLINE_BULK_MEMORY_LIMIT)
+        return false;
+
+    llvm::Type *i8_ptr_ty = llvm::Type::getInt8Ty(ir->_context)->getPointerTo();
+    llvm::Value *inline_size = llvm::ConstantInt::get(i64_ty, size->getZExtValue());
+    llvm::Value *destination = ir->_builder->CreateIntToPtr(args[0], i8_ptr_ty, "memdst");
+
+    if (is_copy) {
+        llvm::Value *source = ir->_builder->CreateIntToPtr(args[1], i8_ptr_ty, "memsrc");
+        ir->_builder->CreateMemCpy(destination, llvm::MaybeAlign(1), source,
+                                   llvm::MaybeAlign(1), inline_size);
+    } else {
+        ir->_builder->CreateMemSet(destination, args[1], inline_size, llvm::MaybeAlign(1));
+    }
+    return true;
+}
+
+//                         black_box
+// ******************************************************************
+
+// black_box / black_box_f64 (from time.emh) give back their argument,
+// in a way that the optimizer can't see through. so the work done for
+// a benchmark isn't thrown away as dead code (or folded into a
+// constant). the value goes through a stack slot, whose address is
+// given to an empty inline assembly (which, as far as LLVM knows, may
+// read and change any memory):
+//
+//     store i64 %value, i64* %bbox
+//     call void asm sideeffect "", "r,~{memory}"(i64* %bbox)
+//     %blackbox = load i64, i64* %bbox
+//
+// (a call to the runtime wouldn't do, since it's linked into the same
+// module, and so it could be inlined and optimized away.)
+//
+// returns nullptr if the call isn't to one of these.
+inline llvm::Value *generate_ir__black_box(AST_Function_Call *call,
+                                           llvm::Function *callee,
+                                           std::vector<llvm::Value *> &args,
+                                           LLVM_IR *ir) {
+    // (only the declarations from time.emh, like for mem_copy)
+    if ((call->function_name != "black_box" && call->function_name != "black_box_f64") ||
+        !is_std_library_declaration(call, callee, ir) || args.size() != 1 ||
+        args[0]->getType() != callee->getReturnType())
+        return nullptr;
+
+    llvm::Type *type = callee->getReturnType();
+
+    // (the slot goes in the entry block, with the other allocas)
+    llvm::BasicBlock &entry = ir->_builder->GetInsertBlock()->getParent()->getEntryBlock();
+    llvm::IRBuilder<> tmp_builder(&entry, entry.begin());
+    llvm::AllocaInst *slot = tmp_builder.CreateAlloca(type, nullptr, "bbox");
+
+    ir->_builder->CreateStore(args[0], slot);
+    llvm::FunctionType *asm_type = llvm::FunctionType::get(
+        llvm::Type::getVoidTy(ir->_context), {slot->getType()}, false);
+    ir->_builder->CreateCall(llvm::InlineAsm::get(asm_type, "", "r,~{memory}", true), {slot});
+    return ir->_builder->CreateLoad(type, slot, "blackbox");
+}
+
+//                       Inline assembly
+// ******************************************************************
+
+/*
+the constraints of inline assembly are checked against the target
+here (the same way clang does it), since LLVM would otherwise only
+complain about them much later, during the code generation, or
+worse, silently do something else.
+
+for every target we know of the constraint letters, and the names
+of the registers (for {reg} constraints and the clobbers).
+*/
+
+// tells whether name is <prefix><number>, with the number <= max
+inline bool is_numbered_register(const std::string &name, const char *prefix, int max) {
+    size_t prefix_len = strlen(prefix);
+    if (name.size() <= prefix_len || name.compare(0, prefix_len, prefix) != 0)
+        return false;
+
+    int num = 0;
+    for (size_t i = prefix_len; i < name.size(); i++) {
+        if (!isdigit((unsigned char)name[i]))
+            return false;
+        num = num * 10 + (name[i] - '0');
+    }
+    return num <= max;
+}
+
+inline bool is_asm_register(const llvm::Triple &triple, const std::string &name) {
+    switch (triple.getArch()) {
+    case llvm::Triple::x86:
+    case llvm::Triple::x86_64: {
+        static const char *registers[] = {
+            "al", "bl", "cl", "dl", "ah", "bh", "ch", "dh", "sil", "dil", "bpl", "spl",
+            "ax", "bx", "cx", "dx", "si", "di", "bp", "sp",
+            "eax", "ebx", "ecx", "edx", "esi", "edi", "ebp", "esp",
+            "rax", "rbx", "rcx", "rdx", "rsi", "rdi", "rbp", "rsp",
+            "flags", "eflags", "dirflag", "fpsr", "fpcr", "st"};
+        for (const char *r : registers)
+            if (name == r) return true;
+
+        // r8 - r15 (and their lower parts: r8d, r8w, r8b)
+        std::string base = name;
+        if (base.size() > 2 && (base.back() == 'd' || base.back() == 'w' || base.back() == 'b'))
+            base.pop_back();
+        if (is_numbered_register(base, "r", 15) && base.size() > 1 && std::stoi(base.substr(1)) >= 8)
+            return true;
+
+        return is_numbered_register(name, "xmm", 31) || is_numbered_register(name, "ymm", 31) ||
+               is_numbered_register(name, "zmm", 31) || is_numbered_register(name, "mm", 7) ||
+               is_numbered_register(name, "k", 7);
+    }
+    case llvm::Triple::arm:
+    case llvm::Triple::armeb:
+    case llvm::Triple::thumb:
+    case llvm::Triple::thumbeb: {
+        static const char *registers[] = {"sp", "lr", "pc", "ip", "fp", "sl", "sb", "apsr", "cpsr"};
+        for (const char *r : registers)
+            if (name == r) return true;
+        if (is_numbered_register(name, "r", 15))
+            return true;
+
+        // cortex-m3 (v7m) has no floating point unit, and the
+        // ones with v7em only have the single / double registers
+        llvm::Triple::SubArchType sub_arch = triple.getSubArch();
+        if (sub_arch == llvm::Triple::ARMSubArch_v7m)
+            return false;
+        if (sub_arch == llvm::Triple::ARMSubArch_v7em)
+            return is_numbered_register(name, "s", 31) || is_numbered_register(name, "d", 15);
+        return is_numbered_register(name, "s", 31) || is_numbered_register(name, "d", 31) ||
+               is_numbered_register(name, "q", 15);
+    }
+    case llvm::Triple::aarch64:
+    case llvm::Triple::aarch64_be:
+    case llvm::Triple::aarch64_32: {
+        static const char *registers[] = {"sp", "wsp", "xzr", "wzr", "lr", "fp", "nzcv"};
+        for (const char *r : registers)
+            if (name == r) return true;
+        if (is_numbered_register(name, "x", 30) || is_numbered_register(name, "w", 30))
+            return true;
+        for (const char *prefix : {"v", "q", "d", "s", "h", "b"})
+            if (is_numbered_register(name, prefix, 31)) return true;
+        return false;
+    }
+    default:
+        // (a target that we know nothing about gets the benefit of the doubt)
+        return true;
+    }
+}
+
+// the single letter constraints that a target accepts
+inline const char *get_asm_constraint_letters(const llvm::Triple &triple) {
+    switch (triple.getArch()) {
+    case llvm::Triple::x86:
+    case llvm::Triple::x86_64:
+        return "rgimnoVXEFsabcdSDAqQRlftuxyYvIJKLMNOeZ";
+    case llvm::Triple::arm:
+    case llvm::Triple::armeb:
+    case llvm::Triple::thumb:
+    case llvm::Triple::thumbeb:
+        // (w, t and x are floating point registers)
+        if (triple.getSubArch() == llvm::Triple::ARMSubArch_v7m)
+            return "rgimnoVXEFslhIJKLMNOQ";
+        return "rgimnoVXEFslhwtxIJKLMNOQ";
+    case llvm::Triple::aarch64:
+    case llvm::Triple::aarch64_be:
+    case llvm::Triple::aarch64_32:
+        return "rgimnoVXEFswxyzIJKLMNQSYZ";
+    default:
+        return "rgimnoVXEFs";
+    }
+}
+
+// the constraints that only allow memory operands. these are passed
+// indirectly (the address of the variable), instead of by value.
+inline bool is_memory_only_asm_constraint(const llvm::Triple &triple, const std::string &code) {
+    if (code.empty())
+        return false;
+    for (char c : code) {
+        // (Q is a memory operand everywhere except on x86)
+        if (c == 'Q' && !triple.isX86())
+            continue;
+        if (c != 'm' && c != 'o' && c != 'V')
+            return false;
+    }
+    return true;
+}
+
+// the constraints that only allow immediates (compile time constants)
+inline bool is_immediate_only_asm_constraint(const std::string &code) {
+    if (code.empty())
+        return false;
+    for (char c : code)
+        if (c != 'i' && c != 'n')
+            return false;
+    return true;
+}
+
+// checks the constraint of an operand (without the = / + / & of outputs):
+// a list of alternatives, each being a letter or a {register}.
+// inputs can also be tied to an output, by giving its number.
+inline bool is_valid_asm_constraint(const llvm::Triple &triple, const std::string &code,
+                                    bool is_output, size_t num_outputs) {
+    if (code.empty())
+        return false;
+
+    if (!is_output && isdigit((unsigned char)code[0])) {
+        for (char c : code)
+            if (!isdigit((unsigned char)c)) return false;
+        return (size_t)std::stoi(code) < num_outputs;
+    }
+
+    const char *letters = get_asm_constraint_letters(triple);
+    for (size_t i = 0; i < code.size(); i++) {
+        if (code[i] == '{') {
+            size_t close = code.find('}', i);
+            if (close == std::string::npos ||
+                !is_asm_register(triple, code.substr(i + 1, close - i - 1)))
+                return false;
+            i = close;
+        } else if (strchr(letters, code[i]) == NULL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// some of the constraints are written differently in LLVM. on x86
+// the letters for specific registers become the registers themselves
+// (like clang does it):  a -> {ax}, S -> {si}, t -> {st}
+inline std::string convert_asm_constraint(const llvm::Triple &triple, const std::string &code) {
+    if (!triple.isX86())
+        return code;
+
+    std::string result;
+    for (size_t i = 0; i < code.size(); i++) {
+        switch (code[i]) {
+        case 'a': result += "{ax}"; break;
+        case 'b': result += "{bx}"; break;
+        case 'c': result += "{cx}"; break;
+        case 'd': result += "{dx}"; break;
+        case 'S': result += "{si}"; break;
+        case 'D': result += "{di}"; break;
+        case 't': result += "{st}"; break;
+        case 'u': result += "{st(1)}"; break;
+        case '{': {
+            size_t close = code.find('}', i);
+            result += code.substr(i, close - i + 1);
+            i = close;
+            break;
+        }
+        default: result += code[i];
+        }
+    }
+    return result;
+}
+
+// converts a template from the GCC syntax to the LLVM one:
+//     %0 -> $0, %w0 -> ${0:w}, %% -> %, $ -> $$, %= -> ${:uid}
+// (without any operands, like in GCC, a % is just a %)
+inline std::string convert_asm_template(const std::string &asm_template,
+                                        size_t num_operands, bool has_operands) {
+    std::string result;
+    for (size_t i = 0; i < asm_template.size(); i++) {
+        char c = asm_template[i];
+        char next = (i + 1 < asm_template.size()) ? asm_template[i + 1] : '\0';
+
+        if (c == '$') {
+            result += "$$";
+        } else if (c != '%' || !has_operands) {
+            result += c;
+        } else if (next == '%') {
+            result += '%';
+            i++;
+        } else if (next == '=') {
+            result += "${:uid}";
+            i++;
+        } else if (isdigit((unsigned char)next) ||
+                   (isalpha((unsigned char)next) && i + 2 < asm_template.size() &&
+                    isdigit((unsigned char)asm_template[i + 2]))) {
+            char modifier = isalpha((unsigned char)next) ? next : '\0';
+            size_t j = modifier ? i + 2 : i + 1;
+            size_t num = 0;
+            while (j < asm_template.size() && isdigit((unsigned char)asm_template[j]))
+                num = num * 10 + (asm_template[j++] - '0');
+
+            if (num >= num_operands) {
+                throw_ir_error(E144);
+            }
+            result += modifier ? "${" + std::to_string(num) + ":" + modifier + "}"
+                               : "$" + std::to_string(num);
+            i = j - 1;
+        } else {
+            result += c;
+        }
+    }
+    return result;
+}
+
 //                       Function declarations
 // ******************************************************************
 
 LLVM_IR *emit_llvm_ir(std::vector<AST_Expression *> *ast,
-                      const char *file_name);
+                      const char *file_name, const std::string &target_triple,
+                      bool discard_value_names, llvm::LLVMContext *shared_context,
+                      bool instrument_functions, bool only_reachable,
+                      const std::vector<std::string> *called_from_other_files,
+                      Function_Cache *cache);
+void free_llvm_ir(LLVM_IR *ir);
+Data_Type *get_data_type_from_llvm_type(llvm::Type *type);
+Data_Type *get_expression_data_type(AST_Expression *expr, LLVM_IR *ir);
+Data_Type *get_operand_data_type(AST_Binary_Expression *binary, LLVM_IR *ir);
+Data_Type *get_common_data_type(AST_Expression *left_expr, AST_Expression *right_expr,
+                                LLVM_IR *ir);
+bool is_signed_int_value(llvm::Value *val, AST_Expression *expr, LLVM_IR *ir);
 void write_llvm_ir_to_file(const char *llvm_file_name, llvm::Module *_module);
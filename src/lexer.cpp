@@ -5,6 +5,8 @@
 #include "lexer.h"
 #include "linker.h"
 #include "errors.h"
+#include "scan.h"
+#include "literals.h"
 
 /*
 
@@ -242,6 +244,7 @@ void handle_preprocessor_directive(Lexer *lexer,
         }
 
 	auto *actual_token = new Partial_Token{"", PTOK_ALNUM, lexer->file_name};
+	int value_pos = pos;
 	is_first_char = true;
 
         while (lexer->line[pos] && lexer->line[pos] != ' ' && lexer->line[pos] != '\t') {
@@ -259,18 +262,25 @@ void handle_preprocessor_directive(Lexer *lexer,
 		    throw_error(E006,
                         lexer->line, lexer->line_num, pos, lexer->file_name);
 		}
-	    } else if (
-		lexer->line[pos] != '.' &&
-		!is_numeric(lexer->line[pos])
-	    ) {
-		throw_error(E007,
-			    lexer->line, lexer->line_num, pos, lexer->file_name);
 	    }
 
             actual_token->val += lexer->line[pos];
             pos++;
         }
 
+	// (a numeric value is checked all at once, see literals.h)
+	if (actual_token->type == PTOK_NUMERIC) {
+	    Numeric_Literal literal;
+	    const char *invalid_char;
+	    const std::string &val = actual_token->val;
+	    if (decode_numeric_literal(val.data(), val.data() + val.size(),
+				       &literal, &invalid_char) != LITERAL_OK) {
+		throw_error(E007,
+			    lexer->line, lexer->line_num,
+			    value_pos + (int)(invalid_char - val.data()), lexer->file_name);
+	    }
+	}
+
 	// create a mapping
 	lexer->preprocessor_definitions_map.insert(token_defined, actual_token);
 	return;
@@ -340,6 +350,25 @@ void handle_preprocessor_directive(Lexer *lexer,
 inline void make_token_as_per_ptok(Lexer *lexer, std::string &curr,
                                    Partial_Token_Type ptok, int pos) {
     if (ptok == PTOK_NUMERIC) {
+        // checking the literal here, where we know where each char of it is
+        // (it ends right before pos, unless it came from a #define)
+        Numeric_Literal literal;
+        const char *invalid_char;
+        Numeric_Literal_Status status = decode_numeric_literal(
+            curr.data(), curr.data() + curr.size(), &literal, &invalid_char);
+
+        if (status != LITERAL_OK) {
+            int error_pos = std::max(pos - (int)curr.size(), 0) + (int)(invalid_char - curr.data());
+            bool is_decimal = curr.size() < 2 || (curr[1] != 'x' && curr[1] != 'X' && curr[1] != 'b' && curr[1] != 'B');
+
+            if (status == LITERAL_TOO_LARGE)
+                throw_error(E149, lexer->line, lexer->line_num, error_pos, lexer->file_name);
+            else if (is_decimal && is_alpha(*invalid_char))
+                throw_error(E009, lexer->line, lexer->line_num, error_pos, lexer->file_name);
+            else
+                throw_error(E148, lexer->line, lexer->line_num, error_pos, lexer->file_name);
+        }
+
         lexer->tokens.push_back(Token{curr, TOKEN_NUMERIC_LITERAL,
                                       lexer->line_num, pos, lexer->file_name});
         return;
@@ -353,8 +382,8 @@ inline void make_token_as_per_ptok(Lexer *lexer, std::string &curr,
 
     for (int i = 0; i < TOTAL_KEYWORDS; i++) {
         if (KEYWORDS[i] == curr) {
-            lexer->tokens.push_back(Token{curr, TOKEN_KEYWORD, lexer->line_num,
-                                          pos, lexer->file_name});
+            lexer->tokens.push_back(Token{{}, TOKEN_KEYWORD, lexer->line_num,
+                                          pos, lexer->file_name, i});
             return;
         }
     }
@@ -370,6 +399,155 @@ inline void make_token_as_per_ptok(Lexer *lexer, std::string &curr,
         Token{curr, TOKEN_IDENTIFIER, lexer->line_num, pos, lexer->file_name});
 }
 
+// moves past the run of the class that starts at pos (see scan.h),
+// and returns where it ends
+inline int skip_run(Lexer *lexer, int pos, Scan_Class scan_class) {
+    const char *line = lexer->line.c_str();
+    return pos + (int)scan_run(line + pos, line + lexer->line.size(), scan_class);
+}
+
+//                     Operators
+// ***************************************************
+
+/*
+
+The brackets, operators and other symbols are all recognized
+by one DFA, which is generated (at compile time) from the
+list of them below. each state is a prefix of some of them,
+and the DFA takes the longest one that matches (maximal munch),
+so "<<=" is one token, and not "<<" and then "=".
+
+the chars are first mapped to a class (the chars that are in
+no symbol are class 0, where every state stops), so the
+transition table only needs a column per char that is used.
+
+*/
+
+struct Symbol_Spelling {
+    const char *text;
+    Token_Type type;
+};
+
+const Symbol_Spelling SYMBOL_SPELLINGS[] = {
+    {"{", TOKEN_LEFT_BRACE},   {"}", TOKEN_RIGHT_BRACE},   {"(", TOKEN_LEFT_PAREN},
+    {")", TOKEN_RIGHT_PAREN},  {"[", TOKEN_LEFT_SQUARE},   {"]", TOKEN_RIGHT_SQUARE},
+    {",", TOKEN_SEPARATOR},    {";", TOKEN_DELIMITER},     {":", TOKEN_COLON},
+    {".", TOKEN_DOT},          {"~", TOKEN_BIT_NOT},
+    {"!", TOKEN_NOT},          {"!=", TOKEN_NOTEQ},
+    {"+", TOKEN_PLUS},         {"++", TOKEN_INCREMENT},    {"+=", TOKEN_PLUSEQ},
+    {"-", TOKEN_MINUS},        {"--", TOKEN_DECREMENT},    {"-=", TOKEN_MINUSEQ},
+    {"*", TOKEN_STAR},         {"*=", TOKEN_MULTIPLYEQ},
+    {"/", TOKEN_DIVIDE},       {"/=", TOKEN_DIVIDEEQ},
+    {"%", TOKEN_MOD},          {"%=", TOKEN_MODEQ},
+    {"<", TOKEN_LESS},         {"<=", TOKEN_LESSEQ},       {"<<", TOKEN_LSHIFT},
+    {"<<=", TOKEN_LSHIFT_EQ},
+    {">", TOKEN_GREATER},      {">=", TOKEN_GREATEREQ},    {">>", TOKEN_RSHIFT},
+    {">>=", TOKEN_RSHIFT_EQ},
+    {"=", TOKEN_ASSIGN},       {"==", TOKEN_EQUAL},
+    {"&", TOKEN_AMPERSAND},    {"&=", TOKEN_BIT_ANDEQ},    {"&&", TOKEN_AND},
+    {"&&=", TOKEN_ANDEQ},
+    {"|", TOKEN_BIT_OR},       {"|=", TOKEN_BIT_OREQ},     {"||", TOKEN_OR},
+    {"||=", TOKEN_OREQ},
+    {"^", TOKEN_XOR},          {"^=", TOKEN_XOREQ},
+};
+
+const int TOTAL_SYMBOL_SPELLINGS = sizeof(SYMBOL_SPELLINGS) / sizeof(SYMBOL_SPELLINGS[0]);
+const int MAX_SYMBOL_STATES = 64;
+const int MAX_SYMBOL_CHAR_CLASSES = 32;
+
+struct Symbol_DFA {
+    uint8_t char_class[256] = {};
+    uint8_t next_state[MAX_SYMBOL_STATES][MAX_SYMBOL_CHAR_CLASSES] = {}; // (0 is "stop")
+    int8_t accepted[MAX_SYMBOL_STATES] = {};  // (index into SYMBOL_SPELLINGS, or -1)
+    bool can_go_on[MAX_SYMBOL_STATES] = {};   // (whether it has any next state)
+    int num_states = 1;
+    int num_char_classes = 1;
+};
+
+// builds the DFA (a trie of the spellings, with state 0 as the root)
+constexpr Symbol_DFA make_symbol_dfa() {
+    Symbol_DFA dfa;
+    for (int state = 0; state < MAX_SYMBOL_STATES; state++)
+        dfa.accepted[state] = -1;
+
+    for (int i = 0; i < TOTAL_SYMBOL_SPELLINGS; i++) {
+        int state = 0;
+
+        for (const char *c = SYMBOL_SPELLINGS[i].text; *c; c++) {
+            uint8_t &char_class = dfa.char_class[(uint8_t)*c];
+            if (char_class == 0)
+                char_class = dfa.num_char_classes++;
+
+            uint8_t &next = dfa.next_state[state][char_class];
+            if (next == 0)
+                next = dfa.num_states++;
+
+            dfa.can_go_on[state] = true;
+            state = next;
+        }
+        dfa.accepted[state] = i;
+    }
+    return dfa;
+}
+
+constexpr Symbol_DFA SYMBOL_DFA = make_symbol_dfa();
+static_assert(SYMBOL_DFA.num_states <= MAX_SYMBOL_STATES, "too many states for the symbol DFA");
+static_assert(SYMBOL_DFA.num_char_classes <= MAX_SYMBOL_CHAR_CLASSES, "too many char classes for the symbol DFA");
+
+// makes a token of the longest symbol that starts at pos, and moves past it
+inline void make_operator_token(Lexer *lexer, int *pos) {
+    const char *line = lexer->line.c_str() + *pos;
+    int state = 0, length = 0;
+    int accepted = -1, accepted_length = 0;
+
+    while (1) {
+        int next = SYMBOL_DFA.next_state[state][SYMBOL_DFA.char_class[(uint8_t)line[length]]];
+        if (next == 0)
+            break;
+
+        state = next;
+        length++;
+        if (SYMBOL_DFA.accepted[state] != -1) {
+            accepted = SYMBOL_DFA.accepted[state];
+            accepted_length = length;
+        }
+    }
+
+    if (accepted == -1) {
+        throw_error(E014, lexer->line,
+                    lexer->line_num, *pos, lexer->file_name);
+    }
+
+    // the token is placed at the last char that was looked at to make
+    // it (the one after it, if it could have gone on with more chars)
+    int last_char_looked_at = *pos + length - 1 + (SYMBOL_DFA.can_go_on[state] ? 1 : 0);
+
+    // (the text is not kept, since it follows from the type)
+    lexer->tokens.push_back(Token{{}, SYMBOL_SPELLINGS[accepted].type, lexer->line_num,
+                                  last_char_looked_at, lexer->file_name});
+    *pos += accepted_length;
+}
+
+const std::string &token_text(const Token &tok) {
+    static const std::string EMPTY;
+    static const std::vector<std::string> SYMBOL_TEXTS = [] {
+        std::vector<std::string> texts;
+        for (const Symbol_Spelling &spelling : SYMBOL_SPELLINGS)
+            texts.push_back(spelling.text);
+        return texts;
+    }();
+
+    if (tok.type == TOKEN_KEYWORD && tok.keyword >= 0)
+        return KEYWORDS[tok.keyword];
+    if (!tok.val.empty())
+        return tok.val;
+    for (int i = 0; i < TOTAL_SYMBOL_SPELLINGS; i++) {
+        if (SYMBOL_SPELLINGS[i].type == tok.type)
+            return SYMBOL_TEXTS[i];
+    }
+    return EMPTY;
+}
+
 // generates tokens for a line
 void generate_tokens(Lexer *lexer, bool *inside_multiline_comment) {
     int pos = 0;
@@ -393,9 +571,7 @@ void generate_tokens(Lexer *lexer, bool *inside_multiline_comment) {
 	    // must start at the beginning of a line.
 
 	    // skip whitespace
-            while (lexer->line[pos] &&
-                   (lexer->line[pos] == ' ' || lexer->line[pos] == '\t'))
-                   pos++;
+            pos = skip_run(lexer, pos, SCAN_WHITESPACE);
 
             if (lexer->line[pos] != '#') break;
             pos++;
@@ -421,23 +597,24 @@ void generate_tokens(Lexer *lexer, bool *inside_multiline_comment) {
             // until we reach '*/'
 
             if (*inside_multiline_comment) {
-                while (lexer->line[pos]) {
-                    if (lexer->line[pos] == '*') {
-                        pos++;
-                        if (lexer->line[pos] && lexer->line[pos] == '/') {
-                            *inside_multiline_comment = false;
-                            pos++;
-                            break;
-                        }
+                // (jumping from one '*' to the next, and checking the
+                // next char without moving past the '*', so that a line
+                // ending in '*' or a '**/' is handled right)
+                while (1) {
+                    pos = skip_run(lexer, pos, SCAN_COMMENT);
+                    if (!lexer->line[pos])
+                        break;
+                    if (lexer->line[pos + 1] == '/') {
+                        *inside_multiline_comment = false;
+                        pos += 2;
+                        break;
                     }
                     pos++;
                 }
             }
 
             // skip whitespace
-            while (lexer->line[pos] &&
-                   (lexer->line[pos] == ' ' || lexer->line[pos] == '\t'))
-                pos++;
+            pos = skip_run(lexer, pos, SCAN_WHITESPACE);
 
             currently_reading_token = true;
             continue;
@@ -492,7 +669,9 @@ void generate_tokens(Lexer *lexer, bool *inside_multiline_comment) {
         }
 
         // handling dots in float numeric literals
-        if (c == '.' && curr != "" && ptok == PTOK_NUMERIC) {
+        // (but not the ".." of a range, like in 0..10)
+        if (c == '.' && curr != "" && ptok == PTOK_NUMERIC &&
+            lexer->line[pos + 1] != '.') {
             curr += c;
             pos++;
 
@@ -508,9 +687,12 @@ void generate_tokens(Lexer *lexer, bool *inside_multiline_comment) {
             // if we start with a digit, it is numeric type
             if (curr == "")
                 ptok = PTOK_NUMERIC;
-            curr += c;
 
-            pos++;
+            // (along with the rest of the digits, and the letters and
+            // '_'s of the literal, which are checked once it is done)
+            int run_end = skip_run(lexer, pos, SCAN_IDENTIFIER);
+            curr.append(lexer->line, pos, run_end - pos);
+            pos = run_end;
 
 	    if (lexer->line[pos] == NULL) {
 		c = NULL;
@@ -530,10 +712,11 @@ void generate_tokens(Lexer *lexer, bool *inside_multiline_comment) {
                     lexer->line, lexer->line_num, pos, lexer->file_name);
             }
 
-            curr += c;
+            // (the rest of the identifier is taken all at once)
+            int run_end = skip_run(lexer, pos, SCAN_IDENTIFIER);
+            curr.append(lexer->line, pos, run_end - pos);
             ptok = PTOK_ALNUM;
-
-            pos++;
+            pos = run_end;
 
 	    if (lexer->line[pos] == NULL) {
 		c = NULL;
@@ -566,47 +749,6 @@ void generate_tokens(Lexer *lexer, bool *inside_multiline_comment) {
 
         // handle the symbol
         switch (c) {
-        /* brackets */
-        case '{': {
-            lexer->tokens.push_back(Token{
-                "{", TOKEN_LEFT_BRACE, lexer->line_num, pos, lexer->file_name});
-            pos++;
-            break;
-        }
-        case '}': {
-            lexer->tokens.push_back(Token{"}", TOKEN_RIGHT_BRACE,
-                                          lexer->line_num, pos,
-                                          lexer->file_name});
-            pos++;
-            break;
-        }
-        case '(': {
-            lexer->tokens.push_back(Token{
-                "(", TOKEN_LEFT_PAREN, lexer->line_num, pos, lexer->file_name});
-            pos++;
-            break;
-        }
-        case ')': {
-            lexer->tokens.push_back(Token{")", TOKEN_RIGHT_PAREN,
-                                          lexer->line_num, pos,
-                                          lexer->file_name});
-            pos++;
-            break;
-        }
-        case '[': {
-            lexer->tokens.push_back(Token{"[", TOKEN_LEFT_SQUARE,
-                                          lexer->line_num, pos,
-                                          lexer->file_name});
-            pos++;
-            break;
-        }
-        case ']': {
-            lexer->tokens.push_back(Token{"]", TOKEN_RIGHT_SQUARE,
-                                          lexer->line_num, pos,
-                                          lexer->file_name});
-            pos++;
-            break;
-        }
         /* char and string literals */
         case '\'': {
             char literal_val = lexer->line[++pos];
@@ -652,6 +794,15 @@ void generate_tokens(Lexer *lexer, bool *inside_multiline_comment) {
             char literal_char = lexer->line[pos];
 
             while (literal_char && literal_char != '\"') {
+                // (the chars that don't need a closer look are taken all at once)
+                int run_end = skip_run(lexer, pos, SCAN_STRING);
+                if (run_end > pos) {
+                    literal.append(lexer->line, pos, run_end - pos);
+                    pos = run_end;
+                    literal_char = lexer->line[pos];
+                    continue;
+                }
+
 		// handle escape sequences
 		if (literal_char == '\\') {
 		    pos++;
@@ -690,302 +841,29 @@ void generate_tokens(Lexer *lexer, bool *inside_multiline_comment) {
             pos++;
             break;
         }
-        /* other symbols */
-        case '~': {
-            lexer->tokens.push_back(Token{"~", TOKEN_BIT_NOT, lexer->line_num,
-                                          pos, lexer->file_name});
-            pos++;
-            break;
-        }
-        case '.': {
-            lexer->tokens.push_back(
-                Token{".", TOKEN_DOT, lexer->line_num, pos, lexer->file_name});
-            pos++;
-            break;
-        }
-        case ',': {
-            lexer->tokens.push_back(Token{",", TOKEN_SEPARATOR, lexer->line_num,
-                                          pos, lexer->file_name});
-            pos++;
-            break;
-        }
-        case ';': {
-            lexer->tokens.push_back(Token{";", TOKEN_DELIMITER, lexer->line_num,
-                                          pos, lexer->file_name});
-            pos++;
-            break;
-        }
-        case ':': {
-            lexer->tokens.push_back(Token{ ";", TOKEN_COLON, lexer->line_num,
-                                          pos, lexer->file_name });
-            pos++;
-            break;
-        }
-        /* (! !=) */
-        case '!': {
-            pos++;
-            char next = lexer->line[pos];
-
-            if (next && next == '=') {
-                lexer->tokens.push_back(Token{
-                    "!=", TOKEN_NOTEQ, lexer->line_num, pos, lexer->file_name});
-                pos++;
-                break;
-            }
-            lexer->tokens.push_back(
-                Token{"!", TOKEN_NOT, lexer->line_num, pos, lexer->file_name});
-            break;
-        }
-        /* (+ ++ +=)  */
-        case '+': {
-            pos++;
-            char next = lexer->line[pos];
-
-            if (next && next == '=') {
-                lexer->tokens.push_back(Token{"+=", TOKEN_PLUSEQ,
-                                              lexer->line_num, pos,
-                                              lexer->file_name});
-                pos++;
-                break;
-            } else if (next && next == '+') {
-                lexer->tokens.push_back(Token{"++", TOKEN_INCREMENT,
-                                              lexer->line_num, pos,
-                                              lexer->file_name});
-                pos++;
-                break;
-            }
-            lexer->tokens.push_back(
-                Token{"+", TOKEN_PLUS, lexer->line_num, pos, lexer->file_name});
-            break;
-        }
-        /* (- -- -=) */
-        case '-': {
-            pos++;
-            char next = lexer->line[pos];
-
-            if (next && next == '=') {
-                lexer->tokens.push_back(Token{"-=", TOKEN_MINUSEQ,
-                                              lexer->line_num, pos,
-                                              lexer->file_name});
-                pos++;
-                break;
-            } else if (next && next == '-') {
-                lexer->tokens.push_back(Token{"--", TOKEN_DECREMENT,
-                                              lexer->line_num, pos,
-                                              lexer->file_name});
-                pos++;
-                break;
-            }
-            lexer->tokens.push_back(Token{"-", TOKEN_MINUS, lexer->line_num,
-                                          pos, lexer->file_name});
-            break;
-        }
-        /* (* *=) */
-        case '*': {
-            pos++;
-            char next = lexer->line[pos];
-
-            if (next && next == '=') {
-                lexer->tokens.push_back(Token{"*=", TOKEN_MULTIPLYEQ,
-                                              lexer->line_num, pos,
-                                              lexer->file_name});
-                pos++;
-                break;
-            }
-            lexer->tokens.push_back(
-                Token{"*", TOKEN_STAR, lexer->line_num, pos, lexer->file_name});
-            break;
-        }
-        /* (/ /= // /*) */
+        /* comments (which start like the '/' operator) */
         case '/': {
-            pos++;
-            char next = lexer->line[pos];
+            char next = lexer->line[pos + 1];
 
-            if (next && next == '=') {
-                lexer->tokens.push_back(Token{"/=", TOKEN_DIVIDEEQ,
-                                              lexer->line_num, pos,
-                                              lexer->file_name});
-                pos++;
-                break;
-            } else if (next && next == '/') {
+            if (next == '/') {
                 // encountered a comment
                 // (so the remaining line ahead will be ignored)
 
                 encountered_comment = true;
                 break;
-            } else if (next && next == '*') {
+            } else if (next == '*') {
                 // encountered a multi-line comment
 
                 *inside_multiline_comment = true;
-                pos++;
-                break;
-            }
-            lexer->tokens.push_back(Token{"/", TOKEN_DIVIDE, lexer->line_num,
-                                          pos, lexer->file_name});
-            break;
-        }
-        /* (% %=) */
-        case '%': {
-            pos++;
-            char next = lexer->line[pos];
-
-            if (next && next == '=') {
-                lexer->tokens.push_back(Token{
-                    "%=", TOKEN_MODEQ, lexer->line_num, pos, lexer->file_name});
-                pos++;
-                break;
-            }
-            lexer->tokens.push_back(
-                Token{"%", TOKEN_MOD, lexer->line_num, pos, lexer->file_name});
-            break;
-        }
-        /* (< <= << <<=) */
-        case '<': {
-            pos++;
-            char next = lexer->line[pos];
-
-            if (next && next == '=') {
-                lexer->tokens.push_back(Token{"<=", TOKEN_LESSEQ,
-                                              lexer->line_num, pos,
-                                              lexer->file_name});
-                pos++;
-                break;
-            } else if (next && next == '<') {
-                next = lexer->line[++pos];
-                if (next && next == '=') {
-                    lexer->tokens.push_back(Token{"<<=", TOKEN_LSHIFT_EQ,
-                                                  lexer->line_num, pos,
-                                                  lexer->file_name});
-                    pos++;
-                    break;
-                }
-                lexer->tokens.push_back(Token{"<<", TOKEN_LSHIFT,
-                                              lexer->line_num, pos,
-                                              lexer->file_name});
-                break;
-            }
-            lexer->tokens.push_back(
-                Token{"<", TOKEN_LESS, lexer->line_num, pos, lexer->file_name});
-            break;
-        }
-        /* (> >= >> >>=) */
-        case '>': {
-            pos++;
-            char next = lexer->line[pos];
-
-            if (next && next == '=') {
-                lexer->tokens.push_back(Token{">=", TOKEN_GREATEREQ,
-                                              lexer->line_num, pos,
-                                              lexer->file_name});
-                pos++;
-                break;
-            } else if (next && next == '>') {
-                next = lexer->line[++pos];
-                if (next && next == '=') {
-                    lexer->tokens.push_back(Token{">>=", TOKEN_RSHIFT_EQ,
-                                                  lexer->line_num, pos,
-                                                  lexer->file_name});
-                    pos++;
-                    break;
-                }
-                lexer->tokens.push_back(Token{">>", TOKEN_RSHIFT,
-                                              lexer->line_num, pos,
-                                              lexer->file_name});
-                break;
-            }
-            lexer->tokens.push_back(Token{">", TOKEN_GREATER, lexer->line_num,
-                                          pos, lexer->file_name});
-            break;
-        }
-        /* (= ==) */
-        case '=': {
-            pos++;
-            char next = lexer->line[pos];
-
-            if (next && next == '=') {
-                lexer->tokens.push_back(Token{
-                    "==", TOKEN_EQUAL, lexer->line_num, pos, lexer->file_name});
-                pos++;
-                break;
-            }
-            lexer->tokens.push_back(Token{"=", TOKEN_ASSIGN, lexer->line_num,
-                                          pos, lexer->file_name});
-            break;
-        }
-        /* (& && &= &&=) */
-        case '&': {
-            pos++;
-            char next = lexer->line[pos];
-
-            if (next && next == '=') {
-                lexer->tokens.push_back(Token{"&=", TOKEN_BIT_ANDEQ,
-                                              lexer->line_num, pos,
-                                              lexer->file_name});
-                pos++;
-                break;
-            } else if (next && next == '&') {
-                next = lexer->line[++pos];
-                if (next && next == '=') {
-                    lexer->tokens.push_back(Token{"&&=", TOKEN_ANDEQ,
-                                                  lexer->line_num, pos,
-                                                  lexer->file_name});
-                    pos++;
-                    break;
-                }
-                lexer->tokens.push_back(Token{"&&", TOKEN_AND, lexer->line_num,
-                                              pos, lexer->file_name});
-                break;
-            }
-            lexer->tokens.push_back(Token{"&", TOKEN_AMPERSAND, lexer->line_num,
-                                          pos, lexer->file_name});
-            break;
-        }
-        /* (| || |= ||=) */
-        case '|': {
-            pos++;
-            char next = lexer->line[pos];
-
-            if (next && next == '=') {
-                lexer->tokens.push_back(Token{"|=", TOKEN_BIT_OREQ,
-                                              lexer->line_num, pos,
-                                              lexer->file_name});
-                pos++;
-                break;
-            } else if (next && next == '|') {
-                next = lexer->line[++pos];
-                if (next && next == '=') {
-                    lexer->tokens.push_back(Token{"||=", TOKEN_OREQ,
-                                                  lexer->line_num, pos,
-                                                  lexer->file_name});
-                    pos++;
-                    break;
-                }
-                lexer->tokens.push_back(Token{"||", TOKEN_OR, lexer->line_num,
-                                              pos, lexer->file_name});
-                break;
-            }
-            lexer->tokens.push_back(Token{"|", TOKEN_BIT_OR, lexer->line_num,
-                                          pos, lexer->file_name});
-            break;
-        }
-        /* (^ ^=) */
-        case '^': {
-            pos++;
-            char next = lexer->line[pos];
-
-            if (next && next == '=') {
-                lexer->tokens.push_back(Token{
-                    "^=", TOKEN_XOREQ, lexer->line_num, pos, lexer->file_name});
-                pos++;
+                pos += 2;
                 break;
             }
-            lexer->tokens.push_back(
-                Token{"^", TOKEN_XOR, lexer->line_num, pos, lexer->file_name});
+            make_operator_token(lexer, &pos);
             break;
         }
+        /* brackets, operators and other symbols */
         default: {
-            throw_error(E014, lexer->line,
-                        lexer->line_num, pos, lexer->file_name);
+            make_operator_token(lexer, &pos);
         }
         }
 
@@ -1002,6 +880,8 @@ Lexer *perform_lexical_analysis(const char *file_name) {
 
     std::ifstream file(file_name);
     if (!file.is_open()) {
+        if (error_recovery_hook)
+            error_recovery_hook(E087, file_name, 0, 0);
         fprintf(stderr, E087, file_name);
         exit(1);
     }
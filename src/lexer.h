@@ -36,6 +36,8 @@ struct Lexer {
 
     Symbol_Table symbol_table; // to store symbols during parsing
     bool entry_point_found = false;
+    bool parsing_async_function = false; // (await is only allowed inside these)
+    std::string parameter_pack; // (of the function that is being parsed, if it has one)
 
     smap<Data_Type *> type_info_map; // mapping type names to their data types
     void init_primitive_types();
@@ -139,14 +141,25 @@ const std::string KEYWORDS[] = {
     "case",
     "for",
     "while",
+    "parallel",
+    "in",
 
     /* jumps */
     "return",
     "break",
     "continue",
 
+    /* qualifiers */
+    "const",
+    "atomic",
+
+    /* coroutines */
+    "async",
+    "await",
+
     /* special builtins */
     "varg",
+    "asm",
     "typedef", // can only be used in global scope
     "enum" // can only be used in global scope
 };
@@ -154,6 +167,9 @@ const std::string KEYWORDS[] = {
 const size_t TOTAL_KEYWORDS = sizeof(KEYWORDS) / sizeof(KEYWORDS[0]);
 const size_t TOTAL_DATA_TYPES = sizeof(DATA_TYPES) / sizeof(DATA_TYPES[0]);
 
+// the text of a token, as it was written
+const std::string &token_text(const Token &tok);
+
 //                Helper functions
 // ************************************************
 
@@ -188,9 +204,19 @@ inline std::string get_filename_from_path(const std::string& path) {
     return path.substr(pos + 1);
 }
 
+// when set, errors are handed to this instead of terminating the
+// program. (only the language server sets it, so that an error in
+// one function doesn't take down the whole server. it must not return:
+// the server throws the error back out, to where the parsing began.)
+inline void (*error_recovery_hook)(const char *message, const std::string &file_name,
+                                   int line_num, int pos) = NULL;
+
 // to print error messages
 inline void throw_error(const char *message, const std::string &line,
                         int line_num, int pos, std::string &file_name) {
+    if (error_recovery_hook)
+        error_recovery_hook(message, file_name, line_num, pos);
+
     printf("%s(%d,%d): ", get_filename_from_path(file_name).c_str(), line_num, pos);
     fprintf(stderr, message);
     printf("\n\n");
@@ -208,10 +234,11 @@ inline void throw_error(const char *message, const std::string &line,
 // to print the list of tokens generated by the lexer
 inline void print_tokens(Lexer *lexer) {
     for (Token &tok : lexer->tokens) {
-        printf("<\'%s\', %d>\n", tok.val.c_str(), tok.type);
+        printf("<\'%s\', %d>\n", token_text(tok).c_str(), tok.type);
     }
 }
 
 //               Function definitions
 // **************************************************
+void generate_tokens(Lexer *lexer, bool *inside_multiline_comment);
 Lexer *perform_lexical_analysis(const char *file_name);
@@ -3,6 +3,7 @@
 //
 
 #include "linker.h"
+#include "counters.h"
 
 
 // to link all the LLVM modules
@@ -29,6 +30,130 @@ link_modules(std::vector<std::unique_ptr<llvm::Module>> module_list) {
     return linked_module;
 }
 
+// the link stage. it links the units in the order of their files, waiting
+// for the next one whenever it hasn't been sent yet. all the units that are
+// there (in order) are taken at once, and their modules are all read in
+// before any of them are linked, which turns out to be faster than reading
+// and linking them one at a time.
+void run_link_stage(Link_Stage *stage) {
+    std::unique_ptr<llvm::Linker> linker;
+    std::vector<Link_Unit *> units;
+    std::vector<std::unique_ptr<llvm::Module>> modules;
+
+    for (size_t next_unit = 0; next_unit < stage->units.size();) {
+        units.clear();
+        {
+            std::unique_lock<std::mutex> lock(stage->mutex);
+            stage->unit_sent.wait(lock, [&]() { return stage->units[next_unit] != nullptr; });
+            while (next_unit < stage->units.size() && stage->units[next_unit])
+                units.push_back(stage->units[next_unit++]);
+        }
+
+        // (once a file has failed there won't be any output, so
+        // the rest of the units are only waited for)
+        modules.clear();
+        for (Link_Unit *unit : units) {
+            if (unit->failed)
+                stage->failed = true;
+            if (!stage->failed) {
+                Phase_Counter counter(PHASE_MOVE);
+                modules.push_back(read_module_from_bitcode(unit->bitcode, unit->module_name, stage->context));
+                stage->libs_to_link.insert(stage->libs_to_link.end(),
+                                           unit->libs_to_link.begin(), unit->libs_to_link.end());
+            }
+            delete unit;
+        }
+        if (stage->failed)
+            continue;
+
+        // (the first module is the one that the rest are linked into)
+        for (std::unique_ptr<llvm::Module> &module : modules) {
+            if (!stage->program) {
+                stage->program = std::move(module);
+                linker = std::make_unique<llvm::Linker>(*stage->program);
+                continue;
+            }
+            std::string module_name = module->getModuleIdentifier();
+            Phase_Counter counter(PHASE_LINK);
+            if (linker->linkInModule(std::move(module))) {
+                fprintf(stderr, "LINKER ERROR: Failed to link module %s.\n", module_name.c_str());
+                exit(1);
+            }
+        }
+    }
+}
+
+// starts the link stage, for the given number of files. with
+// in_parallel, it runs on a thread of its own, while the files are
+// compiled. (else, it all happens in finish_link_stage.)
+void start_link_stage(Link_Stage *stage, size_t num_units, bool discard_value_names,
+                      bool in_parallel) {
+    stage->context.setDiscardValueNames(discard_value_names);
+    stage->units.assign(num_units, nullptr);
+    if (in_parallel)
+        stage->thread = std::thread([stage]() {
+            set_counter_thread_name("link stage");
+            run_link_stage(stage);
+        });
+}
+
+// sends the unit of the file at the index to the link stage
+// (every file must send one, even if it failed, since the ones
+// after it are only linked once it is there)
+void send_to_link_stage(Link_Stage *stage, size_t index, Link_Unit *unit) {
+    {
+        std::lock_guard<std::mutex> lock(stage->mutex);
+        stage->units[index] = unit;
+    }
+    stage->unit_sent.notify_one();
+}
+
+// links the module of a file into the batch of its thread
+// (both are under the thread's context, so nothing is moved)
+void add_to_link_batch(Link_Batch *batch, std::unique_ptr<llvm::Module> module,
+                       std::vector<std::string> &libs_to_link) {
+    batch->libs_to_link.insert(batch->libs_to_link.end(),
+                               libs_to_link.begin(), libs_to_link.end());
+
+    if (!batch->module) {
+        batch->module = std::move(module);
+        batch->linker = std::make_unique<llvm::Linker>(*batch->module);
+        return;
+    }
+    std::string module_name = module->getModuleIdentifier();
+    Phase_Counter counter(PHASE_LINK);
+    if (batch->linker->linkInModule(std::move(module))) {
+        fprintf(stderr, "LINKER ERROR: Failed to link module %s.\n", module_name.c_str());
+        exit(1);
+    }
+}
+
+// sends the batch of a thread to the link stage, as the unit at
+// the index (the threads' runs of files are in order, so their
+// units are too)
+void send_batch_to_link_stage(Link_Stage *stage, size_t index, Link_Batch *batch) {
+    auto *unit = new Link_Unit;
+    unit->failed = batch->failed || !batch->module;
+    if (!unit->failed) {
+        unit->module_name = batch->module->getModuleIdentifier();
+        Phase_Counter counter(PHASE_MOVE);
+        write_module_to_bitcode(batch->module.get(), unit->bitcode);
+    }
+    unit->libs_to_link = std::move(batch->libs_to_link);
+
+    batch->linker.reset();
+    batch->module.reset();
+    send_to_link_stage(stage, index, unit);
+}
+
+// waits for the link stage to link the units of all the files
+void finish_link_stage(Link_Stage *stage) {
+    if (stage->thread.joinable())
+        stage->thread.join();
+    else
+        run_link_stage(stage);
+}
+
 // obtain the path to the compiler .exe file (which is in the bin/ folder).
 // this is crucial to locate include/ headers and lib/ files.
 std::filesystem::path get_compiler_executable_path()
@@ -352,6 +477,7 @@ void make_executable_from_object(std::string object_file_name)
     "vcruntime.lib "
     "msvcrt.lib "
     "libcmt.lib "
+    "ws2_32.lib " // (for the sockets of async.bc)
     "/SUBSYSTEM:CONSOLE "
     "/ENTRY:mainCRTStartup "
     "/NODEFAULTLIB "
@@ -15,14 +15,33 @@ involves two kinds of linking:
     operating system, along with the standard
     libraries for this language.
 
+(1) is done by the link stage, which is a thread of its
+own that links the modules in while the other files are
+still being compiled. every file sends its module to it as
+soon as it is done, and the modules are linked in the order
+of the files on the command line (whatever order they are
+done in), so that the output doesn't depend on the timing.
+(with a single core, it just links them all at the end.)
+
+with -fbatch-modules, each thread takes a run of the files
+(in order) instead, and emits all of them into a context
+of its own, linking their modules together as it goes. it
+then sends a single unit, so that there are only as many
+contexts made, and modules moved to the shared context, as
+there are threads (instead of files). this is for lots of
+small files, where those fixed costs are most of the work.
+
 */
 
 #pragma once
 
 #include "llvm.h"
+#include <condition_variable>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include <stdio.h>
 
@@ -42,9 +61,50 @@ struct Cached_Paths {
 };
 
 
+// the module of a file, on its way to the link stage (as bitcode,
+// since it is still under the context of the file's thread)
+struct Link_Unit {
+    bool failed = false; // (the file had errors, so there is no module)
+    llvm::SmallVector<char, 0> bitcode;
+    std::string module_name;
+    std::vector<std::string> libs_to_link;
+};
+
+struct Link_Stage {
+    llvm::LLVMContext context; // the shared context
+    std::unique_ptr<llvm::Module> program; // (all the modules linked so far)
+    std::vector<std::string> libs_to_link;  // (that the files asked for, in order)
+    bool failed = false;
+
+    // the units sent by the files, by the index of the file. the ones
+    // that are done before the files before them wait here.
+    std::vector<Link_Unit *> units;
+    std::mutex mutex;
+    std::condition_variable unit_sent;
+
+    std::thread thread;
+};
+
+// the files of a thread, with -fbatch-modules
+struct Link_Batch {
+    llvm::LLVMContext context; // (that the IR of the files is emitted into)
+    std::unique_ptr<llvm::Module> module; // (the modules of the files, linked)
+    std::unique_ptr<llvm::Linker> linker;
+    std::vector<std::string> libs_to_link;
+    bool failed = false;
+};
+
 std::unique_ptr<llvm::Module>
 link_modules(std::vector<std::unique_ptr<llvm::Module>> module_list);
 
+void start_link_stage(Link_Stage *stage, size_t num_units, bool discard_value_names,
+                      bool in_parallel);
+void send_to_link_stage(Link_Stage *stage, size_t index, Link_Unit *unit);
+void finish_link_stage(Link_Stage *stage);
+void add_to_link_batch(Link_Batch *batch, std::unique_ptr<llvm::Module> module,
+                       std::vector<std::string> &libs_to_link);
+void send_batch_to_link_stage(Link_Stage *stage, size_t index, Link_Batch *batch);
+
 void make_executable_from_object(std::string object_file_name);
 std::filesystem::path get_compiler_executable_path();
 std::string get_include_path();
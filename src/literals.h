@@ -0,0 +1,154 @@
+//
+// literals.h
+//
+
+/*
+
+Decoding of numeric literals, straight from their text (a
+span of the source line, or the value of a token), without
+making any strings along the way.
+
+A numeric literal can be:
+
+    123        decimal
+    0x7F       hexadecimal (0x or 0X)
+    0b1010     binary (0b or 0B)
+    1_000_000  with underscores between the digits, to separate them
+    3.14       a float (decimal only)
+
+An integer literal gets the smallest type out of s32, s64
+and u64 that its value fits in. (it has no sign of its own,
+the '-' in front of it is a unary operator.) A float literal
+is an f64, which is parsed exactly (rounded to the nearest
+double), using std::from_chars.
+
+The lexer decodes each literal once to check it (since it
+knows where each char of it is, for the error), and the
+parser decodes it again to get its value.
+
+*/
+
+#pragma once
+
+#include <charconv>
+#include <stddef.h>
+#include <stdint.h>
+#include <system_error>
+
+
+enum Numeric_Literal_Kind { LITERAL_S32, LITERAL_S64, LITERAL_U64, LITERAL_F64 };
+
+enum Numeric_Literal_Status {
+    LITERAL_OK,
+    LITERAL_INVALID_CHAR, // (a char that can't be there, or a misplaced '_')
+    LITERAL_TOO_LARGE,
+};
+
+struct Numeric_Literal {
+    Numeric_Literal_Kind kind = LITERAL_S32;
+    union {
+        int32_t i_s32;
+        int64_t i_s64;
+        uint64_t i_u64;
+        double f_64;
+    } value;
+};
+
+// the value of a digit in the base (or -1, if it is not one)
+inline int digit_value(char c, int base) {
+    int value = -1;
+    if (c >= '0' && c <= '9')
+        value = c - '0';
+    else if (c >= 'a' && c <= 'f')
+        value = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+        value = c - 'A' + 10;
+    return value < base ? value : -1;
+}
+
+// decodes the literal in [begin, end). when it is not valid,
+// invalid_char is set to the char where the problem is.
+inline Numeric_Literal_Status decode_numeric_literal(const char *begin, const char *end,
+                                                     Numeric_Literal *literal,
+                                                     const char **invalid_char) {
+    *invalid_char = begin;
+
+    int base = 10;
+    const char *digits = begin;
+    if (end - begin >= 2 && begin[0] == '0') {
+        if (begin[1] == 'x' || begin[1] == 'X') base = 16;
+        if (begin[1] == 'b' || begin[1] == 'B') base = 2;
+        if (base != 10) digits += 2;
+    }
+
+    // (an '_' is only allowed between two digits)
+    bool is_float = false;
+    bool has_separators = false;
+    for (const char *p = digits; p < end; p++) {
+        if (*p == '.' && base == 10 && !is_float && p > digits && p[-1] != '_') {
+            is_float = true;
+            continue;
+        }
+        if (*p == '_' && p > digits && p + 1 < end &&
+            digit_value(p[-1], base) != -1 && digit_value(p[1], base) != -1) {
+            has_separators = true;
+            continue;
+        }
+        if (digit_value(*p, base) == -1) {
+            *invalid_char = p;
+            return LITERAL_INVALID_CHAR;
+        }
+    }
+    if (digits == end) {
+        *invalid_char = end - 1;
+        return LITERAL_INVALID_CHAR;
+    }
+
+    if (is_float) {
+        // std::from_chars doesn't skip separators, so those are
+        // copied without them (into a buffer on the stack)
+        char buffer[256];
+        const char *text = begin, *text_end = end;
+
+        if (has_separators) {
+            size_t length = 0;
+            for (const char *p = begin; p < end; p++) {
+                if (*p == '_') continue;
+                if (length == sizeof(buffer)) return LITERAL_TOO_LARGE;
+                buffer[length++] = *p;
+            }
+            text = buffer;
+            text_end = buffer + length;
+        }
+
+        double value = 0;
+        std::from_chars_result result = std::from_chars(text, text_end, value, std::chars_format::fixed);
+        if (result.ec == std::errc::result_out_of_range) return LITERAL_TOO_LARGE;
+        if (result.ec != std::errc() || result.ptr != text_end) return LITERAL_INVALID_CHAR;
+
+        literal->kind = LITERAL_F64;
+        literal->value.f_64 = value;
+        return LITERAL_OK;
+    }
+
+    uint64_t value = 0;
+    for (const char *p = digits; p < end; p++) {
+        if (*p == '_') continue;
+
+        uint64_t digit = (uint64_t)digit_value(*p, base);
+        if (value > (UINT64_MAX - digit) / base) return LITERAL_TOO_LARGE;
+        value = value * base + digit;
+    }
+
+    if (value <= INT32_MAX) {
+        literal->kind = LITERAL_S32;
+        literal->value.i_s32 = (int32_t)value;
+    } else if (value <= INT64_MAX) {
+        literal->kind = LITERAL_S64;
+        literal->value.i_s64 = (int64_t)value;
+    } else {
+        literal->kind = LITERAL_U64;
+        literal->value.i_u64 = value;
+    }
+    return LITERAL_OK;
+}
@@ -10,6 +10,8 @@
 #include "llvm/IR/Verifier.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/TargetParser/Triple.h"
 
 /* for running LLVM backend */
 #include "llvm/IR/LegacyPassManager.h"
@@ -55,27 +57,33 @@
 // AFTER all modules have been created; and (3) then link all these new modules
 // (which are now under a single shared context).
 
-// The function below helps perform step (2) in this process. Based on some
+// The functions below help perform step (2) in this process. Based on some
 // reading it seems that earlier LLVM had an inbuilt llvm::CloneModule function
 // that could move modules to a different context, but in LLVM 21 (which I am
 // using for this project), the CloneModule function does not have any variant
 // that moves a module to a context other than its original context.
 
-// DESCRIPTION:
-//     clone module into a destination context by writing bitcode to an
-//     in-memory buffer, then parsing that buffer back into dest_context.
-inline std::unique_ptr<llvm::Module>
-move_module_to_context(llvm::Module *mod, llvm::LLVMContext &new_context) {
-    // write bitcode into a SmallVector<char> buffer
-    llvm::SmallVector<char, 0> buffer;
-    llvm::raw_svector_ostream os(buffer);
+// So a module is moved by writing it to bitcode in memory, and then parsing
+// that back into the other context. These are two separate steps, so that
+// everything for the file (its context, with the original module) can be freed
+// in between, and only the bitcode is held while the shared context is busy.
 
+// writes the module to an in-memory buffer of bitcode
+inline void write_module_to_bitcode(llvm::Module *mod,
+                                    llvm::SmallVector<char, 0> &buffer) {
+    llvm::raw_svector_ostream os(buffer);
     llvm::WriteBitcodeToFile(*mod, os);
+}
 
+// parses the bitcode back into a module in new_context
+// (module_name is the name of the original module)
+inline std::unique_ptr<llvm::Module>
+read_module_from_bitcode(const llvm::SmallVector<char, 0> &buffer,
+                         const std::string &module_name,
+                         llvm::LLVMContext &new_context) {
     llvm::StringRef dataRef(buffer.data(), buffer.size());
-    llvm::MemoryBufferRef memRef(dataRef, mod->getModuleIdentifier());
+    llvm::MemoryBufferRef memRef(dataRef, module_name);
 
-    // parse into new_context
     llvm::Expected<std::unique_ptr<llvm::Module>> module_or_error =
         llvm::parseBitcodeFile(memRef, new_context);
 
@@ -83,18 +91,7 @@ move_module_to_context(llvm::Module *mod, llvm::LLVMContext &new_context) {
         llvm::errs() << "ERROR: Module cloning failed.";
         exit(1);
     }
-
-    std::unique_ptr<llvm::Module> new_module = std::move(*module_or_error);
-
-    new_module->setTargetTriple(mod->getTargetTriple());
-    new_module->setDataLayout(mod->getDataLayout());
-
-    // verify cloned module
-    if (llvm::verifyModule(*new_module, &llvm::errs())) {
-        llvm::errs() << "ERROR: Cloned module verification failed.";
-        exit(1);
-    }
-    return new_module;
+    return std::move(*module_or_error);
 }
 
 // to read a .bc file (LLVM bitcode) and create a module from it
@@ -0,0 +1,1470 @@
+//
+// lsp.cpp
+//
+
+/*
+
+The language server keeps the state of each open file between
+edits, so that an edit costs about as much as the part of the
+file that it touches, and not the size of the whole file.
+
+For each file we keep:
+
+    (1) the lines, along with the tokens of each line, and
+    whether the line ends inside a multiline comment.
+
+    an edit replaces a range of lines, and only those lines are
+    lexed again. (if one of them now starts or ends a comment
+    differently, we keep going until the comment state lines up
+    again with what it was before.)
+
+    (2) the top-level items (functions, global declarations,
+    typedefs and enums), which are found from the tokens alone:
+    an item ends at a ';' outside of any braces, or, for a
+    function, at the '}' that closes its body. (or, when what
+    looks like another item starts at the beginning of a line,
+    right before it, so that a broken item doesn't swallow the
+    rest of the file.)
+
+    after an edit, the items are found again starting from the
+    first item that the edit touched, up until an item ends at
+    the same place as one from before the edit. from there on,
+    the old items are taken as they were (only moved up or down).
+
+    (3) for each item, the result of parsing it: its diagnostics,
+    and whatever it declared (into the symbol table, or the type
+    and enum maps).
+
+    an item is only parsed again when its tokens change, or when
+    something it uses (by name) was declared differently. all the
+    other items are not parsed at all, and what they declared is
+    just put back into the maps, so that the items after them see
+    it like they would in a full parse.
+
+The parser terminates the program on the first error it finds.
+the server sets error_recovery_hook (lexer.h), which throws the
+error (as an Error) out of the parser, to where the item was
+being parsed. so we get (at most) one diagnostic per item, and
+the rest of the file still gets checked.
+
+(whatever the parser had allocated for that item is left behind,
+like the ASTs of the items are. the server only needs them for
+their diagnostics and their declarations.)
+
+A file that uses #define/#undef/#ifdef/#ifndef is lexed all over
+again on each edit, since a change to a definition can change
+the tokens of any line after it. the items are still cached,
+so this mostly only costs the lexing.
+
+The diagnostics come from the lexer and the parser, and not from
+the IR generation (which needs the whole file at once).
+
+Columns are taken as byte offsets into the line (which is the
+same as the UTF-16 offsets that LSP uses, for ASCII source).
+
+*/
+
+#include "lsp.h"
+#include "parser.h"
+#include <algorithm>
+#include <filesystem>
+#include <iterator>
+#include <string.h>
+#include <unordered_map>
+#include <unordered_set>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+
+
+//                           JSON
+// ***********************************************************
+
+// (just enough of it for the messages that we read: numbers are
+// kept as they were written, and objects keep their keys in order)
+
+enum Json_Kind { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+
+struct Json {
+    Json_Kind kind = JSON_NULL;
+    std::string text;              // (for strings, numbers and bools)
+    std::vector<std::string> keys; // (for objects)
+    std::vector<Json> values;      // (for arrays and objects)
+
+    const Json &operator[](const char *key) const;
+    int as_int() const { return kind == JSON_NUMBER ? atoi(text.c_str()) : 0; }
+};
+
+static const Json json_null;
+
+const Json &Json::operator[](const char *key) const {
+    for (size_t i = 0; i < keys.size(); i++)
+        if (keys[i] == key)
+            return values[i];
+    return json_null;
+}
+
+static void skip_json_whitespace(const std::string &s, size_t &i) {
+    while (i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\n' || s[i] == '\r'))
+        i++;
+}
+
+static void append_utf8(std::string &out, uint32_t c) {
+    if (c < 0x80) {
+        out += (char)c;
+    } else if (c < 0x800) {
+        out += (char)(0xC0 | (c >> 6));
+        out += (char)(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+        out += (char)(0xE0 | (c >> 12));
+        out += (char)(0x80 | ((c >> 6) & 0x3F));
+        out += (char)(0x80 | (c & 0x3F));
+    } else {
+        out += (char)(0xF0 | (c >> 18));
+        out += (char)(0x80 | ((c >> 12) & 0x3F));
+        out += (char)(0x80 | ((c >> 6) & 0x3F));
+        out += (char)(0x80 | (c & 0x3F));
+    }
+}
+
+static bool parse_json_string(const std::string &s, size_t &i, std::string *out) {
+    i++; // (the opening quote)
+
+    while (i < s.size() && s[i] != '"') {
+        if (s[i] != '\\') {
+            *out += s[i++];
+            continue;
+        }
+        if (++i >= s.size()) return false;
+
+        switch (s[i++]) {
+        case 'n': *out += '\n'; break;
+        case 't': *out += '\t'; break;
+        case 'r': *out += '\r'; break;
+        case 'b': *out += '\b'; break;
+        case 'f': *out += '\f'; break;
+        case 'u': {
+            if (i + 4 > s.size()) return false;
+            uint32_t c = (uint32_t)strtoul(s.substr(i, 4).c_str(), NULL, 16);
+            i += 4;
+
+            // (a surrogate pair is two escapes for one character)
+            if (c >= 0xD800 && c < 0xDC00 && i + 6 <= s.size() &&
+                s[i] == '\\' && s[i + 1] == 'u') {
+                uint32_t low = (uint32_t)strtoul(s.substr(i + 2, 4).c_str(), NULL, 16);
+                c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                i += 6;
+            }
+            append_utf8(*out, c);
+            break;
+        }
+        default: *out += s[i - 1]; // (\" \\ and \/)
+        }
+    }
+    if (i >= s.size()) return false;
+
+    i++; // (the closing quote)
+    return true;
+}
+
+// parses the JSON value starting at s[i], and moves i past it.
+// (returns false if it is not valid JSON)
+static bool parse_json(const std::string &s, size_t &i, Json *out) {
+    skip_json_whitespace(s, i);
+    if (i >= s.size()) return false;
+
+    char c = s[i];
+    if (c == '"') {
+        out->kind = JSON_STRING;
+        return parse_json_string(s, i, &out->text);
+    }
+
+    if (c == '{' || c == '[') {
+        out->kind = (c == '{') ? JSON_OBJECT : JSON_ARRAY;
+        char closing = (c == '{') ? '}' : ']';
+        i++;
+
+        skip_json_whitespace(s, i);
+        if (i < s.size() && s[i] == closing) {
+            i++;
+            return true;
+        }
+
+        while (1) {
+            if (out->kind == JSON_OBJECT) {
+                skip_json_whitespace(s, i);
+                if (i >= s.size() || s[i] != '"') return false;
+
+                out->keys.emplace_back();
+                if (!parse_json_string(s, i, &out->keys.back())) return false;
+
+                skip_json_whitespace(s, i);
+                if (i >= s.size() || s[i] != ':') return false;
+                i++;
+            }
+
+            out->values.emplace_back();
+            if (!parse_json(s, i, &out->values.back())) return false;
+
+            skip_json_whitespace(s, i);
+            if (i >= s.size()) return false;
+            if (s[i] == closing) {
+                i++;
+                return true;
+            }
+            if (s[i] != ',') return false;
+            i++;
+        }
+    }
+
+    // numbers, true, false and null
+    size_t start = i;
+    while (i < s.size() && (isalnum((unsigned char)s[i]) || s[i] == '-' || s[i] == '+' || s[i] == '.'))
+        i++;
+    out->text = s.substr(start, i - start);
+
+    if (out->text == "null") out->kind = JSON_NULL;
+    else if (out->text == "true" || out->text == "false") out->kind = JSON_BOOL;
+    else if (!out->text.empty() && (isdigit((unsigned char)c) || c == '-')) out->kind = JSON_NUMBER;
+    else return false;
+
+    return true;
+}
+
+// a string, quoted and escaped for JSON
+static std::string json_string(const std::string &s) {
+    std::string out = "\"";
+    for (unsigned char c : s) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += (char)c;
+            }
+        }
+    }
+    return out + "\"";
+}
+
+// (for sending back the id of a request, which is either a number or a string)
+static std::string json_id(const Json &id) {
+    if (id.kind == JSON_STRING) return json_string(id.text);
+    if (id.kind == JSON_NUMBER) return id.text;
+    return "null";
+}
+
+static std::string json_position(int line, int character) {
+    return "{\"line\":" + std::to_string(line) + ",\"character\":" + std::to_string(character) + "}";
+}
+
+static std::string json_range(int line, int start, int end) {
+    return "{\"start\":" + json_position(line, start) + ",\"end\":" + json_position(line, end) + "}";
+}
+
+
+//                        Transport
+// ***********************************************************
+
+// reads the next message from the client. each one is a header
+// (with its Content-Length) and then the JSON content itself:
+//
+//     Content-Length: <n>\r\n
+//     \r\n
+//     <n bytes of JSON>
+static bool read_message(std::string *content) {
+    char header[1024];
+    long content_length = -1;
+
+    while (1) {
+        if (fgets(header, sizeof(header), stdin) == NULL)
+            return false;
+        if (strcmp(header, "\r\n") == 0 || strcmp(header, "\n") == 0)
+            break;
+        if (strncmp(header, "Content-Length:", 15) == 0)
+            content_length = atol(header + 15);
+    }
+    if (content_length < 0)
+        return false;
+
+    content->resize(content_length);
+    return fread(&(*content)[0], 1, content_length, stdin) == (size_t)content_length;
+}
+
+static void send_message(const std::string &content) {
+    printf("Content-Length: %zu\r\n\r\n", content.size());
+    fwrite(content.data(), 1, content.size(), stdout);
+    fflush(stdout);
+}
+
+static void send_response(const Json &id, const std::string &result) {
+    send_message("{\"jsonrpc\":\"2.0\",\"id\":" + json_id(id) + ",\"result\":" + result + "}");
+}
+
+static void send_error_response(const Json &id, int code, const std::string &message) {
+    send_message("{\"jsonrpc\":\"2.0\",\"id\":" + json_id(id) + ",\"error\":{\"code\":" +
+                 std::to_string(code) + ",\"message\":" + json_string(message) + "}}");
+}
+
+static std::string uri_to_path(const std::string &uri) {
+    std::string path;
+    size_t i = (uri.compare(0, 7, "file://") == 0) ? 7 : 0;
+
+    // (file:///C:/... on Windows)
+    if (uri.size() > i + 2 && uri[i] == '/' && uri[i + 2] == ':')
+        i++;
+
+    for (; i < uri.size(); i++) {
+        if (uri[i] == '%' && i + 2 < uri.size()) {
+            path += (char)strtol(uri.substr(i + 1, 2).c_str(), NULL, 16);
+            i += 2;
+        } else {
+            path += uri[i];
+        }
+    }
+    return path;
+}
+
+static std::string path_to_uri(const std::string &path) {
+    std::error_code error;
+    std::string absolute = std::filesystem::absolute(path, error).generic_string();
+    if (error) absolute = path;
+
+    std::string uri = (absolute[0] == '/') ? "file://" : "file:///";
+    for (char c : absolute) {
+        if (c == ' ') uri += "%20";
+        else if (c == '\\') uri += '/';
+        else uri += c;
+    }
+    return uri;
+}
+
+
+//                  Recovering from errors
+// ***********************************************************
+
+// (what recover_from_error throws)
+struct Error {
+    std::string code; // (like E017)
+    std::string message;
+    std::string file_name;
+    int line_num = 0;
+    int pos = 0;
+};
+
+// set as the error_recovery_hook while lexing or parsing, so that
+// the errors are thrown back to where we started, instead of exiting.
+static void recover_from_error(const char *message, const std::string &file_name,
+                               int line_num, int pos) {
+    Error error;
+
+    // the messages look like "error E017: ...". the code goes
+    // separately in the diagnostic.
+    std::string text = message;
+    size_t start = text.find_first_not_of("\n");
+    text = (start == std::string::npos) ? "" : text.substr(start);
+
+    if (text.compare(0, 6, "error ") == 0 && text.find(':') != std::string::npos) {
+        size_t colon = text.find(':');
+        error.code = text.substr(6, colon - 6);
+        text = text.substr(colon + 1);
+        if (!text.empty() && text[0] == ' ') text.erase(0, 1);
+    }
+
+    size_t format = text.find("%s");
+    if (format != std::string::npos)
+        text.replace(format, 2, file_name);
+
+    error.message = text;
+    error.file_name = file_name;
+    error.line_num = line_num;
+    error.pos = pos;
+    throw error;
+}
+
+
+//                        Documents
+// ***********************************************************
+
+struct Diagnostic {
+    int line; // (for the ones of an item, relative to its first line)
+    int start;
+    int end;
+    std::string code;
+    std::string message;
+};
+
+struct Line {
+    std::string text;
+    std::vector<Token> tokens;
+    bool ends_in_comment = false;
+
+    bool has_error = false; // (from the lexer)
+    Diagnostic error;
+};
+
+enum Item_Kind { ITEM_FUNCTION, ITEM_GLOBAL, ITEM_TYPEDEF, ITEM_ENUM, ITEM_OTHER };
+
+// a name that an item declares, and where
+struct Declaration {
+    std::string name;
+    std::string file_name; // (empty when it is in the document itself)
+    int line;              // (relative to the first line of the item, when it is in the document)
+    int column;
+};
+
+// what we got from parsing an item
+struct Parse_Result {
+    bool parsed = false;
+    std::vector<Diagnostic> diagnostics;
+
+    // whatever the item declared, so that it can be declared
+    // again without parsing the item
+    std::vector<std::pair<std::string, Data_Type *>> types;
+    std::vector<std::pair<std::string, AST_Literal *>> enum_values;
+    std::vector<std::pair<std::string, Symbol *>> functions;
+    std::vector<std::pair<std::string, Symbol *>> prototypes;
+    std::vector<std::pair<std::string, Symbol *>> globals;
+};
+
+struct Item {
+    // the item goes from the token at (first_line, first_index)
+    // till the one at (last_line, last_index), both included.
+    // (the indices are into the tokens of those lines)
+    int first_line, first_index;
+    int last_line, last_index;
+    bool ended_early = false; // (it was cut short, when it seemed like another item started)
+
+    Item_Kind kind = ITEM_OTHER;
+    bool is_prototype = false;
+
+    uint64_t token_hash = 0;     // (of all of its tokens, along with their positions)
+    uint64_t signature_hash = 0; // (of the part that other items can see)
+
+    std::vector<Declaration> declarations;
+    std::vector<std::string> references; // (the names it uses)
+
+    Parse_Result result;
+};
+
+// (the lines and the items are kept as pointers, so that an edit in
+// the middle of a large file only has to move the pointers around)
+struct Document {
+    std::string uri;
+    std::vector<Line *> lines;
+    std::vector<Item *> items;
+    int lines_with_errors = 0;
+
+    // whether it has any #define/#undef/#ifdef/#ifndef
+    bool uses_preprocessor = false;
+    Lexer *line_lexer = NULL;
+
+    // name -> (item, declaration) for go-to-definition and hover
+    // (only worked out when they are asked for)
+    std::unordered_map<std::string, std::pair<int, int>> definitions;
+    bool definitions_outdated = true;
+};
+
+static std::unordered_map<std::string, Document *> documents;
+
+// the column where a token starts. (the lexer gives the position
+// where the word ends for identifiers, keywords, literals, ...)
+static int token_column(const Token &tok) {
+    switch (tok.type) {
+    case TOKEN_IDENTIFIER:
+    case TOKEN_KEYWORD:
+    case TOKEN_DATA_TYPE:
+    case TOKEN_NUMERIC_LITERAL:
+    case TOKEN_BOOL_LITERAL:
+        return std::max(tok.position - (int)token_text(tok).size(), 0);
+    default:
+        return tok.position;
+    }
+}
+
+static bool is_preprocessor_conditional(const std::string &text) {
+    size_t i = text.find_first_not_of(" \t");
+    if (i == std::string::npos || text[i] != '#')
+        return false;
+
+    std::string directive = text.substr(i + 1, text.find_first_of(" \t", i + 1) - i - 1);
+    return directive == "define" || directive == "undef" || directive == "ifdef" ||
+           directive == "ifndef" || directive == "endif";
+}
+
+static std::vector<std::string> split_lines(const std::string &text) {
+    std::vector<std::string> lines(1);
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '\n') {
+            lines.emplace_back();
+        } else if (text[i] == '\r') {
+            if (i + 1 < text.size() && text[i + 1] == '\n') i++;
+            lines.emplace_back();
+        } else {
+            lines.back() += text[i];
+        }
+    }
+    return lines;
+}
+
+
+/* ************************* Lexing ************************** */
+
+// lexes a single line (with the lexer of the document, so that
+// #defines carry over from one line to the next)
+static void lex_line(Document *doc, int line_index, bool starts_in_comment) {
+    Lexer *lexer = doc->line_lexer;
+    Line &line = *doc->lines[line_index];
+
+    lexer->tokens.clear();
+    lexer->line = line.text;
+    lexer->line_num = line_index + 1;
+
+    bool in_comment = starts_in_comment;
+    if (line.has_error) doc->lines_with_errors--;
+    line.has_error = false;
+
+    error_recovery_hook = recover_from_error;
+    try {
+        generate_tokens(lexer, &in_comment);
+    } catch (const Error &error) {
+        line.has_error = true;
+        doc->lines_with_errors++;
+        line.error = Diagnostic{line_index, error.pos, error.pos + 1,
+                                error.code, error.message};
+    }
+    error_recovery_hook = NULL;
+
+    line.tokens = std::move(lexer->tokens);
+    lexer->tokens.clear();
+    line.ends_in_comment = in_comment;
+}
+
+static void lex_all_lines(Document *doc) {
+    // (a new lexer, so that nothing is left from the #defines of before)
+    delete doc->line_lexer;
+    doc->line_lexer = new Lexer;
+
+    doc->uses_preprocessor = false;
+    for (int i = 0; i < (int)doc->lines.size(); i++) {
+        lex_line(doc, i, i > 0 && doc->lines[i - 1]->ends_in_comment);
+        if (is_preprocessor_conditional(doc->lines[i]->text))
+            doc->uses_preprocessor = true;
+    }
+}
+
+// replaces the lines [begin, end) with new ones (which are not lexed yet)
+static void replace_lines(Document *doc, int begin, int end, std::vector<std::string> &new_lines) {
+    for (int i = begin; i < end; i++) {
+        if (doc->lines[i]->has_error) doc->lines_with_errors--;
+        delete doc->lines[i];
+    }
+    doc->lines.erase(doc->lines.begin() + begin, doc->lines.begin() + end);
+    doc->lines.insert(doc->lines.begin() + begin, new_lines.size(), NULL);
+
+    for (size_t i = 0; i < new_lines.size(); i++) {
+        doc->lines[begin + i] = new Line;
+        doc->lines[begin + i]->text = std::move(new_lines[i]);
+    }
+}
+
+// which lines were lexed again after an edit
+struct Edit {
+    bool everything = false; // (the whole document was lexed again)
+    int first_line = 0;      // (the lines [first_line, end_line) were lexed again)
+    int end_line = 0;
+    int line_delta = 0; // (how many lines were added by the edit, or removed if < 0)
+};
+
+// applies one of the changes of a didChange notification. it is either
+// the whole text of the document, or a range along with its new text.
+static Edit apply_change(Document *doc, const Json &change) {
+    Edit edit;
+    const Json &range = change["range"];
+    const std::string &text = change["text"].text;
+
+    if (range.kind == JSON_NULL) {
+        std::vector<std::string> new_lines = split_lines(text);
+        replace_lines(doc, 0, (int)doc->lines.size(), new_lines);
+        lex_all_lines(doc);
+        edit.everything = true;
+        return edit;
+    }
+
+    int num_lines = (int)doc->lines.size();
+    int start_line = std::min(std::max(range["start"]["line"].as_int(), 0), num_lines - 1);
+    int end_line = std::min(std::max(range["end"]["line"].as_int(), start_line), num_lines - 1);
+    std::string &first = doc->lines[start_line]->text;
+    std::string &last = doc->lines[end_line]->text;
+    size_t start_column = std::min((size_t)std::max(range["start"]["character"].as_int(), 0), first.size());
+    size_t end_column = std::min((size_t)std::max(range["end"]["character"].as_int(), 0), last.size());
+
+    std::vector<std::string> new_lines =
+        split_lines(first.substr(0, start_column) + text + last.substr(end_column));
+
+    // a change to the preprocessor definitions can change any line after it
+    bool touches_preprocessor = doc->uses_preprocessor;
+    for (int i = start_line; i <= end_line; i++)
+        touches_preprocessor |= is_preprocessor_conditional(doc->lines[i]->text);
+    for (std::string &line_text : new_lines)
+        touches_preprocessor |= is_preprocessor_conditional(line_text);
+
+    // (whether the lines that come after started in a comment, before this edit)
+    bool old_comment_state = doc->lines[end_line]->ends_in_comment;
+
+    int num_new_lines = (int)new_lines.size();
+    replace_lines(doc, start_line, end_line + 1, new_lines);
+
+    if (touches_preprocessor) {
+        lex_all_lines(doc);
+        edit.everything = true;
+        return edit;
+    }
+
+    int i = start_line;
+    for (; i < start_line + num_new_lines; i++)
+        lex_line(doc, i, i > 0 && doc->lines[i - 1]->ends_in_comment);
+
+    // if the edit opened or closed a comment, the lines after it
+    // are lexed again until they start the way they did before
+    while (i < (int)doc->lines.size() && doc->lines[i - 1]->ends_in_comment != old_comment_state) {
+        old_comment_state = doc->lines[i]->ends_in_comment;
+        lex_line(doc, i, doc->lines[i - 1]->ends_in_comment);
+        i++;
+    }
+
+    edit.first_line = start_line;
+    edit.end_line = i;
+    edit.line_delta = num_new_lines - (end_line - start_line + 1);
+    return edit;
+}
+
+
+/* ************************** Items ************************** */
+
+// moves (line, index) to the next token of the document
+// (returns false if there are no more tokens)
+static bool next_token(Document *doc, int *line, int *index) {
+    (*index)++;
+    while (*line < (int)doc->lines.size() && *index >= (int)doc->lines[*line]->tokens.size()) {
+        (*line)++;
+        *index = 0;
+    }
+    return *line < (int)doc->lines.size();
+}
+
+// (the token n tokens after (line, index), if there is one)
+static Token *token_ahead(Document *doc, int line, int index, int n) {
+    for (int i = 0; i < n; i++)
+        if (!next_token(doc, &line, &index))
+            return NULL;
+    return &doc->lines[line]->tokens[index];
+}
+
+// whether the token at (line, index) looks like the start of
+// another top-level item. (used to cut an item short when it is
+// not finished yet, say, while the user is typing it)
+static bool starts_top_level_item(Document *doc, int line, int index) {
+    if (index != 0) return false;
+
+    Token &tok = doc->lines[line]->tokens[index];
+    if (!tok.file_name.empty() || token_column(tok) != 0) return false;
+
+    if (tok.type == TOKEN_KEYWORD)
+        return token_text(tok) == "typedef" || token_text(tok) == "enum" || token_text(tok) == "const" ||
+               token_text(tok) == "atomic" || token_text(tok) == "async";
+
+    Token *next = token_ahead(doc, line, index, 1);
+    return tok.type == TOKEN_DATA_TYPE && next != NULL && next->type == TOKEN_IDENTIFIER;
+}
+
+// copies out the tokens of an item, for the parser. (the line
+// numbers of the lines that moved since they were lexed are
+// fixed up on the way)
+static std::vector<Token> item_tokens(Document *doc, const Item &item) {
+    std::vector<Token> tokens;
+    int line = item.first_line, index = item.first_index;
+
+    while (1) {
+        tokens.push_back(doc->lines[line]->tokens[index]);
+        if (tokens.back().file_name.empty())
+            tokens.back().line_num = line + 1;
+
+        if (line == item.last_line && index == item.last_index) break;
+        if (!next_token(doc, &line, &index)) break;
+    }
+    return tokens;
+}
+
+static uint64_t hash_combine(uint64_t hash, const std::string &s) {
+    for (unsigned char c : s)
+        hash = (hash ^ c) * 1099511628211ull;
+    return (hash ^ 0xFF) * 1099511628211ull;
+}
+
+static uint64_t hash_combine(uint64_t hash, int64_t value) {
+    return (hash ^ (uint64_t)value) * 1099511628211ull;
+}
+
+// works out the kind of the item, what it declares, and the names it uses
+static void describe_item(Document *doc, Item *item) {
+    std::vector<Token> tokens = item_tokens(doc, *item);
+    size_t n = tokens.size();
+
+    auto declare = [&](size_t i) {
+        if (i >= n || tokens[i].type != TOKEN_IDENTIFIER) return;
+
+        Token &tok = tokens[i];
+        bool in_document = tok.file_name.empty();
+        item->declarations.push_back(Declaration{
+            tok.val, tok.file_name,
+            in_document ? tok.line_num - 1 - item->first_line : tok.line_num - 1,
+            token_column(tok)});
+    };
+
+    const std::string &first = token_text(tokens[0]);
+    size_t name_index = 1;
+
+    if (first == "typedef") {
+        item->kind = ITEM_TYPEDEF;
+        if (n >= 2) declare(n - 2); // typedef <type> <name>;
+    } else if (first == "enum") {
+        // enum <name> { <value>, <value> = ..., ... };
+        item->kind = ITEM_ENUM;
+        declare(1);
+        int depth = 0;
+        for (size_t i = 2; i < n; i++) {
+            if (tokens[i].type == TOKEN_LEFT_BRACE) depth++;
+            else if (tokens[i].type == TOKEN_RIGHT_BRACE) depth--;
+            else if (depth == 1 && (tokens[i - 1].type == TOKEN_LEFT_BRACE ||
+                                    tokens[i - 1].type == TOKEN_SEPARATOR))
+                declare(i);
+        }
+    } else {
+        if (first == "const" || first == "atomic" || first == "async")
+            name_index = 2;
+
+        bool is_function = first == "async" ||
+            (name_index + 1 < n && (tokens[name_index + 1].type == TOKEN_LEFT_PAREN ||
+                                    tokens[name_index + 1].type == TOKEN_LESS));
+        item->kind = is_function ? ITEM_FUNCTION : ITEM_GLOBAL;
+        if (tokens[0].type == TOKEN_RIGHT_BRACE || tokens[0].type == TOKEN_DELIMITER)
+            item->kind = ITEM_OTHER;
+        else
+            declare(name_index);
+    }
+
+    // for functions, the signature is everything before the body.
+    // (a prototype is a signature followed by a ';')
+    size_t signature_end = n;
+    if (item->kind == ITEM_FUNCTION) {
+        int depth = 0;
+        for (size_t i = name_index; i < n; i++) {
+            if (tokens[i].type == TOKEN_LEFT_PAREN) {
+                depth++;
+            } else if (tokens[i].type == TOKEN_RIGHT_PAREN && --depth == 0) {
+                signature_end = i + 1;
+                item->is_prototype = i + 1 < n && tokens[i + 1].type == TOKEN_DELIMITER;
+                break;
+            }
+        }
+    }
+
+    uint64_t token_hash = 1469598103934665603ull;
+    uint64_t signature_hash = 1469598103934665603ull;
+    std::unordered_set<std::string> seen;
+
+    for (size_t i = 0; i < n; i++) {
+        Token &tok = tokens[i];
+        int line = tok.file_name.empty() ? tok.line_num - 1 - item->first_line : tok.line_num;
+
+        token_hash = hash_combine(token_hash, token_text(tok));
+        token_hash = hash_combine(token_hash, ((int64_t)tok.type << 48) ^ ((int64_t)line << 20) ^ tok.position);
+        token_hash = hash_combine(token_hash, tok.file_name);
+
+        if (i < signature_end) {
+            signature_hash = hash_combine(signature_hash, token_text(tok));
+            signature_hash = hash_combine(signature_hash, (int64_t)tok.type);
+        }
+        if (tok.type == TOKEN_IDENTIFIER && seen.insert(tok.val).second)
+            item->references.push_back(tok.val);
+    }
+    item->token_hash = token_hash;
+    item->signature_hash = hash_combine(signature_hash, (int64_t)item->is_prototype);
+}
+
+// finds the item that starts at (line, index)
+static Item *scan_item(Document *doc, int line, int index) {
+    auto *item = new Item;
+    item->first_line = line;
+    item->first_index = index;
+
+    Token *first = &doc->lines[line]->tokens[index];
+    Token *third = token_ahead(doc, line, index, 2);
+    bool is_function = token_text(*first) == "async" ||
+        (first->type != TOKEN_KEYWORD && third != NULL &&
+         (third->type == TOKEN_LEFT_PAREN || third->type == TOKEN_LESS));
+
+    int depth = 0;
+    bool is_first = true;
+
+    while (1) {
+        Token &tok = doc->lines[line]->tokens[index];
+        if (!is_first && starts_top_level_item(doc, line, index)) {
+            item->ended_early = true;
+            break;
+        }
+        is_first = false;
+        item->last_line = line;
+        item->last_index = index;
+
+        if (tok.type == TOKEN_LEFT_BRACE) {
+            depth++;
+        } else if (tok.type == TOKEN_RIGHT_BRACE) {
+            depth--;
+            if (depth < 0 || (depth == 0 && is_function)) break;
+        } else if (tok.type == TOKEN_DELIMITER && depth == 0) {
+            break;
+        }
+
+        // (it runs till the end of the document, so more tokens added
+        // at the end would belong to it as well)
+        if (!next_token(doc, &line, &index)) {
+            item->ended_early = true;
+            break;
+        }
+    }
+
+    describe_item(doc, item);
+    return item;
+}
+
+// (for comparing the positions of tokens)
+static bool ends_before(const Item *item, int line, int index) {
+    return item->last_line < line || (item->last_line == line && item->last_index < index);
+}
+
+// the names that a parsed item declared
+static std::vector<std::string> declared_names(const Parse_Result &result) {
+    std::vector<std::string> names;
+    for (auto &entry : result.types) names.push_back(entry.first);
+    for (auto &entry : result.enum_values) names.push_back(entry.first);
+    for (auto &entry : result.functions) names.push_back(entry.first);
+    for (auto &entry : result.prototypes) names.push_back(entry.first);
+    for (auto &entry : result.globals) names.push_back(entry.first);
+    return names;
+}
+
+// finds the items again after an edit. only the ones from the
+// edit up until the items line up again with the ones from before
+// are scanned (the rest are moved as they are). the parse results
+// are carried over for the items whose tokens did not change, and
+// the names whose declarations might have changed are put into
+// changed_names.
+static void update_items(Document *doc, const Edit &edit,
+                         std::unordered_set<std::string> *changed_names) {
+    std::vector<Item *> old_items = std::move(doc->items);
+    doc->items.clear();
+
+    // the first item that the edit could have changed. (the one before
+    // it as well, if it was cut short, since it may not be anymore)
+    size_t first_changed = 0;
+    if (!edit.everything) {
+        while (first_changed < old_items.size() && old_items[first_changed]->last_line < edit.first_line)
+            first_changed++;
+        if (first_changed > 0 && old_items[first_changed - 1]->ended_early)
+            first_changed--;
+    }
+
+    doc->items.assign(old_items.begin(), old_items.begin() + first_changed);
+
+    // where to start scanning (the lines before the edit have not moved)
+    int line = 0, index = -1;
+    if (first_changed < old_items.size() && !edit.everything &&
+        old_items[first_changed]->first_line < edit.first_line) {
+        line = old_items[first_changed]->first_line;
+        index = old_items[first_changed]->first_index - 1;
+    } else if (first_changed > 0) {
+        line = doc->items.back()->last_line;
+        index = doc->items.back()->last_index;
+    }
+
+    // scan until an item ends at the same place as an old one after
+    // the edit (in the new line numbers)
+    size_t next_old = first_changed;
+    size_t first_kept = old_items.size();
+    size_t first_scanned = doc->items.size();
+
+    while (next_token(doc, &line, &index)) {
+        Item *item = scan_item(doc, line, index);
+        doc->items.push_back(item);
+        line = item->last_line;
+        index = item->last_index;
+
+        if (edit.everything || line < edit.end_line)
+            continue;
+
+        int old_line = line - edit.line_delta;
+        while (next_old < old_items.size() && ends_before(old_items[next_old], old_line, index))
+            next_old++;
+        if (next_old < old_items.size() && old_items[next_old]->last_line >= edit.end_line - edit.line_delta &&
+            old_items[next_old]->last_line == old_line && old_items[next_old]->last_index == index &&
+            old_items[next_old]->ended_early == item->ended_early) {
+            first_kept = next_old + 1;
+            break;
+        }
+    }
+    size_t end_scanned = doc->items.size();
+
+    for (size_t i = first_kept; i < old_items.size(); i++) {
+        doc->items.push_back(old_items[i]);
+        old_items[i]->first_line += edit.line_delta;
+        old_items[i]->last_line += edit.line_delta;
+    }
+
+    // the old items that were replaced by the scanned ones. if one
+    // of the scanned ones has the same tokens as one of these, it
+    // gets its parse result.
+    std::unordered_multimap<uint64_t, Item *> replaced;
+    for (size_t i = first_changed; i < first_kept && i < old_items.size(); i++)
+        replaced.emplace(old_items[i]->token_hash, old_items[i]);
+
+    std::vector<Item *> new_items;
+    for (size_t i = first_scanned; i < end_scanned; i++) {
+        Item *item = doc->items[i];
+        auto found = replaced.find(item->token_hash);
+        if (found != replaced.end()) {
+            item->result = std::move(found->second->result);
+            delete found->second;
+            replaced.erase(found);
+        } else {
+            new_items.push_back(item);
+        }
+    }
+
+    // a new item declares the same things as a replaced one, if their
+    // signatures are the same (like when only a function body changed).
+    // otherwise, whatever either of them declares has changed.
+    std::unordered_multimap<uint64_t, Item *> replaced_signatures;
+    for (auto &entry : replaced)
+        replaced_signatures.emplace(entry.second->signature_hash, entry.second);
+
+    // (the new item keeps the old result, without it being parsed, so
+    // that check_document can tell if it declares anything else now)
+    for (Item *item : new_items) {
+        auto found = replaced_signatures.find(item->signature_hash);
+        if (found != replaced_signatures.end()) {
+            item->result = std::move(found->second->result);
+            item->result.parsed = false;
+            replaced_signatures.erase(found);
+            continue;
+        }
+        for (Declaration &declaration : item->declarations)
+            changed_names->insert(declaration.name);
+    }
+    for (auto &entry : replaced_signatures) {
+        for (Declaration &declaration : entry.second->declarations)
+            changed_names->insert(declaration.name);
+        for (const std::string &name : declared_names(entry.second->result))
+            changed_names->insert(name);
+    }
+
+    for (auto &entry : replaced)
+        delete entry.second;
+
+    doc->definitions_outdated = true;
+}
+
+
+/* ************************* Parsing ************************* */
+
+// parses the items in env, up until the first error (which is
+// given back in error). returns false if there was one.
+static bool parse_until_error(Lexer *env, Error &error) {
+    try {
+        do {
+            parse_top_level_item(env);
+        } while (env->get_next_token() != NULL);
+    } catch (const Error &thrown) {
+        error = thrown;
+        return false;
+    }
+    return true;
+}
+
+// parses an item, in env (which has everything declared by the items before it)
+static void parse_item(Lexer *env, Item *item, std::vector<Token> tokens) {
+    Parse_Result &result = item->result;
+    result = Parse_Result();
+    result.parsed = true;
+
+    struct Declared {
+        Data_Type *data_type;
+        AST_Literal *value;
+        Symbol *function, *prototype, *global;
+    };
+    std::vector<Declared> declared_before;
+    for (const std::string &name : item->references) {
+        declared_before.push_back({env->type_info_map[name], env->enum_values_map[name],
+                                   env->symbol_table.functions[name],
+                                   env->symbol_table.function_prototypes[name],
+                                   env->symbol_table.global_variables[name]});
+    }
+
+    env->tokens = std::move(tokens);
+    env->curr_token_index = 0;
+
+    Error error;
+    error_recovery_hook = recover_from_error;
+    bool succeeded = parse_until_error(env, error);
+    error_recovery_hook = NULL;
+
+    if (!succeeded) {
+        Diagnostic diagnostic{0, 0, 1, error.code, error.message};
+        Token &first = env->tokens[0];
+        diagnostic.start = token_column(first);
+        diagnostic.end = diagnostic.start + (int)token_text(first).size();
+
+        // (point at the token where the error is, if it is one of ours)
+        if (error.file_name.empty() && error.line_num > 0) {
+            diagnostic.line = error.line_num - 1 - item->first_line;
+            diagnostic.start = error.pos;
+            diagnostic.end = error.pos + 1;
+            for (Token &tok : env->tokens) {
+                if (tok.file_name.empty() && tok.line_num == error.line_num &&
+                    tok.position == error.pos) {
+                    diagnostic.start = token_column(tok);
+                    diagnostic.end = diagnostic.start + std::max((int)token_text(tok).size(), 1);
+                    break;
+                }
+            }
+        } else if (!error.file_name.empty()) {
+            diagnostic.message = get_filename_from_path(error.file_name) + "(" +
+                                 std::to_string(error.line_num) + "): " + diagnostic.message;
+        }
+        result.diagnostics.push_back(diagnostic);
+
+        // undo what the parser was in the middle of
+        while (env->symbol_table.curr_scope != NULL)
+            env->symbol_table.pop();
+        env->parsing_async_function = false;
+        env->parameter_pack.clear();
+
+        for (Token &tok : env->tokens) {
+            Data_Type *data_type = env->type_info_map[tok.val];
+            if (tok.type == TOKEN_IDENTIFIER && data_type != NULL && data_type->type_kind == TK_TYPE_PARAM)
+                env->type_info_map.remove(tok.val);
+        }
+    }
+
+    // remember what it declared. (that's whatever it changed in the
+    // maps, which isn't always what it seems to declare: a broken item
+    // can declare the variables of a function body as globals, say.)
+    for (size_t i = 0; i < item->references.size(); i++) {
+        const std::string &name = item->references[i];
+        const Declared &before = declared_before[i];
+
+        Data_Type *data_type = env->type_info_map[name];
+        AST_Literal *value = env->enum_values_map[name];
+        Symbol *function = env->symbol_table.functions[name];
+        Symbol *prototype = env->symbol_table.function_prototypes[name];
+        Symbol *global = env->symbol_table.global_variables[name];
+
+        if (data_type && data_type != before.data_type) result.types.push_back({name, data_type});
+        if (value && value != before.value) result.enum_values.push_back({name, value});
+        if (function && function != before.function) result.functions.push_back({name, function});
+        if (prototype && prototype != before.prototype) result.prototypes.push_back({name, prototype});
+        if (global && global != before.global) result.globals.push_back({name, global});
+    }
+}
+
+// declares what an item declared the last time it was parsed
+static void redeclare_item(Lexer *env, const Item &item) {
+    for (auto &entry : item.result.types) env->type_info_map.insert(entry.first, entry.second);
+    for (auto &entry : item.result.enum_values) env->enum_values_map.insert(entry.first, entry.second);
+    for (auto &entry : item.result.functions) env->symbol_table.functions.insert(entry.first, entry.second);
+    for (auto &entry : item.result.prototypes) env->symbol_table.function_prototypes.insert(entry.first, entry.second);
+    for (auto &entry : item.result.globals) env->symbol_table.global_variables.insert(entry.first, entry.second);
+}
+
+// parses the items that need it (the new ones, and the ones that use
+// a name in changed_names), with all the others only redeclared.
+// (the items after the last one that is parsed don't need to be redeclared)
+static void check_document(Document *doc, std::unordered_set<std::string> *changed_names) {
+    Lexer *env = new Lexer;
+    size_t declared = 0; // (the items before this have been declared in env)
+
+    for (size_t i = 0; i < doc->items.size(); i++) {
+        Item *item = doc->items[i];
+        bool needs = !item->result.parsed;
+
+        for (size_t j = 0; !needs && !changed_names->empty() && j < item->references.size(); j++)
+            needs = changed_names->count(item->references[j]) > 0;
+        if (!needs) continue;
+
+        for (; declared < i; declared++)
+            redeclare_item(env, *doc->items[declared]);
+
+        // an item that was parsed again only because of what it uses
+        // may declare something else now (without its tokens changing),
+        // so everything it declares is changed. a new one has only
+        // changed what it declares differently than the one it replaced.
+        bool was_parsed = item->result.parsed;
+        std::vector<std::string> old_names = declared_names(item->result);
+
+        parse_item(env, item, item_tokens(doc, *item));
+        declared = i + 1;
+
+        std::vector<std::string> new_names = declared_names(item->result);
+        if (was_parsed) {
+            changed_names->insert(old_names.begin(), old_names.end());
+            changed_names->insert(new_names.begin(), new_names.end());
+        } else {
+            std::sort(old_names.begin(), old_names.end());
+            std::sort(new_names.begin(), new_names.end());
+            std::set_symmetric_difference(old_names.begin(), old_names.end(),
+                                          new_names.begin(), new_names.end(),
+                                          std::inserter(*changed_names, changed_names->end()));
+        }
+    }
+    delete env;
+}
+
+static void publish_diagnostics(Document *doc) {
+    std::string diagnostics;
+
+    auto add = [&](const Diagnostic &diagnostic, int line) {
+        if (!diagnostics.empty()) diagnostics += ",";
+        diagnostics += "{\"range\":" + json_range(line, diagnostic.start, diagnostic.end) +
+                       ",\"severity\":1,\"source\":\"emc\"";
+        if (!diagnostic.code.empty())
+            diagnostics += ",\"code\":" + json_string(diagnostic.code);
+        diagnostics += ",\"message\":" + json_string(diagnostic.message) + "}";
+    };
+
+    for (int i = 0; doc->lines_with_errors > 0 && i < (int)doc->lines.size(); i++)
+        if (doc->lines[i]->has_error)
+            add(doc->lines[i]->error, i);
+
+    for (Item *item : doc->items)
+        for (Diagnostic &diagnostic : item->result.diagnostics)
+            add(diagnostic, item->first_line + diagnostic.line);
+
+    send_message("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":" +
+                 json_string(doc->uri) + ",\"diagnostics\":[" + diagnostics + "]}}");
+}
+
+
+//               Go-to-definition and hover
+// ***********************************************************
+
+static void update_definitions(Document *doc) {
+    if (!doc->definitions_outdated) return;
+
+    // (the first declaration of a name wins, except that a
+    // function definition wins over its prototype)
+    doc->definitions.clear();
+    for (int i = 0; i < (int)doc->items.size(); i++) {
+        Item &item = *doc->items[i];
+        for (int j = 0; j < (int)item.declarations.size(); j++) {
+            auto found = doc->definitions.find(item.declarations[j].name);
+            if (found == doc->definitions.end())
+                doc->definitions[item.declarations[j].name] = {i, j};
+            else if (doc->items[found->second.first]->is_prototype && item.kind == ITEM_FUNCTION &&
+                     !item.is_prototype)
+                found->second = {i, j};
+        }
+    }
+    doc->definitions_outdated = false;
+}
+
+// (the item that has the given line in it, if any)
+static Item *item_at_line(Document *doc, int line) {
+    auto found = std::lower_bound(doc->items.begin(), doc->items.end(), line,
+                                  [](const Item *item, int line) { return item->last_line < line; });
+    if (found == doc->items.end() || (*found)->first_line > line)
+        return NULL;
+    return *found;
+}
+
+// joins tokens back into (roughly) how they would be written
+static std::string join_tokens(std::vector<Token> &tokens, size_t begin, size_t end) {
+    std::string text;
+    for (size_t i = begin; i < end && i < tokens.size(); i++) {
+        Token_Type type = tokens[i].type;
+        bool attached = type == TOKEN_LEFT_PAREN || type == TOKEN_RIGHT_PAREN ||
+                        type == TOKEN_SEPARATOR || type == TOKEN_DELIMITER ||
+                        type == TOKEN_LEFT_SQUARE || type == TOKEN_RIGHT_SQUARE ||
+                        type == TOKEN_LESS || type == TOKEN_GREATER || type == TOKEN_DOT;
+        if (i > begin && !attached) {
+            Token_Type prev = tokens[i - 1].type;
+            if (prev != TOKEN_LEFT_PAREN && prev != TOKEN_LEFT_SQUARE && prev != TOKEN_LESS &&
+                prev != TOKEN_DOT && prev != TOKEN_SEPARATOR)
+                text += " ";
+        }
+
+        if (type == TOKEN_STRING_LITERAL) text += "\"" + tokens[i].val + "\"";
+        else if (type == TOKEN_CHAR_LITERAL) text += "'" + tokens[i].val + "'";
+        else text += token_text(tokens[i]);
+        if (type == TOKEN_SEPARATOR) text += " ";
+    }
+    return text;
+}
+
+// the text shown on hover for a top-level declaration
+static std::string declaration_text(Document *doc, Item &item, int declaration) {
+    std::vector<Token> tokens = item_tokens(doc, item);
+    size_t end = tokens.size();
+
+    if (item.kind == ITEM_ENUM) {
+        if (declaration == 0)
+            return "enum " + item.declarations[0].name;
+        return "enum " + item.declarations[0].name + " :: " + item.declarations[declaration].name;
+    }
+
+    if (item.kind == ITEM_FUNCTION) {
+        // (up to the ')' of the parameters)
+        int depth = 0;
+        for (size_t i = 0; i < tokens.size(); i++) {
+            if (tokens[i].type == TOKEN_LEFT_PAREN) depth++;
+            else if (tokens[i].type == TOKEN_RIGHT_PAREN && --depth == 0) {
+                end = i + 1;
+                break;
+            }
+        }
+    } else {
+        for (size_t i = 0; i < tokens.size(); i++) {
+            if (tokens[i].type == TOKEN_ASSIGN || tokens[i].type == TOKEN_DELIMITER) {
+                end = i;
+                break;
+            }
+        }
+    }
+    return join_tokens(tokens, 0, end);
+}
+
+struct Lookup {
+    bool found = false;
+    std::string file_name; // (empty for the document)
+    int line;
+    int start, end;
+    std::string hover;
+};
+
+// finds what the identifier at the given position refers to. locals
+// (parameters, variables, loop variables) are looked for before it in
+// the same item, and then the top-level declarations of the document
+// (and its headers).
+static Lookup look_up(Document *doc, int line, int character) {
+    Lookup lookup;
+    if (line < 0 || line >= (int)doc->lines.size()) return lookup;
+
+    Token *word = NULL;
+    for (Token &tok : doc->lines[line]->tokens) {
+        if (tok.file_name.empty() && tok.type == TOKEN_IDENTIFIER &&
+            token_column(tok) <= character && character <= tok.position) {
+            word = &tok;
+            break;
+        }
+    }
+    if (word == NULL) return lookup;
+    std::string name = word->val;
+    int column = token_column(*word);
+
+    update_definitions(doc);
+
+    Item *item = item_at_line(doc, line);
+    if (item != NULL && item->kind == ITEM_FUNCTION) {
+        std::vector<Token> tokens = item_tokens(doc, *item);
+
+        size_t cursor = 0;
+        while (cursor < tokens.size() &&
+               !(tokens[cursor].file_name.empty() && tokens[cursor].line_num == line + 1 &&
+                 token_column(tokens[cursor]) == column))
+            cursor++;
+
+        for (size_t k = std::min(cursor, tokens.size() - 1) + 1; k-- > 1;) {
+            Token &tok = tokens[k];
+            Token &prev = tokens[k - 1];
+            if (tok.type != TOKEN_IDENTIFIER || tok.val != name) continue;
+
+            Token *next = (k + 1 < tokens.size()) ? &tokens[k + 1] : NULL;
+            if (next != NULL && (next->type == TOKEN_LEFT_PAREN || next->type == TOKEN_LESS))
+                continue;
+
+            // <type> name, for name in ..., and ...name (a parameter pack)
+            auto found = doc->definitions.find(prev.val);
+            bool is_type_name = found != doc->definitions.end() &&
+                (doc->items[found->second.first]->kind == ITEM_TYPEDEF ||
+                 (doc->items[found->second.first]->kind == ITEM_ENUM && found->second.second == 0));
+
+            if (prev.type == TOKEN_DATA_TYPE || (prev.type == TOKEN_IDENTIFIER && is_type_name))
+                lookup.hover = prev.val + " " + name;
+            else if (prev.type == TOKEN_KEYWORD && token_text(prev) == "for")
+                lookup.hover = name + " (loop variable)";
+            else if (prev.type == TOKEN_DOT && k >= 3 && tokens[k - 3].type == TOKEN_DOT)
+                lookup.hover = "..." + name + " (parameter pack)";
+            else
+                continue;
+
+            lookup.found = true;
+            lookup.line = tok.line_num - 1;
+            lookup.start = token_column(tok);
+            lookup.end = lookup.start + (int)name.size();
+            return lookup;
+        }
+    }
+
+    auto found = doc->definitions.find(name);
+    if (found == doc->definitions.end()) return lookup;
+
+    Item &declaring_item = *doc->items[found->second.first];
+    Declaration &declaration = declaring_item.declarations[found->second.second];
+
+    lookup.found = true;
+    lookup.file_name = declaration.file_name;
+    lookup.line = declaration.line + (declaration.file_name.empty() ? declaring_item.first_line : 0);
+    lookup.start = declaration.column;
+    lookup.end = declaration.column + (int)name.size();
+    lookup.hover = declaration_text(doc, declaring_item, found->second.second);
+    return lookup;
+}
+
+
+//                         Server
+// ***********************************************************
+
+static void open_document(const Json &params) {
+    const Json &text_document = params["textDocument"];
+    Document *&doc = documents[text_document["uri"].text];
+    if (doc == NULL) doc = new Document;
+
+    doc->uri = text_document["uri"].text;
+
+    Json change;
+    change.kind = JSON_OBJECT;
+    change.keys.push_back("text");
+    change.values.push_back(text_document["text"]);
+    Edit edit = apply_change(doc, change);
+
+    std::unordered_set<std::string> changed_names;
+    update_items(doc, edit, &changed_names);
+    check_document(doc, &changed_names);
+    publish_diagnostics(doc);
+}
+
+static void change_document(const Json &params) {
+    auto found = documents.find(params["textDocument"]["uri"].text);
+    if (found == documents.end()) return;
+    Document *doc = found->second;
+
+    std::unordered_set<std::string> changed_names;
+    for (const Json &change : params["contentChanges"].values)
+        update_items(doc, apply_change(doc, change), &changed_names);
+
+    check_document(doc, &changed_names);
+    publish_diagnostics(doc);
+}
+
+static void close_document(const Json &params) {
+    auto found = documents.find(params["textDocument"]["uri"].text);
+    if (found == documents.end()) return;
+
+    // (clears its diagnostics in the editor)
+    send_message("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":" +
+                 json_string(found->first) + ",\"diagnostics\":[]}}");
+
+    Document *doc = found->second;
+    for (Line *line : doc->lines) delete line;
+    for (Item *item : doc->items) delete item;
+    delete doc->line_lexer;
+    delete doc;
+    documents.erase(found);
+}
+
+// answers both textDocument/definition and textDocument/hover
+static void answer_lookup(const Json &id, const Json &params, bool is_hover) {
+    auto found = documents.find(params["textDocument"]["uri"].text);
+    if (found == documents.end()) {
+        send_response(id, "null");
+        return;
+    }
+
+    Document *doc = found->second;
+    const Json &position = params["position"];
+    Lookup lookup = look_up(doc, position["line"].as_int(), position["character"].as_int());
+    if (!lookup.found) {
+        send_response(id, "null");
+        return;
+    }
+
+    if (is_hover) {
+        send_response(id, "{\"contents\":{\"kind\":\"markdown\",\"value\":" +
+                      json_string("```em\n" + lookup.hover + "\n```") + "}}");
+        return;
+    }
+
+    std::string uri = lookup.file_name.empty() ? doc->uri : path_to_uri(lookup.file_name);
+    send_response(id, "{\"uri\":" + json_string(uri) + ",\"range\":" +
+                  json_range(lookup.line, lookup.start, lookup.end) + "}");
+}
+
+int run_language_server() {
+#if defined(_WIN32)
+    // (so that \r\n in the messages is left alone)
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    bool shutting_down = false;
+    std::string content;
+
+    while (read_message(&content)) {
+        Json message;
+        size_t i = 0;
+        if (!parse_json(content, i, &message) || message.kind != JSON_OBJECT)
+            continue;
+
+        const std::string &method = message["method"].text;
+        const Json &id = message["id"];
+        const Json &params = message["params"];
+
+        if (method == "initialize") {
+            // (the document changes are sent as ranges: change = 2)
+            send_response(id, "{\"capabilities\":{"
+                              "\"textDocumentSync\":{\"openClose\":true,\"change\":2},"
+                              "\"definitionProvider\":true,"
+                              "\"hoverProvider\":true},"
+                              "\"serverInfo\":{\"name\":\"emc\"}}");
+        } else if (method == "shutdown") {
+            shutting_down = true;
+            send_response(id, "null");
+        } else if (method == "exit") {
+            return shutting_down ? 0 : 1;
+        } else if (method == "textDocument/didOpen") {
+            open_document(params);
+        } else if (method == "textDocument/didChange") {
+            change_document(params);
+        } else if (method == "textDocument/didClose") {
+            close_document(params);
+        } else if (method == "textDocument/definition") {
+            answer_lookup(id, params, false);
+        } else if (method == "textDocument/hover") {
+            answer_lookup(id, params, true);
+        } else if (id.kind != JSON_NULL) {
+            // (notifications that we don't handle are just ignored)
+            send_error_response(id, -32601, "Method not found: " + method);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,24 @@
+//
+// lsp.h
+//
+
+/*
+
+here we have the language server (emc -lsp), which lets
+editors get diagnostics, go-to-definition and hover for
+.em files while they are being edited, without building them.
+
+it talks the Language Server Protocol (JSON-RPC messages,
+over stdin/stdout), and is built on the same lexer and
+parser as the compiler. see lsp.cpp for how it keeps the
+state of each file around, so that an edit only re-lexes
+and re-parses the part of the file that it touched.
+
+*/
+
+#pragma once
+
+
+// runs the language server until the client tells it to exit,
+// and returns the exit code for the process.
+int run_language_server();
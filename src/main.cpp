@@ -34,6 +34,14 @@ passed.
 
 For the compilation of multiple files, we would make use
 of threads to run the compilation process in parallel.
+(a fixed number of them, one per core, which take the
+files one after another, so that thousands of files don't
+start thousands of threads.)
+
+With -fsyntax-only or -fsema-only, we only check the files:
+the compilation stops after parsing, or after the IR has
+been generated (and verified), without the backend, the
+linking, or the need for an entry point.
 
 */
 
@@ -41,11 +49,16 @@ of threads to run the compilation process in parallel.
 #include "parser.h"
 #include "ir_generator.h"
 #include "linker.h"
+#include "lsp.h"
+#include "counters.h"
 
 
 
 // to optimize the IR as per the selected optimization level passed by the user
-void run_optimization(llvm::Module *_module, llvm::TargetMachine *target_machine, int optimization_level)
+// (with -fincremental, the functions have been optimized on their own, so
+// they are only inlined into each other, see build_incremental_pipeline)
+void run_optimization(llvm::Module *_module, llvm::TargetMachine *target_machine,
+                      int optimization_level, bool incremental)
 {
     llvm::OptimizationLevel opt_level;
 
@@ -73,7 +86,12 @@ void run_optimization(llvm::Module *_module, llvm::TargetMachine *target_machine
     pb.crossRegisterProxies(lam, fam, cgam, mam);
 
     // Build optimization pipeline
-    llvm::ModulePassManager mpm = pb.buildPerModuleDefaultPipeline(opt_level);
+    // (at O0 this only has the passes that are always required,
+    // like the ones that lower coroutines)
+    llvm::ModulePassManager mpm = (opt_level == llvm::OptimizationLevel::O0)
+        ? pb.buildO0DefaultPipeline(opt_level)
+        : incremental ? build_incremental_pipeline(pb, opt_level)
+                      : pb.buildPerModuleDefaultPipeline(opt_level);
 
     // Run optimization
     mpm.run(*_module, mam);
@@ -83,7 +101,8 @@ void run_optimization(llvm::Module *_module, llvm::TargetMachine *target_machine
 // to generate the executable / assembly file for the particular target
 void run_llvm_backend(llvm::Module *_module, const std::string &out_file_name,
                       Output_File_Type output_file_type, std::string cpu_type,
-                      std::string target_triple, int optimization_level) {
+                      std::string target_triple, int optimization_level,
+                      bool incremental) {
     // initialize all targets
     llvm::InitializeAllTargetInfos();
     llvm::InitializeAllTargets();
@@ -122,9 +141,14 @@ void run_llvm_backend(llvm::Module *_module, const std::string &out_file_name,
         return;
     }
 
-    // run optimization (if optimization level flag is passed)
-    if (optimization_level > 0)
-        run_optimization(_module, target_machine, optimization_level);
+    // run optimization (if optimization level flag is passed).
+    // async functions must always go through the pipeline, since
+    // their coroutine intrinsics are lowered by LLVM passes.
+    bool has_coroutines = _module->getFunction("llvm.coro.begin") != nullptr;
+    if (optimization_level > 0 || has_coroutines) {
+        Phase_Counter counter(PHASE_OPTIMIZE);
+        run_optimization(_module, target_machine, optimization_level, incremental);
+    }
 
     llvm::legacy::PassManager pass;
 
@@ -147,8 +171,11 @@ void run_llvm_backend(llvm::Module *_module, const std::string &out_file_name,
         return;
     }
 
-    pass.run(*_module);
-    dest.flush();
+    {
+        Phase_Counter counter(PHASE_CODEGEN);
+        pass.run(*_module);
+        dest.flush();
+    }
 }
 
 
@@ -158,9 +185,12 @@ void print_benchmark_metrics(Compilation_Metrics *metrics) {
     printf("\n                                 Performance metrics\n");
     printf("-------------------------------------------------------------------------------------------\n");
     printf("Total lines of code: \t\t\t%zu lines\n", metrics->total_lines);
-    printf("Number of threads: \t\t\t%zu (Equivalent to number of files compiled)\n\n", metrics->num_threads);
+    printf("Number of files: \t\t\t%zu\n", metrics->num_files);
+    printf("Number of threads: \t\t\t%zu (At most one per core)\n", metrics->num_threads);
+    printf("Functions skipped: \t\t\t%zu (Not reachable from main)\n", metrics->skipped_functions);
+    printf("Functions reused: \t\t\t%zu (From the incremental cache)\n\n", metrics->reused_functions);
 
-    printf("Aggregate frontend time elapsed: \t%.6f sec (Sum of frontend times of each thread)\n", metrics->aggregate_frontend_time);
+    printf("Aggregate frontend time elapsed: \t%.6f sec (Sum of frontend times of each file)\n", metrics->aggregate_frontend_time);
     printf("Frontend time elapsed: \t\t\t%.6f sec\n", metrics->frontend_time);
     printf("Backend time elapsed: \t\t\t%.6f sec\n", metrics->backend_time);
     printf("Linking time elapsed: \t\t\t%.6f sec (Time taken for making an exe from .o)\n\n", metrics->linking_time);
@@ -178,16 +208,36 @@ int has_extension(const char *file_name, const char *ext) {
     return strcmp(dot + 1, ext) == 0;
 }
 
-// perform the frontend compilation process for a file, and returns its LLVM
-// module also updates the overall compilation metrics as per the metrics for
-// this file. returns 0 on success, 1 on error.
-int compile(
-    const char *file_name, Flag_Settings *flag_settings,
-    bool *entry_point_found,
+// the end of checking a file (in the check modes), where
+// the metrics are updated, like for the files being compiled
+void finish_check(
+    Lexer *lexer, std::vector<AST_Expression *> *ast,
     std::chrono::time_point<std::chrono::high_resolution_clock> frontend_start,
-    Compilation_Metrics *metrics, std::mutex *metrics_mutex,
-    std::vector<std::unique_ptr<llvm::Module>> *module_list,
-    std::vector<std::string> *libs_to_link) {
+    Flag_Settings *flag_settings, Compilation_Metrics *metrics, std::mutex *metrics_mutex) {
+    auto frontend_end = std::chrono::high_resolution_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(*metrics_mutex);
+        if (flag_settings->print_ast)
+            print_ast(ast);
+
+        metrics->total_lines += lexer->total_lines_postprocessing;
+        metrics->total_tokens += lexer->tokens.size();
+        metrics->aggregate_frontend_time +=
+            ((std::chrono::duration<double>)(frontend_end - frontend_start)).count();
+    }
+    delete lexer;
+    delete ast;
+}
+
+// the lexer and the AST of a file, when it is parsed before the
+// rest of the files are compiled (for -fskip-unreachable)
+struct Parsed_File {
+    Lexer *lexer = nullptr;
+    std::vector<AST_Expression *> *ast = nullptr;
+};
+
+// lexes and parses a file. returns 0 on success, 1 on error.
+int parse_file(const char *file_name, Parsed_File *parsed) {
     if (!has_extension(file_name, LANGUAGE_FILE_EXTENSION)) {
         fprintf(
             stderr,
@@ -196,32 +246,117 @@ int compile(
         return 1;
     }
 
-    Lexer *lexer = perform_lexical_analysis(file_name);
-    if (!lexer)
+    {
+        Phase_Counter counter(PHASE_LEX);
+        parsed->lexer = perform_lexical_analysis(file_name);
+    }
+    if (!parsed->lexer)
         return 1; // Assume perform_lexical_analysis returns nullptr on error
 
-    libs_to_link->insert(
-        libs_to_link->end(),
-	std::make_move_iterator(lexer->libs_to_link.begin()),
-	std::make_move_iterator(lexer->libs_to_link.end())
-    );
-
-    auto *ast = parse_tokens(lexer);
-    if (!ast) {
-        delete lexer;
+    {
+        Phase_Counter counter(PHASE_PARSE);
+        parsed->ast = parse_tokens(parsed->lexer);
+    }
+    if (!parsed->ast) {
+        delete parsed->lexer;
         return 1;
     }
+    return 0;
+}
+
+// perform the frontend compilation process for a file, and returns its LLVM
+// module also updates the overall compilation metrics as per the metrics for
+// this file. returns 0 on success, 1 on error.
+// (in the check modes, the module is thrown away once it is verified)
+//
+// the module is sent to the link stage as soon as it is done (file_index is
+// the position of the file among the files), and the rest of what was made
+// for the file (its tokens, and its IR with the context) is freed right away,
+// instead of all of it being kept till the backend.
+//
+// with -fbatch-modules, the IR is emitted into the context of the thread's
+// batch instead, and the module is linked into the batch (which is sent to
+// the link stage by the thread, once it is done with all of its files).
+//
+// (the file is parsed here, unless it was parsed already, along with the
+// others. called_from_other_files then has the functions that they declare)
+int compile(
+    const char *file_name, Flag_Settings *flag_settings,
+    bool *entry_point_found,
+    std::chrono::time_point<std::chrono::high_resolution_clock> frontend_start,
+    Compilation_Metrics *metrics, std::mutex *metrics_mutex,
+    Link_Stage *link_stage, size_t file_index, Link_Batch *batch,
+    Parsed_File *parsed, const std::vector<std::string> *called_from_other_files) {
+    Parsed_File parsed_here;
+    if (!parsed) {
+        if (parse_file(file_name, &parsed_here) != 0)
+            return 1;
+        parsed = &parsed_here;
+    }
+    Lexer *lexer = parsed->lexer;
+    std::vector<AST_Expression *> *ast = parsed->ast;
+
+    if (flag_settings->mode == SYNTAX_ONLY) {
+        finish_check(lexer, ast, frontend_start, flag_settings, metrics, metrics_mutex);
+        return 0;
+    }
+
+    // with -fincremental, only the functions that have changed since
+    // the last build are emitted (and optimized), the rest are linked in
+    // from the cache. (if the cache turns out to be broken, the file is
+    // emitted again, as a whole)
+    Function_Cache *cache = nullptr;
+    if (flag_settings->incremental)
+        cache = open_function_cache(ast, lexer->file_name, flag_settings);
+
+    LLVM_IR *ir = nullptr;
+    while (true) {
+        {
+            Phase_Counter counter(PHASE_IR_GEN);
+            ir = emit_llvm_ir(ast, lexer->file_name.c_str(), flag_settings->target_triple,
+                              flag_settings->discard_value_names,
+                              batch ? &batch->context : nullptr,
+                              flag_settings->instrument_functions,
+                              flag_settings->skip_unreachable, called_from_other_files,
+                              cache);
+        }
+        if (!ir || !ir->_module || !cache || close_function_cache(cache, ir, flag_settings))
+            break;
+
+        free_llvm_ir(ir);
+        delete cache;
+        cache = open_function_cache(ast, lexer->file_name, flag_settings);
+    }
+    size_t reused_functions = cache ? cache->num_reused : 0;
+    delete cache;
 
-    LLVM_IR *ir = emit_llvm_ir(ast, lexer->file_name.c_str());
     if (!ir || !ir->_module) {
         delete lexer;
         delete ast;
         return 1;
     }
 
+    if (flag_settings->mode == SEMANTICS_ONLY) {
+        if (flag_settings->print_ir) {
+            std::lock_guard<std::mutex> lock(*metrics_mutex);
+            print_ir(ir->_module);
+        }
+        bool is_broken = llvm::verifyModule(*ir->_module, &llvm::errs());
+        free_llvm_ir(ir);
+
+        if (is_broken) {
+            delete lexer;
+            delete ast;
+            return 1;
+        }
+        finish_check(lexer, ast, frontend_start, flag_settings, metrics, metrics_mutex);
+        return 0;
+    }
+
     if (lexer->entry_point_found) {
         if (*entry_point_found) {
             fprintf(stderr, "ERROR: Duplicate entry points found.");
+            free_llvm_ir(ir);
             delete lexer;
             delete ast;
             return 1;
@@ -240,8 +375,10 @@ int compile(
         if (flag_settings->print_ir)
             print_ir(ir->_module);
 
-        module_list->push_back(std::unique_ptr<llvm::Module>(ir->_module));
         metrics->total_lines += lexer->total_lines_postprocessing;
+        metrics->total_tokens += lexer->tokens.size();
+        metrics->skipped_functions += ir->skipped_functions;
+        metrics->reused_functions += reused_functions;
 
         // calculating the elapsed time duration in seconds
         std::chrono::duration<double> frontend_elapsed_time =
@@ -249,9 +386,44 @@ int compile(
         metrics->aggregate_frontend_time += frontend_elapsed_time.count();
     }
 
+    bool is_broken = llvm::verifyModule(*ir->_module, &llvm::errs());
+
+    if (batch) {
+        if (!is_broken) {
+            std::unique_ptr<llvm::Module> module(ir->_module);
+            ir->_module = nullptr;
+            add_to_link_batch(batch, std::move(module), lexer->libs_to_link);
+        }
+        free_llvm_ir(ir);
+        delete lexer;
+        delete ast;
+        return is_broken ? 1 : 0;
+    }
+
+    // the module is written out as bitcode, so that the file's IR (and its
+    // context) can be freed before the link stage reads the module back in
+    // under the shared context.
+    auto *unit = new Link_Unit;
+    unit->module_name = ir->_module->getModuleIdentifier();
+    if (!is_broken) {
+        Phase_Counter counter(PHASE_MOVE);
+        write_module_to_bitcode(ir->_module, unit->bitcode);
+    }
+
+    // the parser can also ask for libs (for language features that
+    // need runtime support), so these are collected after parsing.
+    unit->libs_to_link = std::move(lexer->libs_to_link);
+
     // cleaning up allocated memory
+    free_llvm_ir(ir);
     delete lexer;
     delete ast;
+
+    if (is_broken) {
+        delete unit;
+        return 1;
+    }
+    send_to_link_stage(link_stage, file_index, unit);
     return 0;
 }
 
@@ -271,6 +443,10 @@ int main(int argc, char **argv) {
         exit(1);
     }
 
+    // (emc -lsp runs the language server, for editors, instead)
+    if (argc == 2 && strcmp(argv[1], "-lsp") == 0)
+        return run_language_server();
+
     int flags_start_index = 2;
     bool flags_exist = false;
 
@@ -298,6 +474,12 @@ int main(int argc, char **argv) {
                 flag_settings.output_file_type = ASM;
             else if (strcmp(argv[i], "-benchmark") == 0)
                 show_benchmarking_metrics = true;
+            else if (strcmp(argv[i], "-benchmark=counters") == 0) {
+                // (along with the hardware counters of each phase)
+                show_benchmarking_metrics = true;
+                enable_counters();
+                set_counter_thread_name("main");
+            }
             else if (strcmp(argv[i], "-cpu") == 0 && i < argc - 1) {
                 flag_settings.cpu_type =
                     argv[++i]; // reads the next argument as the cpu type
@@ -311,32 +493,183 @@ int main(int argc, char **argv) {
 	        flag_settings.optimization_level = 2;
 	    else if (strcmp(argv[i], "-O3") == 0)
 	        flag_settings.optimization_level = 3;
+	    else if (strcmp(argv[i], "-fsyntax-only") == 0)
+	        flag_settings.mode = SYNTAX_ONLY;
+	    else if (strcmp(argv[i], "-fsema-only") == 0)
+	        flag_settings.mode = SEMANTICS_ONLY;
+	    else if (strcmp(argv[i], "-fbatch-modules") == 0)
+	        flag_settings.batch_modules = true;
+	    else if (strcmp(argv[i], "-finstrument-functions") == 0)
+	        flag_settings.instrument_functions = true;
+	    else if (strcmp(argv[i], "-fskip-unreachable") == 0)
+	        flag_settings.skip_unreachable = true;
+	    else if (strcmp(argv[i], "-fincremental") == 0)
+	        flag_settings.incremental = true;
         }
     }
 
+    // the target is needed from the frontend onwards
+    // (the constraints of inline assembly depend on it)
+    if (flag_settings.cpu_type != "") {
+        for (int i = 0; i < NUM_CPU_TYPES; i++) {
+            if (cpu_to_target[i][0] == flag_settings.cpu_type) {
+                flag_settings.target_triple = cpu_to_target[i][1];
+                break;
+            }
+        }
+    }
+    if (flag_settings.target_triple == "") {
+        flag_settings.cpu_type = "generic";
+        flag_settings.target_triple = llvm::sys::getDefaultTargetTriple();
+    }
+
+    // (the check modes are there for the errors in all of the functions,
+    // so nothing is skipped in them, or taken from the cache)
+    if (flag_settings.mode != FULL_COMPILATION) {
+        flag_settings.skip_unreachable = false;
+        flag_settings.incremental = false;
+    }
+
+    // (with -fincremental, the functions are optimized by the threads
+    // of the files, so the targets are set up before those start)
+    if (flag_settings.incremental) {
+        llvm::InitializeAllTargetInfos();
+        llvm::InitializeAllTargets();
+        llvm::InitializeAllTargetMCs();
+    }
+
+    // the names of the local values are only needed if the IR is printed
+    flag_settings.discard_value_names =
+        !flag_settings.print_ir && flag_settings.output_file_type != LL;
+
     // run the compilation frontend for each file in parallel
     Compilation_Metrics metrics;
     bool entry_point_found = false;
     std::mutex metrics_mutex;
     std::vector<std::thread> threads;
-    std::vector<std::unique_ptr<llvm::Module>> module_list;
-    std::vector<std::string> libs_to_link;
     std::atomic<bool> error_occurred(false);
 
-    int last_file_arg_index = flags_exist ? flags_start_index - 1 : argc - 1;
-    metrics.num_threads = last_file_arg_index;
+    // in order to link all the modules together
+    // we must first bring them all under a single
+    // shared context. the link stage does this
+    // (and the linking) while the files are still
+    // being compiled, as each of them is done.
+    Link_Stage link_stage;
 
-    for (int i = 1; i <= last_file_arg_index; i++) {
-        threads.emplace_back([&, i]() {
-            if (compile(argv[i], &flag_settings, &entry_point_found,
-                        frontend_start, &metrics, &metrics_mutex,
-                        &module_list, &libs_to_link) != 0)
-                error_occurred = true;
-        });
+    int last_file_arg_index = flags_exist ? flags_start_index - 1 : argc - 1;
+    std::atomic<int> next_file_arg_index(1);
+
+    // (each thread keeps taking the next file, till none are left)
+    size_t num_cores = std::max(std::thread::hardware_concurrency(), 1u);
+    metrics.num_files = last_file_arg_index;
+    metrics.num_threads = std::min((size_t)last_file_arg_index, num_cores);
+
+    // with -fskip-unreachable, the functions of a file can also be called
+    // from the other files. so when there are several, they are all parsed
+    // first, and the functions that are declared in any of them (which is
+    // how a file calls a function from another one) are kept in every file,
+    // along with the functions that those call.
+    bool parse_files_first = flag_settings.skip_unreachable && metrics.num_files > 1;
+    std::vector<Parsed_File> parsed_files(parse_files_first ? metrics.num_files : 0);
+    std::vector<std::string> declared_functions;
+    if (parse_files_first) {
+        for (size_t t = 0; t < metrics.num_threads; t++) {
+            threads.emplace_back([&]() {
+                int i;
+                while ((i = next_file_arg_index++) <= last_file_arg_index) {
+                    auto parse_start = std::chrono::high_resolution_clock::now();
+                    if (parse_file(argv[i], &parsed_files[i - 1]) != 0) {
+                        error_occurred = true;
+                        continue;
+                    }
+                    auto parse_end = std::chrono::high_resolution_clock::now();
+
+                    std::lock_guard<std::mutex> lock(metrics_mutex);
+                    metrics.aggregate_frontend_time +=
+                        ((std::chrono::duration<double>)(parse_end - parse_start)).count();
+                    for (AST_Expression *ast_expr : *parsed_files[i - 1].ast) {
+                        auto *function = (AST_Function_Definition *)ast_expr;
+                        if (ast_expr->expr_type == EXPR_FUNC_DEF && function->is_prototype &&
+                            !function->is_from_std_library)
+                            declared_functions.push_back(function->function_name);
+                    }
+                }
+            });
+        }
+        for (auto &t : threads)
+            t.join();
+        threads.clear();
+        next_file_arg_index = 1;
+
+        if (error_occurred) {
+            fprintf(
+                stderr,
+                "ERROR: Compilation failed due to errors in one or more files.");
+            exit(1);
+        }
+    }
+    auto parsed_file = [&](int i) { return parse_files_first ? &parsed_files[i - 1] : nullptr; };
+    const std::vector<std::string> *called_from_other_files =
+        parse_files_first ? &declared_functions : nullptr;
+
+    // (with a single core, there is nothing for the link stage to
+    // run alongside of, so it links everything once all are done)
+    if (flag_settings.mode == FULL_COMPILATION)
+        start_link_stage(&link_stage,
+                         flag_settings.batch_modules ? metrics.num_threads : metrics.num_files,
+                         flag_settings.discard_value_names, num_cores > 1);
+
+    // with -fbatch-modules, each thread gets a run of the files instead
+    // (the t-th of the equal parts of them), which are compiled in order
+    // into its batch, so that the batches are in the order of the files
+    if (flag_settings.batch_modules) {
+        for (size_t t = 0; t < metrics.num_threads; t++) {
+            threads.emplace_back([&, t]() {
+                Link_Batch batch;
+                int first = 1 + (int)(t * metrics.num_files / metrics.num_threads);
+                int last = (int)((t + 1) * metrics.num_files / metrics.num_threads);
+
+                for (int i = first; i <= last; i++) {
+                    if (compile(argv[i], &flag_settings, &entry_point_found,
+                                std::chrono::high_resolution_clock::now(), &metrics,
+                                &metrics_mutex, &link_stage, i - 1, &batch,
+                                parsed_file(i), called_from_other_files) != 0) {
+                        error_occurred = true;
+                        batch.failed = true;
+                    }
+                }
+                if (flag_settings.mode == FULL_COMPILATION)
+                    send_batch_to_link_stage(&link_stage, t, &batch);
+            });
+        }
+    } else {
+        for (size_t t = 0; t < metrics.num_threads; t++) {
+            threads.emplace_back([&]() {
+                int i;
+                while ((i = next_file_arg_index++) <= last_file_arg_index) {
+                    if (compile(argv[i], &flag_settings, &entry_point_found,
+                                std::chrono::high_resolution_clock::now(), &metrics,
+                                &metrics_mutex, &link_stage, i - 1, nullptr,
+                                parsed_file(i), called_from_other_files) != 0) {
+                        error_occurred = true;
+
+                        // (the link stage still waits for every file)
+                        if (flag_settings.mode == FULL_COMPILATION) {
+                            auto *failed_unit = new Link_Unit;
+                            failed_unit->failed = true;
+                            send_to_link_stage(&link_stage, i - 1, failed_unit);
+                        }
+                    }
+                }
+            });
+        }
     }
     for (auto &t : threads)
         t.join(); // wait for all threads to finish
 
+    if (flag_settings.mode == FULL_COMPILATION)
+        finish_link_stage(&link_stage);
+
     if (error_occurred) {
         fprintf(
             stderr,
@@ -344,6 +677,17 @@ int main(int argc, char **argv) {
         exit(1);
     }
 
+    // the check modes are done here (the files are valid)
+    if (flag_settings.mode != FULL_COMPILATION) {
+        if (show_benchmarking_metrics) {
+            metrics.frontend_time = metrics.total_time =
+                ((std::chrono::duration<double>)(std::chrono::high_resolution_clock::now() - frontend_start)).count();
+            print_benchmark_metrics(&metrics);
+            print_counter_report(metrics.total_tokens);
+        }
+        return 0;
+    }
+
     // ensure that entry point exists
     if (!entry_point_found) {
         fprintf(stderr, "ERROR: No entry point (main) found.");
@@ -354,58 +698,43 @@ int main(int argc, char **argv) {
     auto backend_start = std::chrono::high_resolution_clock::now();
     metrics.frontend_time = ((std::chrono::duration<double>)(backend_start - frontend_start)).count();
 
-    // in order to link all the modules together
-    // we must first bring them all under a single
-    // shared context. to do this, we will have to
-    // move/clone each module to the shared context.
-
-    llvm::LLVMContext shared_context; // holds the global LLVM context
+    // (the modules of the files have all been linked by now)
     std::vector<std::unique_ptr<llvm::Module>> unified_modules;
-
-    unified_modules.reserve(module_list.size());
-
-    // clone the module into the shared_context
-    for (size_t i = 0; i < module_list.size(); ++i) {
-        if (llvm::verifyModule(*module_list[i], &llvm::errs())) {
-            error_occurred = true;
-            break;
-        }
-        auto cloned_module = move_module_to_context(module_list[i].get(), shared_context);
-        unified_modules.push_back(std::move(cloned_module));
-        module_list[i].release();
-    }
+    unified_modules.push_back(std::move(link_stage.program));
 
     // include libs that are needed, by converting
     // .bc files to LLVM modules.
+    // (a lib may be needed by more than one file, but it
+    // must only be linked once)
     std::string lib_path = get_lib_path();
+    std::vector<std::string> unique_libs;
+
+    // (the calls from -finstrument-functions go to the profiling runtime)
+    if (flag_settings.instrument_functions)
+        link_stage.libs_to_link.push_back("profile.bc");
+
+    for (std::string& lib_to_link: link_stage.libs_to_link) {
+        if (std::find(unique_libs.begin(), unique_libs.end(), lib_to_link) != unique_libs.end())
+            continue;
+        unique_libs.push_back(lib_to_link);
 
-    for (std::string& lib_to_link: libs_to_link) {
 	unified_modules.push_back(std::move(
-	    get_module_from_bitcode(lib_path + lib_to_link, shared_context)
+	    get_module_from_bitcode(lib_path + lib_to_link, link_stage.context)
 	));
     }
 
     // link the modules into a single module
-    std::unique_ptr<llvm::Module> linked_module = link_modules(std::move(unified_modules));
+    std::unique_ptr<llvm::Module> linked_module;
+    {
+        Phase_Counter counter(PHASE_LINK);
+        linked_module = link_modules(std::move(unified_modules));
+    }
 
     if (llvm::verifyModule(*linked_module, &llvm::errs())) {
         fprintf(stderr, "LINKER ERROR: Merged module verification failed.\n");
         exit(1);
     }
 
-    // preparing for LLVM backend execution
-    std::string target_triple;
-    if (flag_settings.cpu_type != "") {
-        for (int i = 0; i < NUM_CPU_TYPES; i++) {
-            if (cpu_to_target[i][0] == flag_settings.cpu_type) {
-                target_triple = cpu_to_target[i][1];
-                break;
-            }
-        }
-    }
-    if (target_triple == "")
-        flag_settings.cpu_type = "generic";
-
     std::string file_extension;
     switch (flag_settings.output_file_type) {
     case OBJ:
@@ -425,12 +754,17 @@ int main(int argc, char **argv) {
         flag_settings.output_file_name + file_extension;
 
     // generate the output file for the particular target cpu
+    // (with -fincremental, the functions from the cache are only inlined
+    // here, not optimized again. see incremental.h)
     if (flag_settings.output_file_type != LL) {
         run_llvm_backend(linked_module.get(), output_file_name,
                          flag_settings.output_file_type, flag_settings.cpu_type,
-                         target_triple, flag_settings.optimization_level);
-    } else
+                         flag_settings.target_triple, flag_settings.optimization_level,
+                         flag_settings.incremental);
+    } else {
+        Phase_Counter counter(PHASE_CODEGEN);
         write_llvm_ir_to_file(output_file_name.c_str(), linked_module.get());
+    }
 
     auto backend_end = std::chrono::high_resolution_clock::now();
 
@@ -450,6 +784,7 @@ int main(int argc, char **argv) {
     if (show_benchmarking_metrics) {
         metrics.total_time = metrics.frontend_time + metrics.backend_time + metrics.linking_time;
         print_benchmark_metrics(&metrics);
+        print_counter_report(metrics.total_tokens);
     }
     return 0;
 }
@@ -100,6 +100,8 @@ evaluating many expressions.
 */
 
 #include "parser.h"
+#include "literals.h"
+#include "linker.h"
 
 void parse_ast_block(std::vector<AST_Expression *> &block, Lexer *lexer) {
     // one possibility is that this is not a block
@@ -179,7 +181,7 @@ inline AST_If_Expression *parse_ast_if_expression(Lexer *lexer) {
 
     // check whether there is an else block as well
     tok = lexer->peek_next_token();
-    if (tok != NULL && tok->val == "else") {
+    if (tok != NULL && token_text(*tok) == "else") {
         lexer->move_to_next_token();
         tok = lexer->get_next_token();
         if (tok == NULL) {
@@ -275,6 +277,128 @@ inline AST_For_Expression *parse_ast_for_expression(Lexer *lexer) {
     return ast_for;
 }
 
+// parses the loop over a parameter pack. the current token is the pack
+//     for <identifier> in <pack> { ... }
+inline AST_Pack_For_Expression *parse_ast_pack_for_expression(Lexer *lexer,
+                                                              std::string &element) {
+    auto *ast_pack_for = new AST_Pack_For_Expression;
+    ast_pack_for->element = element;
+    lexer->move_to_next_token();
+
+    // the type of the element is different for every argument, so
+    // it is a type parameter (that only the IR generator binds)
+    lexer->symbol_table.push();
+
+    ast_pack_for->element_type = create_type_parameter(ast_pack_for->element);
+
+    auto *symbol = new Symbol;
+    symbol->identifier = ast_pack_for->element;
+    symbol->symbol_type = SYM_VARIABLE;
+    symbol->return_type = ast_pack_for->element_type;
+    lexer->symbol_table.insert(symbol);
+
+    parse_ast_block(ast_pack_for->block, lexer);
+    lexer->symbol_table.pop();
+
+    return ast_pack_for;
+}
+
+inline AST_Expression *parse_ast_range_for_expression(Lexer *lexer) {
+    // currently the token must be a "for"
+    //     for [<data_type>] <identifier> in <begin>..<end> [step <step>] { ... }
+    //     for <identifier> in <parameter_pack> { ... }
+    // (the body has to be a block here, since that is
+    // how we know where the last expression stops)
+
+    auto *ast_range_for = new AST_Range_For_Expression;
+
+    Token *tok = lexer->get_next_token();
+    if (tok == NULL || (tok->type != TOKEN_IDENTIFIER && tok->type != TOKEN_DATA_TYPE)) {
+        throw_parser_error(E136, lexer);
+    }
+    if (lexer->type_info_map[tok->val] != NULL) {
+        ast_range_for->induction_type = lexer->type_info_map[tok->val];
+        tok = lexer->get_next_token();
+        if (tok == NULL || tok->type != TOKEN_IDENTIFIER) {
+            throw_parser_error(E136, lexer);
+        }
+    }
+    ast_range_for->induction_variable = tok->val;
+
+    if (lexer->symbol_table.exists(tok->val, SYM_VARIABLE)) {
+        throw_parser_error(E041, lexer);
+    }
+
+    tok = lexer->get_next_token();
+    if (tok == NULL || tok->type != TOKEN_KEYWORD || token_text(*tok) != "in") {
+        throw_parser_error(E136, lexer);
+    }
+
+    // in <parameter_pack> {
+    tok = lexer->peek_next_token();
+    Token *after = lexer->peek(2);
+    if (ast_range_for->induction_type == NULL && tok != NULL && after != NULL &&
+        tok->type == TOKEN_IDENTIFIER && tok->val == lexer->parameter_pack &&
+        after->type == TOKEN_LEFT_BRACE) {
+        lexer->move_to_next_token();
+        AST_Expression *ast_pack_for =
+            parse_ast_pack_for_expression(lexer, ast_range_for->induction_variable);
+        delete ast_range_for;
+        return ast_pack_for;
+    }
+
+    // <begin> ..
+    lexer->move_to_next_token();
+    ast_range_for->begin = parse_ast_subexpression(lexer, PREC_MIN, TOKEN_DOT);
+    tok = lexer->peek_next_token();
+    if (ast_range_for->begin == NULL || tok == NULL || tok->type != TOKEN_DOT) {
+        throw_parser_error(E136, lexer);
+    }
+    lexer->move_to_next_token();
+    lexer->move_to_next_token();
+
+    // <end> [step <step>]
+    // ("step" is not a keyword, since it makes for a perfectly fine
+    // variable name. so it ends <end> only where an operator would
+    // have to come, and is told apart by its spelling.)
+    ast_range_for->end =
+        parse_ast_subexpression(lexer, PREC_MIN, TOKEN_LEFT_BRACE, NULL, "step");
+    if (ast_range_for->end == NULL) {
+        throw_parser_error(E136, lexer);
+    }
+    tok = lexer->peek();
+    if (tok != NULL && tok->type == TOKEN_IDENTIFIER && tok->val == "step") {
+        lexer->move_to_next_token();
+        ast_range_for->step = parse_ast_subexpression(lexer, PREC_MIN, TOKEN_LEFT_BRACE);
+        if (ast_range_for->step == NULL) {
+            throw_parser_error(E136, lexer);
+        }
+    }
+    if (lexer->peek() == NULL || lexer->peek()->type != TOKEN_LEFT_BRACE) {
+        throw_parser_error(E136, lexer);
+    }
+
+    // the induction variable belongs to the loop alone
+    lexer->symbol_table.push();
+
+    // (without a type, it is the type of the bounds, which only the IR
+    // generator knows. so it is a type parameter, that gets bound to it)
+    if (ast_range_for->induction_type == NULL)
+        ast_range_for->deduced_type = create_type_parameter(ast_range_for->induction_variable);
+
+    auto *symbol = new Symbol;
+    symbol->identifier = ast_range_for->induction_variable;
+    symbol->symbol_type = SYM_VARIABLE;
+    symbol->return_type = ast_range_for->induction_type != NULL
+        ? ast_range_for->induction_type : ast_range_for->deduced_type;
+    lexer->symbol_table.insert(symbol);
+
+    parse_ast_block(ast_range_for->block, lexer);
+    lexer->symbol_table.pop();
+
+    return ast_range_for;
+}
+
 inline AST_While_Expression *parse_ast_while_expression(Lexer *lexer) {
     // currently the token must be a "while"
     // so we will start from the next token
@@ -320,6 +444,224 @@ inline AST_While_Expression *parse_ast_while_expression(Lexer *lexer) {
     return ast_while;
 }
 
+inline bool is_ast_identifier_named(AST_Expression *expr,
+                                    const std::string &name) {
+    expr = unwrap_ast_expression(expr);
+    return expr != NULL && expr->expr_type == EXPR_IDENT &&
+           ((AST_Identifier *)expr)->name == name;
+}
+
+// walks through the body of a parallel for, collecting the names of
+// the variables that are referred to, and the ones that are declared
+// inside of it. it also rejects the expressions that cannot escape an
+// outlined body (break out of the parallel loop, return, varg).
+void collect_parallel_for_references(AST_Expression *expr, int loop_depth,
+                                     Lexer *lexer,
+                                     std::vector<std::string> &referenced,
+                                     std::vector<std::string> &declared) {
+    if (expr == NULL)
+        return;
+
+    auto collect_block = [&](std::vector<AST_Expression *> &block, int depth) {
+        for (AST_Expression *e : block)
+            collect_parallel_for_references(e, depth, lexer, referenced, declared);
+    };
+
+    switch (expr->expr_type) {
+    case EXPR_IDENT:
+        referenced.push_back(((AST_Identifier *)expr)->name);
+        break;
+    case EXPR_DECL:
+        declared.push_back(((AST_Declaration *)expr)->variable_name);
+        break;
+    case EXPR_UNARY:
+        collect_parallel_for_references(((AST_Unary_Expression *)expr)->expr,
+                                        loop_depth, lexer, referenced, declared);
+        break;
+    case EXPR_BINARY: {
+        auto *e = (AST_Binary_Expression *)expr;
+        collect_parallel_for_references(e->left, loop_depth, lexer, referenced, declared);
+        collect_parallel_for_references(e->right, loop_depth, lexer, referenced, declared);
+        break;
+    }
+    case EXPR_FUNC_CALL:
+        collect_block(((AST_Function_Call *)expr)->params, loop_depth);
+        break;
+    case EXPR_IF: {
+        auto *e = (AST_If_Expression *)expr;
+        collect_parallel_for_references(e->condition, loop_depth, lexer, referenced, declared);
+        collect_block(e->block, loop_depth);
+        collect_block(e->else_block, loop_depth);
+        break;
+    }
+    case EXPR_SWITCH: {
+        auto *e = (AST_Switch_Expression *)expr;
+        collect_parallel_for_references(e->identifier_or_call, loop_depth, lexer, referenced, declared);
+        for (AST_Case_Expression *c : e->case_list)
+            collect_block(c->block, loop_depth);
+        break;
+    }
+    case EXPR_FOR: {
+        auto *e = (AST_For_Expression *)expr;
+        collect_parallel_for_references(e->init, loop_depth, lexer, referenced, declared);
+        collect_parallel_for_references(e->condition, loop_depth, lexer, referenced, declared);
+        collect_parallel_for_references(e->increment, loop_depth, lexer, referenced, declared);
+        collect_block(e->block, loop_depth + 1);
+        break;
+    }
+    case EXPR_RANGE_FOR: {
+        auto *e = (AST_Range_For_Expression *)expr;
+        collect_parallel_for_references(e->begin, loop_depth, lexer, referenced, declared);
+        collect_parallel_for_references(e->end, loop_depth, lexer, referenced, declared);
+        collect_parallel_for_references(e->step, loop_depth, lexer, referenced, declared);
+        declared.push_back(e->induction_variable);
+        collect_block(e->block, loop_depth + 1);
+        break;
+    }
+    case EXPR_WHILE: {
+        auto *e = (AST_While_Expression *)expr;
+        collect_parallel_for_references(e->condition, loop_depth, lexer, referenced, declared);
+        collect_block(e->block, loop_depth + 1);
+        break;
+    }
+    case EXPR_PARALLEL_FOR: {
+        // a nested parallel for has already worked out what it needs
+        // from the outside, so those become our references too.
+        auto *e = (AST_Parallel_For_Expression *)expr;
+        collect_parallel_for_references(e->begin, loop_depth, lexer, referenced, declared);
+        collect_parallel_for_references(e->end, loop_depth, lexer, referenced, declared);
+        referenced.insert(referenced.end(), e->captures.begin(), e->captures.end());
+        if (e->induction_type == NULL)
+            referenced.push_back(e->induction_variable);
+        break;
+    }
+    case EXPR_ASM: {
+        auto *e = (AST_Asm_Expression *)expr;
+        for (Asm_Operand &operand : e->outputs)
+            collect_parallel_for_references(operand.expr, loop_depth, lexer, referenced, declared);
+        for (Asm_Operand &operand : e->inputs)
+            collect_parallel_for_references(operand.expr, loop_depth, lexer, referenced, declared);
+        break;
+    }
+    case EXPR_BLOCK:
+        collect_block(((AST_Block_Expression *)expr)->block, loop_depth);
+        break;
+    case EXPR_JUMP:
+        // continue simply moves on to the next iteration, but a break
+        // would have to stop the iterations running on other threads.
+        if (loop_depth == 0 && ((AST_Jump_Expression *)expr)->jump_type == J_BREAK)
+            throw_parser_error(E119, lexer);
+        break;
+    case EXPR_RETURN:
+    case EXPR_VARG:
+    case EXPR_AWAIT:
+    case EXPR_PACK_FOR:
+        throw_parser_error(E119, lexer);
+        break;
+    default:
+        break;
+    }
+}
+
+inline AST_Parallel_For_Expression *
+parse_ast_parallel_for_expression(Lexer *lexer) {
+    // currently the token must be a "parallel"
+    // and the next one has to be a "for"
+
+    Token *tok = lexer->get_next_token();
+    if (tok == NULL || tok->type != TOKEN_KEYWORD || token_text(*tok) != "for") {
+        throw_parser_error(E117, lexer);
+    }
+
+    // the induction variable (if declared in the loop) belongs to
+    // the loop alone, since every iteration gets its own copy of it.
+    lexer->symbol_table.push();
+    AST_For_Expression *ast_for = parse_ast_for_expression(lexer);
+    lexer->symbol_table.pop();
+
+    auto *ast_parallel_for = new AST_Parallel_For_Expression;
+
+    // the loop must be a simple counted loop, so that the range of
+    // iterations is known before the loop begins:
+    //     for (i = <begin>; i < <end>; i++)
+
+    // init: <data_type> i = <begin>  OR  i = <begin>
+    auto *init = (AST_Binary_Expression *)unwrap_ast_expression(ast_for->init);
+    if (init == NULL || init->expr_type != EXPR_BINARY ||
+        init->op != TOKEN_ASSIGN || init->right == NULL) {
+        throw_parser_error(E118, lexer);
+    }
+    AST_Expression *init_var = unwrap_ast_expression(init->left);
+    if (init_var->expr_type == EXPR_DECL) {
+        auto *decl = (AST_Declaration *)init_var;
+        ast_parallel_for->induction_variable = decl->variable_name;
+        ast_parallel_for->induction_type = decl->data_type;
+    } else if (init_var->expr_type == EXPR_IDENT) {
+        ast_parallel_for->induction_variable = ((AST_Identifier *)init_var)->name;
+    } else {
+        throw_parser_error(E118, lexer);
+    }
+    ast_parallel_for->begin = init->right;
+    const std::string &name = ast_parallel_for->induction_variable;
+
+    // condition: i < <end>  OR  i <= <end>
+    auto *condition = (AST_Binary_Expression *)unwrap_ast_expression(ast_for->condition);
+    if (condition == NULL || condition->expr_type != EXPR_BINARY ||
+        (condition->op != TOKEN_LESS && condition->op != TOKEN_LESSEQ) ||
+        !is_ast_identifier_named(condition->left, name) || condition->right == NULL) {
+        throw_parser_error(E118, lexer);
+    }
+    ast_parallel_for->end = condition->right;
+    ast_parallel_for->is_inclusive = condition->op == TOKEN_LESSEQ;
+
+    // increment: i++  OR  ++i  OR  i += 1
+    AST_Expression *increment = unwrap_ast_expression(ast_for->increment);
+    bool valid_increment = false;
+    if (increment != NULL && increment->expr_type == EXPR_UNARY) {
+        auto *unary = (AST_Unary_Expression *)increment;
+        valid_increment = unary->op == TOKEN_INCREMENT &&
+                          is_ast_identifier_named(unary->expr, name);
+    } else if (increment != NULL && increment->expr_type == EXPR_BINARY) {
+        auto *binary = (AST_Binary_Expression *)increment;
+        AST_Expression *step = unwrap_ast_expression(binary->right);
+        valid_increment = binary->op == TOKEN_PLUSEQ &&
+                          is_ast_identifier_named(binary->left, name) &&
+                          step != NULL && step->expr_type == EXPR_LITERAL &&
+                          ((AST_Literal *)step)->type == lexer->type_info_map["s32"] &&
+                          ((AST_Literal *)step)->value.i_s32 == 1;
+    }
+    if (!valid_increment) {
+        throw_parser_error(E118, lexer);
+    }
+
+    ast_parallel_for->block = std::move(ast_for->block);
+
+    // work out the captures. these are the local variables from
+    // the enclosing function that the body uses. (globals can be
+    // reached directly, and shadowing is not allowed, so a name
+    // declared inside the body can never refer to the outside.)
+    std::vector<std::string> referenced, declared;
+    for (AST_Expression *e : ast_parallel_for->block)
+        collect_parallel_for_references(e, 0, lexer, referenced, declared);
+
+    for (const std::string &ref : referenced) {
+        if (ref == name ||
+            lexer->symbol_table.global_variables[ref] != NULL ||
+            std::find(declared.begin(), declared.end(), ref) != declared.end() ||
+            std::find(ast_parallel_for->captures.begin(),
+                      ast_parallel_for->captures.end(), ref) != ast_parallel_for->captures.end())
+            continue;
+        ast_parallel_for->captures.push_back(ref);
+    }
+
+    // the loop body is run by the work-stealing scheduler in the runtime
+    if (std::find(lexer->libs_to_link.begin(), lexer->libs_to_link.end(),
+                  "parallel.bc") == lexer->libs_to_link.end())
+        lexer->libs_to_link.push_back("parallel.bc");
+
+    return ast_parallel_for;
+}
+
 inline AST_Return_Expression *parse_ast_return_expression(Lexer *lexer) {
     // currently the token must be a "return"
     // so we will start from the next token
@@ -365,6 +707,156 @@ parse_ast_jump_expression(Lexer *lexer, const std::string &jump_type) {
     return ast_jump;
 }
 
+// the atomic builtins, along with the number of arguments
+// that each of them takes (including the memory ordering,
+// which is always the last argument)
+//
+//     atomic_load(<variable>, <ordering>)
+//     atomic_store(<variable>, <value>, <ordering>)
+//     atomic_fetch_add(<variable>, <value>, <ordering>)
+//     atomic_cas(<variable>, <expected>, <desired>, <ordering>)
+//     fence(<ordering>)
+inline int get_atomic_builtin_num_args(const std::string &name) {
+    if (name == "atomic_load") return 2;
+    if (name == "atomic_store") return 3;
+    if (name == "atomic_fetch_add") return 3;
+    if (name == "atomic_cas") return 4;
+    if (name == "fence") return 1;
+    return -1; // not an atomic builtin
+}
+
+inline Atomic_Ordering get_atomic_ordering(const std::string &name) {
+    if (name == "relaxed") return AO_RELAXED;
+    if (name == "acquire") return AO_ACQUIRE;
+    if (name == "release") return AO_RELEASE;
+    if (name == "acq_rel") return AO_ACQ_REL;
+    if (name == "seq_cst") return AO_SEQ_CST;
+    return AO_NONE;
+}
+
+// not every ordering makes sense for every operation
+// (for instance, a load cannot "release" anything)
+inline bool is_valid_atomic_ordering(const std::string &name,
+                                     Atomic_Ordering ordering) {
+    if (name == "atomic_load")
+        return ordering == AO_RELAXED || ordering == AO_ACQUIRE || ordering == AO_SEQ_CST;
+    if (name == "atomic_store")
+        return ordering == AO_RELAXED || ordering == AO_RELEASE || ordering == AO_SEQ_CST;
+    if (name == "fence")
+        return ordering != AO_RELAXED && ordering != AO_NONE;
+    return ordering != AO_NONE;
+}
+
+inline AST_Function_Call *parse_ast_atomic_call(Lexer *lexer) {
+    // currently the token must be at the builtin name.
+    // these look like function calls, except that the last
+    // argument is the memory ordering, which is one of:
+    //     relaxed, acquire, release, acq_rel, seq_cst
+
+    auto ast_call = new AST_Function_Call;
+
+    Token *tok = lexer->peek();
+    ast_call->function_name = tok->val;
+    int num_args = get_atomic_builtin_num_args(tok->val);
+
+    // count the arguments first (same as for a normal call)
+    int num_separators = 0, i = 2;
+    while (1) {
+        if (lexer->peek(i) == NULL)
+            throw_error__incomplete_func_call(lexer);
+        if (lexer->peek(i)->type == TOKEN_SEPARATOR)
+            num_separators++;
+        else if (lexer->peek(i)->type == TOKEN_RIGHT_PAREN)
+            break;
+        i++;
+    }
+    if (num_separators + 1 != num_args) {
+        throw_parser_error(E037, lexer);
+    }
+
+    tok = lexer->get_next_token(); // this is '('
+    tok = lexer->get_next_token();
+
+    // the first argument of the operations on memory
+    // must be the (atomic) variable itself.
+    if (ast_call->function_name != "fence") {
+        if (tok == NULL || tok->type != TOKEN_IDENTIFIER ||
+            lexer->peek_next_token() == NULL ||
+            lexer->peek_next_token()->type != TOKEN_SEPARATOR) {
+            throw_parser_error(E123, lexer);
+        }
+    }
+
+    // parse the arguments before the ordering
+    for (int arg_num = 0; arg_num < num_args - 1; arg_num++) {
+        if (tok == NULL || tok->type == TOKEN_RIGHT_PAREN) {
+            throw_parser_error(E037, lexer);
+        }
+        AST_Expression *arg_expr =
+            parse_ast_subexpression(lexer, PREC_MIN, TOKEN_SEPARATOR);
+        if (arg_num == 0 && ast_call->function_name != "fence")
+            arg_expr = unwrap_ast_expression(arg_expr);
+        ast_call->params.push_back(arg_expr);
+
+        tok = lexer->get_next_token(); // skip ','
+    }
+
+    // and now the ordering
+    if (tok == NULL || tok->type == TOKEN_RIGHT_PAREN) {
+        throw_parser_error(E037, lexer);
+    }
+    ast_call->ordering = get_atomic_ordering(tok->val);
+    if (tok->type != TOKEN_IDENTIFIER ||
+        !is_valid_atomic_ordering(ast_call->function_name, ast_call->ordering)) {
+        throw_parser_error(E122, lexer);
+    }
+
+    tok = lexer->get_next_token();
+    if (tok == NULL || tok->type != TOKEN_RIGHT_PAREN) {
+        throw_parser_error(E037, lexer);
+    }
+
+    lexer->move_to_next_token();
+    return ast_call;
+}
+
+inline bool is_generic_function(Lexer *lexer, const std::string &name) {
+    Symbol *symbol = lexer->symbol_table.functions[name];
+    return symbol != NULL && symbol->num_type_params > 0;
+}
+
+inline void parse_ast_type_args(AST_Function_Call *ast_call, Lexer *lexer) {
+    // <name><type_1, type_2, ...>(...)
+    //
+    // the current token is the function name. after this,
+    // the current token will be '>' (followed by the '(').
+
+    size_t num_type_params =
+        lexer->symbol_table.functions[ast_call->function_name]->num_type_params;
+
+    Token *tok = lexer->get_next_token(); // this is '<'
+    while (1) {
+        tok = lexer->get_next_token();
+        if (tok == NULL || lexer->type_info_map[tok->val] == NULL) {
+            throw_parser_error(E133, lexer);
+        }
+        ast_call->type_args.push_back(lexer->type_info_map[tok->val]);
+
+        tok = lexer->get_next_token();
+        if (tok != NULL && tok->type == TOKEN_GREATER)
+            break;
+        if (tok == NULL || tok->type != TOKEN_SEPARATOR) {
+            throw_parser_error(E133, lexer);
+        }
+    }
+
+    Token *next = lexer->peek_next_token();
+    if (ast_call->type_args.size() != num_type_params ||
+        next == NULL || next->type != TOKEN_LEFT_PAREN) {
+        throw_parser_error(E133, lexer);
+    }
+}
+
 inline AST_Function_Call *parse_ast_function_call(Lexer *lexer) {
     // currently the token must be at the function name (i.e., an identifier)
     // we will read that token, and then move ahead.
@@ -374,6 +866,11 @@ inline AST_Function_Call *parse_ast_function_call(Lexer *lexer) {
     Token *tok = lexer->peek();
     ast_call->function_name = tok->val;
 
+    if (get_atomic_builtin_num_args(tok->val) != -1) {
+        delete ast_call;
+        return parse_ast_atomic_call(lexer);
+    }
+
     // get the number of arguments that are expected
     // (NOTE: this excludes the variadic portion)
     int num_expected_args;
@@ -392,6 +889,11 @@ inline AST_Function_Call *parse_ast_function_call(Lexer *lexer) {
                            lexer);
     }
 
+    // explicit type arguments (for a generic function)
+    Token *next = lexer->peek_next_token();
+    if (next != NULL && next->type == TOKEN_LESS && is_generic_function(lexer, tok->val))
+        parse_ast_type_args(ast_call, lexer);
+
     /*
     The argument structure is:
 
@@ -404,8 +906,13 @@ inline AST_Function_Call *parse_ast_function_call(Lexer *lexer) {
     // we won't check if it is NULL
     // because we already checked this, and only due to that
     // was the parse_ast_function_call() called in the first place.
+    // (other than after the type arguments, which are checked
+    // to be followed by it)
 
     tok = lexer->get_next_token();
+    if (tok == NULL) {
+        throw_error__incomplete_func_call(lexer);
+    }
 
     // if there are no arguments, just return this directly
     if (tok->type == TOKEN_RIGHT_PAREN) {
@@ -474,6 +981,11 @@ inline AST_Expression *parse_ast_identifier(Lexer *lexer) {
         // this is a function call
         return parse_ast_function_call(lexer);
     }
+    if (next->type == TOKEN_LESS && is_generic_function(lexer, tok->val) &&
+        !lexer->symbol_table.exists(tok->val, SYM_VARIABLE)) {
+        // a generic function call, with explicit type arguments
+        return parse_ast_function_call(lexer);
+    }
 
     // if it is not a function call...
     //
@@ -531,6 +1043,116 @@ inline AST_Varg *parse_ast_varg(Lexer *lexer) {
     return ast_varg;
 }
 
+// "<constraint>"(<expression>), with the current token at the constraint.
+// afterwards, the current token is the one following the ')'
+inline Asm_Operand parse_ast_asm_operand(Lexer *lexer, bool is_output) {
+    Asm_Operand operand;
+    operand.constraint = lexer->peek()->val;
+
+    Token *tok = lexer->get_next_token();
+    if (tok == NULL || tok->type != TOKEN_LEFT_PAREN) {
+        throw_parser_error(E141, lexer);
+    }
+    lexer->move_to_next_token();
+    operand.expr = parse_ast_subexpression(lexer, PREC_MIN, TOKEN_RIGHT_PAREN);
+
+    // the outputs get written to, so they must be variables
+    if (operand.expr == NULL ||
+        (is_output && unwrap_ast_expression(operand.expr)->expr_type != EXPR_IDENT)) {
+        throw_parser_error(E141, lexer);
+    }
+    if (is_output)
+        operand.expr = unwrap_ast_expression(operand.expr);
+
+    lexer->move_to_next_token();
+    return operand;
+}
+
+inline AST_Asm_Expression *parse_ast_asm_expression(Lexer *lexer) {
+    // asm [volatile] ("<template>" : <outputs> : <inputs> : <clobbers>)
+    //
+    // the current token is "asm". every section after the
+    // template is optional (and may be left empty):
+    //     asm("cpsid i");
+    //     asm("add %0, %1, %2" : "=r"(sum) : "r"(a), "r"(b));
+    //     asm volatile("" : : : "memory");
+
+    auto *ast_asm = new AST_Asm_Expression;
+
+    Token *tok = lexer->get_next_token();
+    if (tok != NULL && tok->type == TOKEN_IDENTIFIER && tok->val == "volatile") {
+        ast_asm->is_volatile = true;
+        tok = lexer->get_next_token();
+    }
+    if (tok == NULL || tok->type != TOKEN_LEFT_PAREN) {
+        throw_parser_error(E140, lexer);
+    }
+
+    // the template (adjacent strings are joined together,
+    // so that it can be written over multiple lines)
+    tok = lexer->get_next_token();
+    if (tok == NULL || tok->type != TOKEN_STRING_LITERAL) {
+        throw_parser_error(E140, lexer);
+    }
+    while (tok != NULL && tok->type == TOKEN_STRING_LITERAL) {
+        ast_asm->asm_template += tok->val;
+        tok = lexer->get_next_token();
+    }
+
+    // outputs : inputs : clobbers
+    for (int section = 0; section < 3 && tok != NULL && tok->type == TOKEN_COLON; section++) {
+        tok = lexer->get_next_token();
+
+        while (tok != NULL && tok->type == TOKEN_STRING_LITERAL) {
+            if (section == 0) {
+                ast_asm->outputs.push_back(parse_ast_asm_operand(lexer, true));
+            } else if (section == 1) {
+                ast_asm->inputs.push_back(parse_ast_asm_operand(lexer, false));
+            } else {
+                ast_asm->clobbers.push_back(tok->val);
+                lexer->move_to_next_token();
+            }
+
+            tok = lexer->peek();
+            if (tok == NULL || tok->type != TOKEN_SEPARATOR)
+                break;
+            tok = lexer->get_next_token();
+            if (tok == NULL || tok->type != TOKEN_STRING_LITERAL) {
+                throw_parser_error(E140, lexer);
+            }
+        }
+    }
+
+    if (tok == NULL || tok->type != TOKEN_RIGHT_PAREN) {
+        throw_parser_error(E140, lexer);
+    }
+    lexer->move_to_next_token();
+
+    return ast_asm;
+}
+
+inline AST_Await_Expression *parse_ast_await_expression(Lexer *lexer) {
+    // await <function_call>
+    //
+    // the current token is "await". this suspends the
+    // async function, so it can't be used anywhere else.
+
+    if (!lexer->parsing_async_function) {
+        throw_parser_error(E127, lexer);
+    }
+
+    Token *tok = lexer->get_next_token();
+    Token *next = lexer->peek_next_token();
+    if (tok == NULL || tok->type != TOKEN_IDENTIFIER ||
+        next == NULL || next->type != TOKEN_LEFT_PAREN) {
+        throw_parser_error(E128, lexer);
+    }
+
+    auto *ast_await = new AST_Await_Expression;
+    ast_await->call = parse_ast_function_call(lexer);
+    return ast_await;
+}
+
 inline AST_Declaration *parse_ast_declaration(Lexer *lexer) {
     // declaration
     //     <data_type> <identifier>
@@ -568,32 +1190,84 @@ inline AST_Declaration *parse_ast_declaration(Lexer *lexer) {
     return ast_decl;
 }
 
+inline AST_Declaration *parse_ast_const_declaration(Lexer *lexer) {
+    // const declaration
+    //     const <data_type> <identifier> = <expression>
+    //
+    // the current token is "const". a const variable
+    // can never be assigned to later, so it must
+    // always be initialized where it is declared.
+
+    Token *tok = lexer->get_next_token();
+    if (tok == NULL || lexer->type_info_map[tok->val] == NULL) {
+        throw_parser_error(E114, lexer);
+    }
+
+    AST_Declaration *ast_decl = parse_ast_declaration(lexer);
+    ast_decl->is_const = true;
+
+    tok = lexer->peek();
+    if (tok == NULL || tok->type != TOKEN_ASSIGN) {
+        throw_parser_error(E115, lexer);
+    }
+    return ast_decl;
+}
+
+inline AST_Declaration *parse_ast_atomic_declaration(Lexer *lexer) {
+    // atomic declaration
+    //     atomic <data_type> <identifier>
+    //     atomic <data_type> <identifier> = <expression>
+    //
+    // the current token is "atomic". only integer
+    // types can be atomic (the hardware only has
+    // atomic instructions for those).
+
+    Token *tok = lexer->get_next_token();
+    if (tok == NULL || lexer->type_info_map[tok->val] == NULL) {
+        throw_parser_error(E121, lexer);
+    }
+
+    Data_Type *data_type = lexer->type_info_map[tok->val];
+    while (data_type->type_kind == TK_ALIAS) data_type = data_type->base_type;
+    if (data_type->type_kind != TK_PRIMITIVE || !is_int_type(data_type)) {
+        throw_parser_error(E121, lexer);
+    }
+
+    AST_Declaration *ast_decl = parse_ast_declaration(lexer);
+    ast_decl->is_atomic = true;
+    return ast_decl;
+}
+
 inline AST_Literal *parse_ast_literal(Lexer *lexer) {
     auto *ast_literal = new AST_Literal;
     Token *tok = lexer->peek();
 
     if (tok->type == TOKEN_NUMERIC_LITERAL) {
-        // it is either an int or a float
-        // if it has a decimal point ('.'), then it is a float
-        //
-        // there is some stuff we have to assume for ints
-        // considering that they could be either:
-        //   u32, u64, s32 or s64
-        //
-        // we will assume (during parsing of the literal)
-        // that it is signed, and we will first try to parse
-        // it as s32. if it doesn't fit in it, then we will
-        // try using s64.
-
-        if (tok->val.find('.') != std::string::npos) {
-            ast_literal->value.f_64 = std::stod(tok->val);
-            ast_literal->type = lexer->type_info_map["f64"];
-        } else if (fits_s32(tok->val)) {
-            ast_literal->value.i_s32 = std::stoi(tok->val);
+        // it is either an int or a float (see literals.h). an int
+        // gets the smallest of s32, s64 and u64 that it fits in.
+        // (the lexer has already checked that it is valid)
+        Numeric_Literal literal;
+        const char *invalid_char;
+        decode_numeric_literal(tok->val.data(), tok->val.data() + tok->val.size(),
+                               &literal, &invalid_char);
+
+        switch (literal.kind) {
+        case LITERAL_S32:
+            ast_literal->value.i_s32 = literal.value.i_s32;
             ast_literal->type = lexer->type_info_map["s32"];
-        } else {
-            ast_literal->value.i_s64 = std::stoll(tok->val);
+            break;
+        case LITERAL_S64:
+            ast_literal->value.i_s64 = literal.value.i_s64;
             ast_literal->type = lexer->type_info_map["s64"];
+            break;
+        case LITERAL_U64:
+            ast_literal->value.i_u64 = literal.value.i_u64;
+            ast_literal->type = lexer->type_info_map["u64"];
+            break;
+        case LITERAL_F64:
+            ast_literal->value.f_64 = literal.value.f_64;
+            ast_literal->type = lexer->type_info_map["f64"];
+            break;
         }
 
     } else if (tok->type == TOKEN_BOOL_LITERAL) {
@@ -658,6 +1332,7 @@ inline AST_Switch_Expression *parse_ast_switch_expression(Lexer* lexer) {
 	throw_parser_error(E093, lexer);
     }
     if (ident_or_call_type->type_kind == TK_PRIMITIVE && ident_or_call_type->name.p == T_STRING) is_string_type = true;
+    else if (ident_or_call_type->type_kind == TK_TYPE_PARAM) ; // (not known until it is bound)
     else if (!is_int_type(ident_or_call_type)) throw_parser_error(E102, lexer);
 
     // TODO: handle hashing in case of string types
@@ -685,7 +1360,7 @@ inline AST_Switch_Expression *parse_ast_switch_expression(Lexer* lexer) {
     // have a bunch of case expressions.
 
     while (tok != NULL && tok->type != TOKEN_RIGHT_BRACE) {
-        if (tok->val != "case") {
+        if (token_text(*tok) != "case") {
             throw_parser_error(E096, lexer);
         }
         tok = lexer->get_next_token();
@@ -799,10 +1474,26 @@ inline AST_Expression *parse_primary_subexpression(Lexer *lexer, Token *tok) {
             expr = parse_ast_parenthesized_expression(lexer);
             break;
         case TOKEN_KEYWORD:
-            if (tok->val == "varg") {
+            if (token_text(*tok) == "varg") {
                 expr = parse_ast_varg(lexer);
                 break;
             }
+            if (token_text(*tok) == "const") {
+                expr = parse_ast_const_declaration(lexer);
+                break;
+            }
+            if (token_text(*tok) == "atomic") {
+                expr = parse_ast_atomic_declaration(lexer);
+                break;
+            }
+            if (token_text(*tok) == "await") {
+                expr = parse_ast_await_expression(lexer);
+                break;
+            }
+            if (token_text(*tok) == "asm") {
+                expr = parse_ast_asm_expression(lexer);
+                break;
+            }
             // other keywords are not supposed to be inside
             // a primary subexpression
         default:
@@ -835,10 +1526,22 @@ inline AST_Expression *parse_primary_subexpression(Lexer *lexer, Token *tok) {
     return (ast_unary_prefix == NULL) ? expr : ast_unary_prefix;
 }
 
+// whether the token that comes where an operator is expected ends the
+// expression. that is the token stops_at, or the identifier spelled as
+// stops_at_word (for a word that ends an expression without being a
+// keyword, like the "step" of a range for).
+inline bool is_end_of_subexpression(Token *tok, Token_Type stops_at,
+                                    const char *stops_at_word) {
+    return tok->type == stops_at ||
+           (stops_at_word != NULL && tok->type == TOKEN_IDENTIFIER &&
+            tok->val == stops_at_word);
+}
+
 AST_Expression *
 parse_decreasing_precedence(Lexer *lexer, AST_Binary_Expression *left,
                             Precedence curr_precedence,
-                            Token_Type stops_at = TOKEN_DELIMITER) {
+                            Token_Type stops_at = TOKEN_DELIMITER,
+                            const char *stops_at_word = NULL) {
     auto *curr_expression = new AST_Binary_Expression;
 
     while (1) {
@@ -865,7 +1568,7 @@ parse_decreasing_precedence(Lexer *lexer, AST_Binary_Expression *left,
                 E047,
                 lexer);
         }
-        if (op->type == stops_at) {
+        if (is_end_of_subexpression(op, stops_at, stops_at_word)) {
             curr_expression->right = tok_expr;
             break;
         }
@@ -881,7 +1584,7 @@ parse_decreasing_precedence(Lexer *lexer, AST_Binary_Expression *left,
         Precedence new_prec = op_prec(op->type);
         if (new_prec > curr_precedence) {
             curr_expression->right =
-                parse_ast_subexpression(lexer, new_prec, stops_at, tok_expr);
+                parse_ast_subexpression(lexer, new_prec, stops_at, tok_expr, stops_at_word);
             break;
         }
 
@@ -903,10 +1606,15 @@ parse_decreasing_precedence(Lexer *lexer, AST_Binary_Expression *left,
 // tells which token comes right after the end of this expression.
 // We need this to know when to stop reading further. By default it is ';',
 // but it can also be a ')' (or certain other characters too...)
+//
+// stops_at_word :
+// a word (not a keyword) that also ends the expression, where an
+// operator would otherwise have to come. (NULL if there is none)
 AST_Expression *parse_ast_subexpression(Lexer *lexer,
                                         Precedence curr_precedence,
                                         Token_Type stops_at,
-                                        AST_Expression *left) {
+                                        AST_Expression *left,
+                                        const char *stops_at_word) {
     /*
     The idea is that parsing in accordance with operator
     precedence can simply be broken into two scenarios:
@@ -948,7 +1656,7 @@ AST_Expression *parse_ast_subexpression(Lexer *lexer,
 
     while (1) {
         tok = lexer->peek();
-        if (tok != NULL && tok->type == stops_at)
+        if (tok != NULL && is_end_of_subexpression(tok, stops_at, stops_at_word))
             break;
         if (tok != NULL && tok->type == TOKEN_DELIMITER) {
             throw_error__used_delimiter_in_a_non_statement(lexer);
@@ -973,7 +1681,7 @@ AST_Expression *parse_ast_subexpression(Lexer *lexer,
                 E047,
                 lexer);
         }
-        if (op->type == stops_at) {
+        if (is_end_of_subexpression(op, stops_at, stops_at_word)) {
             curr_expression->right = tok_expr;
             break;
         }
@@ -990,7 +1698,7 @@ AST_Expression *parse_ast_subexpression(Lexer *lexer,
         if (new_prec < curr_precedence) {
             curr_expression->right = tok_expr;
             auto *updated_expression = parse_decreasing_precedence(
-                lexer, curr_expression, new_prec, stops_at);
+                lexer, curr_expression, new_prec, stops_at, stops_at_word);
 
             if (prev_expression == NULL)
                 return updated_expression;
@@ -1050,25 +1758,38 @@ AST_Expression *parse_ast_expression(Lexer *lexer) {
     //     if ( <expression> ) <block>
     //     switch ( <identifier> ) { ... }
     //     for ( <expression> ; <expression> ; <expression> ) <block>
+    //     for <identifier> in <expression>..<expression> [step <expression>] <block>
     //     while ( <expression> ) <block>
+    //     parallel for ( <expression> ; <expression> ; <expression> ) <block>
     //     return <expression>;
     //     break; OR continue;
+    //     const <data_type> <identifier> = <expression>;
+    //     atomic <data_type> <identifier>;
+    //     await <function_call>;
+    //     asm ( "<template>" : <outputs> : <inputs> : <clobbers> );
 
     if (tok->type == TOKEN_KEYWORD) {
-        if (tok->val == "if")
+        if (token_text(*tok) == "if")
             return parse_ast_if_expression(lexer);
-	else if (tok->val == "switch")
+	else if (token_text(*tok) == "switch")
 	    return parse_ast_switch_expression(lexer);
-        else if (tok->val == "for")
+        else if (token_text(*tok) == "for" && lexer->peek(1) != NULL && lexer->peek(1)->type != TOKEN_LEFT_PAREN)
+            return parse_ast_range_for_expression(lexer);
+        else if (token_text(*tok) == "for")
             return parse_ast_for_expression(lexer);
-        else if (tok->val == "while")
+        else if (token_text(*tok) == "while")
             return parse_ast_while_expression(lexer);
-        else if (tok->val == "return")
+        else if (token_text(*tok) == "parallel")
+            return parse_ast_parallel_for_expression(lexer);
+        else if (token_text(*tok) == "return")
             return parse_ast_return_expression(lexer);
-        else if (tok->val == "break")
+        else if (token_text(*tok) == "break")
             return parse_ast_jump_expression(lexer, "break");
-        else if (tok->val == "continue")
+        else if (token_text(*tok) == "continue")
             return parse_ast_jump_expression(lexer, "continue");
+        else if (token_text(*tok) == "const" || token_text(*tok) == "atomic" || token_text(*tok) == "await" ||
+                 token_text(*tok) == "asm")
+            return parse_ast_subexpression(lexer, PREC_MIN);
         else
             throw_parser_error(E048,
                                lexer);
@@ -1143,15 +1864,19 @@ void parse_ast_function_params(AST_Function_Definition *ast_function,
 		    if (tok == NULL || tok->type != TOKEN_DOT) goto invalid_arg;
 		}
 
-		// now we have got a variadic arg marker
-		// but we still need to ensure that the next
-		// token is ')'
+		// now we have got a variadic arg marker. if it is
+		// followed by a name, it is a typed parameter pack
+		// instead. either way the next token has to be ')'
 		tok = lexer->get_next_token();
+		if (tok != NULL && tok->type == TOKEN_IDENTIFIER) {
+		    ast_function->pack_name = tok->val;
+		    tok = lexer->get_next_token();
+		}
 		if (tok == NULL || tok->type != TOKEN_RIGHT_PAREN) {
 		    throw_parser_error(E088, lexer);
 		}
 
-		ast_function->has_variadic_args = true;
+		ast_function->has_variadic_args = ast_function->pack_name.empty();
 		break;
 	    }
 
@@ -1209,15 +1934,55 @@ void parse_ast_function_params(AST_Function_Definition *ast_function,
         throw_error__insufficient_tokens_func_def(lexer);
 }
 
+// declares the type parameters of a generic function, so that they
+// can be used as data types within it (including the return type,
+// which comes before them).
+//
+//     <return_type> <name><T, U, ...>(...)
+//
+// this only looks ahead from the current token (the return type),
+// and does not consume anything.
+void declare_function_type_params(AST_Function_Definition *ast_function,
+                                  Lexer *lexer) {
+    int i = 3; // the token after '<'
+    while (1) {
+        Token *tok = lexer->peek(i);
+        if (tok == NULL || tok->type != TOKEN_IDENTIFIER) {
+            throw_parser_error(E130, lexer);
+        }
+        if (lexer->type_info_map[tok->val] != NULL) {
+            throw_parser_error(E131, lexer);
+        }
+
+        Data_Type *type_param = create_type_parameter(tok->val);
+        lexer->type_info_map.insert(tok->val, type_param);
+        ast_function->type_params.push_back(type_param);
+
+        tok = lexer->peek(i + 1);
+        if (tok != NULL && tok->type == TOKEN_GREATER)
+            break;
+        if (tok == NULL || tok->type != TOKEN_SEPARATOR) {
+            throw_parser_error(E130, lexer);
+        }
+        i += 2;
+    }
+}
+
 // parses the entire function (and everything within it)
 AST_Function_Definition *parse_ast_function(Lexer *lexer) {
     // Function syntax:
     // <return_type> <name>(...) <block>|<expr>
+    // <return_type> <name><T, U, ...>(...) <block>|<expr>  (generic function)
 
     // return type
     Token *tok_return_type = lexer->peek();
 
     auto *ast_function = new AST_Function_Definition;
+
+    Token *tok_after_name = lexer->peek(2);
+    if (tok_after_name != NULL && tok_after_name->type == TOKEN_LESS)
+        declare_function_type_params(ast_function, lexer);
+
     ast_function->return_type = lexer->type_info_map[tok_return_type->val];
     if (ast_function->return_type == NULL) {
 	throw_parser_error(E053, lexer);
@@ -1235,12 +2000,29 @@ AST_Function_Definition *parse_ast_function(Lexer *lexer) {
     }
     ast_function->function_name = tok_name->val;
 
+    // (the compiler treats a few of the standard library's functions
+    // specially, but not some other function that has the same name)
+    static const std::string include_path = get_include_path();
+    ast_function->is_from_std_library = tok_name->file_name.compare(0, include_path.size(), include_path) == 0;
+
+    // (a call to one of these is always parsed as the builtin,
+    // so a function of the same name could never be called)
+    if (get_atomic_builtin_num_args(ast_function->function_name) != -1) {
+        throw_parser_error(E150, lexer);
+    }
+
     if (lexer->symbol_table.exists(ast_function->function_name, SYM_FUNCTION)) {
         throw_parser_error(
             E055,
             lexer);
     }
 
+    // skip over the type parameters (they have already been declared)
+    if (!ast_function->type_params.empty()) {
+        for (size_t i = 0; i < 2 * ast_function->type_params.size() + 1; i++)
+            lexer->move_to_next_token();
+    }
+
     // left parenthesis
     Token *tok_left_paren = lexer->get_next_token();
     if (tok_left_paren == NULL) {
@@ -1262,7 +2044,10 @@ AST_Function_Definition *parse_ast_function(Lexer *lexer) {
     symbol->symbol_type = SYM_FUNCTION;
     symbol->return_type = ast_function->return_type;
     symbol->signature = new std::vector<Data_Type *>();
-    symbol->has_variadic_args = ast_function->has_variadic_args;
+    // (a call can pass any number of arguments to a parameter pack)
+    symbol->has_variadic_args =
+        ast_function->has_variadic_args || !ast_function->pack_name.empty();
+    symbol->num_type_params = ast_function->type_params.size();
 
     for (auto *param : ast_function->params) {
         symbol->signature->push_back(param->type);
@@ -1287,21 +2072,40 @@ AST_Function_Definition *parse_ast_function(Lexer *lexer) {
             throw_parser_error(E058,
                                lexer);
         }
+        if (!ast_function->type_params.empty()) {
+            throw_parser_error(E132, lexer);
+        }
+        if (!ast_function->pack_name.empty()) {
+            throw_parser_error(E146, lexer);
+        }
         ast_function->is_prototype = true;
         lexer->symbol_table.function_prototypes.insert(
             ast_function->function_name, symbol);
     } else {
         lexer->symbol_table.insert(symbol); // normal function symbol insertion
+        lexer->parameter_pack = ast_function->pack_name;
         parse_ast_block(ast_function->block, lexer);
+        lexer->parameter_pack.clear();
     }
 
     lexer->symbol_table.pop();
+
+    // the type parameters are only visible inside the function
+    for (Data_Type *type_param : ast_function->type_params)
+        lexer->type_info_map.remove(*(type_param->name.np));
+
     return ast_function;
 }
 
 // parse global declarations (with or without initialization)
 AST_Expression *parse_ast_global_declaration(Lexer *lexer) {
-    AST_Declaration *ast_decl = parse_ast_declaration(lexer);
+    AST_Declaration *ast_decl;
+    if (token_text(*lexer->peek()) == "const")
+        ast_decl = parse_ast_const_declaration(lexer);
+    else if (token_text(*lexer->peek()) == "atomic")
+        ast_decl = parse_ast_atomic_declaration(lexer);
+    else
+        ast_decl = parse_ast_declaration(lexer);
 
     if (lexer->peek()->type == TOKEN_ASSIGN) {
         auto *ast_binary = new AST_Binary_Expression;
@@ -1343,7 +2147,7 @@ void parse_typedef(Lexer *lexer) {
 
     std::string definition_string;
     while (i >= 3) {
-	definition_string += lexer->get_next_token()->val;
+	definition_string += token_text(*lexer->get_next_token());
 	if (i > 3) definition_string += " ";
 	i--;
     }
@@ -1447,6 +2251,85 @@ void parse_enum_definition(Lexer *lexer) {
 }
 
 
+// parses one item at the outermost level of a file, starting at
+// the current token, and leaves the current token at its last one.
+// (returns NULL for the items that do not add anything to the ast)
+AST_Expression *parse_top_level_item(Lexer *lexer) {
+    // at the outermost, we only have function definitions
+    // or global declarations
+    // (well actually, we could also have some type related
+    // stuff, like: enums, structs, and typedefs)
+
+    // both declarations and function definitions start with
+    // <data_type> <identifier>. so the difference is at the
+    // third token.
+
+    // TODO : this does not handle pointers/arrays
+
+
+    // first we will check for keywords like enum, struct or typedef
+    Token *tok = lexer->peek();
+
+    if (tok->type == TOKEN_KEYWORD) {
+	if (token_text(*tok) == "typedef") {
+	    // this does not actually add anything
+	    // to the ast. it simply inserts a new
+	    // item into the type_info_map.
+	    parse_typedef(lexer);
+	    return NULL;
+	} else if (token_text(*tok) == "enum") {
+	    parse_enum_definition(lexer);
+	    return NULL;
+	} else if (token_text(*tok) == "const" || token_text(*tok) == "atomic") {
+	    return parse_ast_global_declaration(lexer);
+	} else if (token_text(*tok) == "async") {
+	    // async <return_type> <name>(...) <block>
+	    //
+	    // the function becomes a coroutine. calling it runs
+	    // the body until its first await, and then returns
+	    // (the rest of it runs whenever it gets resumed), so
+	    // there is no way for it to hand back a value.
+	    tok = lexer->get_next_token();
+	    if (tok == NULL || tok->val != "void" ||
+		lexer->peek(2) == NULL || lexer->peek(2)->type != TOKEN_LEFT_PAREN) {
+		throw_parser_error(E126, lexer);
+	    }
+
+	    lexer->parsing_async_function = true;
+	    AST_Function_Definition *ast_function = parse_ast_function(lexer);
+	    lexer->parsing_async_function = false;
+
+	    if (ast_function->has_variadic_args || !ast_function->pack_name.empty()) {
+		throw_parser_error(E126, lexer);
+	    }
+	    ast_function->is_async = !ast_function->is_prototype;
+
+	    // the coroutine frames are allocated by the async runtime
+	    if (ast_function->is_async &&
+		std::find(lexer->libs_to_link.begin(), lexer->libs_to_link.end(),
+			  "async.bc") == lexer->libs_to_link.end())
+		lexer->libs_to_link.push_back("async.bc");
+	    return ast_function;
+	}
+
+	throw_parser_error(E104, lexer);
+    }
+
+    tok = lexer->peek(2);
+    if (tok == NULL) {
+        throw_parser_error(
+            E061,
+            lexer);
+    }
+
+    // (a '<' after the name means that it is a generic function)
+    if (tok->type == TOKEN_LEFT_PAREN || tok->type == TOKEN_LESS)
+        return parse_ast_function(lexer);
+
+    return parse_ast_global_declaration(lexer);
+}
+
+
 std::vector<AST_Expression *> *parse_tokens(Lexer *lexer) {
     ZoneScopedS(10); // for tracy profiler
 
@@ -1458,52 +2341,16 @@ std::vector<AST_Expression *> *parse_tokens(Lexer *lexer) {
     bool entry_point_exists = false;
 
     do {
-        // at the outermost, we only have function definitions
-        // or global declarations
-	// (well actually, we could also have some type related
-	// stuff, like: enums, structs, and typedefs)
-
-        // both declarations and function definitions start with
-        // <data_type> <identifier>. so the difference is at the
-        // third token.
-
-        // TODO : this does not handle pointers/arrays
-
-
-	// first we will check for keywords like enum, struct or typedef
-	Token *tok = lexer->peek();
-
-	if (tok->type == TOKEN_KEYWORD) {
-	    if (tok->val == "typedef") {
-		// this does not actually add anything
-		// to the ast. it simply inserts a new
-		// item into the type_info_map.
-		parse_typedef(lexer);
-		continue;
-	    } else if (tok->val == "enum") {
-		parse_enum_definition(lexer);
-		continue;
-	    }
-
-	    throw_parser_error(E104, lexer);
-	}
-
-        tok = lexer->peek(2);
-        if (tok == NULL) {
-            throw_parser_error(
-                E061,
-                lexer);
-        }
+        AST_Expression *item = parse_top_level_item(lexer);
+        if (item == NULL)
+            continue;
 
-        if (tok->type == TOKEN_LEFT_PAREN) {
-            AST_Function_Definition *ast_function = parse_ast_function(lexer);
-            ast->push_back(ast_function);
+        ast->push_back(item);
 
+        if (item->expr_type == EXPR_FUNC_DEF) {
+            auto *ast_function = (AST_Function_Definition *)item;
             if (ast_function->function_name == "main")
                 entry_point_exists = true;
-        } else {
-            auto *global_decl = parse_ast_global_declaration(lexer);
-            ast->push_back(global_decl);
         }
     } while (lexer->get_next_token() != NULL);
 
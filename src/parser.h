@@ -128,7 +128,9 @@ inline void print_ast_expression(AST_Expression *ast_expr,
     case EXPR_FUNC_DEF: {
         auto *expr = (AST_Function_Definition *)ast_expr;
         print_indentation(indentation_level);
-        printf("<FUNC, %s> (", expr->function_name.c_str());
+        printf("<FUNC%s%s, %s> (", expr->is_async ? " (ASYNC)" : "",
+               expr->type_params.empty() ? "" : " (GENERIC)",
+               expr->function_name.c_str());
 
         for (Function_Parameter *param : expr->params) {
             printf("[%s : Type %d]", param->name.c_str(), param->type);
@@ -220,6 +222,75 @@ inline void print_ast_expression(AST_Expression *ast_expr,
         printf("}\n");
         break;
     }
+    case EXPR_ASM: {
+        auto *expr = (AST_Asm_Expression *)ast_expr;
+        print_indentation(indentation_level);
+        printf("<ASM%s> \"%s\" (\n", expr->is_volatile ? " (VOLATILE)" : "",
+               expr->asm_template.c_str());
+        for (Asm_Operand &operand : expr->outputs) {
+            print_indentation(indentation_level + 1);
+            printf("<OUTPUT \"%s\">\n", operand.constraint.c_str());
+            print_ast_expression(operand.expr, indentation_level + 2);
+        }
+        for (Asm_Operand &operand : expr->inputs) {
+            print_indentation(indentation_level + 1);
+            printf("<INPUT \"%s\">\n", operand.constraint.c_str());
+            print_ast_expression(operand.expr, indentation_level + 2);
+        }
+        for (std::string &clobber : expr->clobbers) {
+            print_indentation(indentation_level + 1);
+            printf("<CLOBBER \"%s\">\n", clobber.c_str());
+        }
+        print_indentation(indentation_level);
+        printf(")\n");
+        break;
+    }
+    case EXPR_RANGE_FOR: {
+        auto *expr = (AST_Range_For_Expression *)ast_expr;
+        print_indentation(indentation_level);
+        printf("<RANGE FOR> %s (\n", expr->induction_variable.c_str());
+        print_ast_expression(expr->begin, indentation_level + 1);
+        print_ast_expression(expr->end, indentation_level + 1);
+        if (expr->step != NULL)
+            print_ast_expression(expr->step, indentation_level + 1);
+        print_indentation(indentation_level);
+        printf(") {\n");
+
+        for (AST_Expression *e : expr->block) {
+            print_ast_expression(e, indentation_level + 1);
+        }
+        print_indentation(indentation_level);
+        printf("}\n");
+        break;
+    }
+    case EXPR_PACK_FOR: {
+        auto *expr = (AST_Pack_For_Expression *)ast_expr;
+        print_indentation(indentation_level);
+        printf("<PACK FOR> %s {\n", expr->element.c_str());
+
+        for (AST_Expression *e : expr->block) {
+            print_ast_expression(e, indentation_level + 1);
+        }
+        print_indentation(indentation_level);
+        printf("}\n");
+        break;
+    }
+    case EXPR_PARALLEL_FOR: {
+        auto *expr = (AST_Parallel_For_Expression *)ast_expr;
+        print_indentation(indentation_level);
+        printf("<PARALLEL FOR> %s (\n", expr->induction_variable.c_str());
+        print_ast_expression(expr->begin, indentation_level + 1);
+        print_ast_expression(expr->end, indentation_level + 1);
+        print_indentation(indentation_level);
+        printf(")%s {\n", expr->is_inclusive ? " (INCLUSIVE)" : "");
+
+        for (AST_Expression *e : expr->block) {
+            print_ast_expression(e, indentation_level + 1);
+        }
+        print_indentation(indentation_level);
+        printf("}\n");
+        break;
+    }
     case EXPR_WHILE: {
         auto *expr = (AST_While_Expression *)ast_expr;
         print_indentation(indentation_level);
@@ -238,8 +309,8 @@ inline void print_ast_expression(AST_Expression *ast_expr,
     case EXPR_DECL: {
         auto *expr = (AST_Declaration *)ast_expr;
         print_indentation(indentation_level);
-        printf("<DECL, [%s : Type %d]>\n", expr->variable_name.c_str(),
-               expr->data_type);
+        printf("<DECL%s, [%s : Type %d]>\n", expr->is_const ? " (CONST)" : expr->is_atomic ? " (ATOMIC)" : "",
+               expr->variable_name.c_str(), expr->data_type);
         break;
     }
     case EXPR_UNARY: {
@@ -286,7 +357,8 @@ inline void print_ast_expression(AST_Expression *ast_expr,
     case EXPR_FUNC_CALL: {
         auto *expr = (AST_Function_Call *)ast_expr;
         print_indentation(indentation_level);
-        printf("<CALL, %s> (\n", expr->function_name.c_str());
+        printf("<CALL, %s%s> (\n", expr->function_name.c_str(),
+               expr->ordering != AO_NONE ? " (ATOMIC)" : "");
 
         for (AST_Expression *e : expr->params) {
             print_ast_expression(e, indentation_level + 1);
@@ -325,6 +397,13 @@ inline void print_ast_expression(AST_Expression *ast_expr,
         printf("}\n");
         break;
     }
+    case EXPR_AWAIT: {
+        auto *expr = (AST_Await_Expression *)ast_expr;
+        print_indentation(indentation_level);
+        printf("<AWAIT>\n");
+        print_ast_expression(expr->call, indentation_level + 1);
+        break;
+    }
     case EXPR_VARG: {
 	print_indentation(indentation_level);
         printf("<VARG>\n");
@@ -382,6 +461,11 @@ inline void throw_parser_error(const char *message, Lexer *lexer) {
     // if not, throw a fatal error
 
     Token *tok = lexer->peek(0);
+    if (error_recovery_hook) {
+        if (tok == NULL) error_recovery_hook(E015, lexer->file_name, 0, 0);
+        error_recovery_hook(message, tok->file_name, tok->line_num, tok->position);
+    }
+
     if (tok == NULL) {
         fprintf(stderr, E015);
         exit(1);
@@ -433,6 +517,8 @@ inline void throw_error__used_delimiter_in_a_non_statement(Lexer *lexer) {
 AST_Expression *parse_ast_subexpression(Lexer *lexer,
                                         Precedence curr_precedence,
                                         Token_Type stops_at = TOKEN_DELIMITER,
-                                        AST_Expression *left = NULL);
+                                        AST_Expression *left = NULL,
+                                        const char *stops_at_word = NULL);
 AST_Expression *parse_ast_expression(Lexer *lexer);
+AST_Expression *parse_top_level_item(Lexer *lexer);
 std::vector<AST_Expression *> *parse_tokens(Lexer *lexer);
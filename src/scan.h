@@ -0,0 +1,194 @@
+//
+// scan.h
+//
+
+/*
+
+Scanning runs of characters for the lexer, 16 or 32 bytes
+at a time, instead of one character at a time.
+
+Each kind of run (Scan_Class) is a set of characters that it
+stops at: an identifier stops at anything that can't be in
+an identifier, a comment body at a '*' (which might start
+the closing '*' + '/'), and so on. For a block of the line,
+we make a mask of the bytes where the run stops (1 bit per
+byte with SSE2/AVX2, 4 bits per byte with NEON), and the
+first set bit is where the run ends.
+
+The vectors are only loaded while a whole block is left in
+the line (the lexer knows its length), and the rest of it is
+scanned one character at a time, so nothing is read past the
+end of the line.
+
+Without any of those instruction sets, it is all scanned one
+character at a time.
+
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCAN_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCAN_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define SCAN_NEON
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+
+enum Scan_Class {
+    SCAN_IDENTIFIER, // a-z, A-Z, 0-9 and _
+    SCAN_WHITESPACE, // spaces and tabs
+    SCAN_COMMENT,    // the body of a multiline comment (stops at '*')
+    SCAN_STRING,     // the body of a string literal (stops at '"', '\', a tab)
+};
+
+// whether a run of the class stops at c
+inline bool scan_stops_at(char c, Scan_Class scan_class) {
+    switch (scan_class) {
+    case SCAN_IDENTIFIER:
+        return !((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                 (c >= '0' && c <= '9') || c == '_');
+    case SCAN_WHITESPACE:
+        return c != ' ' && c != '\t';
+    case SCAN_COMMENT:
+        return c == '*' || c == '\0';
+    case SCAN_STRING:
+        return c == '\"' || c == '\\' || c == '\t' || c == '\0';
+    }
+    return true;
+}
+
+inline int scan_first_bit(uint64_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+
+//                  Vector operations
+// ***************************************************
+
+#if defined(SCAN_AVX2)
+
+#define SCAN_WIDTH 32
+#define SCAN_MASK_BITS 1
+#define SCAN_FULL_MASK 0xFFFFFFFFull
+typedef __m256i Scan_Vector;
+
+inline Scan_Vector scan_load(const char *p) { return _mm256_loadu_si256((const __m256i *)p); }
+inline Scan_Vector scan_eq(Scan_Vector v, char c) { return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)); }
+inline Scan_Vector scan_or(Scan_Vector a, Scan_Vector b) { return _mm256_or_si256(a, b); }
+inline Scan_Vector scan_or_bits(Scan_Vector v, char bits) { return _mm256_or_si256(v, _mm256_set1_epi8(bits)); }
+inline uint64_t scan_mask(Scan_Vector v) { return (uint32_t)_mm256_movemask_epi8(v); }
+
+// the bytes in [lo, hi] (moved down so that lo is at -128,
+// since there is only a signed comparison)
+inline Scan_Vector scan_in_range(Scan_Vector v, char lo, char hi) {
+    Scan_Vector shifted = _mm256_add_epi8(v, _mm256_set1_epi8((char)(-128 - lo)));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(-128 + (hi - lo) + 1)), shifted);
+}
+
+#elif defined(SCAN_SSE2)
+
+#define SCAN_WIDTH 16
+#define SCAN_MASK_BITS 1
+#define SCAN_FULL_MASK 0xFFFFull
+typedef __m128i Scan_Vector;
+
+inline Scan_Vector scan_load(const char *p) { return _mm_loadu_si128((const __m128i *)p); }
+inline Scan_Vector scan_eq(Scan_Vector v, char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); }
+inline Scan_Vector scan_or(Scan_Vector a, Scan_Vector b) { return _mm_or_si128(a, b); }
+inline Scan_Vector scan_or_bits(Scan_Vector v, char bits) { return _mm_or_si128(v, _mm_set1_epi8(bits)); }
+inline uint64_t scan_mask(Scan_Vector v) { return (uint32_t)_mm_movemask_epi8(v); }
+
+// (the same way as with AVX2)
+inline Scan_Vector scan_in_range(Scan_Vector v, char lo, char hi) {
+    Scan_Vector shifted = _mm_add_epi8(v, _mm_set1_epi8((char)(-128 - lo)));
+    return _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(-128 + (hi - lo) + 1)));
+}
+
+#elif defined(SCAN_NEON)
+
+#define SCAN_WIDTH 16
+#define SCAN_MASK_BITS 4
+#define SCAN_FULL_MASK 0xFFFFFFFFFFFFFFFFull
+typedef uint8x16_t Scan_Vector;
+
+inline Scan_Vector scan_load(const char *p) { return vld1q_u8((const uint8_t *)p); }
+inline Scan_Vector scan_eq(Scan_Vector v, char c) { return vceqq_u8(v, vdupq_n_u8((uint8_t)c)); }
+inline Scan_Vector scan_or(Scan_Vector a, Scan_Vector b) { return vorrq_u8(a, b); }
+inline Scan_Vector scan_or_bits(Scan_Vector v, char bits) { return vorrq_u8(v, vdupq_n_u8((uint8_t)bits)); }
+
+// (there is no movemask, so each byte is narrowed down to 4 bits)
+inline uint64_t scan_mask(Scan_Vector v) {
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(v), 4)), 0);
+}
+
+inline Scan_Vector scan_in_range(Scan_Vector v, char lo, char hi) {
+    return vcleq_u8(vsubq_u8(v, vdupq_n_u8((uint8_t)lo)), vdupq_n_u8((uint8_t)(hi - lo)));
+}
+
+#else
+
+#define SCAN_WIDTH 0
+
+#endif
+
+#if SCAN_WIDTH
+// a mask of the bytes of the block at p where a run of the class stops
+inline uint64_t scan_stop_mask(const char *p, Scan_Class scan_class) {
+    Scan_Vector v = scan_load(p);
+
+    switch (scan_class) {
+    case SCAN_IDENTIFIER: {
+        // (lowercasing the letters first, since 'A' | 0x20 == 'a')
+        Scan_Vector in_class = scan_or(scan_or(scan_in_range(scan_or_bits(v, 0x20), 'a', 'z'),
+                                               scan_in_range(v, '0', '9')),
+                                       scan_eq(v, '_'));
+        return ~scan_mask(in_class) & SCAN_FULL_MASK;
+    }
+    case SCAN_WHITESPACE:
+        return ~scan_mask(scan_or(scan_eq(v, ' '), scan_eq(v, '\t'))) & SCAN_FULL_MASK;
+    case SCAN_COMMENT:
+        return scan_mask(scan_or(scan_eq(v, '*'), scan_eq(v, '\0')));
+    case SCAN_STRING:
+        return scan_mask(scan_or(scan_or(scan_eq(v, '\"'), scan_eq(v, '\\')),
+                                 scan_or(scan_eq(v, '\t'), scan_eq(v, '\0'))));
+    }
+    return 1;
+}
+#endif
+
+
+// the length of the run of the class that starts at p
+// (it doesn't go past end, which is where the line ends)
+inline size_t scan_run(const char *p, const char *end, Scan_Class scan_class) {
+    const char *start = p;
+
+#if SCAN_WIDTH
+    for (; end - p >= SCAN_WIDTH; p += SCAN_WIDTH) {
+        uint64_t mask = scan_stop_mask(p, scan_class);
+        if (mask)
+            return (size_t)(p - start) + scan_first_bit(mask) / SCAN_MASK_BITS;
+    }
+#endif
+
+    while (p < end && !scan_stops_at(*p, scan_class))
+        p++;
+    return (size_t)(p - start);
+}
@@ -45,6 +45,7 @@ struct Symbol {
     Data_Type *return_type = nullptr; // data_type in case of variables
     std::vector<Data_Type *> *signature = NULL; // param types (only for functions)
     bool has_variadic_args = false; // (only for functions)
+    size_t num_type_params = 0; // (only for generic functions)
 };
 
 struct Scope {
@@ -86,6 +86,9 @@ struct Partial_Token {
     std::string file_name;
 };
 
+// only the identifiers, data types and literals keep their text in val.
+// the text of an operator (or a bracket, or punctuation) is known from
+// its type, and that of a keyword from its index. (see token_text)
 struct Token {
     std::string val;
     Token_Type type = TOKEN_NONE;
@@ -93,6 +96,8 @@ struct Token {
     int line_num;
     int position;
     std::string file_name;
+
+    int keyword = -1; // (the index in KEYWORDS, for a keyword)
 };
 
 inline bool is_literal(Token *tok) {
@@ -104,3 +109,24 @@ inline bool is_unary_op(Token *tok) {
 }
 
 inline bool is_binary_op(Token *tok) { return (tok->type >= 300); }
+
+inline bool is_assignment_op(Token_Type type) {
+    switch (type) {
+    case TOKEN_ASSIGN:
+    case TOKEN_PLUSEQ:
+    case TOKEN_MINUSEQ:
+    case TOKEN_MULTIPLYEQ:
+    case TOKEN_DIVIDEEQ:
+    case TOKEN_MODEQ:
+    case TOKEN_LSHIFT_EQ:
+    case TOKEN_RSHIFT_EQ:
+    case TOKEN_ANDEQ:
+    case TOKEN_OREQ:
+    case TOKEN_BIT_ANDEQ:
+    case TOKEN_BIT_OREQ:
+    case TOKEN_XOREQ:
+        return true;
+    default:
+        return false;
+    }
+}
@@ -14,7 +14,8 @@ enum Type_Kind {
    TK_ARRAY,
    TK_ENUM,
    TK_STRUCT,
-   TK_ALIAS
+   TK_ALIAS,
+   TK_TYPE_PARAM // a type parameter of a generic function
 };
 
 // to store at the parsing stage (in the ast)
@@ -49,8 +50,26 @@ struct Data_Type {
 };
 
 
+// a type parameter (like the T in: T max<T>(T a, T b)) has no
+// actual type of its own. it is bound to a type argument (through
+// the base_type) only while an instance of its function is being
+// emitted, and is unbound (NULL) the rest of the time.
+inline Data_Type *create_type_parameter(std::string &name) {
+    auto *type_param = new Data_Type;
+    type_param->type_kind = TK_TYPE_PARAM;
+    type_param->name.np = &name;
+    return type_param;
+}
+
+// gets to the type that a (bound) type parameter stands for
+inline Data_Type *resolve_type_parameter(Data_Type *data_type) {
+    while (data_type->type_kind == TK_TYPE_PARAM && data_type->base_type)
+        data_type = data_type->base_type;
+    return data_type;
+}
+
 inline bool is_int_type(Data_Type *data_type) {
-    Data_Type* dt = data_type;
+    Data_Type* dt = resolve_type_parameter(data_type);
     while (dt->type_kind == TK_ALIAS) dt = dt->base_type;
 
     if (dt->type_kind != TK_PRIMITIVE) {
@@ -60,6 +79,44 @@ inline bool is_int_type(Data_Type *data_type) {
     return (dt->name.p >= T_U8 && dt->name.p <= T_S64);
 }
 
+// the primitive type that a type stands for (through aliases, enums
+// and bound type parameters), or NULL if it is not a primitive type
+inline Data_Type *get_primitive_type(Data_Type *data_type) {
+    while (data_type && data_type->type_kind != TK_PRIMITIVE) {
+        if (data_type->type_kind != TK_ALIAS && data_type->type_kind != TK_ENUM &&
+            data_type->type_kind != TK_TYPE_PARAM)
+            return nullptr;
+        data_type = data_type->base_type;
+    }
+    return data_type;
+}
+
+inline bool is_unsigned_int_type(Data_Type *data_type) {
+    Data_Type *dt = get_primitive_type(data_type);
+    return dt && dt->name.p >= T_U8 && dt->name.p <= T_U64;
+}
+
+
+// the names of the primitive types (in the order of Primitive_Type)
+const std::string PRIMITIVE_TYPE_NAMES[] = {
+    "void", "bool",
+    "u8", "u16", "u32", "u64",
+    "s8", "s16", "s32", "s64",
+    "f32", "f64", "string"
+};
+
+// the name of a type, as it would be written in the source.
+// (used for naming the instances of generic functions. aliases and
+// enums generate the same code as their underlying types, so they
+// are named after those)
+inline std::string get_type_name(Data_Type *data_type) {
+    data_type = resolve_type_parameter(data_type);
+    while (data_type->type_kind == TK_ALIAS || data_type->type_kind == TK_ENUM)
+        data_type = resolve_type_parameter(data_type->base_type);
+    if (data_type->type_kind == TK_PRIMITIVE)
+        return PRIMITIVE_TYPE_NAMES[data_type->name.p];
+    return *(data_type->name.np);
+}
 
 const std::string DATA_TYPES[] = {
     "void", "bool", "int",
@@ -0,0 +1,11 @@
+// the other part of the program in main.em
+
+int twice(int x);
+
+int add_twice(int x) {
+    return twice(x) + x;
+}
+
+int unused_in_library(int x) {
+    return twice(x);
+}
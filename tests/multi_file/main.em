@@ -0,0 +1,20 @@
+// the part of a program that is split over two files (main.em and
+// library.em), which call each other's functions
+
+int add_twice(int x);
+
+// (only called from library.em)
+int twice(int x) {
+    return x + x;
+}
+
+int unused_in_main(int x) {
+    return x;
+}
+
+int main() {
+    if (add_twice(3) != 9) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,4 @@
+int main() {
+    asm("" : "=r"(1));
+    return 0;
+}
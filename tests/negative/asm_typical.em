@@ -0,0 +1,6 @@
+int main() {
+    int x = 0;
+    int y = 0;
+    asm("mov %2, %0" : "=r"(x) : "r"(y));
+    return x;
+}
@@ -0,0 +1,10 @@
+#include <async.emh>
+
+void worker() {
+    await yield_now();
+}
+
+int main() {
+    worker();
+    return 0;
+}
@@ -0,0 +1,10 @@
+#include <async.emh>
+
+async int worker(s32 fd) {
+    await wait_readable(fd);
+    return 1;
+}
+
+int main() {
+    return worker(0);
+}
@@ -0,0 +1,4 @@
+int main() {
+    atomic f64 ratio = 0.5;
+    return 0;
+}
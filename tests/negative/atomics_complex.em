@@ -0,0 +1,11 @@
+atomic s64 counter = 0;
+
+// fence is an atomic builtin, so it cannot be defined
+void fence(int ordering) {
+    counter += ordering;
+}
+
+int main() {
+    fence(seq_cst);
+    return 0;
+}
@@ -0,0 +1,6 @@
+atomic s32 ready = 0;
+
+int main() {
+    s32 value = atomic_load(ready, release);
+    return 0;
+}
@@ -0,0 +1,4 @@
+int main() {
+    const int x;
+    return 0;
+}
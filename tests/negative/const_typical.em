@@ -0,0 +1,6 @@
+const int LIMIT = 10;
+
+int main() {
+    LIMIT = 20;
+    return 0;
+}
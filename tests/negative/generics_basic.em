@@ -0,0 +1,7 @@
+T zero<T>() {
+    return 0;
+}
+
+int main() {
+    return zero();
+}
@@ -0,0 +1,11 @@
+T max<T>(T a, T b) {
+    if (a > b) {
+        return a;
+    }
+    return b;
+}
+
+int main() {
+    int a = max<s32, s64>(1, 2);
+    return a;
+}
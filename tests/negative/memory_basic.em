@@ -0,0 +1,8 @@
+#include <memory.emh>
+
+int main() {
+    u64 p = mem_alloc(64);
+    s64 value = mem_load_s64(p, 0);
+    u64 q = mem_alloc(value);
+    return 0;
+}
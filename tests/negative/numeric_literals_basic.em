@@ -0,0 +1,4 @@
+int main() {
+    int x = 0x;
+    return 0;
+}
@@ -0,0 +1,5 @@
+// doesn't fit in 64 bits
+int main() {
+    u64 x = 18_446_744_073_709_551_616;
+    return 0;
+}
@@ -0,0 +1,6 @@
+// a function with a parameter pack has to have a body
+int sum(...values);
+
+int main() {
+    return sum(1, 2);
+}
@@ -0,0 +1,14 @@
+// the loop over a pack cannot be outlined into a parallel for body
+int sum(...values) {
+    int total = 0;
+    parallel for (int i = 0; i < 4; i++) {
+        for v in values {
+            int copy = v;
+        }
+    }
+    return total;
+}
+
+int main() {
+    return sum(1, 2);
+}
@@ -0,0 +1,6 @@
+int main() {
+    parallel for (int i = 0; i < 10; i++) {
+        break;
+    }
+    return 0;
+}
@@ -0,0 +1,7 @@
+int main() {
+    int n = 100;
+    parallel for (int i = 0; i < n; i += 2) {
+        int x = i;
+    }
+    return 0;
+}
@@ -0,0 +1,8 @@
+int main() {
+    int sum = 0;
+    for i in 0..10 {
+        i += 1;
+        sum += i;
+    }
+    return sum;
+}
@@ -0,0 +1,6 @@
+int main() {
+    // a compiler barrier
+    asm volatile("" : : : "memory");
+    asm("");
+    return 0;
+}
@@ -0,0 +1,31 @@
+// (the template is empty, so that this works on every target.
+// only the widening of the tied input is being tested here)
+
+u64 widen(u32 x) {
+    u64 y = 18446744073709551615;
+    asm("" : "=r"(y) : "0"(x));
+    return y;
+}
+
+s64 widen_signed(s32 x) {
+    s64 y = 9223372036854775807;
+    asm("" : "=r"(y) : "0"(x));
+    return y;
+}
+
+int main() {
+    // (a u32 above the largest s32 is filled with zeros)
+    u32 two_billion = 2000000000;
+    u64 expected = 3000000000;
+    if (widen(two_billion + two_billion / 2) != expected) {
+        return 1;
+    }
+
+    s32 minus_one = 0 - 1;
+    s64 big = 9223372036854775807;
+    s64 wide_minus_one = (big - big) - (big / big);
+    if (widen_signed(minus_one) != wide_minus_one) {
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,30 @@
+// (the templates are empty, so that this works on every target.
+// only the operands are being tested here)
+
+int pass_through(int x) {
+    int y = 0;
+    asm("" : "=r"(y) : "0"(x));
+    return y;
+}
+
+int keep(int x) {
+    asm volatile("" : "+r"(x));
+    return x;
+}
+
+int swap_sum(int a, int b) {
+    int c = 0;
+    int d = 0;
+    asm("" : "=r"(c), "=r"(d) : "0"(b), "1"(a) : "memory", "cc");
+    return (c * 10) + d;
+}
+
+int main() {
+    int x = 5;
+    asm volatile("" : : "r"(x), "m"(x));
+
+    if (pass_through(7) != 7) return 1;
+    if (keep(9) != 9) return 2;
+    if (swap_sum(1, 2) != 21) return 3;
+    return 0;
+}
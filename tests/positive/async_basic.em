@@ -0,0 +1,13 @@
+#include <async.emh>
+
+async void worker(s32 id) {
+    await yield_now();
+    await yield_now();
+}
+
+int main() {
+    worker(1);
+    worker(2);
+    run_event_loop();
+    return 0;
+}
@@ -0,0 +1,38 @@
+#include <async.emh>
+
+async void server(s32 fd) {
+    while (true) {
+        if (echo_pending(fd) > 0) {
+            await wait_writable(fd);
+        } else {
+            await wait_readable(fd);
+        }
+        int n = echo(fd);
+        if (n == 0) {
+            close_fd(fd);
+            return;
+        }
+    }
+}
+
+async void client(s32 fd, int messages) {
+    int received = 0;
+    while (received < messages) {
+        send_bytes(fd, 64);
+        await wait_readable(fd);
+        if (recv_bytes(fd, 64) > 0) {
+            received++;
+        }
+    }
+    close_fd(fd);
+}
+
+int main() {
+    for (int i = 0; i < 4; i++) {
+        s32 fd = socket_pair();
+        server(socket_peer(fd));
+        client(fd, 100);
+    }
+    run_event_loop();
+    return 0;
+}
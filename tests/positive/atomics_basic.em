@@ -0,0 +1,9 @@
+atomic s64 counter = 0;
+
+int main() {
+    atomic_fetch_add(counter, 1, relaxed);
+    s64 value = atomic_load(counter, acquire);
+    atomic_store(counter, 0, release);
+    fence(seq_cst);
+    return 0;
+}
@@ -0,0 +1,14 @@
+atomic u64 total;
+int main() {
+    u32 two_billion = 2000000000;
+    u32 x = two_billion + two_billion / 2;
+
+    // (x is above the largest s32, so it must be zero-extended)
+    total += x;
+    atomic_fetch_add(total, x, relaxed);
+    u64 expected = 6000000000;
+    if (total != expected) {
+        return 1;
+    }
+    return 0;
+}
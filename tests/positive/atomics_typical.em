@@ -0,0 +1,26 @@
+atomic s32 hits = 0;
+atomic s32 lock = 0;
+
+void acquire_lock() {
+    while (!atomic_cas(lock, 0, 1, acquire)) {
+    }
+}
+
+void release_lock() {
+    atomic_store(lock, 0, release);
+}
+
+int main() {
+    atomic u32 flags;
+
+    parallel for (s32 i = 0; i < 1000; i++) {
+        hits += 1;
+        flags |= 4;
+        acquire_lock();
+        release_lock();
+    }
+
+    hits++;
+    s32 total = hits;
+    return 0;
+}
@@ -0,0 +1,7 @@
+const int LIMIT = 10;
+
+int main() {
+    const int x = 5;
+    int y = x + LIMIT;
+    return 0;
+}
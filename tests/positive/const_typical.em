@@ -0,0 +1,17 @@
+const s32 TABLE_SIZE = 16;
+const s64 MASK = 255;
+const bool DEBUG = false;
+
+s32 wrap(s32 index) {
+    const s32 step = 3;
+    return (index + step) % TABLE_SIZE;
+}
+
+int main() {
+    s64 value = MASK;
+    s32 i = wrap(14);
+    if (DEBUG) {
+        i = 0;
+    }
+    return 0;
+}
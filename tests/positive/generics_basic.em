@@ -0,0 +1,13 @@
+T max<T>(T a, T b) {
+    if (a > b) {
+        return a;
+    }
+    return b;
+}
+
+int main() {
+    int a = max(3, 7);
+    s64 b = max<s64>(a, 2);
+    f64 c = max(1.5, 2.5);
+    return 0;
+}
@@ -0,0 +1,39 @@
+// the type arguments are deduced from the Em types of the arguments,
+// so the unsigned and signed instances are kept apart
+
+T max<T>(T a, T b) {
+    if (a > b) {
+        return a;
+    }
+    return b;
+}
+
+T half<T>(T value, T two) {
+    return value / two;
+}
+
+int main() {
+    u64 big = 18446744073709551615;
+    u64 small = big / big;
+    if (max(big, small) != big) {
+        return 1;
+    }
+
+    s64 top = 9223372036854775807;
+    s64 one = top / top;
+    s64 minus_one = one - one - one;
+    if (max(minus_one, one) != one) {
+        return 2;
+    }
+
+    // (a literal takes the type of the other argument)
+    if (max(small, 0) != small) {
+        return 3;
+    }
+
+    // (unsigned division, which signed division would make 0)
+    if (half(big, small + small) != top) {
+        return 4;
+    }
+    return 0;
+}
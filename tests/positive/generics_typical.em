@@ -0,0 +1,35 @@
+T max<T>(T a, T b) {
+    if (a > b) {
+        return a;
+    }
+    return b;
+}
+
+T max3<T>(T a, T b, T c) {
+    return max<T>(max(a, b), c);
+}
+
+T power<T>(T base, int n) {
+    if (n == 0) {
+        return 1;
+    }
+    return base * power(base, n - 1);
+}
+
+T first<T, U>(T a, U b) {
+    T result = a;
+    return result;
+}
+
+int main() {
+    if (max3(4, 3, 7) != 7) {
+        return 1;
+    }
+    if (power(2, 10) != 1024) {
+        return 2;
+    }
+    s64 big = max3<s64>(1, 2, 3);
+    f64 p = power(1.5, 2);
+    int f = first(5, 2.5);
+    return 0;
+}
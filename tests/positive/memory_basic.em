@@ -0,0 +1,30 @@
+#include <memory.emh>
+
+// (a literal is widened to s64 when it is passed for an s64)
+s64 wide(s64 value) {
+    return value;
+}
+
+int main() {
+    u64 p = mem_alloc(64);
+    mem_store_s64(p, 0, 5);
+    mem_store_s64(p, 7, 7);
+    s64 value = mem_load_s64(p, 7);
+    s64 first = mem_load_s64(p, 0);
+    mem_free(p);
+    if (value != wide(7)) {
+        return 1;
+    }
+    if (first != wide(5)) {
+        return 2;
+    }
+
+    u64 arena = arena_create(1024);
+    for i in 0..100 {
+        u64 node = arena_alloc(arena, 32);
+        mem_store_u8(node, 0, 1);
+    }
+    arena_reset(arena);
+    arena_destroy(arena);
+    return 0;
+}
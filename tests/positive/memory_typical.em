@@ -0,0 +1,35 @@
+#include <memory.emh>
+
+// bulk operations: the small constant sizes are emitted
+// inline, the rest go to the runtime
+int main() {
+    int size = 1000;
+    u64 a = mem_alloc(size);
+    u64 b = mem_alloc_zeroed(size);
+
+    mem_set(a, 7, size);
+    mem_set(a, 0, 16);
+    mem_copy(b, a, size);
+    mem_copy(b, a, 64);
+
+    if (mem_compare(a, b, size) != 0) {
+        return 1;
+    }
+    mem_store_u8(b, 500, 9);
+    if (mem_compare(a, b, size) >= 0) {
+        return 2;
+    }
+    if (mem_find(b, 9, size) != 500) {
+        return 3;
+    }
+    if (mem_find(a, 9, size) >= 0) {
+        return 4;
+    }
+    if (str_length("vectorized") != 10) {
+        return 5;
+    }
+
+    mem_free(a);
+    mem_free(b);
+    return 0;
+}
@@ -0,0 +1,6 @@
+int main() {
+    int a = 0xFF;
+    int b = 0b1010;
+    int c = 1_000_000;
+    return 0;
+}
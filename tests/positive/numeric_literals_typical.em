@@ -0,0 +1,17 @@
+// an integer literal gets the smallest of s32, s64 and u64 that it fits in
+int main() {
+    int mask = 0x7FFF_FFFF;
+    s64 big = 0x8000_0000;
+    s64 max = 9_223_372_036_854_775_807;
+    u64 all_ones = 0xFFFF_FFFF_FFFF_FFFF;
+    f64 ratio = 1_000.000_5;
+
+    int flags = 0b0000_0101;
+    if ((flags & 0b100) == 0) {
+        return 1;
+    }
+    if (0x10 + 0b10 != 18) {
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,18 @@
+// the sum is specialized for every list of argument types
+int sum(...values) {
+    int total = 0;
+    for v in values {
+        total += v;
+    }
+    return total;
+}
+
+int main() {
+    int a = sum(1, 2, 3);
+    int b = sum(a, 4);
+    int c = sum();
+    if ((a + b + c) != 16) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,40 @@
+T larger<T>(T a, T b) {
+    if (a > b) {
+        return a;
+    }
+    return b;
+}
+
+// the element has the type of its own argument, so these are
+// compared as unsigned
+int count_above(u64 limit, ...values) {
+    int count = 0;
+    for v in values {
+        if (v > limit) {
+            count += 1;
+        }
+    }
+    return count;
+}
+
+// (and the type arguments are deduced from it alone)
+u64 largest(...values) {
+    u64 top = 18446744073709551615;
+    u64 result = top - top;
+    for v in values {
+        result = larger(v, v);
+    }
+    return result;
+}
+
+int main() {
+    u64 top = 18446744073709551615;
+    u64 one = top / top;
+    if (count_above(one, top, one, top) != 2) {
+        return 1;
+    }
+    if (largest(one, top) != top) {
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+T larger<T>(T a, T b) {
+    if (a > b) {
+        return a;
+    }
+    return b;
+}
+
+// counts the values above the limit, up until the first zero
+int count_above(int limit, ...values) {
+    int count = 0;
+    for v in values {
+        if (v == 0) {
+            break;
+        }
+        if (v <= limit) {
+            continue;
+        }
+        count += 1;
+    }
+    return count;
+}
+
+// every element has its own type, so each one gets its own
+// instance of larger<T>
+f64 largest_f64(f64 start, ...values) {
+    f64 result = start;
+    for v in values {
+        result = larger(result, v);
+    }
+    return result;
+}
+
+int main() {
+    if (count_above(2, 1, 5, 7, 0, 9) != 2) {
+        return 1;
+    }
+    if (count_above(2) != 0) {
+        return 2;
+    }
+    f64 m = largest_f64(1.5, 2.5, 0.5);
+    if (m < 2.0) {
+        return 3;
+    }
+    return 0;
+}
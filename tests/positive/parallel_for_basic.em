@@ -0,0 +1,6 @@
+int main() {
+    parallel for (int i = 0; i < 1000; i++) {
+        int square = i * i;
+    }
+    return 0;
+}
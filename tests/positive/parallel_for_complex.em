@@ -0,0 +1,47 @@
+atomic s32 count_high = 0;
+atomic s32 count_top = 0;
+atomic s32 count_signed_top = 0;
+atomic s32 count_empty = 0;
+
+int main() {
+    u64 top = 18446744073709551615;
+    u64 one = top / top;
+    u64 three = one + one + one;
+    u64 high = top - three;
+
+    // unsigned bounds above the largest s64
+    parallel for (u64 i = high; i < top; i++) {
+        count_high += 1;
+    }
+
+    // an inclusive end at the largest value of the type
+    parallel for (u64 j = high; j <= top; j++) {
+        count_top += 1;
+    }
+
+    s64 smax = 9223372036854775807;
+    s64 sone = smax / smax;
+    s64 stwo = sone + sone;
+    parallel for (s64 k = smax - stwo; k <= smax; k++) {
+        count_signed_top += 1;
+    }
+
+    // (top is past one, when they are compared as unsigned)
+    parallel for (u64 m = top; m < one; m++) {
+        count_empty += 1;
+    }
+
+    if (count_high != 3) {
+        return 1;
+    }
+    if (count_top != 4) {
+        return 2;
+    }
+    if (count_signed_top != 3) {
+        return 3;
+    }
+    if (count_empty != 0) {
+        return 4;
+    }
+    return 0;
+}
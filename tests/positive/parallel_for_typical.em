@@ -0,0 +1,17 @@
+s32 scale(s32 x, s32 factor) {
+    return x * factor;
+}
+
+int main() {
+    s32 n = 4096;
+    s32 factor = 3;
+    s32 i = 0;
+
+    parallel for (i = 1; i <= n; i += 1) {
+        s32 scaled = scale(i, factor);
+        parallel for (s32 j = 0; j < factor; ++j) {
+            s32 partial = scaled + j;
+        }
+    }
+    return 0;
+}
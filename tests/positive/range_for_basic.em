@@ -0,0 +1,7 @@
+int main() {
+    int sum = 0;
+    for i in 0..10 {
+        sum += i;
+    }
+    return sum - 45;
+}
@@ -0,0 +1,42 @@
+// a step only known at run time (no iterations if it isn't positive),
+// a variable named step, the type of the bounds (u64, compared as
+// unsigned), and a switch over an induction variable without a type
+
+int count(int begin, int end, int s) {
+    int n = 0;
+    for i in begin..end step s {
+        n += 1;
+    }
+    return n;
+}
+
+int main() {
+    if (count(0, 10, 0) != 0) { return 1; }
+    if (count(0, 10, 0 - 1) != 0) { return 2; }
+    if (count(0, 10, 3) != 4) { return 3; }
+
+    int step = 2;
+    int n = 0;
+    for i in 0..step step step {
+        n += 1;
+    }
+    if (n != 1) { return 4; }
+
+    u64 top = 18446744073709551615;
+    u64 one = top / top;
+    u64 last = top;
+    for i in top - one - one - one..top {
+        last = i;
+    }
+    if (last != top - one) { return 5; }
+
+    int hits = 0;
+    for i in 0..4 {
+        switch (i) {
+            case 2: hits += 1;
+            case: hits += 0;
+        }
+    }
+    if (hits != 1) { return 6; }
+    return 0;
+}
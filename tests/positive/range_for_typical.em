@@ -0,0 +1,43 @@
+int sum_of_multiples(int n, int step) {
+    int sum = 0;
+    for i in 0..n step step {
+        sum += i;
+    }
+    return sum;
+}
+
+int count_odd(int end) {
+    int count = 0;
+    for int i in 0..end {
+        if ((i % 2) == 0)
+            continue;
+        count += 1;
+    }
+    return count;
+}
+
+int main() {
+    int total = 0;
+
+    // nested loops, with the bounds of the inner
+    // one depending on the outer one
+    for i in 1..5 {
+        for j in i..(i * 2) {
+            total += j;
+        }
+    }
+
+    // empty ranges do not run at all
+    for k in 10..0 {
+        total += 1000;
+    }
+
+    for u8 c in 250..255 step 2 {
+        total += 1;
+    }
+
+    if (sum_of_multiples(10, 3) != 18) return 1;
+    if (count_odd(7) != 3) return 2;
+    if (total != 43) return 3;
+    return 0;
+}
@@ -0,0 +1,35 @@
+#include <time.emh>
+
+s64 square_sum(s64 n) {
+    s64 zero = n - n;
+    s64 total = zero;
+    for i in zero..n {
+        total = total + i * i;
+    }
+    return total;
+}
+
+int main() {
+    s64 start = time_now_ns();
+    u64 cycles = cycles_start();
+    black_box(square_sum(black_box(100)));
+    cycles = cycles_stop() - cycles;
+    s64 elapsed = time_now_ns() - start;
+    f64 rate = black_box_f64(cycles_per_ns());
+
+    int bench = bench_begin("square_sum");
+    while (bench_running(bench)) {
+        black_box(square_sum(black_box(100)));
+    }
+    f64 ns = bench_ns_per_iteration(bench);
+
+    // (the clock is monotonic, and the loop did take some time)
+    s64 zero = start - start;
+    if (elapsed < zero) {
+        return 1;
+    }
+    if (ns <= 0.0) {
+        return 2;
+    }
+    return 0;
+}
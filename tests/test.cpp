@@ -18,6 +18,20 @@ The list of categories that need to be tested are:
 - Assignment
 - Binary operations
 - Unary operations
+- Const declarations
+- Parallel for
+- Atomics
+- Async functions
+- Generic functions
+- Range for
+- Inline assembly
+- Parameter packs
+- Heap allocation and bulk operations (memory.emh)
+- Timing and benchmarking (time.emh)
+- Numeric literals (hex, binary, digit separators)
+- Compiler flags (-finstrument-functions, -fskip-unreachable, -fbatch-modules)
+- Incremental builds (-fincremental)
+- Language server (emc -lsp)
 
 Basic rules to follow
 
@@ -40,9 +54,141 @@ the following ideas:
 #include <vector>
 #include <iomanip>
 #include <cstdio>
+#include <iterator>
+#include <cstring>
 
 namespace fs = std::filesystem;
 
+// frames a JSON-RPC message for the language server (emc -lsp)
+static std::string lsp_message(const std::string& content)
+{
+    return "Content-Length: " + std::to_string(content.size()) + "\r\n\r\n" + content;
+}
+
+static int count_occurrences(const std::string& text, const std::string& pattern)
+{
+    int count = 0;
+    for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1))
+        count++;
+    return count;
+}
+
+// a scripted session with the language server: initialize, open a file
+// with an error in each of its two functions (so the server has to carry
+// on after the first one), fix the first one, and shut down. the requests
+// go through a file, and the answers are checked for what they must have.
+static bool run_language_server_test()
+{
+    const std::string uri = "\"file:///d%3A/lsp_test.em\"";
+    const std::string text =
+        "\"int first() {\\n    int x = 1\\n    return x;\\n}\\n"
+        "int main() {\\n    int y = 2\\n    return y;\\n}\\n\"";
+
+    std::ofstream requests("lsp_requests.txt", std::ios::binary);
+    requests << lsp_message("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"initialize\",\"params\":{}}");
+    requests << lsp_message("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didOpen\",\"params\":{\"textDocument\":{\"uri\":" +
+                            uri + ",\"languageId\":\"em\",\"version\":1,\"text\":" + text + "}}}");
+    requests << lsp_message("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didChange\",\"params\":{\"textDocument\":{\"uri\":" +
+                            uri + ",\"version\":2},\"contentChanges\":[{\"range\":{\"start\":{\"line\":1,\"character\":13},"
+                            "\"end\":{\"line\":1,\"character\":13}},\"text\":\";\"}]}}");
+    requests << lsp_message("{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"shutdown\"}");
+    requests << lsp_message("{\"jsonrpc\":\"2.0\",\"method\":\"exit\"}");
+    requests.close();
+
+    int result = system("d:/github/emc/bin/emc.exe -lsp <lsp_requests.txt >lsp_responses.txt 2>>test_logs.txt");
+
+    std::ifstream responses_file("lsp_responses.txt", std::ios::binary);
+    std::string responses((std::istreambuf_iterator<char>(responses_file)), std::istreambuf_iterator<char>());
+    responses_file.close();
+    fs::remove("lsp_requests.txt");
+    fs::remove("lsp_responses.txt");
+
+    size_t opened = responses.find("textDocument/publishDiagnostics");
+    size_t changed = (opened == std::string::npos) ? opened : responses.find("textDocument/publishDiagnostics", opened + 1);
+    if (result != 0 || changed == std::string::npos ||
+        responses.find("\"id\":1,\"result\":{\"capabilities\"") == std::string::npos ||
+        responses.find("\"id\":2,\"result\":null") == std::string::npos)
+        return false;
+
+    // both errors after the open, and only the one in main after the fix
+    std::string after_open = responses.substr(opened, changed - opened);
+    std::string after_change = responses.substr(changed);
+    return count_occurrences(after_open, "\"code\":\"E045\"") == 2 &&
+           count_occurrences(after_change, "\"code\":\"E045\"") == 1 &&
+           after_change.find("\"start\":{\"line\":6,") != std::string::npos;
+}
+
+// builds the program with -fincremental (and -benchmark), runs it, and
+// gives back its exit code, along with the number of functions reused
+static int build_incrementally(int& reused)
+{
+    int result = system("d:/github/emc/bin/emc.exe incremental_test.em -O2 -fincremental -benchmark "
+                        "-o incremental_test >incremental_output.txt 2>>test_logs.txt");
+    std::ifstream output_file("incremental_output.txt");
+    std::string output((std::istreambuf_iterator<char>(output_file)), std::istreambuf_iterator<char>());
+    output_file.close();
+
+    size_t pos = output.find("Functions reused:");
+    reused = (pos == std::string::npos) ? -1 : std::stoi(output.substr(pos + strlen("Functions reused:")));
+    if (result != 0 || reused < 0)
+        return -1;
+    return system("incremental_test.exe");
+}
+
+// a program that is built with -fincremental: from an empty cache, then
+// again as it is, then with one of its functions changed, and then with
+// the pack of the cache broken (when everything is emitted again). its
+// exit code is the product of two functions, so it shows whether the
+// build has the change.
+static bool run_incremental_test()
+{
+    const std::string program =
+        "int base() {\n    return 10;\n}\n"
+        "int scale() {\n    return 3;\n}\n"
+        "int product() {\n    return base() * scale();\n}\n"
+        "int main() {\n    return product();\n}\n";
+    fs::remove_all("emc-cache");
+    std::ofstream("incremental_test.em") << program;
+
+    int cold_reused, warm_reused, changed_reused, broken_reused;
+    bool passed = build_incrementally(cold_reused) == 30 && cold_reused == 0 &&
+                  build_incrementally(warm_reused) == 30 && warm_reused > 0;
+
+    // (scale returns 4 now)
+    std::string changed = program;
+    changed[changed.find("return 3;") + strlen("return ")] = '4';
+    std::ofstream("incremental_test.em") << changed;
+    passed = passed && build_incrementally(changed_reused) == 40 && changed_reused > 0;
+
+    // (the index is still there, but its pack can't be read)
+    for (const auto& entry : fs::directory_iterator("emc-cache")) {
+        if (entry.path().extension() == ".bc")
+            std::ofstream(entry.path(), std::ios::binary | std::ios::trunc) << "not bitcode";
+    }
+    passed = passed && build_incrementally(broken_reused) == 40 && broken_reused == 0;
+
+    fs::remove_all("emc-cache");
+    fs::remove("incremental_test.em");
+    fs::remove("incremental_test.exe");
+    fs::remove("incremental_output.txt");
+    return passed;
+}
+
+// positive test files that are compiled again with a flag, for the code
+// that only that flag brings in (such as the profiling runtime), and the
+// programs that are split over several files (in multi_file/)
+struct Flag_Test {
+    std::string files;
+    std::string flags;
+};
+
+static const std::vector<Flag_Test> flag_tests = {
+    { "positive/async_basic.em", "-finstrument-functions" },
+    { "positive/parallel_for_typical.em", "-finstrument-functions" },
+    { "multi_file/main.em multi_file/library.em", "-fskip-unreachable" },
+    { "multi_file/main.em multi_file/library.em", "-fbatch-modules" },
+};
+
 // to run the tests
 int main()
 {
@@ -102,5 +248,27 @@ int main()
         std::cout << std::left << std::setw(50) << file << (status == "passed" ? "\033[32mpassed\033[0m" : "\033[31mfailed\033[0m") << std::endl;
     }
 
+    // Run the flag tests
+    std::cout << "\nRunning Flag Test Cases:" << std::endl;
+    std::cout << "=============================" << std::endl;
+    for (const auto& test : flag_tests) {
+        std::string command = "d:/github/emc/bin/emc.exe " + test.files + " " + test.flags + " >nul 2>>test_logs.txt";
+        int result = system(command.c_str());
+        std::string status = (result == 0) ? "passed" : "failed";
+        std::cout << std::left << std::setw(50) << (test.files + " " + test.flags) << (status == "passed" ? "\033[32mpassed\033[0m" : "\033[31mfailed\033[0m") << std::endl;
+    }
+
+    // Run the incremental build test
+    std::cout << "\nRunning Incremental Build Test:" << std::endl;
+    std::cout << "=============================" << std::endl;
+    bool incremental_passed = run_incremental_test();
+    std::cout << std::left << std::setw(50) << "emc -fincremental (four builds)" << (incremental_passed ? "\033[32mpassed\033[0m" : "\033[31mfailed\033[0m") << std::endl;
+
+    // Run the language server test
+    std::cout << "\nRunning Language Server Test:" << std::endl;
+    std::cout << "=============================" << std::endl;
+    bool lsp_passed = run_language_server_test();
+    std::cout << std::left << std::setw(50) << "emc -lsp (scripted session)" << (lsp_passed ? "\033[32mpassed\033[0m" : "\033[31mfailed\033[0m") << std::endl;
+
     return 0;
 }